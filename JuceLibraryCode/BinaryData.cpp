@@ -17,16 +17,61 @@ static const unsigned char temp_binary_data_0[] =
 "    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
 " \n"
 "    Fragment Shader\n"
-"    This fragment shader simply colors all shape fragments with a purple color.\n"
+"    This fragment shader colors all shape fragments with the colour of the\n"
+"    object they belong to, optionally modulated by a texture and lit by a\n"
+"    headlight, depending on the #defines of the program variant. With\n"
+"    WEIGHTED_BLENDED_OIT it writes the two transparency targets instead.\n"
 "*/\n"
 "\n"
 "#version 330 core\n"
+"in vec4 vertexColour;\n"
+"\n"
+"#ifdef HAS_NORMALS\n"
+"in vec3 vertexNormal;\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_TEXTURE_COORDINATES\n"
+"#ifdef HAS_TEXTURE_LAYERS\n"
+"in vec3 vertexTextureCoordinate;\n"
+"uniform sampler2DArray colourTexture;\n"
+"#else\n"
+"in vec2 vertexTextureCoordinate;\n"
+"uniform sampler2D colourTexture;\n"
+"#endif\n"
+"#endif\n"
+"\n"
+"#ifdef WEIGHTED_BLENDED_OIT\n"
+"layout (location = 0) out vec4 accumulation;\n"
+"layout (location = 1) out vec4 weightSum;\n"
+"#else\n"
 "out vec4 fragColor;\n"
+"#endif\n"
 "\n"
 "void main()\n"
 "{\n"
-"    fragColor = vec4 (0.6f, 0.1f, 1.0f, 0.8f);\n"
-"} \n";
+"    vec4 colour = vertexColour;\n"
+"\n"
+"#ifdef HAS_TEXTURE_COORDINATES\n"
+"    colour *= texture (colourTexture, vertexTextureCoordinate);\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_NORMALS\n"
+"    // Headlight: the light shines along the view direction\n"
+"    float diffuse = max (dot (normalize (vertexNormal), vec3 (0.0, 0.0, 1.0)), 0.0);\n"
+"    colour.rgb *= 0.2 + 0.8 * diffuse;\n"
+"#endif\n"
+"\n"
+"#ifdef WEIGHTED_BLENDED_OIT\n"
+"    // Nearer and more opaque surfaces count for more, equation 10 of\n"
+"    // McGuire and Bavoil, in terms of window depth\n"
+"    float weight = clamp (pow (min (1.0, colour.a * 10.0) + 0.01, 3.0) * 1.0e8\n"
+"                          * pow (1.0 - gl_FragCoord.z * 0.9, 3.0), 1.0e-2, 3.0e3);\n"
+"    accumulation = vec4 (colour.rgb * colour.a * weight, colour.a);\n"
+"    weightSum = vec4 (colour.a * weight);\n"
+"#else\n"
+"    fragColor = colour;\n"
+"#endif\n"
+"}\n";
 
 const char* BasicFragment_glsl = (const char*) temp_binary_data_0;
 
@@ -40,25 +85,398 @@ static const unsigned char temp_binary_data_1[] =
 "    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
 " \n"
 "    Vertex Shader\n"
-"    This vertex shader takes the object vertices and applies view and projection\n"
-"    based transformations to those vertices.\n"
+"    This vertex shader takes the object vertices and applies model, view and\n"
+"    projection based transformations to those vertices. The camera matrices come\n"
+"    from a uniform buffer shared by every program, the model matrix and colour\n"
+"    from a per-object uniform buffer record.\n"
+" \n"
+"    Optional inputs are enabled per program variant by the #defines listed in\n"
+"    Source/ShaderFeatures.hpp.\n"
 "*/\n"
 "\n"
 "#version 330 core\n"
 "layout (location = 0) in vec3 position;\n"
 "\n"
-"uniform mat4 projectionMatrix;\n"
-"uniform mat4 viewMatrix;\n"
+"#ifdef HAS_NORMALS\n"
+"layout (location = 1) in vec3 normal;\n"
+"out vec3 vertexNormal;\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_TEXTURE_COORDINATES\n"
+"#ifdef HAS_TEXTURE_LAYERS\n"
+"layout (location = 2) in vec3 textureCoordinate; // Texture array layer in z\n"
+"out vec3 vertexTextureCoordinate;\n"
+"#else\n"
+"layout (location = 2) in vec2 textureCoordinate;\n"
+"out vec2 vertexTextureCoordinate;\n"
+"#endif\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_VERTEX_COLOURS\n"
+"layout (location = 7) in vec4 colour; // Multiplies the object's colour\n"
+"#endif\n"
+"\n"
+"layout (std140) uniform CameraUniforms\n"
+"{\n"
+"    mat4 projectionMatrix;\n"
+"    mat4 viewMatrix;\n"
+"};\n"
+"\n"
+"layout (std140) uniform ObjectUniforms\n"
+"{\n"
+"    mat4 modelMatrix;\n"
+"    vec4 objectColour;\n"
+"};\n"
+"\n"
+"out vec4 vertexColour;\n"
+"\n"
+"// Depth-only variants must produce exactly the same depth for GL_EQUAL to pass\n"
+"invariant gl_Position;\n"
 "\n"
 "void main()\n"
 "{\n"
-"    gl_Position = projectionMatrix * viewMatrix * vec4 (position.x, position.y, position.z, 1.0);\n"
+"#ifdef HAS_VERTEX_COLOURS\n"
+"    vertexColour = objectColour * colour;\n"
+"#else\n"
+"    vertexColour = objectColour;\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_NORMALS\n"
+"    vertexNormal = mat3 (viewMatrix * modelMatrix) * normal;\n"
+"#endif\n"
+"\n"
+"#ifdef HAS_TEXTURE_COORDINATES\n"
+"    vertexTextureCoordinate = textureCoordinate;\n"
+"#endif\n"
+"\n"
+"    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4 (position.x, position.y, position.z, 1.0);\n"
 "}\n";
 
 const char* BasicVertex_glsl = (const char*) temp_binary_data_1;
 
-//================== teapot.obj ==================
+//================== OcclusionBoxFragment.glsl ==================
 static const unsigned char temp_binary_data_2[] =
+"/*\n"
+"    OcclusionBoxFragment.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Fragment Shader\n"
+"    Writes nothing. Occlusion queries only count the samples that pass the\n"
+"    depth test, and colour writes are masked off while they run.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"\n"
+"void main()\n"
+"{\n"
+"}\n";
+
+const char* OcclusionBoxFragment_glsl = (const char*) temp_binary_data_2;
+
+//================== OcclusionBoxVertex.glsl ==================
+static const unsigned char temp_binary_data_3[] =
+"/*\n"
+"    OcclusionBoxVertex.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Vertex Shader\n"
+"    Places one corner of an object's bounding box for an occlusion query.\n"
+"    The box is a unit cube stretched over the mesh's local bounds, then\n"
+"    transformed like the mesh itself, so it covers every pixel the object\n"
+"    could cover.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"layout (location = 0) in vec3 position; // 0 to 1 along each axis\n"
+"\n"
+"layout (std140) uniform CameraUniforms\n"
+"{\n"
+"    mat4 projectionMatrix;\n"
+"    mat4 viewMatrix;\n"
+"};\n"
+"\n"
+"layout (std140) uniform ObjectUniforms\n"
+"{\n"
+"    mat4 modelMatrix;\n"
+"    vec4 objectColour;\n"
+"};\n"
+"\n"
+"uniform vec3 boxMin;\n"
+"uniform vec3 boxSize;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4 (boxMin + position * boxSize, 1.0);\n"
+"}\n";
+
+const char* OcclusionBoxVertex_glsl = (const char*) temp_binary_data_3;
+
+//================== SharpeningUpscaleFragment.glsl ==================
+static const unsigned char temp_binary_data_4[] =
+"/*\n"
+"    SharpeningUpscaleFragment.glsl\n"
+"    OpenGL 3D App Template - App\n"
+"\n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+"\n"
+"    Fragment Shader\n"
+"    Stretches a scene rendered at reduced resolution over the viewport and\n"
+"    restores some of the detail lost to the bilinear stretch, in the spirit\n"
+"    of contrast adaptive sharpening: a negative lobe from the four\n"
+"    neighbouring texels, strongest where the local contrast is lowest, so\n"
+"    edges that are already sharp don't ring.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"in vec2 targetCoordinate;\n"
+"\n"
+"uniform sampler2D sourceTexture;\n"
+"uniform vec2 sourceScale;   // The rendered part of the texture, from its bottom left\n"
+"uniform float sharpness;    // 0 to 1\n"
+"\n"
+"out vec4 fragColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec2 texel = 1.0 / vec2 (textureSize (sourceTexture, 0));\n"
+"\n"
+"    // Stay inside the rendered part, or the edges pick up stale texels\n"
+"    vec2 lowest = 0.5 * texel;\n"
+"    vec2 highest = sourceScale - 0.5 * texel;\n"
+"    vec2 centreCoordinate = clamp (targetCoordinate * sourceScale, lowest, highest);\n"
+"\n"
+"    vec3 centre = texture (sourceTexture, centreCoordinate).rgb;\n"
+"    vec3 north = texture (sourceTexture, clamp (centreCoordinate + vec2 (0.0, texel.y), lowest, highest)).rgb;\n"
+"    vec3 south = texture (sourceTexture, clamp (centreCoordinate - vec2 (0.0, texel.y), lowest, highest)).rgb;\n"
+"    vec3 east = texture (sourceTexture, clamp (centreCoordinate + vec2 (texel.x, 0.0), lowest, highest)).rgb;\n"
+"    vec3 west = texture (sourceTexture, clamp (centreCoordinate - vec2 (texel.x, 0.0), lowest, highest)).rgb;\n"
+"\n"
+"    vec3 minimum = min (centre, min (min (north, south), min (east, west)));\n"
+"    vec3 maximum = max (centre, max (max (north, south), max (east, west)));\n"
+"\n"
+"    // Near 1 in flat areas, near 0 next to black or white, where sharpening would clip\n"
+"    vec3 amplitude = sqrt (clamp (min (minimum, 1.0 - maximum) / max (maximum, 1.0e-4), 0.0, 1.0));\n"
+"    vec3 weight = -amplitude / mix (8.0, 5.0, clamp (sharpness, 0.0, 1.0));\n"
+"\n"
+"    vec3 colour = (centre + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);\n"
+"    fragColor = vec4 (clamp (colour, 0.0, 1.0), 1.0);\n"
+"}\n";
+
+const char* SharpeningUpscaleFragment_glsl = (const char*) temp_binary_data_4;
+
+//================== SpectrogramFragment.glsl ==================
+static const unsigned char temp_binary_data_5[] =
+"/*\n"
+"    SpectrogramFragment.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Fragment Shader\n"
+"    The level texture holds one column per spectrum, written at an index that\n"
+"    wraps around instead of moving the older columns. Scrolling is just an\n"
+"    offset added to the texture x coordinate here, with GL_REPEAT doing the\n"
+"    wrapping. Levels are coloured through a one row colour map texture.\n"
+"    Drawn over FullScreenQuadVertex.glsl.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"\n"
+"in vec2 targetCoordinate; // x: oldest column 0 to newest 1, y: lowest bin 0 to highest 1\n"
+"out vec4 fragmentColour;\n"
+"\n"
+"uniform sampler2D levelTexture;\n"
+"uniform sampler2D colourMapTexture;\n"
+"\n"
+"uniform float oldestColumn; // Texture x of the centre of the oldest column\n"
+"uniform float columnSpan;   // Texture x distance from the oldest column's centre to the newest's\n"
+"\n"
+"void main()\n"
+"{\n"
+"    // Centre to centre, so filtering never blends the newest column into the oldest\n"
+"    float x = oldestColumn + targetCoordinate.x * columnSpan;\n"
+"    float level = texture (levelTexture, vec2 (x, targetCoordinate.y)).r;\n"
+"    fragmentColour = texture (colourMapTexture, vec2 (level, 0.5));\n"
+"}\n";
+
+const char* SpectrogramFragment_glsl = (const char*) temp_binary_data_5;
+
+//================== TerrainFragment.glsl ==================
+static const unsigned char temp_binary_data_6[] =
+"/*\n"
+"    TerrainFragment.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Fragment Shader\n"
+"    Colours the terrain by slope, grass on the flat and rock on the steep,\n"
+"    lit by a fixed sun.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"in vec3 terrainNormal;\n"
+"\n"
+"out vec4 fragColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec3 normal = normalize (terrainNormal);\n"
+"    vec3 grass = vec3 (0.28, 0.45, 0.2);\n"
+"    vec3 rock = vec3 (0.45, 0.4, 0.36);\n"
+"    vec3 colour = mix (grass, rock, smoothstep (0.15, 0.4, 1.0 - normal.y));\n"
+"\n"
+"    float diffuse = max (dot (normal, normalize (vec3 (0.4, 0.8, 0.3))), 0.0);\n"
+"    fragColor = vec4 (colour * (0.25 + 0.75 * diffuse), 1.0);\n"
+"}\n";
+
+const char* TerrainFragment_glsl = (const char*) temp_binary_data_6;
+
+//================== TerrainVertex.glsl ==================
+static const unsigned char temp_binary_data_7[] =
+"/*\n"
+"    TerrainVertex.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Vertex Shader\n"
+"    Places one vertex of a clipmap level's grid. The grid holds integer cell\n"
+"    coordinates shared by every level; the level's spacing and origin put\n"
+"    them in the world, and its layer of the height texture array raises them.\n"
+"    Heights are stored toroidally, so texel coordinates wrap around the\n"
+"    texture. Near the level's outer edge heights blend into the next coarser\n"
+"    level's, which hides the seam between them.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"layout (location = 0) in vec2 gridPosition;\n"
+"\n"
+"layout (std140) uniform CameraUniforms\n"
+"{\n"
+"    mat4 projectionMatrix;\n"
+"    mat4 viewMatrix;\n"
+"};\n"
+"\n"
+"uniform sampler2DArray heights;\n"
+"uniform int level;\n"
+"uniform float spacing;                  // World distance between vertices of this level\n"
+"uniform float gridSize;                 // Cells along each side of a level\n"
+"uniform vec2 levelOrigin;               // World xz of the grid's first vertex\n"
+"uniform vec2 textureOffset;             // Texel of the grid's first vertex\n"
+"uniform vec2 coarserTextureOffset;      // Texel of the same point in the coarser level\n"
+"uniform vec2 viewerPosition;            // Camera, in cells from the grid's first vertex\n"
+"uniform int hasCoarserLevel;\n"
+"\n"
+"out vec3 terrainNormal;\n"
+"\n"
+"float fetchHeight (ivec2 offset)\n"
+"{\n"
+"    int size = textureSize (heights, 0).x;\n"
+"    ivec2 texel = (ivec2 (gridPosition + textureOffset) + offset + size) % size;\n"
+"    return texelFetch (heights, ivec3 (texel, level), 0).r;\n"
+"}\n"
+"\n"
+"void main()\n"
+"{\n"
+"    float height = fetchHeight (ivec2 (0, 0));\n"
+"\n"
+"    if (hasCoarserLevel != 0)\n"
+"    {\n"
+"        // 0 inside, rising to 1 over the last tenth of the grid before the edge\n"
+"        float transitionWidth = 0.1 * gridSize;\n"
+"        vec2 distance = abs (gridPosition - viewerPosition);\n"
+"        vec2 blend = clamp ((distance - (0.5 * gridSize - transitionWidth - 2.0)) / transitionWidth, 0.0, 1.0);\n"
+"\n"
+"        // Halfway between coarser texels, linear filtering gives the height of the coarser grid's edge\n"
+"        vec2 coarserCoordinate = (gridPosition * 0.5 + coarserTextureOffset + 0.5) / vec2 (textureSize (heights, 0).xy);\n"
+"        float coarserHeight = texture (heights, vec3 (coarserCoordinate, float (level + 1))).r;\n"
+"\n"
+"        height = mix (height, coarserHeight, max (blend.x, blend.y));\n"
+"    }\n"
+"\n"
+"    terrainNormal = normalize (vec3 (fetchHeight (ivec2 (-1, 0)) - fetchHeight (ivec2 (1, 0)),\n"
+"                                     2.0 * spacing,\n"
+"                                     fetchHeight (ivec2 (0, -1)) - fetchHeight (ivec2 (0, 1))));\n"
+"\n"
+"    vec3 worldPosition = vec3 (levelOrigin.x + gridPosition.x * spacing, height, levelOrigin.y + gridPosition.y * spacing);\n"
+"    gl_Position = projectionMatrix * viewMatrix * vec4 (worldPosition, 1.0);\n"
+"}\n";
+
+const char* TerrainVertex_glsl = (const char*) temp_binary_data_7;
+
+//================== TransparencyCompositeFragment.glsl ==================
+static const unsigned char temp_binary_data_8[] =
+"/*\n"
+"    TransparencyCompositeFragment.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Fragment Shader\n"
+"    Resolves the weighted blended transparency targets: the weighted average\n"
+"    colour of every transparent surface at the pixel, with the coverage they\n"
+"    add up to as alpha. Blend it over the opaque scene with\n"
+"    (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"in vec2 targetCoordinate;\n"
+"\n"
+"uniform sampler2D accumulationTexture; // Sum of colour * alpha * weight, revealage in alpha\n"
+"uniform sampler2D weightTexture;       // Sum of alpha * weight\n"
+"\n"
+"out vec4 fragColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec4 accumulation = texture (accumulationTexture, targetCoordinate);\n"
+"    float revealage = accumulation.a;\n"
+"\n"
+"    // Nothing transparent here\n"
+"    if (revealage >= 1.0)\n"
+"        discard;\n"
+"\n"
+"    float weightSum = texture (weightTexture, targetCoordinate).r;\n"
+"    fragColor = vec4 (accumulation.rgb / max (weightSum, 1.0e-5), 1.0 - revealage);\n"
+"}\n";
+
+const char* TransparencyCompositeFragment_glsl = (const char*) temp_binary_data_8;
+
+//================== FullScreenQuadVertex.glsl ==================
+static const unsigned char temp_binary_data_9[] =
+"/*\n"
+"    FullScreenQuadVertex.glsl\n"
+"    OpenGL 3D App Template - App\n"
+" \n"
+"    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.\n"
+" \n"
+"    Vertex Shader\n"
+"    Covers the viewport with a quad made from gl_VertexID alone, for\n"
+"    full-screen passes such as the transparency composite, the dynamic\n"
+"    resolution upscale and the spectrogram. Draw 4 vertices as a triangle strip, with an empty\n"
+"    vertex array bound.\n"
+"*/\n"
+"\n"
+"#version 330 core\n"
+"\n"
+"out vec2 targetCoordinate;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    vec2 corner = vec2 (gl_VertexID & 1, gl_VertexID >> 1);\n"
+"    targetCoordinate = corner;\n"
+"    gl_Position = vec4 (corner * 2.0 - 1.0, 0.0, 1.0);\n"
+"}\n";
+
+const char* FullScreenQuadVertex_glsl = (const char*) temp_binary_data_9;
+
+//================== teapot.obj ==================
+static const unsigned char temp_binary_data_10[] =
 { 35,32,77,97,120,50,79,98,106,32,86,101,114,115,105,111,110,32,52,46,48,32,77,97,114,32,49,48,116,104,44,32,50,48,48,49,10,35,10,35,32,111,98,106,101,99,116,32,84,101,97,112,111,116,48,49,32,116,111,32,99,111,109,101,32,46,46,46,10,35,10,118,32,32,53,
 46,57,50,57,54,56,56,32,52,46,49,50,53,48,48,48,32,48,46,48,48,48,48,48,48,10,118,32,32,53,46,56,51,50,48,51,49,32,52,46,52,57,52,49,52,49,32,48,46,48,48,48,48,48,48,10,118,32,32,53,46,57,52,53,51,49,51,32,52,46,54,49,55,49,56,56,32,48,46,48,48,48,48,
 48,48,10,118,32,32,54,46,49,55,53,55,56,49,32,52,46,52,57,52,49,52,49,32,48,46,48,48,48,48,48,48,10,118,32,32,54,46,52,50,57,54,56,56,32,52,46,49,50,53,48,48,48,32,48,46,48,48,48,48,48,48,10,118,32,32,53,46,51,56,55,49,56,56,32,52,46,49,50,53,48,48,48,
@@ -1212,7 +1630,7 @@ static const unsigned char temp_binary_data_2[] =
 55,57,52,47,53,50,57,32,52,54,57,47,55,57,57,47,52,54,57,32,52,55,48,47,56,48,48,47,52,55,48,10,102,32,52,55,48,47,56,48,48,47,52,55,48,32,53,51,48,47,55,57,53,47,53,51,48,32,53,50,57,47,55,57,52,47,53,50,57,10,35,32,57,57,50,32,102,97,99,101,115,10,
 10,103,10,0,0 };
 
-const char* teapot_obj = (const char*) temp_binary_data_2;
+const char* teapot_obj = (const char*) temp_binary_data_10;
 
 
 const char* getNamedResource (const char* resourceNameUTF8, int& numBytes)
@@ -1225,8 +1643,16 @@ const char* getNamedResource (const char* resourceNameUTF8, int& numBytes)
 
     switch (hash)
     {
-        case 0xc2ac111f:  numBytes = 383; return BasicFragment_glsl;
-        case 0xa72632cb:  numBytes = 552; return BasicVertex_glsl;
+        case 0xc2ac111f:  numBytes = 1768; return BasicFragment_glsl;
+        case 0xa72632cb:  numBytes = 1844; return BasicVertex_glsl;
+        case 0xb9f4420f:  numBytes = 341; return OcclusionBoxFragment_glsl;
+        case 0xbfa5dfbb:  numBytes = 832; return OcclusionBoxVertex_glsl;
+        case 0x2e23eeed:  numBytes = 2118; return SharpeningUpscaleFragment_glsl;
+        case 0xfddb5040:  numBytes = 1192; return SpectrogramFragment_glsl;
+        case 0xf6e72d78:  numBytes = 684; return TerrainFragment_glsl;
+        case 0xaffe9164:  numBytes = 2812; return TerrainVertex_glsl;
+        case 0xf4a770de:  numBytes = 1012; return TransparencyCompositeFragment_glsl;
+        case 0x24b94677:  numBytes = 632; return FullScreenQuadVertex_glsl;
         case 0x754c69fd:  numBytes = 95000; return teapot_obj;
         default: break;
     }
@@ -1239,6 +1665,14 @@ const char* namedResourceList[] =
 {
     "BasicFragment_glsl",
     "BasicVertex_glsl",
+    "OcclusionBoxFragment_glsl",
+    "OcclusionBoxVertex_glsl",
+    "SharpeningUpscaleFragment_glsl",
+    "SpectrogramFragment_glsl",
+    "TerrainFragment_glsl",
+    "TerrainVertex_glsl",
+    "TransparencyCompositeFragment_glsl",
+    "FullScreenQuadVertex_glsl",
     "teapot_obj"
 };
 
@@ -1246,6 +1680,14 @@ const char* originalFilenames[] =
 {
     "BasicFragment.glsl",
     "BasicVertex.glsl",
+    "OcclusionBoxFragment.glsl",
+    "OcclusionBoxVertex.glsl",
+    "SharpeningUpscaleFragment.glsl",
+    "SpectrogramFragment.glsl",
+    "TerrainFragment.glsl",
+    "TerrainVertex.glsl",
+    "TransparencyCompositeFragment.glsl",
+    "FullScreenQuadVertex.glsl",
     "teapot.obj"
 };
 
@@ -9,16 +9,40 @@
 namespace BinaryData
 {
     extern const char*   BasicFragment_glsl;
-    const int            BasicFragment_glslSize = 383;
+    const int            BasicFragment_glslSize = 1768;
 
     extern const char*   BasicVertex_glsl;
-    const int            BasicVertex_glslSize = 552;
+    const int            BasicVertex_glslSize = 1844;
+
+    extern const char*   OcclusionBoxFragment_glsl;
+    const int            OcclusionBoxFragment_glslSize = 341;
+
+    extern const char*   OcclusionBoxVertex_glsl;
+    const int            OcclusionBoxVertex_glslSize = 832;
+
+    extern const char*   SharpeningUpscaleFragment_glsl;
+    const int            SharpeningUpscaleFragment_glslSize = 2118;
+
+    extern const char*   SpectrogramFragment_glsl;
+    const int            SpectrogramFragment_glslSize = 1192;
+
+    extern const char*   TerrainFragment_glsl;
+    const int            TerrainFragment_glslSize = 684;
+
+    extern const char*   TerrainVertex_glsl;
+    const int            TerrainVertex_glslSize = 2812;
+
+    extern const char*   TransparencyCompositeFragment_glsl;
+    const int            TransparencyCompositeFragment_glslSize = 1012;
+
+    extern const char*   FullScreenQuadVertex_glsl;
+    const int            FullScreenQuadVertex_glslSize = 632;
 
     extern const char*   teapot_obj;
     const int            teapot_objSize = 95000;
 
     // Number of elements in the namedResourceList and originalFileNames arrays.
-    const int namedResourceListSize = 3;
+    const int namedResourceListSize = 11;
 
     // Points to the start of a list of resource names.
     extern const char* namedResourceList[];
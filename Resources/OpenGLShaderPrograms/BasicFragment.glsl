@@ -6,13 +6,58 @@
     Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
  
     Fragment Shader
-    This fragment shader simply colors all shape fragments with a purple color.
+    This fragment shader colors all shape fragments with the colour of the
+    object they belong to, optionally modulated by a texture and lit by a
+    headlight, depending on the #defines of the program variant. With
+    WEIGHTED_BLENDED_OIT it writes the two transparency targets instead.
 */
 
 #version 330 core
+in vec4 vertexColour;
+
+#ifdef HAS_NORMALS
+in vec3 vertexNormal;
+#endif
+
+#ifdef HAS_TEXTURE_COORDINATES
+#ifdef HAS_TEXTURE_LAYERS
+in vec3 vertexTextureCoordinate;
+uniform sampler2DArray colourTexture;
+#else
+in vec2 vertexTextureCoordinate;
+uniform sampler2D colourTexture;
+#endif
+#endif
+
+#ifdef WEIGHTED_BLENDED_OIT
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out vec4 weightSum;
+#else
 out vec4 fragColor;
+#endif
 
 void main()
 {
-    fragColor = vec4 (0.6f, 0.1f, 1.0f, 0.8f);
-} 
+    vec4 colour = vertexColour;
+
+#ifdef HAS_TEXTURE_COORDINATES
+    colour *= texture (colourTexture, vertexTextureCoordinate);
+#endif
+
+#ifdef HAS_NORMALS
+    // Headlight: the light shines along the view direction
+    float diffuse = max (dot (normalize (vertexNormal), vec3 (0.0, 0.0, 1.0)), 0.0);
+    colour.rgb *= 0.2 + 0.8 * diffuse;
+#endif
+
+#ifdef WEIGHTED_BLENDED_OIT
+    // Nearer and more opaque surfaces count for more, equation 10 of
+    // McGuire and Bavoil, in terms of window depth
+    float weight = clamp (pow (min (1.0, colour.a * 10.0) + 0.01, 3.0) * 1.0e8
+                          * pow (1.0 - gl_FragCoord.z * 0.9, 3.0), 1.0e-2, 3.0e3);
+    accumulation = vec4 (colour.rgb * colour.a * weight, colour.a);
+    weightSum = vec4 (colour.a * weight);
+#else
+    fragColor = colour;
+#endif
+}
@@ -6,17 +6,69 @@
     Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
  
     Vertex Shader
-    This vertex shader takes the object vertices and applies view and projection
-    based transformations to those vertices.
+    This vertex shader takes the object vertices and applies model, view and
+    projection based transformations to those vertices. The camera matrices come
+    from a uniform buffer shared by every program, the model matrix and colour
+    from a per-object uniform buffer record.
+ 
+    Optional inputs are enabled per program variant by the #defines listed in
+    Source/ShaderFeatures.hpp.
 */
 
 #version 330 core
 layout (location = 0) in vec3 position;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
+#ifdef HAS_NORMALS
+layout (location = 1) in vec3 normal;
+out vec3 vertexNormal;
+#endif
+
+#ifdef HAS_TEXTURE_COORDINATES
+#ifdef HAS_TEXTURE_LAYERS
+layout (location = 2) in vec3 textureCoordinate; // Texture array layer in z
+out vec3 vertexTextureCoordinate;
+#else
+layout (location = 2) in vec2 textureCoordinate;
+out vec2 vertexTextureCoordinate;
+#endif
+#endif
+
+#ifdef HAS_VERTEX_COLOURS
+layout (location = 7) in vec4 colour; // Multiplies the object's colour
+#endif
+
+layout (std140) uniform CameraUniforms
+{
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+layout (std140) uniform ObjectUniforms
+{
+    mat4 modelMatrix;
+    vec4 objectColour;
+};
+
+out vec4 vertexColour;
+
+// Depth-only variants must produce exactly the same depth for GL_EQUAL to pass
+invariant gl_Position;
 
 void main()
 {
-    gl_Position = projectionMatrix * viewMatrix * vec4 (position.x, position.y, position.z, 1.0);
+#ifdef HAS_VERTEX_COLOURS
+    vertexColour = objectColour * colour;
+#else
+    vertexColour = objectColour;
+#endif
+
+#ifdef HAS_NORMALS
+    vertexNormal = mat3 (viewMatrix * modelMatrix) * normal;
+#endif
+
+#ifdef HAS_TEXTURE_COORDINATES
+    vertexTextureCoordinate = textureCoordinate;
+#endif
+
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4 (position.x, position.y, position.z, 1.0);
 }
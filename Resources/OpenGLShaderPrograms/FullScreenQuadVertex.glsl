@@ -0,0 +1,23 @@
+/*
+    FullScreenQuadVertex.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Vertex Shader
+    Covers the viewport with a quad made from gl_VertexID alone, for
+    full-screen passes such as the transparency composite, the dynamic
+    resolution upscale and the spectrogram. Draw 4 vertices as a triangle strip, with an empty
+    vertex array bound.
+*/
+
+#version 330 core
+
+out vec2 targetCoordinate;
+
+void main()
+{
+    vec2 corner = vec2 (gl_VertexID & 1, gl_VertexID >> 1);
+    targetCoordinate = corner;
+    gl_Position = vec4 (corner * 2.0 - 1.0, 0.0, 1.0);
+}
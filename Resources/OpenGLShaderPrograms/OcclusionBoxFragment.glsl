@@ -0,0 +1,16 @@
+/*
+    OcclusionBoxFragment.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Fragment Shader
+    Writes nothing. Occlusion queries only count the samples that pass the
+    depth test, and colour writes are masked off while they run.
+*/
+
+#version 330 core
+
+void main()
+{
+}
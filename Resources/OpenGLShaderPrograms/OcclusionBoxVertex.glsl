@@ -0,0 +1,35 @@
+/*
+    OcclusionBoxVertex.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Vertex Shader
+    Places one corner of an object's bounding box for an occlusion query.
+    The box is a unit cube stretched over the mesh's local bounds, then
+    transformed like the mesh itself, so it covers every pixel the object
+    could cover.
+*/
+
+#version 330 core
+layout (location = 0) in vec3 position; // 0 to 1 along each axis
+
+layout (std140) uniform CameraUniforms
+{
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+layout (std140) uniform ObjectUniforms
+{
+    mat4 modelMatrix;
+    vec4 objectColour;
+};
+
+uniform vec3 boxMin;
+uniform vec3 boxSize;
+
+void main()
+{
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4 (boxMin + position * boxSize, 1.0);
+}
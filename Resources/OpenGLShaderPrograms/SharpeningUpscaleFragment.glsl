@@ -0,0 +1,48 @@
+/*
+    SharpeningUpscaleFragment.glsl
+    OpenGL 3D App Template - App
+
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+
+    Fragment Shader
+    Stretches a scene rendered at reduced resolution over the viewport and
+    restores some of the detail lost to the bilinear stretch, in the spirit
+    of contrast adaptive sharpening: a negative lobe from the four
+    neighbouring texels, strongest where the local contrast is lowest, so
+    edges that are already sharp don't ring.
+*/
+
+#version 330 core
+in vec2 targetCoordinate;
+
+uniform sampler2D sourceTexture;
+uniform vec2 sourceScale;   // The rendered part of the texture, from its bottom left
+uniform float sharpness;    // 0 to 1
+
+out vec4 fragColor;
+
+void main()
+{
+    vec2 texel = 1.0 / vec2 (textureSize (sourceTexture, 0));
+
+    // Stay inside the rendered part, or the edges pick up stale texels
+    vec2 lowest = 0.5 * texel;
+    vec2 highest = sourceScale - 0.5 * texel;
+    vec2 centreCoordinate = clamp (targetCoordinate * sourceScale, lowest, highest);
+
+    vec3 centre = texture (sourceTexture, centreCoordinate).rgb;
+    vec3 north = texture (sourceTexture, clamp (centreCoordinate + vec2 (0.0, texel.y), lowest, highest)).rgb;
+    vec3 south = texture (sourceTexture, clamp (centreCoordinate - vec2 (0.0, texel.y), lowest, highest)).rgb;
+    vec3 east = texture (sourceTexture, clamp (centreCoordinate + vec2 (texel.x, 0.0), lowest, highest)).rgb;
+    vec3 west = texture (sourceTexture, clamp (centreCoordinate - vec2 (texel.x, 0.0), lowest, highest)).rgb;
+
+    vec3 minimum = min (centre, min (min (north, south), min (east, west)));
+    vec3 maximum = max (centre, max (max (north, south), max (east, west)));
+
+    // Near 1 in flat areas, near 0 next to black or white, where sharpening would clip
+    vec3 amplitude = sqrt (clamp (min (minimum, 1.0 - maximum) / max (maximum, 1.0e-4), 0.0, 1.0));
+    vec3 weight = -amplitude / mix (8.0, 5.0, clamp (sharpness, 0.0, 1.0));
+
+    vec3 colour = (centre + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    fragColor = vec4 (clamp (colour, 0.0, 1.0), 1.0);
+}
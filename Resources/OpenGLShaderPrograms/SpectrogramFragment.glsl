@@ -0,0 +1,32 @@
+/*
+    SpectrogramFragment.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Fragment Shader
+    The level texture holds one column per spectrum, written at an index that
+    wraps around instead of moving the older columns. Scrolling is just an
+    offset added to the texture x coordinate here, with GL_REPEAT doing the
+    wrapping. Levels are coloured through a one row colour map texture.
+    Drawn over FullScreenQuadVertex.glsl.
+*/
+
+#version 330 core
+
+in vec2 targetCoordinate; // x: oldest column 0 to newest 1, y: lowest bin 0 to highest 1
+out vec4 fragmentColour;
+
+uniform sampler2D levelTexture;
+uniform sampler2D colourMapTexture;
+
+uniform float oldestColumn; // Texture x of the centre of the oldest column
+uniform float columnSpan;   // Texture x distance from the oldest column's centre to the newest's
+
+void main()
+{
+    // Centre to centre, so filtering never blends the newest column into the oldest
+    float x = oldestColumn + targetCoordinate.x * columnSpan;
+    float level = texture (levelTexture, vec2 (x, targetCoordinate.y)).r;
+    fragmentColour = texture (colourMapTexture, vec2 (level, 0.5));
+}
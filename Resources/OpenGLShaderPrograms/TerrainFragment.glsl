@@ -0,0 +1,26 @@
+/*
+    TerrainFragment.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Fragment Shader
+    Colours the terrain by slope, grass on the flat and rock on the steep,
+    lit by a fixed sun.
+*/
+
+#version 330 core
+in vec3 terrainNormal;
+
+out vec4 fragColor;
+
+void main()
+{
+    vec3 normal = normalize (terrainNormal);
+    vec3 grass = vec3 (0.28, 0.45, 0.2);
+    vec3 rock = vec3 (0.45, 0.4, 0.36);
+    vec3 colour = mix (grass, rock, smoothstep (0.15, 0.4, 1.0 - normal.y));
+
+    float diffuse = max (dot (normal, normalize (vec3 (0.4, 0.8, 0.3))), 0.0);
+    fragColor = vec4 (colour * (0.25 + 0.75 * diffuse), 1.0);
+}
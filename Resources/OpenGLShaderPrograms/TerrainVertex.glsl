@@ -0,0 +1,68 @@
+/*
+    TerrainVertex.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Vertex Shader
+    Places one vertex of a clipmap level's grid. The grid holds integer cell
+    coordinates shared by every level; the level's spacing and origin put
+    them in the world, and its layer of the height texture array raises them.
+    Heights are stored toroidally, so texel coordinates wrap around the
+    texture. Near the level's outer edge heights blend into the next coarser
+    level's, which hides the seam between them.
+*/
+
+#version 330 core
+layout (location = 0) in vec2 gridPosition;
+
+layout (std140) uniform CameraUniforms
+{
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+uniform sampler2DArray heights;
+uniform int level;
+uniform float spacing;                  // World distance between vertices of this level
+uniform float gridSize;                 // Cells along each side of a level
+uniform vec2 levelOrigin;               // World xz of the grid's first vertex
+uniform vec2 textureOffset;             // Texel of the grid's first vertex
+uniform vec2 coarserTextureOffset;      // Texel of the same point in the coarser level
+uniform vec2 viewerPosition;            // Camera, in cells from the grid's first vertex
+uniform int hasCoarserLevel;
+
+out vec3 terrainNormal;
+
+float fetchHeight (ivec2 offset)
+{
+    int size = textureSize (heights, 0).x;
+    ivec2 texel = (ivec2 (gridPosition + textureOffset) + offset + size) % size;
+    return texelFetch (heights, ivec3 (texel, level), 0).r;
+}
+
+void main()
+{
+    float height = fetchHeight (ivec2 (0, 0));
+
+    if (hasCoarserLevel != 0)
+    {
+        // 0 inside, rising to 1 over the last tenth of the grid before the edge
+        float transitionWidth = 0.1 * gridSize;
+        vec2 distance = abs (gridPosition - viewerPosition);
+        vec2 blend = clamp ((distance - (0.5 * gridSize - transitionWidth - 2.0)) / transitionWidth, 0.0, 1.0);
+
+        // Halfway between coarser texels, linear filtering gives the height of the coarser grid's edge
+        vec2 coarserCoordinate = (gridPosition * 0.5 + coarserTextureOffset + 0.5) / vec2 (textureSize (heights, 0).xy);
+        float coarserHeight = texture (heights, vec3 (coarserCoordinate, float (level + 1))).r;
+
+        height = mix (height, coarserHeight, max (blend.x, blend.y));
+    }
+
+    terrainNormal = normalize (vec3 (fetchHeight (ivec2 (-1, 0)) - fetchHeight (ivec2 (1, 0)),
+                                     2.0 * spacing,
+                                     fetchHeight (ivec2 (0, -1)) - fetchHeight (ivec2 (0, 1))));
+
+    vec3 worldPosition = vec3 (levelOrigin.x + gridPosition.x * spacing, height, levelOrigin.y + gridPosition.y * spacing);
+    gl_Position = projectionMatrix * viewMatrix * vec4 (worldPosition, 1.0);
+}
@@ -0,0 +1,33 @@
+/*
+    TransparencyCompositeFragment.glsl
+    OpenGL 3D App Template - App
+ 
+    Copyright 2020 TesserAct Music Technology LLC. All rights reserved.
+ 
+    Fragment Shader
+    Resolves the weighted blended transparency targets: the weighted average
+    colour of every transparent surface at the pixel, with the coverage they
+    add up to as alpha. Blend it over the opaque scene with
+    (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA).
+*/
+
+#version 330 core
+in vec2 targetCoordinate;
+
+uniform sampler2D accumulationTexture; // Sum of colour * alpha * weight, revealage in alpha
+uniform sampler2D weightTexture;       // Sum of alpha * weight
+
+out vec4 fragColor;
+
+void main()
+{
+    vec4 accumulation = texture (accumulationTexture, targetCoordinate);
+    float revealage = accumulation.a;
+
+    // Nothing transparent here
+    if (revealage >= 1.0)
+        discard;
+
+    float weightSum = texture (weightTexture, targetCoordinate).r;
+    fragColor = vec4 (accumulation.rgb / max (weightSum, 1.0e-5), 1.0 - revealage);
+}
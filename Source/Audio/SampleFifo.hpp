@@ -0,0 +1,74 @@
+//
+//  SampleFifo.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Audio
+{
+
+/** A single producer, single consumer ring of mono samples, for getting audio
+    out of an audio callback.
+
+    `push()` is wait-free: it never locks, allocates or waits for the reader.
+    If the ring is full, the samples that don't fit are dropped and counted
+    rather than making the audio thread wait, so a stalled reader can only
+    ever cost it data, never time.
+ */
+class SampleFifo
+{
+public:
+    explicit SampleFifo (int capacity)
+        : fifo (capacity), buffer ((size_t) capacity)
+    {
+    }
+
+    /** Call from the producer thread only. Returns how many samples were
+        written; the rest were dropped. */
+    int push (const float* samples, int numSamples) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+
+        std::copy (samples, samples + size1, buffer.data() + start1);
+        std::copy (samples + size1, samples + size1 + size2, buffer.data() + start2);
+        fifo.finishedWrite (size1 + size2);
+
+        const int numWritten = size1 + size2;
+
+        if (numWritten < numSamples)
+            numDroppedSamples.fetch_add (numSamples - numWritten, std::memory_order_relaxed);
+
+        return numWritten;
+    }
+
+    /** Call from the consumer thread only. Returns how many samples were read. */
+    int pop (float* destination, int numSamples) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (numSamples, start1, size1, start2, size2);
+
+        std::copy (buffer.data() + start1, buffer.data() + start1 + size1, destination);
+        std::copy (buffer.data() + start2, buffer.data() + start2 + size2, destination + size1);
+        fifo.finishedRead (size1 + size2);
+
+        return size1 + size2;
+    }
+
+    int getNumReady() const noexcept                { return fifo.getNumReady(); }
+    int64 getNumDroppedSamples() const noexcept     { return numDroppedSamples.load (std::memory_order_relaxed); }
+
+private:
+    AbstractFifo fifo;
+    std::vector<float> buffer;
+    std::atomic<int64> numDroppedSamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (SampleFifo)
+};
+
+} // namespace Audio
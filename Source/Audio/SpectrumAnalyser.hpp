@@ -0,0 +1,224 @@
+//
+//  SpectrumAnalyser.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <complex>
+#include "SampleFifo.hpp"
+#include "TripleBuffer.hpp"
+
+namespace Audio
+{
+
+/** Turns a stream of samples from an audio callback into spectra a renderer
+    can draw, without either of those threads ever waiting.
+
+    Three threads are involved:
+        1. The audio thread calls `pushSamples()`, which only copies into a
+           wait-free ring (see SampleFifo).
+        2. The analyser's own thread takes a hop of samples at a time, applies
+           a Hann window to the last `fftSize` samples and runs an FFT. The
+           magnitudes are reduced to `numBins` log-spaced bins, each the peak
+           of the FFT bins it covers, scaled to 0..1 over `minDecibels`..0 dB.
+        3. The render thread calls `getLatestSpectrum()`, which hands over the
+           newest result through a TripleBuffer, with no locks, copies or
+           allocations.
+ */
+class SpectrumAnalyser : private Thread
+{
+public:
+    struct Spectrum
+    {
+        std::vector<float> levels;  // numBins values in 0..1, lowest frequency first
+        uint32 sequenceNumber = 0;  // Increases by one per analysed hop
+    };
+
+    static constexpr float minDecibels = -100.0f;
+
+    /** The FFT size is 2^fftOrder and the analyser moves on by a quarter of
+        that each time. The ring holds a quarter of a second of audio. */
+    SpectrumAnalyser (double sampleRateToUse = 44100.0, int fftOrder = 11, int numBinsToUse = 256)
+        : Thread ("Spectrum Analyser"),
+          sampleRate (sampleRateToUse),
+          fftSize (1 << fftOrder),
+          hopSize (fftSize / 4),
+          numBins (numBinsToUse),
+          fifo (jmax (fftSize, (int) sampleRateToUse / 4)),
+          fft (fftOrder),
+          results ({ std::vector<float> ((size_t) numBinsToUse), 0 })
+    {
+        samples.resize ((size_t) fftSize);
+        fftData.resize ((size_t) fftSize);
+        windowTable.resize ((size_t) fftSize);
+
+        for (int i = 0; i < fftSize; ++i)
+            windowTable[(size_t) i] = 0.5f - 0.5f * std::cos (MathConstants<float>::twoPi * (float) i / (float) fftSize);
+
+        calculateBinRanges();
+    }
+
+    ~SpectrumAnalyser()
+    {
+        stop();
+    }
+
+    void start()    { startThread(); }
+    void stop()     { stopThread (1000); }
+
+    int getNumBins() const noexcept         { return numBins; }
+    double getSampleRate() const noexcept   { return sampleRate; }
+
+    //==============================================================================
+    /** Call from the audio thread. Wait-free; samples that don't fit in the
+        ring are dropped and counted. */
+    void pushSamples (const float* newSamples, int numSamples) noexcept
+    {
+        fifo.push (newSamples, numSamples);
+    }
+
+    /** Samples dropped so far because the analyser fell behind. */
+    int64 getNumDroppedSamples() const noexcept { return fifo.getNumDroppedSamples(); }
+
+    //==============================================================================
+    /** Call from the render thread. The result stays valid and unchanged until
+        the next call; compare sequence numbers to see if anything is new. */
+    const Spectrum& getLatestSpectrum() noexcept
+    {
+        results.fetchLatest();
+        return results.getReadBuffer();
+    }
+
+private:
+    /** An in-place, iterative radix-2 FFT with precomputed twiddles. */
+    class FFT
+    {
+    public:
+        explicit FFT (int order)
+            : size (1 << order)
+        {
+            for (int i = 0; i < size / 2; ++i)
+                twiddles.push_back (std::polar (1.0f, -MathConstants<float>::twoPi * (float) i / (float) size));
+
+            for (int i = 0; i < size; ++i)
+            {
+                int reversed = 0;
+
+                for (int bit = 0; bit < order; ++bit)
+                    reversed |= ((i >> bit) & 1) << (order - 1 - bit);
+
+                bitReversed.push_back (reversed);
+            }
+        }
+
+        void perform (std::complex<float>* data) const noexcept
+        {
+            for (int i = 0; i < size; ++i)
+                if (i < bitReversed[(size_t) i])
+                    std::swap (data[i], data[bitReversed[(size_t) i]]);
+
+            for (int length = 2; length <= size; length <<= 1)
+            {
+                const int half = length / 2, twiddleStep = size / length;
+
+                for (int start = 0; start < size; start += length)
+                {
+                    for (int k = 0; k < half; ++k)
+                    {
+                        const auto t = twiddles[(size_t) (k * twiddleStep)] * data[start + k + half];
+                        data[start + k + half] = data[start + k] - t;
+                        data[start + k] += t;
+                    }
+                }
+            }
+        }
+
+    private:
+        const int size;
+        std::vector<std::complex<float>> twiddles;
+        std::vector<int> bitReversed;
+    };
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (fifo.getNumReady() < hopSize)
+            {
+                wait (2);
+                continue;
+            }
+
+            // Slide the window along by one hop
+            std::move (samples.begin() + hopSize, samples.end(), samples.begin());
+            fifo.pop (samples.data() + fftSize - hopSize, hopSize);
+
+            analyse();
+        }
+    }
+
+    void analyse() noexcept
+    {
+        for (size_t i = 0; i < samples.size(); ++i)
+            fftData[i] = { samples[i] * windowTable[i], 0.0f };
+
+        fft.perform (fftData.data());
+
+        // A full scale sine wave peaks at fftSize / 4 through a Hann window
+        const float amplitudeScale = 4.0f / (float) fftSize;
+        auto& spectrum = results.getWriteBuffer();
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            float peak = 0.0f;
+
+            for (int i = binRanges[(size_t) bin].getStart(); i < binRanges[(size_t) bin].getEnd(); ++i)
+                peak = jmax (peak, std::abs (fftData[(size_t) i]));
+
+            const float decibels = Decibels::gainToDecibels (peak * amplitudeScale, minDecibels);
+            spectrum.levels[(size_t) bin] = jmap (jlimit (minDecibels, 0.0f, decibels), minDecibels, 0.0f, 0.0f, 1.0f);
+        }
+
+        spectrum.sequenceNumber = ++sequenceNumber;
+        results.publish();
+    }
+
+    /** Spreads the output bins logarithmically from 20 Hz to Nyquist, giving
+        each at least one FFT bin. */
+    void calculateBinRanges()
+    {
+        const double minFrequency = 20.0, nyquist = sampleRate / 2.0;
+        const int numFFTBins = fftSize / 2;
+        auto toFFTBin = [&] (int bin)
+        {
+            const double frequency = minFrequency * std::pow (nyquist / minFrequency, bin / (double) numBins);
+            return jlimit (1, numFFTBins, (int) (frequency * fftSize / sampleRate));
+        };
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            const int start = jmin (toFFTBin (bin), numFFTBins - 1);
+            binRanges.push_back ({ start, jmax (start + 1, toFFTBin (bin + 1)) });
+        }
+    }
+
+    const double sampleRate;
+    const int fftSize, hopSize, numBins;
+
+    SampleFifo fifo;
+    FFT fft;
+    std::vector<float> samples, windowTable;
+    std::vector<std::complex<float>> fftData;
+    std::vector<Range<int>> binRanges;
+
+    TripleBuffer<Spectrum> results;
+    uint32 sequenceNumber = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (SpectrumAnalyser)
+};
+
+} // namespace Audio
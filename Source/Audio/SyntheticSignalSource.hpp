@@ -0,0 +1,117 @@
+//
+//  SyntheticSignalSource.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Audio
+{
+
+/** Stands in for an audio device while there isn't one: a thread that calls
+    `callback (samples, numSamples)` with blocks of a test signal, at the pace
+    a real device would.
+
+    The signal is a logarithmic sweep from 100 Hz to 10 kHz and back every
+    eight seconds, over a steady 440 Hz tone with two harmonics and a little
+    noise, so there is always something moving in a visualiser.
+
+    The time spent inside each callback is measured. The worst case is what
+    the audio side of a visualiser costs a real device, and it should stay far
+    below a block's duration however busy the reader is.
+ */
+class SyntheticSignalSource : private Thread
+{
+public:
+    using Callback = std::function<void (const float* samples, int numSamples)>;
+
+    SyntheticSignalSource (Callback callbackToUse, double sampleRateToUse = 44100.0, int blockSizeToUse = 512)
+        : Thread ("Synthetic Signal Source"),
+          callback (std::move (callbackToUse)),
+          sampleRate (sampleRateToUse),
+          blockSize (blockSizeToUse),
+          block ((size_t) blockSizeToUse)
+    {
+    }
+
+    ~SyntheticSignalSource()
+    {
+        stop();
+    }
+
+    void start()    { startThread (Thread::realtimeAudioPriority); }
+    void stop()     { stopThread (1000); }
+
+    /** The longest a single callback has taken so far. */
+    double getMaxCallbackTimeMs() const noexcept    { return maxCallbackTimeMs.load(); }
+
+private:
+    void run() override
+    {
+        const double blockDurationMs = 1000.0 * blockSize / sampleRate;
+        double nextBlockTimeMs = Time::getMillisecondCounterHiRes();
+
+        while (! threadShouldExit())
+        {
+            generateBlock();
+
+            const auto startTicks = Time::getHighResolutionTicks();
+            callback (block.data(), blockSize);
+            const double callbackTimeMs = 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+
+            if (callbackTimeMs > maxCallbackTimeMs.load())
+                maxCallbackTimeMs = callbackTimeMs;
+
+            nextBlockTimeMs += blockDurationMs;
+            const double waitMs = nextBlockTimeMs - Time::getMillisecondCounterHiRes();
+
+            if (waitMs > 1.0)
+                wait ((int) waitMs);
+            else if (waitMs < -100.0)
+                nextBlockTimeMs = Time::getMillisecondCounterHiRes(); // Fell far behind, e.g. after a breakpoint
+        }
+    }
+
+    void generateBlock() noexcept
+    {
+        const double sweepPeriod = 8.0, minSweepFrequency = 100.0, maxSweepFrequency = 10000.0;
+        const float twoPi = MathConstants<float>::twoPi;
+
+        for (auto& sample : block)
+        {
+            // Triangle wave from 0 to 1 and back, used as the sweep's log position
+            const double sweepPhase = std::fmod (time / sweepPeriod, 1.0);
+            const double sweepPosition = 1.0 - std::abs (2.0 * sweepPhase - 1.0);
+            const double sweepFrequency = minSweepFrequency * std::pow (maxSweepFrequency / minSweepFrequency, sweepPosition);
+
+            sweepAngle = std::fmod (sweepAngle + sweepFrequency / sampleRate, 1.0);
+            toneAngle = std::fmod (toneAngle + 440.0 / sampleRate, 1.0);
+
+            const float tone = (float) toneAngle * twoPi;
+            sample = 0.25f * std::sin ((float) sweepAngle * twoPi)
+                   + 0.2f * std::sin (tone) + 0.05f * std::sin (2.0f * tone) + 0.02f * std::sin (3.0f * tone)
+                   + 0.005f * (random.nextFloat() * 2.0f - 1.0f);
+
+            time += 1.0 / sampleRate;
+        }
+    }
+
+    Callback callback;
+    const double sampleRate;
+    const int blockSize;
+    std::vector<float> block;
+
+    // Seconds, and phases in cycles kept in 0..1 so they stay precise
+    double time = 0.0, sweepAngle = 0.0, toneAngle = 0.0;
+    Random random;
+
+    std::atomic<double> maxCallbackTimeMs { 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE (SyntheticSignalSource)
+};
+
+} // namespace Audio
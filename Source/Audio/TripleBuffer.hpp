@@ -0,0 +1,68 @@
+//
+//  TripleBuffer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Audio
+{
+
+/** Hands the latest version of a value from one writer thread to one reader
+    thread, without locks, allocations or copies.
+
+    The writer fills its own buffer and publishes it by swapping it with a
+    shared middle buffer; the reader takes the middle buffer the same way
+    when it wants something newer. Three buffers, rather than a plain front
+    and back pair, mean neither side ever waits for the other to finish: the
+    writer always has a free buffer, and the reader keeps its buffer for as
+    long as it likes. Versions the reader was too slow to see are skipped.
+ */
+template <typename ValueType>
+class TripleBuffer
+{
+public:
+    explicit TripleBuffer (const ValueType& initialValue = {})
+        : buffers { initialValue, initialValue, initialValue }
+    {
+    }
+
+    /** Writer only: the buffer to fill before the next publish(). It may hold
+        any older version, not necessarily the last one published. */
+    ValueType& getWriteBuffer() noexcept            { return buffers[writeIndex]; }
+
+    /** Writer only: makes the write buffer the latest version. */
+    void publish() noexcept
+    {
+        writeIndex = middle.exchange (writeIndex | newDataFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /** Reader only: takes the latest version if there is a newer one than the
+        one being read. Returns true if the read buffer changed. */
+    bool fetchLatest() noexcept
+    {
+        if ((middle.load (std::memory_order_relaxed) & newDataFlag) == 0)
+            return false;
+
+        readIndex = middle.exchange (readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    /** Reader only: valid, and unchanged, until the next fetchLatest(). */
+    const ValueType& getReadBuffer() const noexcept { return buffers[readIndex]; }
+
+private:
+    static constexpr int indexMask = 3, newDataFlag = 4;
+
+    ValueType buffers[3];
+    int writeIndex = 0, readIndex = 2;
+    std::atomic<int> middle { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};
+
+} // namespace Audio
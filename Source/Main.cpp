@@ -8,6 +8,7 @@
 
 #include <JuceHeader.h>
 #include "MainContentComponent.hpp"
+#include "SelfTests/SelfTests.hpp"
 
 class Application    : public JUCEApplication
 {
@@ -18,10 +19,187 @@ public:
     const String getApplicationName() override       { return "OpenGL3DAppTemplate"; }
     const String getApplicationVersion() override    { return "1.0.0"; }
 
-    void initialise (const String&) override         { mainWindow.reset (new MainWindow ("OpenGL3DAppTemplate", new MainContentComponent(), *this)); }
+    void initialise (const String& commandLine) override
+    {
+        if (runSelfTestsIfRequested (commandLine) || buildPointCloudIfRequested (commandLine))
+            return;
+
+        auto* content = new MainContentComponent();
+        mainWindow.reset (new MainWindow ("OpenGL3DAppTemplate", content, *this));
+
+        loadPointCloudIfRequested (commandLine, content->getOpenGLComponent());
+        applyFramePacingOptions (commandLine, content->getOpenGLComponent());
+        startOffscreenRenderingIfRequested (commandLine, content->getOpenGLComponent());
+    }
+
     void shutdown() override                         { mainWindow = nullptr; }
 
 private:
+    //==============================================================================
+    /** Console runs of the tests and benchmarks in SelfTests, which need no
+        window or OpenGL context:
+
+            --self-test    returns 1 if any test fails
+            --benchmark    logs the timings
+    */
+    bool runSelfTestsIfRequested (const String& commandLine)
+    {
+        auto args = StringArray::fromTokens (commandLine, true);
+
+        const String category = args.contains ("--self-test") ? SelfTests::testCategory
+                              : args.contains ("--benchmark") ? SelfTests::benchmarkCategory
+                                                              : String();
+
+        if (category.isEmpty())
+            return false;
+
+        setApplicationReturnValue (SelfTests::run (category) > 0 ? 1 : 0);
+        quit();
+        return true;
+    }
+
+    /** The value of a --name=value argument, or an empty string. */
+    static String getOption (const String& commandLine, const String& name)
+    {
+        for (auto& arg : StringArray::fromTokens (commandLine, true))
+            if (arg.startsWith (name + "="))
+                return arg.fromFirstOccurrenceOf ("=", false, false).unquoted();
+
+        return {};
+    }
+
+    /** Point clouds are sorted into an octree file once, offline, e.g.
+
+            --build-point-cloud=scan.xyz --point-cloud-output=scan.pcot --points-per-node=16384
+
+        reads a text file of points (see PointCloudOctree::readTextPoints()),
+        writes the octree and quits, with no window. The output defaults to
+        the input with a .pcot extension. Then
+
+            --point-cloud=scan.pcot
+
+        opens the octree at startup, alongside any other options.
+    */
+    bool buildPointCloudIfRequested (const String& commandLine)
+    {
+        const auto inputPath = getOption (commandLine, "--build-point-cloud");
+
+        if (inputPath.isEmpty())
+            return false;
+
+        const auto input = File::getCurrentWorkingDirectory().getChildFile (inputPath);
+        const auto outputPath = getOption (commandLine, "--point-cloud-output");
+        const auto output = outputPath.isNotEmpty() ? File::getCurrentWorkingDirectory().getChildFile (outputPath)
+                                                    : input.withFileExtension ("pcot");
+        const int pointsPerNode = getOption (commandLine, "--points-per-node").getIntValue();
+
+        std::vector<Rendering::PointCloudOctree::Point> points;
+        auto result = Rendering::PointCloudOctree::readTextPoints (input, points);
+
+        if (result.wasOk())
+            result = Rendering::PointCloudOctree::build (points, output, pointsPerNode > 0 ? pointsPerNode : 16384);
+
+        if (result.failed())
+        {
+            std::cerr << "Building the point cloud failed: " << result.getErrorMessage() << std::endl;
+            setApplicationReturnValue (1);
+        }
+        else
+        {
+            std::cout << "Wrote " << (int64) points.size() << " points to " << output.getFullPathName() << std::endl;
+        }
+
+        quit();
+        return true;
+    }
+
+    void loadPointCloudIfRequested (const String& commandLine, OpenGLComponent& openGLComponent)
+    {
+        const auto path = getOption (commandLine, "--point-cloud");
+
+        if (path.isEmpty())
+            return;
+
+        const auto result = openGLComponent.loadPointCloud (File::getCurrentWorkingDirectory().getChildFile (path));
+
+        if (result.failed())
+            std::cerr << "Can't open the point cloud: " << result.getErrorMessage() << std::endl;
+    }
+
+    /** Frame pacing, e.g.
+
+            --target-fps=72 --refresh-rate=144
+
+        renders at 72 fps with a swap interval of 2, so vsync does the pacing.
+        JUCE can't query the display's refresh rate, so give it unless it is
+        60 Hz. --no-vsync leaves the target frame rate as the only limit.
+    */
+    void applyFramePacingOptions (const String& commandLine, OpenGLComponent& openGLComponent)
+    {
+        const auto refreshRate = getOption (commandLine, "--refresh-rate").getDoubleValue();
+
+        if (refreshRate > 0)
+            openGLComponent.setDisplayRefreshRate (refreshRate);
+
+        if (StringArray::fromTokens (commandLine, true).contains ("--no-vsync"))
+            openGLComponent.setVSyncEnabled (false);
+
+        openGLComponent.setTargetFrameRate (getOption (commandLine, "--target-fps").getDoubleValue());
+    }
+
+    /** Offscreen rendering for thumbnails, video and benchmarks, e.g.
+
+            --offscreen-output=/tmp/frames --offscreen-size=1920x1080 --offscreen-frames=600 --target-fps=60
+
+        renders 600 frames into a 1920x1080 framebuffer, writes them as a PNG
+        sequence, prints the frame pacing statistics and quits. An OpenGL
+        context still needs a window, so on a machine with no display run this
+        under a virtual X server such as Xvfb (with Mesa's software renderer).
+        Without --offscreen-frames it keeps rendering until the app is quit.
+    */
+    void startOffscreenRenderingIfRequested (const String& commandLine, OpenGLComponent& openGLComponent)
+    {
+        auto outputPath = getOption (commandLine, "--offscreen-output");
+
+        if (outputPath.isEmpty())
+            return;
+
+        OpenGLComponent::OffscreenSettings settings;
+        settings.outputDirectory = File::getCurrentWorkingDirectory().getChildFile (outputPath);
+        settings.numFrames = jmax (0, getOption (commandLine, "--offscreen-frames").getIntValue()); // 0, or absent, runs until quit
+
+        auto size = getOption (commandLine, "--offscreen-size");
+
+        if (size.containsChar ('x'))
+        {
+            settings.width  = jmax (1, size.upToFirstOccurrenceOf ("x", false, false).getIntValue());
+            settings.height = jmax (1, size.fromFirstOccurrenceOf ("x", false, false).getIntValue());
+        }
+
+        openGLComponent.onOffscreenRenderingFinished = [this, &openGLComponent, settings] (const Result& result,
+                                                                                          int numFramesRendered)
+        {
+            if (result.failed())
+            {
+                std::cerr << "Offscreen rendering failed: " << result.getErrorMessage() << std::endl;
+                setApplicationReturnValue (1);
+                systemRequestedQuit();
+                return;
+            }
+
+            std::cout << "Rendered " << numFramesRendered << " frames at "
+                      << settings.width << "x" << settings.height << " to "
+                      << settings.outputDirectory.getFullPathName() << std::endl
+                      << openGLComponent.getFrameStatistics().toString() << std::endl
+                      << "Frame time variance: "
+                      << openGLComponent.getFrameStatistics().frameTimeVarianceMs << " ms^2" << std::endl;
+
+            systemRequestedQuit();
+        };
+
+        openGLComponent.startOffscreenRendering (settings);
+    }
+
     class MainWindow    : public DocumentWindow
     {
     public:
@@ -33,6 +33,8 @@ public:
         openGLComponent.setBounds (getLocalBounds());
     }
 
+    OpenGLComponent& getOpenGLComponent() noexcept { return openGLComponent; }
+
 private:
     OpenGLComponent openGLComponent;
 
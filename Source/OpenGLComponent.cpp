@@ -13,60 +13,402 @@ OpenGLComponent::OpenGLComponent()
 {
     // Sets the OpenGL version to 3.2
     openGLContext.setOpenGLVersionRequired (OpenGLContext::OpenGLVersion::openGL3_2);
+    
+    openGLContext.setPixelFormat (getPixelFormat());
+    
+    // Painting components into the frame makes JUCE hold the message manager lock
+    // across renderOpenGL(), and the frame pacer may sleep there. The status
+    // overlay is drawn by renderStatusOverlay() instead
+    openGLContext.setComponentPaintingEnabled (false);
 
     // Set default 3D orientation for the draggable GUI tool
     draggableOrientation.reset ({ 0.0, 1.0, 0.0 });
+    
+    // Every program variant reads the shared uniform buffers
+    shaderPrograms.setProgramBinaryCache (&programBinaryCache);
+    shaderPrograms.onProgramLinked = [this] (OpenGLUtil::AsyncShaderProgram& program)
+    {
+        const auto& registry = program.getUniforms();
+        registry.bindBlock (coreFunctions, program.getProgramID(), "CameraUniforms",
+                            cameraUniforms.getBindingPoint(), sizeof (ShaderUniformBlocks::CameraUniforms));
+        registry.bindBlock (coreFunctions, program.getProgramID(), "ObjectUniforms",
+                            objectUniforms.getBindingPoint(), sizeof (ShaderUniformBlocks::ObjectUniforms));
+    };
+    
+    // A single purple object at the origin
+    sceneObjects.push_back ({ sceneGraph.addNode (Rendering::SceneGraph::root), 0,
+                              getSharedMaterial (Colour::fromFloatRGBA (0.6f, 0.1f, 1.0f, 0.8f), {}) });
 
     // Attach the OpenGL context
     openGLContext.setRenderer (this);
     openGLContext.attachTo (*this);
-    openGLContext.setContinuousRepainting (true); // Enable rendering
-
-    // Setup OpenGL GUI Overlay Label: Status of Shaders, compiler errors, etc.
-    addAndMakeVisible (openGLStatusLabel);
-    openGLStatusLabel.setJustificationType (Justification::topLeft);
-    openGLStatusLabel.setFont (Font (14.0f));
+    setRenderMode (renderMode); // Enable rendering
+    
+    // Recompile shaders as they are edited, if we can find their sources
+    shaderSourceDirectory = OpenGLUtil::ShaderSourceWatcher::findSourceDirectory ("Resources/OpenGLShaderPrograms");
+    
+    if (shaderSourceDirectory.isDirectory())
+    {
+        shaderSourceWatcher.onFilesChanged = [this] (const Array<File>& changedFiles)
+        {
+            reloadShaderSources (changedFiles);
+        };
+        shaderSourceWatcher.startWatching (shaderSourceDirectory);
+    }
 }
 
 OpenGLComponent::~OpenGLComponent()
 {
+    shaderSourceWatcher.stopWatching();
     openGLContext.setContinuousRepainting (false);
     openGLContext.detach();
 }
 
+// Render Scheduling ===========================================================
+void OpenGLComponent::setRenderMode (RenderMode newMode)
+{
+    renderMode = newMode;
+    openGLContext.setContinuousRepainting (renderMode == RenderMode::continuous);
+    invalidate();
+}
+
+void OpenGLComponent::invalidate()
+{
+    // triggerRepaint() coalesces, so calling this many times per frame is cheap
+    openGLContext.triggerRepaint();
+}
+
+void OpenGLComponent::beginAnimation()
+{
+    if (activeAnimations++ == 0)
+        invalidate();
+}
+
+void OpenGLComponent::endAnimation()
+{
+    jassert (activeAnimations > 0); // Unbalanced beginAnimation()/endAnimation() calls
+    
+    --activeAnimations;
+    invalidate(); // Render the final state of the animation
+}
+
+void OpenGLComponent::setTargetFrameRate (double framesPerSecond)
+{
+    framePacer.setTargetFrameRate (framesPerSecond);
+    invalidate();
+}
+
+void OpenGLComponent::setDisplayRefreshRate (double hz)
+{
+    framePacer.setDisplayRefreshRate (hz);
+    invalidate();
+}
+
+void OpenGLComponent::setVSyncEnabled (bool shouldUseVSync)
+{
+    framePacer.setVSyncEnabled (shouldUseVSync);
+    invalidate();
+}
+
+OpenGLUtil::FramePacer::Statistics OpenGLComponent::getFrameStatistics() const
+{
+    return framePacer.getStatistics();
+}
+
+void OpenGLComponent::setDepthPrePassMode (Rendering::DepthPrePass::Mode newMode)
+{
+    depthPrePass.setMode (newMode);
+    invalidate();
+}
+
+void OpenGLComponent::setDynamicResolution (const Rendering::DynamicResolution::Settings& newSettings)
+{
+    openGLContext.executeOnGLThread ([this, newSettings] (OpenGLContext&)
+    {
+        dynamicResolution.setSettings (newSettings);
+    }, false);
+    
+    invalidate();
+}
+
+void OpenGLComponent::setOcclusionCulling (const Rendering::OcclusionCuller::Settings& newSettings)
+{
+    openGLContext.executeOnGLThread ([this, newSettings] (OpenGLContext&)
+    {
+        occlusionCuller.setSettings (newSettings);
+    }, false);
+    
+    invalidate();
+}
+
+// Models ======================================================================
+Result OpenGLComponent::loadModel (const File& objFile, const Matrix3D<GLfloat>& modelMatrix)
+{
+    WavefrontObjFile wavefrontFile;
+    const auto result = wavefrontFile.load (objFile);
+    
+    if (result.failed())
+        return result;
+    
+    std::shared_ptr<PackedModel> model = PackedModel::fromWavefrontFile (wavefrontFile, objFile.getParentDirectory());
+    
+    openGLContext.executeOnGLThread ([this, model, modelMatrix] (OpenGLContext&)
+    {
+        // All of the model's batches share one node
+        const auto node = sceneGraph.addNode (Rendering::SceneGraph::root, modelMatrix);
+        Array<OpenGLUtil::ShaderPermutationSet::FeatureMask> usedShaderFeatures;
+        
+        // Each batch is one mesh, drawn with one material. uploadModel() adds the meshes
+        for (size_t i = 0; i < model->batches.size(); ++i)
+        {
+            auto& batch = model->batches[i];
+            batch.mesh = (Rendering::MeshID) (meshes.size() + i);
+            batch.material = (Rendering::MaterialID) materials.size();
+            
+            materials.push_back ({ Colours::white });
+            sceneObjects.push_back ({ node, batch.mesh, batch.material });
+            usedShaderFeatures.addIfNotAlreadyThere (PackedModel::Vertex::shaderFeatures);
+        }
+        
+        models.push_back (model);
+        uploadModel (*model);
+        requestMaterialTextures();
+        
+        shaderPrograms.precompile (openGLContext, coreFunctions, usedShaderFeatures);
+        invalidate();
+    }, false);
+    
+    return Result::ok();
+}
+
+Result OpenGLComponent::loadPointCloud (const File& octreeFile, const Matrix3D<GLfloat>& modelMatrix)
+{
+    auto octree = std::make_shared<Rendering::PointCloudOctree>();
+    const auto result = octree->open (octreeFile);
+    
+    if (result.failed())
+        return result;
+    
+    openGLContext.executeOnGLThread ([this, octree, modelMatrix] (OpenGLContext&)
+    {
+        if (! hasPointCloud)
+            pointCloudNode = sceneGraph.addNode (Rendering::SceneGraph::root, modelMatrix);
+        else
+            sceneGraph.setLocalTransform (pointCloudNode, modelMatrix);
+        
+        pointCloud.setOctree (openGLContext, octree);
+        hasPointCloud = true;
+        
+        shaderPrograms.precompile (openGLContext, coreFunctions, { VertexFormats::PositionColour::shaderFeatures });
+        invalidate();
+    }, false);
+    
+    return Result::ok();
+}
+
+void OpenGLComponent::addPrimitive (Rendering::Primitives::Shape shape, int tessellation,
+                                    const Matrix3D<GLfloat>& modelMatrix, Colour colour)
+{
+    openGLContext.executeOnGLThread ([this, shape, tessellation, modelMatrix, colour] (OpenGLContext&)
+    {
+        auto primitive = std::find_if (primitiveMeshes.begin(), primitiveMeshes.end(), [&] (const PrimitiveMesh& existing)
+        {
+            return existing.shape == shape && existing.tessellation == tessellation;
+        });
+        
+        if (primitive == primitiveMeshes.end())
+        {
+            primitiveMeshes.push_back ({ shape, tessellation, (Rendering::MeshID) meshes.size() });
+            primitive = primitiveMeshes.end() - 1;
+            uploadPrimitive (*primitive);
+        }
+        
+        const bool isTransparent = ! colour.isOpaque();
+        const auto features = Rendering::Primitives::Vertex::shaderFeatures
+                            | (isTransparent ? (uint32) ShaderFeatures::isWeightedBlended : 0u);
+        shaderPrograms.precompile (openGLContext, coreFunctions, { features });
+        
+        sceneObjects.push_back ({ sceneGraph.addNode (Rendering::SceneGraph::root, modelMatrix),
+                                  primitive->mesh, getSharedMaterial (colour, {}) });
+        invalidate();
+    }, false);
+}
+
+Result OpenGLComponent::loadTerrain (const File& rawHeightFile, int width, int depth,
+                                     float sampleSpacing, float heightScale, int numLevels)
+{
+    auto heightfield = std::make_shared<Rendering::MappedHeightfield>();
+    const auto result = heightfield->open (rawHeightFile, width, depth, heightScale);
+    
+    if (result.failed())
+        return result;
+    
+    openGLContext.executeOnGLThread ([this, heightfield, sampleSpacing, numLevels] (OpenGLContext&)
+    {
+        // The number of levels sets the size of the texture array, so start afresh
+        terrain.release (openGLContext);
+        terrain.setSource (heightfield, sampleSpacing, numLevels);
+        hasTerrain = true;
+        invalidate();
+    }, false);
+    
+    return Result::ok();
+}
+
+// Spectrogram =================================================================
+void OpenGLComponent::setSpectrogramVisible (bool shouldBeVisible)
+{
+    if (isSpectrogramVisible == shouldBeVisible)
+        return;
+    
+    isSpectrogramVisible = shouldBeVisible;
+    
+    // New spectra arrive continuously, so keep the frames coming while visible
+    if (shouldBeVisible)
+    {
+        spectrumAnalyser.start();
+        beginAnimation();
+    }
+    else
+    {
+        endAnimation();
+        spectrumAnalyser.stop();
+    }
+}
+
+void OpenGLComponent::setSyntheticSignalEnabled (bool shouldBeEnabled)
+{
+    isSyntheticSignalEnabled = shouldBeEnabled;
+    
+    if (shouldBeEnabled)
+        syntheticSignal.start();
+    else
+        syntheticSignal.stop();
+}
+
+// Offscreen Rendering =========================================================
+void OpenGLComponent::startOffscreenRendering (const OffscreenSettings& settings)
+{
+    jassert (settings.width > 0 && settings.height > 0);
+    
+    // Keep frames coming until the session ends
+    beginAnimation();
+    
+    openGLContext.executeOnGLThread ([this, settings] (OpenGLContext&)
+    {
+        if (offscreenSession != nullptr)
+            finishOffscreenRendering();
+        
+        auto session = std::make_unique<OffscreenSession>();
+        session->settings = settings;
+        
+        if (settings.frameCallback != nullptr)
+            session->writer = std::make_unique<OpenGLUtil::OffscreenFrameWriter> (settings.frameCallback);
+        else
+            session->writer = std::make_unique<OpenGLUtil::OffscreenFrameWriter> (settings.outputDirectory);
+        
+        if (! session->target.create (openGLContext, settings.width, settings.height))
+        {
+            setOpenGLStatusText ("Could not create a " + String (settings.width) + "x"
+                                 + String (settings.height) + " offscreen framebuffer");
+            offscreenSession = std::move (session);
+            finishOffscreenRendering();
+            return;
+        }
+        
+        session->reader.create (openGLContext);
+        offscreenSession = std::move (session);
+        framePacer.resetStatistics();
+    }, false);
+}
+
+void OpenGLComponent::stopOffscreenRendering()
+{
+    openGLContext.executeOnGLThread ([this] (OpenGLContext&)
+    {
+        if (offscreenSession != nullptr)
+            finishOffscreenRendering();
+    }, false);
+}
+
 // OpenGLRenderer Callbacks ================================================
 void OpenGLComponent::newOpenGLContextCreated()
 {
-    compileOpenGLShaderProgram();
+    coreFunctions.initialise();
+    jassert (coreFunctions.areAllFunctionsAvailable());
+    programBinaryCache.initialise (coreFunctions);
+    
+    // Compiles submitted before its workers are up run on this context
+    shaderCompiler.contextCreated (openGLContext, getPixelFormat());
+    
+    // Uniform buffers need to exist before the program binds its blocks to them
+    cameraUniforms.create (openGLContext, coreFunctions);
+    objectUniforms.create (openGLContext);
+    pointCloudUniforms.create (openGLContext);
+    cameraNeedsUpdate = true;
+    
+    compileOpenGLShaderProgram (BinaryData::BasicVertex_glsl, BinaryData::BasicFragment_glsl);
     
     vertices = ShapeVertices::generateTriangle(); // Setup vertices
     
     // Generate opengl vertex objects ==========================================
-    openGLContext.extensions.glGenVertexArrays(1, &VAO); // Vertex Array Object
     openGLContext.extensions.glGenBuffers (1, &VBO);     // Vertex Buffer Object
     
-    
-    // Bind opengl vertex objects to data ======================================
-    openGLContext.extensions.glBindVertexArray (VAO);
-    
     // Fill VBO buffer with vertices array
     openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, VBO);
     openGLContext.extensions.glBufferData (GL_ARRAY_BUFFER,
                                            sizeof (GLfloat) * vertices.size() * 3,
                                            vertices.data(),
                                            GL_STATIC_DRAW);
-
-
-    // Define that our vertices are laid out as groups of 3 GLfloats
-    openGLContext.extensions.glVertexAttribPointer (0, 3, GL_FLOAT, GL_FALSE,
-                                                    3 * sizeof (GLfloat), NULL);
-    openGLContext.extensions.glEnableVertexAttribArray (0);
+    openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+    
+    // Our vertices are laid out as groups of 3 GLfloats, see VertexFormats
+    const auto& layout = VertexFormats::PositionLayout::getDescription();
+    meshes = { { vertexArrays.get (openGLContext, layout, VBO), &layout, (GLsizei) vertices.size(), 0 } };
+    meshes[0].depthVertexArrayID = vertexArrays.get (openGLContext, *layout.positionOnly, VBO);
+    meshes[0].bounds = Rendering::Bounds::around (&vertices[0].x, vertices.size(), sizeof (Vector3D<GLfloat>));
+    
+    // Sampled by materials without a texture, and by those whose texture is still streaming in
+    const uint32 whitePixel = 0xffffffff;
+    glGenTextures (1, &whiteTextureID);
+    glBindTexture (GL_TEXTURE_2D, whiteTextureID);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, &whitePixel);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    
+    glGenTextures (1, &whiteTextureArrayID);
+    glBindTexture (GL_TEXTURE_2D_ARRAY, whiteTextureArrayID);
+    coreFunctions.glTexImage3D (GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, &whitePixel);
+    glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+    
+    for (auto& model : models)
+        uploadModel (*model);
+    
+    for (const auto& primitive : primitiveMeshes)
+        uploadPrimitive (primitive);
+    
+    // Build the program variants the meshes need now, rather than on first use
+    Array<OpenGLUtil::ShaderPermutationSet::FeatureMask> usedShaderFeatures;
+    
+    for (const auto& mesh : meshes)
+        usedShaderFeatures.addIfNotAlreadyThere (mesh.shaderFeatures);
+    
+    usedShaderFeatures.addIfNotAlreadyThere (ShaderFeatures::depthOnly);
+    
+    for (const auto& object : sceneObjects)
+        if (materials[object.material].isTransparent)
+            usedShaderFeatures.addIfNotAlreadyThere (meshes[object.mesh].shaderFeatures | ShaderFeatures::isWeightedBlended);
+    
+    shaderPrograms.precompile (openGLContext, coreFunctions, usedShaderFeatures);
+    requestMaterialTextures();
     
     
     // Optional OpenGL styling commands ========================================
     
-    // glEnable (GL_BLEND); // Enable alpha blending, allowing for transparency of objects
-    // glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // Paired with above line
+    // Blending is set up per frame for transparent materials, see WeightedBlendedOIT
     
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Show wireframe
 }
@@ -74,96 +416,468 @@ void OpenGLComponent::newOpenGLContextCreated()
 void OpenGLComponent::openGLContextClosing()
 {
     // Add any OpenGL related cleanup code here . . .
+    if (offscreenSession != nullptr)
+        finishOffscreenRendering();
+    
+    shaderPrograms.release (openGLContext);
+    textureStreamer.release (openGLContext);
+    glDeleteTextures (1, &whiteTextureID);
+    glDeleteTextures (1, &whiteTextureArrayID);
+    whiteTextureID = 0;
+    whiteTextureArrayID = 0;
+    
+    // The streamer forgets its textures, so the next context requests them again
+    for (auto& material : materials)
+        material.diffuseTexture = 0;
+    
+    for (auto& model : models)
+        for (auto& array : model->streamedArrays)
+            array.texture = 0;
+    
+    spectrogram.release (openGLContext);
+    pointCloud.release (openGLContext);
+    terrain.release (openGLContext);
+    transparency.release (openGLContext);
+    depthPrePass.release (coreFunctions);
+    dynamicResolution.release (openGLContext, coreFunctions);
+    occlusionCuller.release (openGLContext, coreFunctions);
+    pointCloudUniforms.release (openGLContext);
+    
+    for (auto& model : models)
+    {
+        model->textures.release();
+        
+        for (auto& batch : model->batches)
+            openGLContext.extensions.glDeleteBuffers (1, &batch.vertexBufferID);
+    }
+    
+    primitiveBuffers.release (openGLContext);
+    vertexArrays.release (openGLContext);
+    openGLContext.extensions.glDeleteBuffers (1, &VBO);
+    VBO = 0;
+    
+    cameraUniforms.release (openGLContext);
+    objectUniforms.release (openGLContext);
+    
+    if (overlayVertexArrayID != 0)
+        openGLContext.extensions.glDeleteVertexArrays (1, &overlayVertexArrayID);
+    
+    overlayVertexArrayID = 0;
+    
+    // Every program has let go of its compile jobs, so the workers can stop
+    shaderCompiler.contextClosing();
 }
 
 void OpenGLComponent::renderOpenGL()
 {
     jassert (OpenGLHelpers::isContextActive());
     
+    // Wait for the right moment to start this frame
+    framePacer.beginFrame (openGLContext);
+    
+    // Swap in newly compiled shader programs, if any have finished
+    updateShaderPrograms();
+    
+    // Upload this frame's share of decoded textures
+    textureStreamer.update (openGLContext, coreFunctions);
+    
     // Scale viewport
     const float renderingScale = (float) openGLContext.getRenderingScale();
-    glViewport (0, 0, roundToInt (renderingScale * getWidth()), roundToInt (renderingScale * getHeight()));
-
-    // Set background color
-    OpenGLHelpers::clear (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
-
-    // Select shader program
-    shaderProgram->use();
-
-    // Setup the Uniforms for use in the Shader
-    if (projectionMatrix)
-        projectionMatrix->setMatrix4 (calculateProjectionMatrix().mat, 1, false);
-    if (viewMatrix)
-        viewMatrix->setMatrix4 (calculateViewMatrix().mat, 1, false);
+    const Rectangle<int> viewportArea (roundToInt (renderingScale * getWidth()),
+                                       roundToInt (renderingScale * getHeight()));
     
-    // Draw Vertices
-    openGLContext.extensions.glBindVertexArray (VAO);
-    glDrawArrays (GL_TRIANGLES, 0, (int) vertices.size());
-    openGLContext.extensions.glBindVertexArray (0);
+    if (offscreenSession != nullptr)
+    {
+        renderOffscreenFrame (viewportArea);
+    }
+    else
+    {
+        // Possibly at reduced resolution, scaled up when it's done
+        renderScene (dynamicResolution.begin (openGLContext, coreFunctions, viewportArea));
+        dynamicResolution.end (openGLContext, coreFunctions);
+    }
+    
+    renderStatusOverlay (viewportArea, renderingScale);
+    framePacer.endFrame();
+    
+    // Refresh the overlay's frame statistics a couple of times per second
+    const double now = Time::getMillisecondCounterHiRes();
+    
+    if (now - lastStatisticsUpdateTime > 500.0)
+    {
+        lastStatisticsUpdateTime = now;
+        triggerAsyncUpdate();
+    }
+    
+    // In on-demand mode, keep the frames coming for as long as something animates,
+    // a shader compile or texture upload is in flight, or occlusion results for
+    // the current view are still to come
+    const auto textureStatistics = textureStreamer.getStatistics();
+    const bool isStreamingTextures = textureStatistics.numDecoding + textureStatistics.numUploading > 0;
+    
+    if (renderMode == RenderMode::onDemand && (activeAnimations > 0 || shaderPrograms.isCompiling() || isStreamingTextures
+                                                || occlusionCuller.isAwaitingResults()))
+        openGLContext.triggerRepaint();
 }
 
 // JUCE Component Callbacks ====================================================
 void OpenGLComponent::paint (Graphics& g)
 {
-    // You can optionally paint any JUCE graphics over the top of your OpenGL graphics
+    // Component painting is off, see the constructor, so paint any JUCE graphics
+    // over the top of your OpenGL graphics in renderStatusOverlay() instead
 }
 
 void OpenGLComponent::resized ()
 {
     draggableOrientation.setViewport (getLocalBounds());
-    openGLStatusLabel.setBounds (getLocalBounds().reduced (4).removeFromTop (75));
+    cameraNeedsUpdate = true;
+    invalidate();
 }
 
 void OpenGLComponent::mouseDown (const MouseEvent& e)
 {
     draggableOrientation.mouseDown (e.getPosition());
+    
+    // Render every vsync for the duration of the drag so no frame gets skipped
+    beginAnimation();
 }
 
 void OpenGLComponent::mouseDrag (const MouseEvent& e)
 {
     draggableOrientation.mouseDrag (e.getPosition());
+    cameraNeedsUpdate = true;
+    invalidate();
+}
+
+void OpenGLComponent::mouseUp (const MouseEvent&)
+{
+    endAnimation();
 }
 
 void OpenGLComponent::handleAsyncUpdate()
 {
-    openGLStatusLabel.setText (openGLStatusText, dontSendNotification);
+    String statusText;
+    
+    {
+        const SpinLock::ScopedLockType sl (statusTextLock);
+        statusText = openGLStatusText;
+    }
+    
+    statusText << "\n" << framePacer.getStatistics().toString();
+    const auto textureStatistics = textureStreamer.getStatistics();
+    
+    if (textureStatistics.numTextures > 0)
+        statusText << "\n" << textureStatistics.toString();
+    
+    statusText << "\n" << submissionCounters.toString();
+    statusText << "\n" << depthPrePass.getStatistics().toString();
+    statusText << "\n" << dynamicResolution.getStatistics().toString();
+    statusText << "\n" << occlusionCuller.getStatistics().toString();
+    
+    if (hasTerrain)
+        statusText << "\n" << terrain.getStatistics().toString();
+    
+    if (hasPointCloud)
+        statusText << "\n" << pointCloud.getStatistics().toString();
+    
+    if (isSpectrogramVisible)
+    {
+        statusText << "\nAudio: " << String (spectrumAnalyser.getNumDroppedSamples()) << " samples dropped";
+        
+        if (isSyntheticSignalEnabled)
+            statusText << ", longest callback " << String (syntheticSignal.getMaxCallbackTimeMs(), 3) << " ms";
+    }
+    
+    {
+        const SpinLock::ScopedLockType sl (statusTextLock);
+        overlayText = statusText;
+    }
+    
+    invalidate(); // Show it, see renderStatusOverlay()
 }
 
 // OpenGL Related Member Functions =============================================
-void OpenGLComponent::compileOpenGLShaderProgram()
+void OpenGLComponent::compileOpenGLShaderProgram (const String& vertexSource, const String& fragmentSource)
 {
-    std::unique_ptr<OpenGLShaderProgram> shaderProgramAttempt
-        = std::make_unique<OpenGLShaderProgram> (openGLContext);
+    shaderPrograms.setSources (openGLContext, coreFunctions, vertexSource, fragmentSource);
+    invalidate();
+}
+
 
-    // Attempt to compile the program
-    if (shaderProgramAttempt->addVertexShader ({ BinaryData::BasicVertex_glsl })
-        && shaderProgramAttempt->addFragmentShader ({ BinaryData::BasicFragment_glsl })
-        && shaderProgramAttempt->link())
+void OpenGLComponent::updateShaderPrograms()
+{
+    if (! shaderPrograms.update (openGLContext, coreFunctions))
+        return;
+    
+    if (shaderPrograms.getLastError().isNotEmpty())
     {
-        projectionMatrix.disconnectFromShaderProgram();
-        viewMatrix.disconnectFromShaderProgram();
-        
-        shaderProgram.reset (shaderProgramAttempt.release());
-        
-        projectionMatrix.connectToShaderProgram (openGLContext, *shaderProgram);
-        viewMatrix.connectToShaderProgram (openGLContext, *shaderProgram);
-        
-        openGLStatusText = "GLSL: v" + String (OpenGLShaderProgram::getLanguageVersion(), 2);
+        setOpenGLStatusText ("Shader compile failed, still using the last good program:\n"
+                             + shaderPrograms.getLastError());
     }
     else
     {
-        openGLStatusText = shaderProgramAttempt->getLastError();
+        setOpenGLStatusText ("GLSL: v" + String (OpenGLShaderProgram::getLanguageVersion(), 2) + ", "
+                             + String (shaderPrograms.getNumVariants()) + " variants in "
+                             + String (shaderPrograms.getNumPrograms()) + " programs"
+                             + (OpenGLUtil::AsyncShaderProgram::canCompileWithoutStalling (coreFunctions)
+                                    ? "" : ", compiled on " + String (shaderCompiler.getNumWorkers()) + " shared contexts") + "\n"
+                             + programBinaryCache.getStatistics().toString());
     }
+    
+    invalidate();
+}
+
 
+void OpenGLComponent::renderStatusOverlay (Rectangle<int> viewportArea, float renderingScale)
+{
+    String text;
+    
+    {
+        const SpinLock::ScopedLockType sl (statusTextLock);
+        text = overlayText;
+    }
+    
+    if (text.isEmpty())
+        return;
+    
+    // JUCE's renderer needs a vertex array bound in a core profile, as when it paints components
+    if (overlayVertexArrayID == 0)
+        openGLContext.extensions.glGenVertexArrays (1, &overlayVertexArrayID);
+    
+    openGLContext.extensions.glBindVertexArray (overlayVertexArrayID);
+    glViewport (0, 0, viewportArea.getWidth(), viewportArea.getHeight());
+    glDisable (GL_DEPTH_TEST);
+    
+    {
+        std::unique_ptr<LowLevelGraphicsContext> glRenderer (createOpenGLGraphicsContext (openGLContext, 0, viewportArea.getWidth(),
+                                                                                          viewportArea.getHeight()));
+        Graphics g (*glRenderer);
+        g.addTransform (AffineTransform::scale (renderingScale));
+        
+        const Font font (14.0f);
+        g.setFont (font);
+        g.setColour (Colours::white);
+        g.drawMultiLineText (text, 4, 4 + roundToInt (font.getAscent()),
+                             roundToInt (viewportArea.getWidth() / renderingScale) - 8);
+    }
+    
+    openGLContext.extensions.glBindVertexArray (0);
+}
+
+
+void OpenGLComponent::setOpenGLStatusText (const String& newText)
+{
+    {
+        const SpinLock::ScopedLockType sl (statusTextLock);
+        openGLStatusText = newText;
+    }
+    
     triggerAsyncUpdate(); // Update status text
 }
 
 
-Matrix3D<GLfloat> OpenGLComponent::calculateProjectionMatrix() const
+void OpenGLComponent::reloadShaderSources (const Array<File>& changedFiles)
+{
+    const auto vertexFile = shaderSourceDirectory.getChildFile ("BasicVertex.glsl");
+    const auto fragmentFile = shaderSourceDirectory.getChildFile ("BasicFragment.glsl");
+    
+    if (! changedFiles.contains (vertexFile) && ! changedFiles.contains (fragmentFile))
+        return;
+    
+    const String vertexSource = vertexFile.loadFileAsString();
+    const String fragmentSource = fragmentFile.loadFileAsString();
+    
+    openGLContext.executeOnGLThread ([this, vertexSource, fragmentSource] (OpenGLContext&)
+    {
+        compileOpenGLShaderProgram (vertexSource, fragmentSource);
+    }, false);
+}
+
+
+void OpenGLComponent::renderScene (Rectangle<int> viewportArea)
+{
+    glViewport (viewportArea.getX(), viewportArea.getY(), viewportArea.getWidth(), viewportArea.getHeight());
+
+    // Set background color
+    OpenGLHelpers::clear (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
+
+    // Upload the camera, if it has changed
+    updateCameraUniforms (viewportArea.toFloat().getAspectRatio (false));
+    
+    // Record and draw the scene, with world transforms recomputed only where they have changed
+    sceneGraph.update();
+    
+    // Without float targets for order-independent transparency, transparent objects must be sorted instead
+    const bool hasTransparentMaterials = std::any_of (materials.begin(), materials.end(), [] (const Material& material)
+    {
+        return material.isTransparent;
+    });
+    
+    const bool useWeightedBlended = hasTransparentMaterials
+                                     && transparency.prepare (openGLContext, coreFunctions, viewportArea.getWidth(), viewportArea.getHeight());
+    
+    prepareScene (depthPrePass.beginFrame (coreFunctions), useWeightedBlended);
+    
+    if (hasTerrain)
+        renderTerrain();
+    
+    submitDrawCommands (viewportArea, useWeightedBlended);
+    
+    if (hasPointCloud)
+        renderPointCloud (viewportArea);
+    
+    if (isSpectrogramVisible)
+        renderSpectrogram (viewportArea);
+}
+
+
+void OpenGLComponent::renderSpectrogram (Rectangle<int> viewportArea)
+{
+    if (! spectrogram.isCreated())
+        spectrogram.create (openGLContext, coreFunctions, spectrumAnalyser.getNumBins(), spectrogramHistoryLength);
+    
+    // Only the newest column is uploaded, however long the history
+    const auto& spectrum = spectrumAnalyser.getLatestSpectrum();
+    spectrogram.update (spectrum.levels.data(), (int) spectrum.levels.size(), spectrum.sequenceNumber);
+    
+    glViewport (viewportArea.getX(), viewportArea.getY(), viewportArea.getWidth(), viewportArea.getHeight() / 4);
+    spectrogram.render (openGLContext, coreFunctions);
+}
+
+
+void OpenGLComponent::renderTerrain()
+{
+    if (! terrain.isCreated())
+        terrain.create (openGLContext, coreFunctions);
+    
+    // The camera sits where the inverse of the view matrix takes the origin
+    const auto cameraToWorld = Rendering::Matrix4::fromMatrix3D (calculateViewMatrix()).affineInverted();
+    terrain.update (coreFunctions, { cameraToWorld.m[12], cameraToWorld.m[13], cameraToWorld.m[14] });
+    
+    glEnable (GL_DEPTH_TEST);
+    terrain.render (openGLContext, coreFunctions, cameraUniforms.getBindingPoint());
+    glDisable (GL_DEPTH_TEST);
+}
+
+
+void OpenGLComponent::renderPointCloud (Rectangle<int> viewportArea)
+{
+    const auto& modelMatrix = sceneGraph.getWorldTransform (pointCloudNode);
+    const auto projectionMatrix = calculateProjectionMatrix (viewportArea.toFloat().getAspectRatio (false));
+    
+    pointCloud.update (openGLContext, modelMatrix * calculateViewMatrix(), projectionMatrix, viewportArea.getHeight());
+    
+    auto* program = shaderPrograms.getProgram (openGLContext, coreFunctions, VertexFormats::PositionColour::shaderFeatures);
+    
+    if (program == nullptr)
+        return;
+    
+    // The points carry their own colours, so the object colour is white
+    ShaderUniformBlocks::ObjectUniforms block;
+    memcpy (block.modelMatrix, modelMatrix.mat, sizeof (block.modelMatrix));
+    std::fill (std::begin (block.colour), std::end (block.colour), 1.0f);
+    
+    pointCloudUniforms.resize (1);
+    pointCloudUniforms.set (0, block);
+    pointCloudUniforms.upload (openGLContext);
+    pointCloudUniforms.bindElement (coreFunctions, 0);
+    
+    // submitDrawCommands() leaves depth testing off, but the points must still hide behind the scene
+    program->use (openGLContext);
+    glPointSize (2.0f);
+    glEnable (GL_DEPTH_TEST);
+    glDepthFunc (GL_LESS);
+    pointCloud.render (openGLContext);
+    glDisable (GL_DEPTH_TEST);
+    
+    // Nodes are still streaming in, so keep the frames coming until they've arrived
+    const auto statistics = pointCloud.getStatistics();
+    
+    if (statistics.numDrawnNodes < statistics.numSelectedNodes)
+        invalidate();
+}
+
+
+void OpenGLComponent::renderOffscreenFrame (Rectangle<int> windowViewportArea)
+{
+    auto& session = *offscreenSession;
+    auto deliverFrame = [&session] (Image&& image, int frameNumber)
+    {
+        session.writer->addFrame (std::move (image), frameNumber);
+    };
+    
+    // Render, then queue the readback while the GPU is still busy with it
+    session.target.bind (openGLContext);
+    renderScene ({ session.target.getWidth(), session.target.getHeight() });
+    session.reader.readPixels (openGLContext, coreFunctions,
+                               { session.target.getWidth(), session.target.getHeight() },
+                               session.numFramesRendered++, deliverFrame);
+    
+    // Hand over any earlier frames the GPU has finished with
+    session.reader.collectFinishedReads (openGLContext, coreFunctions, false, deliverFrame);
+    session.target.unbind (openGLContext);
+    
+    // Letterboxed preview in the window
+    glViewport (0, 0, windowViewportArea.getWidth(), windowViewportArea.getHeight());
+    OpenGLHelpers::clear (getLookAndFeel().findColour (ResizableWindow::backgroundColourId));
+    
+    const auto previewArea = RectanglePlacement (RectanglePlacement::centred)
+                                .appliedTo (Rectangle<int> (session.target.getWidth(), session.target.getHeight()),
+                                            windowViewportArea);
+    session.target.blitTo (openGLContext, coreFunctions, previewArea);
+    
+    const int numFramesRequested = session.settings.numFrames;
+    
+    if (numFramesRequested > 0 && session.numFramesRendered >= numFramesRequested)
+        finishOffscreenRendering();
+}
+
+
+void OpenGLComponent::finishOffscreenRendering()
+{
+    jassert (offscreenSession != nullptr);
+    
+    auto& session = *offscreenSession;
+    const int numFramesRendered = session.numFramesRendered;
+    const auto result = session.target.isValid() ? Result::ok()
+                                                 : Result::fail ("Could not create a " + String (session.settings.width) + "x"
+                                                                 + String (session.settings.height) + " offscreen framebuffer");
+    
+    if (session.target.isValid())
+    {
+        session.reader.collectFinishedReads (openGLContext, coreFunctions, true,
+                                            [&session] (Image&& image, int frameNumber)
+                                            {
+                                                session.writer->addFrame (std::move (image), frameNumber);
+                                            });
+    }
+    
+    session.reader.release (openGLContext, coreFunctions);
+    session.target.release (openGLContext);
+    
+    // Flush the worker thread off the GL thread's back before telling anyone we're done
+    session.writer->waitUntilAllFramesWritten();
+    offscreenSession.reset();
+    cameraNeedsUpdate = true;
+    
+    MessageManager::callAsync ([safeThis = Component::SafePointer<OpenGLComponent> (this), result, numFramesRendered]
+    {
+        if (safeThis == nullptr)
+            return;
+        
+        safeThis->endAnimation();
+        
+        if (safeThis->onOffscreenRenderingFinished != nullptr)
+            safeThis->onOffscreenRenderingFinished (result, numFramesRendered);
+    });
+}
+
+
+Matrix3D<GLfloat> OpenGLComponent::calculateProjectionMatrix (float aspectRatio) const
 {
     float w = 1.0f / (0.5f + 0.1f);
-    float h = w * getLocalBounds().toFloat().getAspectRatio (false);
-    return Matrix3D<GLfloat>::fromFrustum (-w, w, -h, h, 4.0f, 30.0f);
+    float h = w * aspectRatio;
+    return Matrix3D<GLfloat>::fromFrustum (-w, w, -h, h, nearPlane, farPlane);
 }
 
 
@@ -174,3 +888,408 @@ Matrix3D<GLfloat> OpenGLComponent::calculateViewMatrix() const
     Matrix3D<GLfloat> translate (Vector3D<GLfloat> (0.0f, 0.0f, -10.0f));
     return rotate * scale * translate;
 }
+
+
+void OpenGLComponent::updateCameraUniforms (float aspectRatio)
+{
+    if (! cameraNeedsUpdate.exchange (false) && aspectRatio == uploadedCameraAspectRatio)
+        return;
+    
+    uploadedCameraAspectRatio = aspectRatio;
+    
+    ShaderUniformBlocks::CameraUniforms camera;
+    memcpy (camera.projectionMatrix, calculateProjectionMatrix (aspectRatio).mat, sizeof (camera.projectionMatrix));
+    memcpy (camera.viewMatrix, calculateViewMatrix().mat, sizeof (camera.viewMatrix));
+    
+    cameraUniforms.upload (openGLContext, camera);
+}
+
+
+void OpenGLComponent::prepareScene (bool useDepthPrePass, bool useWeightedBlended)
+{
+    // Below this many objects per chunk, handing work to other threads costs more than it saves
+    constexpr size_t objectsPerChunk = 1024;
+    
+    const size_t numObjects = sceneObjects.size();
+    const size_t numChunks = (numObjects + objectsPerChunk - 1) / objectsPerChunk;
+    
+    // One command list per chunk, so the merged order doesn't depend on which thread ran which chunk
+    drawCommands.beginFrame (jmax (1, (int) numChunks));
+    
+    const auto viewMatrix = calculateViewMatrix();
+    
+    sceneJobs.parallelFor (0, numObjects, objectsPerChunk, [this, &viewMatrix, useDepthPrePass, useWeightedBlended] (size_t begin, size_t end)
+    {
+        auto& list = drawCommands.getList ((int) (begin / objectsPerChunk));
+        
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto& object = sceneObjects[i];
+            const auto& modelMatrix = sceneGraph.getWorldTransform (object.node);
+            const auto& material = materials[object.material];
+            const uint32 program = meshes[object.mesh].shaderFeatures;
+            
+            // Distance of the object's origin from the camera, which looks down -z
+            const auto* m = modelMatrix.mat;
+            const auto* v = viewMatrix.mat;
+            const float distance = -(v[2] * m[12] + v[6] * m[13] + v[10] * m[14] + v[14]);
+            const uint32 depth = Rendering::SortKey::quantiseDepth (distance, nearPlane, farPlane);
+            
+            // The pre-pass leaves no overdraw to save, so its opaque draws sort by state alone.
+            // Transparent draws group by state when blended order-independently, else go back to front
+            uint64 sortKey;
+            
+            if (material.isTransparent)
+                sortKey = useWeightedBlended ? Rendering::SortKey::makeWeightedBlended (program, object.material, object.mesh)
+                                             : Rendering::SortKey::makeTransparent (program, object.material, object.mesh, depth);
+            else
+                sortKey = useDepthPrePass ? Rendering::SortKey::makeOpaque (program, object.material, object.mesh, depth)
+                                          : Rendering::SortKey::makeOpaqueFrontToBack (program, object.material, object.mesh, depth);
+            
+            list.add (sortKey, (uint32) i, object.mesh, object.material, modelMatrix);
+        }
+    });
+    
+    sceneJobs.reset();
+}
+
+
+Rendering::MaterialID OpenGLComponent::getSharedMaterial (Colour colour, const File& diffuseTextureFile)
+{
+    // Model batches own their materials, since each has its own texture array
+    for (size_t i = 0; i < materials.size(); ++i)
+        if (materials[i].isShared && materials[i].colour == colour && materials[i].diffuseTextureFile == diffuseTextureFile)
+            return (Rendering::MaterialID) i;
+    
+    materials.push_back ({ colour, diffuseTextureFile });
+    materials.back().isTransparent = ! colour.isOpaque();
+    materials.back().isShared = true;
+    requestMaterialTextures();
+    
+    return (Rendering::MaterialID) (materials.size() - 1);
+}
+
+
+void OpenGLComponent::requestMaterialTextures()
+{
+    // Decoding starts straight away; the textures show up over the next frames
+    for (auto& material : materials)
+        if (material.diffuseTexture == 0 && material.diffuseTextureFile != File())
+            material.diffuseTexture = textureStreamer.request (material.diffuseTextureFile);
+    
+    for (auto& model : models)
+    {
+        for (auto& array : model->streamedArrays)
+            if (array.texture == 0)
+                array.texture = textureStreamer.requestArray (array.layers, PackedModel::textureLayerSize);
+        
+        for (const auto& batch : model->batches)
+            if (batch.streamedArray >= 0)
+                materials[batch.material].diffuseTexture = model->streamedArrays[(size_t) batch.streamedArray].texture;
+    }
+}
+
+
+void OpenGLComponent::uploadModel (PackedModel& model)
+{
+    model.textures.upload (coreFunctions);
+    
+    const auto& layout = PackedModel::Vertex::Layout::getDescription();
+    
+    for (auto& batch : model.batches)
+    {
+        openGLContext.extensions.glGenBuffers (1, &batch.vertexBufferID);
+        openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, batch.vertexBufferID);
+        openGLContext.extensions.glBufferData (GL_ARRAY_BUFFER,
+                                               (GLsizeiptr) (sizeof (PackedModel::Vertex) * batch.vertices.size()),
+                                               batch.vertices.data(),
+                                               GL_STATIC_DRAW);
+        openGLContext.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+        
+        if (meshes.size() <= batch.mesh)
+            meshes.resize (batch.mesh + 1);
+        
+        meshes[batch.mesh] = { vertexArrays.get (openGLContext, layout, batch.vertexBufferID), &layout,
+                               (GLsizei) batch.vertices.size(), PackedModel::Vertex::shaderFeatures };
+        meshes[batch.mesh].depthVertexArrayID = vertexArrays.get (openGLContext, *layout.positionOnly, batch.vertexBufferID);
+        meshes[batch.mesh].bounds = Rendering::Bounds::around (batch.vertices.data()->position, batch.vertices.size(),
+                                                               sizeof (PackedModel::Vertex));
+        materials[batch.material].textureArrayID = model.textures.getTextureID (batch.textureArray);
+    }
+}
+
+
+void OpenGLComponent::uploadPrimitive (const PrimitiveMesh& primitive)
+{
+    const auto range = primitiveBuffers.get (openGLContext, primitive.shape, primitive.tessellation);
+    const auto& layout = Rendering::Primitives::Vertex::Layout::getDescription();
+    
+    if (meshes.size() <= primitive.mesh)
+        meshes.resize (primitive.mesh + 1);
+    
+    // Every primitive shares the one VAO over the shared buffers
+    meshes[primitive.mesh] = { vertexArrays.get (openGLContext, layout, primitiveBuffers.getVertexBufferID(),
+                                                 primitiveBuffers.getIndexBufferID()),
+                               &layout, 0, Rendering::Primitives::Vertex::shaderFeatures,
+                               range.getIndexOffset(), range.numIndices,
+                               vertexArrays.get (openGLContext, *layout.positionOnly, primitiveBuffers.getVertexBufferID(),
+                                                 primitiveBuffers.getIndexBufferID()) };
+    
+    const auto& shapeVertices = Rendering::Primitives::getCached (primitive.shape, primitive.tessellation).vertices;
+    meshes[primitive.mesh].bounds = Rendering::Bounds::around (shapeVertices.data()->position, shapeVertices.size(),
+                                                               sizeof (Rendering::Primitives::Vertex));
+}
+
+
+void OpenGLComponent::submitDrawCommands (Rectangle<int> viewportArea, bool useWeightedBlended)
+{
+    const auto& commands = drawCommands.merge();
+    
+    if (commands.empty())
+    {
+        submissionCounters.set (0, 0, 0, 0, drawCommands.getSortTimeMs());
+        depthPrePass.endFrame();
+        return;
+    }
+    
+    // Visibility as of the latest query results, which is what the draws below go by
+    occlusionCuller.beginFrame (coreFunctions, sceneObjects.size());
+    
+    // One upload for every object's uniforms, in submission order
+    objectUniforms.resize (commands.size());
+    
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        const auto& command = *commands[i];
+        const auto& colour = materials[command.material].colour;
+        
+        ShaderUniformBlocks::ObjectUniforms block;
+        memcpy (block.modelMatrix, command.transform, sizeof (block.modelMatrix));
+        block.colour[0] = colour.getFloatRed();
+        block.colour[1] = colour.getFloatGreen();
+        block.colour[2] = colour.getFloatBlue();
+        block.colour[3] = colour.getFloatAlpha();
+        
+        objectUniforms.set (i, block);
+    }
+    
+    objectUniforms.upload (openGLContext);
+    
+    // Transparent commands sort after every opaque one
+    const size_t numOpaque = (size_t) (std::partition_point (commands.begin(), commands.end(), [] (const Rendering::DrawCommand* command)
+    {
+        return (command->sortKey >> 60) == Rendering::SortKey::opaquePass;
+    }) - commands.begin());
+    
+    DrawCounts counts;
+    glEnable (GL_DEPTH_TEST);
+    glDepthFunc (GL_LESS);
+    
+    // With the pre-pass, depth is already final, so only the nearest surface passes
+    if (depthPrePass.isActiveThisFrame() && numOpaque > 0)
+    {
+        depthPrePass.beginDepthPass (coreFunctions);
+        const bool isDepthComplete = submitDepthOnly (commands, numOpaque, counts);
+        depthPrePass.endDepthPass (coreFunctions);
+        
+        // Meshes whose depth program hasn't linked yet must still be able to write depth
+        glDepthFunc (isDepthComplete ? GL_EQUAL : GL_LEQUAL);
+        glDepthMask (isDepthComplete ? GL_FALSE : GL_TRUE);
+    }
+    
+    depthPrePass.beginShadingPass (coreFunctions);
+    submitDrawRange (commands, 0, numOpaque, 0, counts);
+    depthPrePass.endShadingPass (coreFunctions);
+    depthPrePass.endFrame();
+    
+    glDepthFunc (GL_LESS);
+    glDepthMask (GL_TRUE);
+    
+    // Every opaque occluder is in the depth buffer now; the transparent ones don't write it
+    occlusionCuller.issueQueries (openGLContext, coreFunctions, commands, objectUniforms, calculateViewMatrix(), nearPlane,
+                                  [this] (const Rendering::DrawCommand& command) { return meshes[command.mesh].bounds; });
+    
+    if (numOpaque < commands.size())
+    {
+        if (useWeightedBlended)
+        {
+            transparency.begin (openGLContext, coreFunctions, viewportArea);
+            submitDrawRange (commands, numOpaque, commands.size(), ShaderFeatures::isWeightedBlended, counts);
+            transparency.end (openGLContext, coreFunctions);
+        }
+        else
+        {
+            // Without float targets, blend back to front, as prepareScene() sorted them.
+            // Still wrong where surfaces intersect, since objects are sorted as a whole
+            glEnable (GL_BLEND);
+            glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask (GL_FALSE);
+            submitDrawRange (commands, numOpaque, commands.size(), 0, counts);
+            glDepthMask (GL_TRUE);
+            glDisable (GL_BLEND);
+        }
+    }
+    
+    glDisable (GL_DEPTH_TEST);
+    openGLContext.extensions.glBindVertexArray (0);
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+    
+    submissionCounters.set (counts.numDraws, counts.numProgramBinds, counts.numVertexArrayBinds,
+                            counts.numTextureBinds, drawCommands.getSortTimeMs());
+}
+
+
+bool OpenGLComponent::submitDepthOnly (const std::vector<const Rendering::DrawCommand*>& commands,
+                                       size_t numCommands, DrawCounts& counts)
+{
+    bool isComplete = true;
+    glColorMask (GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    
+    Rendering::MeshID boundMesh = std::numeric_limits<Rendering::MeshID>::max();
+    OpenGLUtil::AsyncShaderProgram* boundProgram = nullptr;
+    
+    for (size_t i = 0; i < numCommands; ++i)
+    {
+        const auto& command = *commands[i];
+        const auto& mesh = meshes[command.mesh];
+        
+        if (! occlusionCuller.isVisible (command.object))
+            continue;
+        
+        if (command.mesh != boundMesh)
+        {
+            auto* program = shaderPrograms.getProgram (openGLContext, coreFunctions, ShaderFeatures::depthOnly);
+            
+            if (program != nullptr && program != boundProgram)
+            {
+                jassert (mesh.vertexLayout->positionOnly->isCompatibleWith (program->getUniforms()));
+                
+                program->use (openGLContext);
+                ++counts.numProgramBinds;
+            }
+            
+            openGLContext.extensions.glBindVertexArray (mesh.depthVertexArrayID);
+            ++counts.numVertexArrayBinds;
+            boundMesh = command.mesh;
+            boundProgram = program;
+        }
+        
+        if (boundProgram == nullptr)
+        {
+            isComplete = false;
+            continue;
+        }
+        
+        objectUniforms.bindElement (coreFunctions, i);
+        
+        if (mesh.numIndices > 0)
+            glDrawElements (GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT, mesh.indexOffset);
+        else
+            glDrawArrays (GL_TRIANGLES, 0, mesh.numVertices);
+        
+        ++counts.numDraws;
+    }
+    
+    glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    return isComplete;
+}
+
+
+void OpenGLComponent::submitDrawRange (const std::vector<const Rendering::DrawCommand*>& commands,
+                                       size_t begin, size_t end, uint32 extraShaderFeatures, DrawCounts& counts)
+{
+    // Commands arrive sorted, so only bind a mesh, or its program, when it changes
+    Rendering::MeshID boundMesh = std::numeric_limits<Rendering::MeshID>::max();
+    OpenGLUtil::AsyncShaderProgram* boundProgram = nullptr;
+    GLuint boundTexture = 0, boundTextureArray = 0;
+    
+    for (size_t i = begin; i < end; ++i)
+    {
+        const auto& command = *commands[i];
+        const auto& mesh = meshes[command.mesh];
+        
+        // Hidden behind other objects when last tested
+        if (! occlusionCuller.isVisible (command.object))
+            continue;
+        
+        if (command.mesh != boundMesh)
+        {
+            auto* program = shaderPrograms.getProgram (openGLContext, coreFunctions, mesh.shaderFeatures | extraShaderFeatures);
+            
+            if (program != nullptr && program != boundProgram)
+            {
+                // The program reads an attribute that this mesh's vertex layout doesn't supply
+                jassert (mesh.vertexLayout->isCompatibleWith (program->getUniforms()));
+                
+                program->use (openGLContext);
+                ++counts.numProgramBinds;
+                
+                // Only reaches GL if the value differs from what the program already has
+                program->getUniforms().set (colourTextureUniform, 0);
+                program->getUniforms().upload (openGLContext);
+            }
+            
+            openGLContext.extensions.glBindVertexArray (mesh.vertexArrayID);
+            ++counts.numVertexArrayBinds;
+            boundMesh = command.mesh;
+            boundProgram = program;
+        }
+        
+        // Nothing to draw this mesh with until its program variant has linked
+        if (boundProgram == nullptr)
+            continue;
+        
+        const auto& material = materials[command.material];
+        
+        // Variants without texture coordinates don't sample anything
+        if ((mesh.shaderFeatures & ShaderFeatures::hasTextureCoordinates) != 0)
+        {
+            if ((mesh.shaderFeatures & ShaderFeatures::hasTextureLayers) != 0)
+            {
+                // Every material packed into the same array shares this bind.
+                // Streamed arrays show the material colour until every layer arrives
+                GLuint textureArray = material.textureArrayID;
+                
+                if (textureArray == 0)
+                    textureArray = textureStreamer.getTextureID (material.diffuseTexture);
+                
+                if (textureArray == 0)
+                    textureArray = whiteTextureArrayID;
+                
+                if (textureArray != boundTextureArray)
+                {
+                    openGLContext.extensions.glActiveTexture (GL_TEXTURE0);
+                    glBindTexture (GL_TEXTURE_2D_ARRAY, textureArray);
+                    boundTextureArray = textureArray;
+                    ++counts.numTextureBinds;
+                }
+            }
+            else
+            {
+                // Untextured materials, and textures still streaming in, show just the material colour
+                GLuint texture = textureStreamer.getTextureID (material.diffuseTexture);
+                
+                if (texture == 0)
+                    texture = whiteTextureID;
+                
+                if (texture != boundTexture)
+                {
+                    openGLContext.extensions.glActiveTexture (GL_TEXTURE0);
+                    glBindTexture (GL_TEXTURE_2D, texture);
+                    boundTexture = texture;
+                    ++counts.numTextureBinds;
+                }
+            }
+        }
+        
+        objectUniforms.bindElement (coreFunctions, i);
+        
+        if (mesh.numIndices > 0)
+            glDrawElements (GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT, mesh.indexOffset);
+        else
+            glDrawArrays (GL_TRIANGLES, 0, mesh.numVertices);
+        
+        ++counts.numDraws;
+    }
+}
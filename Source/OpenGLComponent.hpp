@@ -10,6 +10,34 @@
 
 #include <JuceHeader.h>
 #include "OpenGLUtil/OpenGLUtil.hpp"
+#include "OpenGLUtil/FramePacer.hpp"
+#include "OpenGLUtil/OffscreenRenderTarget.hpp"
+#include "OpenGLUtil/AsyncPixelReader.hpp"
+#include "OpenGLUtil/OffscreenFrameWriter.hpp"
+#include "OpenGLUtil/AsyncShaderProgram.hpp"
+#include "OpenGLUtil/ProgramBinaryCache.hpp"
+#include "OpenGLUtil/ShaderPermutationSet.hpp"
+#include "OpenGLUtil/ShaderSourceWatcher.hpp"
+#include "OpenGLUtil/SharedContextCompiler.hpp"
+#include "OpenGLUtil/TextureStreamer.hpp"
+#include "OpenGLUtil/UniformBuffer.hpp"
+#include "ShaderUniformBlocks.hpp"
+#include "ShaderFeatures.hpp"
+#include "VertexFormats.hpp"
+#include "Rendering/DepthPrePass.hpp"
+#include "Rendering/DrawCommandList.hpp"
+#include "Rendering/DynamicResolution.hpp"
+#include "Rendering/JobSystem.hpp"
+#include "Rendering/OcclusionCuller.hpp"
+#include "Rendering/SceneGraph.hpp"
+#include "Rendering/ClipmapTerrain.hpp"
+#include "Rendering/PointCloudRenderer.hpp"
+#include "Rendering/Primitives.hpp"
+#include "Rendering/SpectrogramRenderer.hpp"
+#include "Rendering/WeightedBlendedOIT.hpp"
+#include "Audio/SpectrumAnalyser.hpp"
+#include "Audio/SyntheticSignalSource.hpp"
+#include "PackedModel.hpp"
 #include "ShapeVertices.hpp"
 
 /** A custom JUCE Component which renders using OpenGL. You can use this class
@@ -26,6 +54,132 @@ public:
     OpenGLComponent();
     ~OpenGLComponent();
     
+    // Render Scheduling =======================================================
+    enum class RenderMode
+    {
+        continuous, /**< Renders every frame at the display's refresh rate. */
+        onDemand    /**< Renders only after invalidate(), or while animating. */
+    };
+    
+    /** Selects whether frames are rendered continuously or only on demand.
+        Must be called from the message thread. */
+    void setRenderMode (RenderMode newMode);
+    RenderMode getRenderMode() const noexcept { return renderMode; }
+    
+    /** Requests a new frame because something visible has changed, e.g. new
+        data has arrived. Safe to call from any thread. In continuous mode this
+        does nothing, since the next frame is coming anyway. */
+    void invalidate();
+    
+    /** While at least one animation is in progress, frames are rendered
+        back-to-back even in on-demand mode. Each beginAnimation() call must be
+        paired with an endAnimation(). Safe to call from any thread. */
+    void beginAnimation();
+    void endAnimation();
+    
+    /** Limits rendering to the given number of frames per second, or removes
+        the limit if zero. Safe to call from any thread. */
+    void setTargetFrameRate (double framesPerSecond);
+    
+    /** The refresh rate of the display, from which the frame pacer picks a
+        swap interval for the target frame rate. JUCE can't query it, so it
+        defaults to 60 Hz. Safe to call from any thread. */
+    void setDisplayRefreshRate (double hz);
+    
+    /** With vsync off, only the target frame rate limits rendering. On by
+        default. Safe to call from any thread. */
+    void setVSyncEnabled (bool shouldUseVSync);
+    
+    /** Frame timing statistics over the last few seconds of rendering. */
+    OpenGLUtil::FramePacer::Statistics getFrameStatistics() const;
+    
+    /** Whether opaque geometry is drawn depth first, see Rendering::DepthPrePass.
+        The default, automatic, decides from the measured overdraw and cost
+        per fragment. Safe to call from any thread. */
+    void setDepthPrePassMode (Rendering::DepthPrePass::Mode newMode);
+    
+    /** Controls how far the window's rendering resolution may drop to keep
+        the GPU time per frame under a target, see Rendering::DynamicResolution.
+        Offscreen rendering always uses the full resolution. Safe to call from
+        any thread. */
+    void setDynamicResolution (const Rendering::DynamicResolution::Settings& newSettings);
+    
+    /** Controls skipping objects hidden behind others, found with occlusion
+        queries on their bounding boxes, see Rendering::OcclusionCuller. On by
+        default. Safe to call from any thread. */
+    void setOcclusionCulling (const Rendering::OcclusionCuller::Settings& newSettings);
+    
+    // Models ==================================================================
+    /** Loads a Wavefront OBJ model and adds it to the scene. Its textures are
+        packed into texture arrays and its shapes merged into one draw per
+        array, see PackedModel. Textures are decoded before this returns, so
+        call it from the message thread or a worker thread. */
+    Result loadModel (const File& objFile, const Matrix3D<GLfloat>& modelMatrix = {});
+    
+    /** Opens a point cloud built with Rendering::PointCloudOctree::build()
+        and draws it in place of any previous one. The file is memory-mapped,
+        and only the nodes in view at enough detail are read and uploaded, so
+        the cloud may be far larger than memory. */
+    Result loadPointCloud (const File& octreeFile, const Matrix3D<GLfloat>& modelMatrix = {});
+    
+    /** Adds a generated shape to the scene, see Rendering::Primitives. Every
+        object of the same shape and tessellation draws from the same range of
+        one shared buffer, so they sort together and bind nothing in between.
+        Safe to call from any thread. */
+    void addPrimitive (Rendering::Primitives::Shape shape, int tessellation,
+                       const Matrix3D<GLfloat>& modelMatrix = {}, Colour colour = Colours::white);
+    
+    /** Draws a heightfield of 16 bit samples as terrain around the camera,
+        see Rendering::ClipmapTerrain. The file is memory-mapped, so it can be
+        far larger than memory. `sampleSpacing` is the world distance between
+        samples and `heightScale` the height of the largest sample. Each of
+        the `numLevels` levels covers twice the distance of the one before. */
+    Result loadTerrain (const File& rawHeightFile, int width, int depth,
+                        float sampleSpacing, float heightScale, int numLevels = 8);
+    
+    // Spectrogram =============================================================
+    /** The analyser behind the spectrogram. Feed it from your audio callback
+        with pushSamples(), which is wait-free and so safe on the audio thread. */
+    Audio::SpectrumAnalyser& getSpectrumAnalyser() noexcept { return spectrumAnalyser; }
+    
+    /** Shows a scrolling spectrogram of the analyser's input along the bottom
+        of the view, rendering continuously while it is shown. Must be called
+        from the message thread. */
+    void setSpectrogramVisible (bool shouldBeVisible);
+    
+    /** Feeds the analyser a built-in test signal instead of real audio, see
+        Audio::SyntheticSignalSource. Must be called from the message thread. */
+    void setSyntheticSignalEnabled (bool shouldBeEnabled);
+    
+    // Offscreen Rendering =====================================================
+    struct OffscreenSettings
+    {
+        int width = 1920, height = 1080;
+        
+        /** Number of frames to render before stopping, or 0 to run until
+            stopOffscreenRendering() is called. */
+        int numFrames = 0;
+        
+        /** Frames are written here as a PNG sequence, unless frameCallback is set. */
+        File outputDirectory;
+        
+        /** Called on a worker thread with every rendered frame. */
+        OpenGLUtil::OffscreenFrameWriter::FrameCallback frameCallback;
+    };
+    
+    /** Renders the scene into an offscreen framebuffer of the given size
+        instead of the window, and streams every frame to a PNG sequence or a
+        callback. The window shows a scaled preview. Frames are rendered
+        back-to-back until the requested number have been produced. */
+    void startOffscreenRendering (const OffscreenSettings& settings);
+    void stopOffscreenRendering();
+    
+    /** Called on the message thread once offscreen rendering has stopped and
+        every frame has been delivered, with the number of frames rendered.
+        The result is a failure if the offscreen framebuffer couldn't be
+        created, in which case no frames were rendered. */
+    std::function<void (const Result&, int numFramesRendered)> onOffscreenRenderingFinished;
+    
     // OpenGLRenderer Callbacks ================================================
     void newOpenGLContextCreated() override;
     void openGLContextClosing() override;
@@ -38,6 +192,7 @@ public:
     // Used to connect Draggable3DOrientation to mouse movments
     void mouseDown (const MouseEvent& e) override;
     void mouseDrag (const MouseEvent& e) override;
+    void mouseUp (const MouseEvent& e) override;
     
     // AsyncUpdater Callback ===================================================
     /** If the OpenGLRenderer thread needs to update some form JUCE GUI object
@@ -47,27 +202,288 @@ public:
 
 private:
     
-    /** Attempts to compile the OpenGL program at runtime and setup OpenGL variables. */
-    void compileOpenGLShaderProgram();
+    /** Sets the sources of the OpenGL program and starts rebuilding every
+        variant of it that is in use, from the program binary cache where
+        possible. The render thread keeps drawing with the current programs
+        until the new ones have linked, see updateShaderPrograms(). */
+    void compileOpenGLShaderProgram (const String& vertexSource, const String& fragmentSource);
+    
+    /** Checks on program builds in progress, without blocking. Variants switch
+        to their new program once it has linked, or keep the last good one and
+        report the error if it failed. */
+    void updateShaderPrograms();
+    
+    /** Replaces the status text shown above the frame statistics. Called on
+        the OpenGL thread; the overlay picks it up on the message thread. */
+    void setOpenGLStatusText (const String& newText);
+    
+    /** Draws the text handleAsyncUpdate() last put together over the frame,
+        with JUCE's OpenGL renderer. Component painting is off, so that
+        renderOpenGL() never holds the message manager lock, which also
+        leaves child components such as a Label unseen. */
+    void renderStatusOverlay (Rectangle<int> viewportArea, float renderingScale);
+    
+    /** Reads the shader sources from disk and recompiles them if any of
+        `changedFiles` belong to the program. Called on the message thread. */
+    void reloadShaderSources (const Array<File>& changedFiles);
+    
+    /** Creates the model's texture arrays and vertex buffers, and points its
+        meshes and materials at them. */
+    void uploadModel (PackedModel& model);
+    
+    /** Returns a material with this colour and texture, adding one only if
+        no object uses one yet, so that materials, and their sort key field,
+        grow with the distinct looks in the scene rather than its objects. */
+    Rendering::MaterialID getSharedMaterial (Colour colour, const File& diffuseTextureFile);
+    
+    /** Starts streaming in the texture files of materials, and the texture
+        arrays of models, that haven't been requested yet, see `textureStreamer`. */
+    void requestMaterialTextures();
+    
+    struct PrimitiveMesh;
+    
+    /** Adds the primitive to the shared primitive buffers if needed, and
+        points its mesh at its range of them. */
+    void uploadPrimitive (const PrimitiveMesh& primitive);
+    
+    /** Draws the scene into the currently bound framebuffer. */
+    void renderScene (Rectangle<int> viewportArea);
+    
+    /** Writes the newest spectrum into the spectrogram and draws it across
+        the bottom quarter of the viewport. */
+    void renderSpectrogram (Rectangle<int> viewportArea);
     
-    Matrix3D<GLfloat> calculateProjectionMatrix() const;
+    /** Moves the terrain's levels with the camera and draws them. */
+    void renderTerrain();
+    
+    /** Chooses, streams and draws the point cloud's nodes for the current camera. */
+    void renderPointCloud (Rectangle<int> viewportArea);
+    
+    /** Draws the scene into the offscreen target, queues its readback and
+        shows a preview in the window. */
+    void renderOffscreenFrame (Rectangle<int> windowViewportArea);
+    
+    /** Waits for every outstanding readback and frees the offscreen resources. */
+    void finishOffscreenRendering();
+    
+    Matrix3D<GLfloat> calculateProjectionMatrix (float aspectRatio) const;
     Matrix3D<GLfloat> calculateViewMatrix() const;
+    
+    // Distances of the projection's clipping planes from the camera
+    static constexpr float nearPlane = 4.0f, farPlane = 30.0f;
+    
+    /** 24 bit depth and 8 bit stencil, the format of the offscreen targets,
+        so that depth can be blitted between them and the window. */
+    static OpenGLPixelFormat getPixelFormat()   { return OpenGLPixelFormat (8, 8, 24, 8); }
+    
+    /** Uploads the camera uniform buffer, but only if the camera or the
+        viewport's aspect ratio has changed since the last upload. */
+    void updateCameraUniforms (float aspectRatio);
+    
+    /** Records a draw command for every scene object, keyed by pass, program,
+        material, mesh and distance from the camera (see Rendering::SortKey).
+        Large scenes are split into chunks recorded in parallel by the scene
+        job system, each into its own command list. Without the depth pre-pass
+        opaque objects are sorted front to back before anything else, and
+        without order-independent transparency transparent objects are sorted
+        back to front. */
+    void prepareScene (bool useDepthPrePass, bool useWeightedBlended);
+    
+    /** Merges the recorded command lists and submits them: one upload of the
+        per-object uniform buffer, then one ranged bind and draw per command.
+        Opaque commands are preceded by a depth-only pass if `depthPrePass`
+        chose one; transparent commands come last and go through `transparency`
+        if `useWeightedBlended`, else are alpha blended in their sorted order.
+        Objects `occlusionCuller` found hidden are skipped, and between the
+        two passes it tests the boxes of those due for another look. */
+    void submitDrawCommands (Rectangle<int> viewportArea, bool useWeightedBlended);
+    
+    struct DrawCounts
+    {
+        int numDraws = 0, numProgramBinds = 0, numVertexArrayBinds = 0, numTextureBinds = 0;
+    };
+    
+    /** Draws the first `numCommands` commands into the depth buffer only,
+        through each mesh's position-only VAO. Returns false if some were
+        skipped because their program variant hasn't linked yet. */
+    bool submitDepthOnly (const std::vector<const Rendering::DrawCommand*>& commands,
+                          size_t numCommands, DrawCounts& counts);
+    
+    /** Draws commands [begin, end) with the program variants for their meshes'
+        features plus `extraShaderFeatures`. */
+    void submitDrawRange (const std::vector<const Rendering::DrawCommand*>& commands,
+                          size_t begin, size_t end, uint32 extraShaderFeatures, DrawCounts& counts);
 
     // OpenGL Variables
     OpenGLContext openGLContext;
-    std::unique_ptr<OpenGLShaderProgram> shaderProgram;
+    OpenGLUtil::CoreProfileFunctions coreFunctions;
+    
+    // Compiles programs on contexts of its own where the driver can't do it in the background
+    OpenGLUtil::SharedContextCompiler shaderCompiler { *this };
+    OpenGLUtil::ShaderPermutationSet shaderPrograms { "Basic", ShaderFeatures::getDefineNames() };
+    const OpenGLUtil::UniformHandle<GLint> colourTextureUniform { "colourTexture" };
+    
+    // Linked programs saved between launches
+    OpenGLUtil::ProgramBinaryCache programBinaryCache {
+        File::getSpecialLocation (File::userApplicationDataDirectory)
+            .getChildFile (ProjectInfo::projectName).getChildFile ("ProgramCache") };
+    
+    // Shader hot reloading, for development builds run from inside the project
+    OpenGLUtil::ShaderSourceWatcher shaderSourceWatcher;
+    File shaderSourceDirectory;
+    
+    // Uniform buffers shared by every shader program
+    OpenGLUtil::UniformBuffer<ShaderUniformBlocks::CameraUniforms> cameraUniforms { ShaderUniformBlocks::cameraBindingPoint };
+    OpenGLUtil::UniformBufferArray<ShaderUniformBlocks::ObjectUniforms> objectUniforms { ShaderUniformBlocks::objectBindingPoint };
     
-    OpenGLUtil::UniformWrapper projectionMatrix { "projectionMatrix" };
-    OpenGLUtil::UniformWrapper viewMatrix {"viewMatrix" };
+    // Render scheduling
+    std::atomic<RenderMode> renderMode { RenderMode::onDemand };
+    std::atomic<int> activeAnimations { 0 };
+    OpenGLUtil::FramePacer framePacer;
+    double lastStatisticsUpdateTime = 0;
     
-    GLuint VAO, VBO;
+    // Set from the message thread whenever something the camera depends on changes
+    std::atomic<bool> cameraNeedsUpdate { true };
+    float uploadedCameraAspectRatio = 0.0f;
+    
+    GLuint VBO = 0;
     std::vector<Vector3D<GLfloat>> vertices;
     
+    // One VAO per vertex layout and buffer, set up once
+    OpenGLUtil::VertexArrayCache vertexArrays;
+    
+    // GPU meshes, indexed by Rendering::MeshID
+    struct MeshBinding
+    {
+        GLuint vertexArrayID;
+        const OpenGLUtil::VertexLayoutDescription* vertexLayout;
+        GLsizei numVertices;
+        OpenGLUtil::ShaderPermutationSet::FeatureMask shaderFeatures;
+        
+        // Indexed meshes are drawn with glDrawElements from this range of the VAO's index buffer
+        const GLvoid* indexOffset = nullptr;
+        GLsizei numIndices = 0;
+        
+        // The same buffers with only the position enabled, for the depth pre-pass
+        GLuint depthVertexArrayID = 0;
+        
+        // Local bounds of the vertices, for occlusion queries
+        Rendering::Bounds bounds;
+    };
+    std::vector<MeshBinding> meshes;
+    
+    // Materials, indexed by Rendering::MaterialID
+    struct Material
+    {
+        Colour colour;
+        File diffuseTextureFile; // e.g. from WavefrontObjFile::Material::diffuseTextureName
+        OpenGLUtil::TextureStreamer::TextureID diffuseTexture = 0; // A 2D texture, or a PackedModel's streamed array
+        GLuint textureArrayID = 0; // A PackedModel's colour layers, for variants with texture layers
+        bool isTransparent = false; // Drawn after the opaque objects, in any order, see WeightedBlendedOIT
+        bool isShared = false; // Can be reused by any object with the same colour and texture
+    };
+    std::vector<Material> materials;
+    
+    // Material textures, decoded in the background and uploaded a little per frame
+    OpenGLUtil::TextureStreamer textureStreamer;
+    GLuint whiteTextureID = 0, whiteTextureArrayID = 0;
+    
+    // Models added with loadModel(), kept on the CPU so that a new context can upload them again
+    std::vector<std::shared_ptr<PackedModel>> models;
+    
+    // Shapes added with addPrimitive(), one mesh per shape and tessellation
+    struct PrimitiveMesh
+    {
+        Rendering::Primitives::Shape shape;
+        int tessellation;
+        Rendering::MeshID mesh;
+    };
+    std::vector<PrimitiveMesh> primitiveMeshes;
+    Rendering::PrimitiveBuffers primitiveBuffers;
+    
+    // Transform hierarchy of the scene objects, world transforms updated once per frame
+    Rendering::SceneGraph sceneGraph;
+    
+    // Scene objects
+    struct SceneObject
+    {
+        Rendering::SceneGraph::NodeID node;
+        Rendering::MeshID mesh;
+        Rendering::MaterialID material;
+    };
+    std::vector<SceneObject> sceneObjects;
+    
+    // Draw submission
+    Rendering::DrawCommandQueue drawCommands;
+    Rendering::DepthPrePass depthPrePass;
+    Rendering::DynamicResolution dynamicResolution;
+    Rendering::OcclusionCuller occlusionCuller;
+    Rendering::WeightedBlendedOIT transparency;
+    
+    // Bind and draw counts of the last submitted frame, shown in the overlay
+    struct SubmissionCounters
+    {
+        std::atomic<int> numDraws { 0 }, numProgramBinds { 0 }, numVertexArrayBinds { 0 }, numTextureBinds { 0 };
+        std::atomic<double> sortTimeMs { 0 };
+        
+        void set (int draws, int programBinds, int vertexArrayBinds, int textureBinds, double sortTime)
+        {
+            sortTimeMs = sortTime;
+            numDraws = draws;
+            numProgramBinds = programBinds;
+            numVertexArrayBinds = vertexArrayBinds;
+            numTextureBinds = textureBinds;
+        }
+        
+        String toString() const
+        {
+            return String (numDraws.load()) + " draws, " + String (numProgramBinds.load()) + " program, "
+                 + String (numVertexArrayBinds.load()) + " VAO, " + String (numTextureBinds.load()) + " texture binds, "
+                 + "sorted in " + String (sortTimeMs.load(), 3) + " ms";
+        }
+    };
+    SubmissionCounters submissionCounters;
+    Rendering::JobSystem sceneJobs;
+    
+    // Audio analysis and the spectrogram drawn from it
+    Audio::SpectrumAnalyser spectrumAnalyser;
+    Audio::SyntheticSignalSource syntheticSignal { [this] (const float* samples, int numSamples)
+    {
+        spectrumAnalyser.pushSamples (samples, numSamples);
+    } };
+    Rendering::SpectrogramRenderer spectrogram;
+    static constexpr int spectrogramHistoryLength = 512; // Spectra, about 6 seconds at the default hop size
+    std::atomic<bool> isSpectrogramVisible { false };
+    bool isSyntheticSignalEnabled = false;
+    
+    // Heightfield terrain from loadTerrain()
+    Rendering::ClipmapTerrain terrain;
+    std::atomic<bool> hasTerrain { false };
+    
+    // The point cloud from loadPointCloud(), drawn with its own object uniform record
+    Rendering::PointCloudRenderer pointCloud;
+    Rendering::SceneGraph::NodeID pointCloudNode = 0;
+    std::atomic<bool> hasPointCloud { false };
+    OpenGLUtil::UniformBufferArray<ShaderUniformBlocks::ObjectUniforms> pointCloudUniforms { ShaderUniformBlocks::objectBindingPoint };
+    
+    // Offscreen rendering state, only ever touched on the OpenGL thread
+    struct OffscreenSession
+    {
+        OffscreenSettings settings;
+        OpenGLUtil::OffscreenRenderTarget target;
+        OpenGLUtil::AsyncPixelReader reader;
+        std::unique_ptr<OpenGLUtil::OffscreenFrameWriter> writer;
+        int numFramesRendered = 0;
+    };
+    std::unique_ptr<OffscreenSession> offscreenSession;
+    
     // GUI Mouse Drag Interaction
     Draggable3DOrientation draggableOrientation;
     
-    // GUI overlay status text
-    String openGLStatusText;
-    Label openGLStatusLabel;
+    // GUI overlay status text. The shader status is written on the OpenGL thread and
+    // the overlay text on the message thread, and each is read on the other
+    SpinLock statusTextLock;
+    String openGLStatusText, overlayText;
+    GLuint overlayVertexArrayID = 0;
 };
 
@@ -0,0 +1,180 @@
+//
+//  AsyncPixelReader.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Reads framebuffer contents back to the CPU without stalling the pipeline.
+
+    A plain glReadPixels waits for the GPU to finish everything queued so far.
+    Instead, `readPixels()` asks the GPU to copy into one of a ring of pixel
+    buffer objects and fences it, then returns straight away. A few frames
+    later, `collectFinishedReads()` maps the buffers whose fence has signalled
+    and hands their contents on as juce::Images, so the copy overlaps with
+    rendering the following frames.
+ */
+class AsyncPixelReader
+{
+public:
+    using FrameCallback = std::function<void (Image&& image, int frameNumber)>;
+
+    AsyncPixelReader (int numBuffersInRing = 3)
+        : slots ((size_t) jmax (2, numBuffersInRing))
+    {
+    }
+
+    ~AsyncPixelReader()
+    {
+        // You must call release() while the context is still active
+        jassert (slots.front().bufferID == 0);
+    }
+
+    void create (OpenGLContext& context)
+    {
+        for (auto& slot : slots)
+        {
+            jassert (slot.bufferID == 0);
+            context.extensions.glGenBuffers (1, &slot.bufferID);
+        }
+
+        readIndex = writeIndex = numPending = 0;
+    }
+
+    /** Deletes the buffers. Any reads still in flight are discarded. */
+    void release (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        for (auto& slot : slots)
+        {
+            if (slot.fence != nullptr)
+                functions.glDeleteSync (slot.fence);
+
+            if (slot.bufferID != 0)
+                context.extensions.glDeleteBuffers (1, &slot.bufferID);
+
+            slot = {};
+        }
+
+        numPending = 0;
+    }
+
+    /** Queues a copy of the given area of the current read framebuffer.
+
+        If every buffer in the ring is still waiting for the GPU, the oldest
+        one is waited for and delivered first, so no frame is ever dropped.
+     */
+    void readPixels (OpenGLContext& context, const CoreProfileFunctions& functions,
+                     Rectangle<int> area, int frameNumber, const FrameCallback& callback)
+    {
+        if (numPending == (int) slots.size())
+            deliverOldest (context, functions, true, callback);
+
+        auto& slot = slots[(size_t) writeIndex];
+        const size_t numBytes = (size_t) area.getWidth() * (size_t) area.getHeight() * 4;
+
+        context.extensions.glBindBuffer (GL_PIXEL_PACK_BUFFER, slot.bufferID);
+
+        if (slot.capacity < numBytes)
+        {
+            slot.capacity = numBytes;
+            context.extensions.glBufferData (GL_PIXEL_PACK_BUFFER, (GLsizeiptr) numBytes, nullptr, GL_STREAM_READ);
+        }
+
+        // BGRA matches the in-memory layout of juce::Image::ARGB on little endian machines
+        glPixelStorei (GL_PACK_ALIGNMENT, 4);
+        glReadPixels (area.getX(), area.getY(), area.getWidth(), area.getHeight(), GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        context.extensions.glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = functions.glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = area.getWidth();
+        slot.height = area.getHeight();
+        slot.frameNumber = frameNumber;
+
+        writeIndex = (writeIndex + 1) % (int) slots.size();
+        ++numPending;
+    }
+
+    /** Delivers every read that the GPU has completed, oldest first. If
+        `waitForAll` is true, blocks until all outstanding reads are delivered. */
+    void collectFinishedReads (OpenGLContext& context, const CoreProfileFunctions& functions,
+                               bool waitForAll, const FrameCallback& callback)
+    {
+        while (numPending > 0)
+            if (! deliverOldest (context, functions, waitForAll, callback))
+                break;
+    }
+
+    int getNumPendingReads() const noexcept     { return numPending; }
+
+private:
+    struct Slot
+    {
+        GLuint bufferID = 0;
+        size_t capacity = 0;
+        SyncObject fence = nullptr;
+        int width = 0, height = 0, frameNumber = 0;
+    };
+
+    bool deliverOldest (OpenGLContext& context, const CoreProfileFunctions& functions,
+                        bool wait, const FrameCallback& callback)
+    {
+        jassert (numPending > 0);
+        auto& slot = slots[(size_t) readIndex];
+
+        const uint64 timeoutNanoseconds = wait ? 1000000000ull : 0;
+        const GLenum waitResult = functions.glClientWaitSync (slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNanoseconds);
+
+        jassert (waitResult != GL_WAIT_FAILED);
+        const bool isReady = waitResult == GL_ALREADY_SIGNALED || waitResult == GL_CONDITION_SATISFIED;
+
+        // If we must wait but timed out, mapping the buffer below will finish the wait
+        if (! isReady && ! wait && waitResult != GL_WAIT_FAILED)
+            return false;
+
+        functions.glDeleteSync (slot.fence);
+        slot.fence = nullptr;
+
+        const size_t rowBytes = (size_t) slot.width * 4;
+        context.extensions.glBindBuffer (GL_PIXEL_PACK_BUFFER, slot.bufferID);
+
+        if (auto* pixels = (const uint8*) functions.glMapBufferRange (GL_PIXEL_PACK_BUFFER, 0,
+                                                                      (GLsizeiptr) (rowBytes * (size_t) slot.height),
+                                                                      GL_MAP_READ_BIT))
+        {
+            Image image (Image::ARGB, slot.width, slot.height, false);
+
+            {
+                Image::BitmapData bitmap (image, Image::BitmapData::writeOnly);
+
+                // OpenGL rows go bottom-up, juce::Image rows go top-down
+                for (int y = 0; y < slot.height; ++y)
+                    memcpy (bitmap.getLinePointer (slot.height - 1 - y), pixels + (size_t) y * rowBytes, rowBytes);
+            }
+
+            functions.glUnmapBuffer (GL_PIXEL_PACK_BUFFER);
+
+            if (callback != nullptr)
+                callback (std::move (image), slot.frameNumber);
+        }
+
+        context.extensions.glBindBuffer (GL_PIXEL_PACK_BUFFER, 0);
+
+        readIndex = (readIndex + 1) % (int) slots.size();
+        --numPending;
+        return true;
+    }
+
+    std::vector<Slot> slots;
+    int readIndex = 0, writeIndex = 0, numPending = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (AsyncPixelReader)
+};
+
+} // OpenGLUtil
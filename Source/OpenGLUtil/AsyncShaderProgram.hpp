@@ -0,0 +1,317 @@
+//
+//  AsyncShaderProgram.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "SharedContextCompiler.hpp"
+#include "UniformRegistry.hpp"
+
+namespace OpenGLUtil
+{
+
+/** A vertex + fragment shader program that compiles without making the render
+    thread wait for the driver.
+
+    juce::OpenGLShaderProgram asks for the compile and link status straight
+    after submitting each stage, and that query blocks until the driver is done.
+    Here `compile()` only starts the work, and `update()` is then called once
+    per frame to pick up the result once it is ready. Where the work happens
+    depends on the driver:
+    - With KHR_parallel_shader_compile or ARB_parallel_shader_compile, on
+      this context, whose driver reports when the link has finished.
+    - Otherwise, e.g. on macOS, on the workers of a SharedContextCompiler
+      stored on the context, which wait for the link on their own threads and
+      fence the program for this one.
+    - Without either, e.g. before the workers have started, on this context,
+      asking for the result after a couple of frames. That query blocks until
+      the driver is done, for as long as the compile takes beyond them.
+ */
+class AsyncShaderProgram
+{
+public:
+    enum class State
+    {
+        empty,      /**< Nothing has been compiled yet. */
+        compiling,  /**< Submitted to the driver, result not known yet. */
+        linked,     /**< Ready to use. */
+        failed      /**< See getLastError(). */
+    };
+
+    AsyncShaderProgram() = default;
+
+    ~AsyncShaderProgram()
+    {
+        // You must call release() while the context is still active
+        jassert (programID == 0 && job == nullptr);
+    }
+
+    /** Starts compiling and linking both stages, then returns straight away.
+        Any program this object held before is released. */
+    void compile (OpenGLContext& context, const CoreProfileFunctions& functions,
+                  const String& vertexSource, const String& fragmentSource)
+    {
+        release (context);
+
+        compileFunctions = &functions;
+        canPollForCompletion = canCompileWithoutStalling (functions);
+        numFramesWaited = 0;
+        compileStartTime = Time::getMillisecondCounterHiRes();
+        compileTimeMs = 0.0;
+        isFromBinary = false;
+        lastError.clear();
+        state = State::compiling;
+
+        if (! canPollForCompletion)
+        {
+            if (auto* queue = SharedContextCompiler::getQueue (context))
+            {
+                job = new ShaderCompileJob (vertexSource, fragmentSource);
+
+                if (queue->submit (job.get()))
+                    return;
+
+                job = nullptr;
+            }
+        }
+
+        vertexShaderID = ShaderCompileJob::submitShader (context, GL_VERTEX_SHADER, vertexSource);
+        fragmentShaderID = ShaderCompileJob::submitShader (context, GL_FRAGMENT_SHADER, fragmentSource);
+
+        programID = context.extensions.glCreateProgram();
+        context.extensions.glAttachShader (programID, vertexShaderID);
+        context.extensions.glAttachShader (programID, fragmentShaderID);
+
+        // Lets the driver keep what getBinary() needs around
+        if (functions.glProgramParameteri != nullptr)
+            functions.glProgramParameteri (programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        context.extensions.glLinkProgram (programID);
+    }
+
+    /** Creates the program from a binary previously returned by getBinary().
+        Returns false, leaving the program empty, if the driver rejects it,
+        which it may do after any driver or hardware change. */
+    bool loadBinary (OpenGLContext& context, const CoreProfileFunctions& functions,
+                     GLenum binaryFormat, const void* binary, size_t numBytes)
+    {
+        release (context);
+
+        if (functions.glProgramBinary == nullptr)
+            return false;
+
+        programID = context.extensions.glCreateProgram();
+        functions.glProgramBinary (programID, binaryFormat, binary, (GLsizei) numBytes);
+
+        // No compile happens here, so asking for the result doesn't stall
+        GLint isLinked = GL_FALSE;
+        context.extensions.glGetProgramiv (programID, GL_LINK_STATUS, &isLinked);
+
+        if (isLinked == GL_FALSE)
+        {
+            release (context);
+            return false;
+        }
+
+        compileTimeMs = 0.0;
+        isFromBinary = true;
+        lastError.clear();
+        state = State::linked;
+        return true;
+    }
+
+    /** Retrieves the driver's binary for a linked program, for loadBinary() to
+        restore in a later session. Returns false if the driver can't provide one. */
+    bool getBinary (OpenGLContext& context, const CoreProfileFunctions& functions,
+                    GLenum& binaryFormat, MemoryBlock& binary) const
+    {
+        if (state != State::linked || functions.glGetProgramBinary == nullptr)
+            return false;
+
+        GLint numBytes = 0;
+        context.extensions.glGetProgramiv (programID, GL_PROGRAM_BINARY_LENGTH, &numBytes);
+
+        if (numBytes <= 0)
+            return false;
+
+        binary.setSize ((size_t) numBytes);
+        GLsizei numBytesWritten = 0;
+        functions.glGetProgramBinary (programID, numBytes, &numBytesWritten, &binaryFormat, binary.getData());
+        binary.setSize ((size_t) numBytesWritten);
+
+        return numBytesWritten > 0;
+    }
+
+    /** True if the driver can report that a link has finished without
+        waiting for it. Without this, compiles go to a SharedContextCompiler,
+        see the class description. */
+    static bool canCompileWithoutStalling (const CoreProfileFunctions& functions)
+    {
+        return functions.isExtensionSupported ("GL_KHR_parallel_shader_compile")
+            || functions.isExtensionSupported ("GL_ARB_parallel_shader_compile");
+    }
+
+    /** Checks on a compile in progress. Call once per frame while the state
+        is `compiling`; does nothing in any other state. Never blocks if
+        canCompileWithoutStalling() or a SharedContextCompiler took the
+        compile; otherwise the query made after `numFramesBeforeQuerying`
+        frames waits for the compile to finish. */
+    State update (OpenGLContext& context)
+    {
+        if (state != State::compiling)
+            return state;
+
+        if (job != nullptr)
+            return updateJob (context);
+
+        if (canPollForCompletion)
+        {
+            GLint isComplete = GL_FALSE;
+            context.extensions.glGetProgramiv (programID, GL_COMPLETION_STATUS_KHR, &isComplete);
+
+            if (isComplete == GL_FALSE)
+                return state;
+        }
+        else if (++numFramesWaited < numFramesBeforeQuerying)
+        {
+            return state;
+        }
+
+        GLint isLinked = GL_FALSE;
+        context.extensions.glGetProgramiv (programID, GL_LINK_STATUS, &isLinked);
+
+        if (isLinked != GL_FALSE)
+        {
+            compileTimeMs = Time::getMillisecondCounterHiRes() - compileStartTime;
+            deleteShaders (context);
+            state = State::linked;
+        }
+        else
+        {
+            lastError = ShaderCompileJob::getShaderLog (context, vertexShaderID, "Vertex shader")
+                      + ShaderCompileJob::getShaderLog (context, fragmentShaderID, "Fragment shader")
+                      + ShaderCompileJob::getProgramLog (context, programID);
+            release (context);
+            state = State::failed;
+        }
+
+        return state;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        if (job != nullptr)
+        {
+            job->cancel (context, *compileFunctions);
+            job = nullptr;
+        }
+
+        deleteShaders (context);
+
+        if (programID != 0)
+            context.extensions.glDeleteProgram (programID);
+
+        programID = 0;
+        state = State::empty;
+    }
+
+    void use (OpenGLContext& context) const
+    {
+        jassert (state == State::linked);
+        context.extensions.glUseProgram (programID);
+    }
+
+    State getState() const noexcept             { return state; }
+    bool isLinked() const noexcept              { return state == State::linked; }
+    GLuint getProgramID() const noexcept        { return programID; }
+    const String& getLastError() const noexcept { return lastError; }
+
+    /** True if the program came from loadBinary() rather than compile(). */
+    bool wasLoadedFromBinary() const noexcept   { return isFromBinary; }
+
+    /** Time from compile() until the program was found to have linked. */
+    double getCompileTimeMs() const noexcept    { return compileTimeMs; }
+
+    /** The program's uniforms, attributes and blocks, once something has
+        called `getUniforms().reflect()` after linking. */
+    UniformRegistry& getUniforms() noexcept     { return uniforms; }
+    const UniformRegistry& getUniforms() const noexcept { return uniforms; }
+
+private:
+    static constexpr int numFramesBeforeQuerying = 2;
+
+    /** Takes the worker's program once it is finished and its fence has
+        signalled, without waiting for either. */
+    State updateJob (OpenGLContext& context)
+    {
+        const auto status = job->status.load();
+
+        // The workers stopped before getting to it, so build it here instead
+        if (status == ShaderCompileJob::Status::abandoned)
+        {
+            const ShaderCompileJob::Ptr abandonedJob = job;
+            compile (context, *compileFunctions, abandonedJob->vertexSource, abandonedJob->fragmentSource);
+            return state;
+        }
+
+        if (status != ShaderCompileJob::Status::finished)
+            return state;
+
+        if (job->fence != nullptr)
+        {
+            if (compileFunctions->glClientWaitSync (job->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return state;
+
+            compileFunctions->glDeleteSync (job->fence);
+            job->fence = nullptr;
+        }
+
+        programID = job->programID;
+        lastError = job->error;
+        job = nullptr;
+
+        if (programID != 0)
+        {
+            compileTimeMs = Time::getMillisecondCounterHiRes() - compileStartTime;
+            state = State::linked;
+        }
+        else
+        {
+            state = State::failed;
+        }
+
+        return state;
+    }
+
+    void deleteShaders (OpenGLContext& context)
+    {
+        for (auto* shaderID : { &vertexShaderID, &fragmentShaderID })
+        {
+            if (*shaderID != 0)
+            {
+                if (programID != 0)
+                    context.extensions.glDetachShader (programID, *shaderID);
+
+                context.extensions.glDeleteShader (*shaderID);
+                *shaderID = 0;
+            }
+        }
+    }
+
+    GLuint programID = 0, vertexShaderID = 0, fragmentShaderID = 0;
+    State state = State::empty;
+    bool canPollForCompletion = false, isFromBinary = false;
+    const CoreProfileFunctions* compileFunctions = nullptr;
+    ShaderCompileJob::Ptr job;
+    int numFramesWaited = 0;
+    double compileStartTime = 0.0, compileTimeMs = 0.0;
+    String lastError;
+    UniformRegistry uniforms;
+
+    JUCE_DECLARE_NON_COPYABLE (AsyncShaderProgram)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,281 @@
+//
+//  FramePacer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace OpenGLUtil
+{
+
+/** Controls the cadence of an OpenGLRenderer's frames.
+
+    Call `beginFrame()` at the very start of `renderOpenGL()` and `endFrame()`
+    at the very end. With a target frame rate set, `beginFrame()` sleeps so that
+    frames finish at evenly spaced deadlines: it predicts how long the frame will
+    take to render from recent measurements and wakes up just that much before
+    the next deadline. When the target rate divides the display refresh rate,
+    the swap interval is used instead so that vsync does the pacing.
+
+    The pacer also keeps rolling statistics of the frame intervals, including
+    their variance, so the evenness of the cadence can be checked.
+
+    The sleep must not happen with the message manager locked, which JUCE
+    does around renderOpenGL() whenever it paints components into the frame,
+    so use it with OpenGLContext::setComponentPaintingEnabled (false).
+ */
+class FramePacer
+{
+public:
+    struct Statistics
+    {
+        int numFrames = 0;              // Number of intervals in the window
+        double meanFrameTimeMs = 0;     // Average time between frame starts
+        double frameTimeVarianceMs = 0; // Variance of the above, in ms squared
+        double maxFrameTimeMs = 0;
+        double meanRenderTimeMs = 0;    // Average time spent inside renderOpenGL()
+
+        double getFramesPerSecond() const noexcept       { return meanFrameTimeMs > 0 ? 1000.0 / meanFrameTimeMs : 0.0; }
+        double getFrameTimeStdDevMs() const noexcept     { return std::sqrt (frameTimeVarianceMs); }
+
+        String toString() const
+        {
+            return String (getFramesPerSecond(), 1) + " fps, "
+                 + String (meanFrameTimeMs, 2) + " ms +/- " + String (getFrameTimeStdDevMs(), 2) + " ms (max "
+                 + String (maxFrameTimeMs, 2) + " ms), render " + String (meanRenderTimeMs, 2) + " ms";
+        }
+    };
+
+    FramePacer() = default;
+
+    /** Sets the desired number of frames per second. Zero means no limit, in
+        which case frames are only paced by vsync. Safe to call from any thread. */
+    void setTargetFrameRate (double framesPerSecond)
+    {
+        targetFrameRate = jmax (0.0, framesPerSecond);
+        swapIntervalNeedsUpdate = true;
+    }
+
+    double getTargetFrameRate() const noexcept          { return targetFrameRate; }
+
+    /** Tells the pacer the refresh rate of the display, so that it can choose
+        a swap interval. JUCE has no portable way to query it, so this defaults
+        to 60 Hz. Safe to call from any thread. */
+    void setDisplayRefreshRate (double hz)
+    {
+        displayRefreshRate = jmax (1.0, hz);
+        swapIntervalNeedsUpdate = true;
+    }
+
+    /** Enables or disables vsync entirely. With vsync off, the pacer's sleep is
+        the only thing limiting the frame rate. Safe to call from any thread. */
+    void setVSyncEnabled (bool shouldUseVSync)
+    {
+        vsyncEnabled = shouldUseVSync;
+        swapIntervalNeedsUpdate = true;
+    }
+
+    //==============================================================================
+    /** Call at the start of renderOpenGL(). May sleep the render thread. */
+    void beginFrame (OpenGLContext& context)
+    {
+        if (swapIntervalNeedsUpdate.exchange (false))
+            updateSwapInterval (context);
+
+        const double period = getPacedFramePeriodSeconds();
+        double now = getSeconds();
+
+        if (period > 0 && nextDeadline > 0)
+        {
+            const double wakeTime = nextDeadline - predictedRenderSeconds - safetyMarginSeconds;
+
+            if (now < wakeTime)
+            {
+                sleepUntil (wakeTime);
+                now = getSeconds();
+            }
+        }
+
+        // Record the interval, ignoring gaps where nothing was rendered at all
+        if (lastFrameStart > 0)
+        {
+            const double interval = now - lastFrameStart;
+
+            if (interval < idleGapSeconds)
+                addFrameInterval (interval);
+        }
+
+        lastFrameStart = now;
+
+        if (period > 0)
+        {
+            // If we've fallen behind, start a fresh schedule instead of rushing to catch up
+            const double earliestFinish = now + predictedRenderSeconds;
+            nextDeadline = (nextDeadline > 0 && earliestFinish <= nextDeadline + period)
+                               ? nextDeadline + period
+                               : earliestFinish + period;
+        }
+        else
+        {
+            nextDeadline = 0;
+        }
+    }
+
+    /** Call at the end of renderOpenGL(). */
+    void endFrame()
+    {
+        const double renderSeconds = getSeconds() - lastFrameStart;
+
+        // Track the mean and mean deviation of the render cost, and predict with
+        // a margin of two deviations so that a slightly slow frame still lands on time
+        const double error = renderSeconds - meanRenderSeconds;
+        meanRenderSeconds += smoothing * error;
+        renderDeviationSeconds += smoothing * (std::abs (error) - renderDeviationSeconds);
+        predictedRenderSeconds = meanRenderSeconds + 2.0 * renderDeviationSeconds;
+
+        const SpinLock::ScopedLockType lock (statisticsLock);
+        renderTimes[(size_t) renderTimeIndex] = renderSeconds;
+        renderTimeIndex = (renderTimeIndex + 1) % windowSize;
+        numRenderTimes = jmin (numRenderTimes + 1, windowSize);
+    }
+
+    /** Statistics over the most recent frames. Safe to call from any thread. */
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType lock (statisticsLock);
+        Statistics stats;
+        stats.numFrames = numFrameTimes;
+
+        if (numFrameTimes > 0)
+        {
+            double sum = 0, sumOfSquares = 0;
+
+            for (int i = 0; i < numFrameTimes; ++i)
+            {
+                sum += frameTimes[(size_t) i];
+                stats.maxFrameTimeMs = jmax (stats.maxFrameTimeMs, frameTimes[(size_t) i] * 1000.0);
+            }
+
+            const double mean = sum / numFrameTimes;
+
+            for (int i = 0; i < numFrameTimes; ++i)
+                sumOfSquares += square (frameTimes[(size_t) i] - mean);
+
+            stats.meanFrameTimeMs = mean * 1000.0;
+            stats.frameTimeVarianceMs = (sumOfSquares / numFrameTimes) * 1000.0 * 1000.0;
+        }
+
+        if (numRenderTimes > 0)
+        {
+            double sum = 0;
+
+            for (int i = 0; i < numRenderTimes; ++i)
+                sum += renderTimes[(size_t) i];
+
+            stats.meanRenderTimeMs = sum / numRenderTimes * 1000.0;
+        }
+
+        return stats;
+    }
+
+    void resetStatistics()
+    {
+        const SpinLock::ScopedLockType lock (statisticsLock);
+        numFrameTimes = numRenderTimes = frameTimeIndex = renderTimeIndex = 0;
+    }
+
+private:
+    static double getSeconds() noexcept
+    {
+        return Time::getMillisecondCounterHiRes() * 0.001;
+    }
+
+    /** The period the pacer has to enforce itself, or zero if vsync does it. */
+    double getPacedFramePeriodSeconds() const noexcept
+    {
+        const double target = targetFrameRate;
+
+        if (target <= 0)
+            return 0;
+
+        if (vsyncEnabled && swapInterval > 0 && displayRefreshRate / swapInterval <= target * 1.01)
+            return 0;
+
+        return 1.0 / target;
+    }
+
+    void updateSwapInterval (OpenGLContext& context)
+    {
+        swapInterval = vsyncEnabled ? 1 : 0;
+
+        // If the target rate divides the refresh rate, e.g. 72 Hz on a 144 Hz
+        // display, a swap interval of 2 gives perfectly even frames for free
+        const double target = targetFrameRate;
+
+        if (vsyncEnabled && target > 0 && target < displayRefreshRate)
+        {
+            const double ratio = displayRefreshRate / target;
+
+            if (std::abs (ratio - std::round (ratio)) < 0.02)
+                swapInterval = (int) std::round (ratio);
+        }
+
+        if (! context.setSwapInterval (swapInterval))
+            swapInterval = context.getSwapInterval();
+    }
+
+    void sleepUntil (double wakeTime) const
+    {
+        // Sleep coarsely, then yield for the last couple of milliseconds since
+        // the OS scheduler's sleep granularity is much worse than that
+        for (;;)
+        {
+            const double remaining = wakeTime - getSeconds();
+
+            if (remaining <= 0)
+                return;
+
+            if (remaining > 0.002)
+                Thread::sleep (jmax (1, (int) ((remaining - 0.002) * 1000.0)));
+            else
+                Thread::yield();
+        }
+    }
+
+    void addFrameInterval (double seconds)
+    {
+        const SpinLock::ScopedLockType lock (statisticsLock);
+        frameTimes[(size_t) frameTimeIndex] = seconds;
+        frameTimeIndex = (frameTimeIndex + 1) % windowSize;
+        numFrameTimes = jmin (numFrameTimes + 1, windowSize);
+    }
+
+    //==============================================================================
+    static constexpr int windowSize = 240;
+    static constexpr double smoothing = 0.1;
+    static constexpr double safetyMarginSeconds = 0.0005;
+    static constexpr double idleGapSeconds = 0.25;
+
+    std::atomic<double> targetFrameRate { 0.0 };
+    std::atomic<double> displayRefreshRate { 60.0 };
+    std::atomic<bool> vsyncEnabled { true };
+    std::atomic<bool> swapIntervalNeedsUpdate { true };
+    int swapInterval = 1;
+
+    // Only touched by the render thread
+    double lastFrameStart = 0, nextDeadline = 0;
+    double meanRenderSeconds = 0, renderDeviationSeconds = 0, predictedRenderSeconds = 0;
+
+    SpinLock statisticsLock;
+    std::array<double, windowSize> frameTimes {}, renderTimes {};
+    int frameTimeIndex = 0, numFrameTimes = 0;
+    int renderTimeIndex = 0, numRenderTimes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (FramePacer)
+};
+
+} // OpenGLUtil
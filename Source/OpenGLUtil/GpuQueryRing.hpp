@@ -0,0 +1,206 @@
+//
+//  GpuQueryRing.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Measures parts of each frame on the GPU, e.g. how long a pass took or how
+    many samples it shaded, without ever waiting for the answer.
+
+    Each frame gets a slot of `numQueries` query objects from a small ring and
+    a tag saying what kind of frame it was. `collect()` hands back the results
+    of earlier frames once the GPU has produced them, usually two or three
+    frames later. If every slot is still waiting, the frame simply goes
+    unmeasured, so reading results never stalls the pipeline.
+
+    @code
+    queries.beginFrame (functions, tag);
+    queries.begin (functions, 0, GL_TIME_ELAPSED);
+    ... draw ...
+    queries.end (functions, GL_TIME_ELAPSED);
+    queries.endFrame();
+
+    queries.collect (functions, [] (const GpuQueryRing<1>::Results& results) { ... });
+    @endcode
+ */
+template <int numQueries>
+class GpuQueryRing
+{
+public:
+    static_assert (numQueries > 0 && numQueries <= 32, "Results track the queries used in a 32 bit mask");
+
+    struct Results
+    {
+        uint32 tag = 0;
+        std::array<uint64, numQueries> values {};
+        uint32 measuredMask = 0;
+
+        /** False if the query wasn't begun in that frame. */
+        bool wasMeasured (int index) const noexcept    { return (measuredMask & (1u << index)) != 0; }
+    };
+
+    GpuQueryRing() = default;
+
+    ~GpuQueryRing()
+    {
+        // You must call release() while the context is still active
+        jassert (! isCreated);
+    }
+
+    /** True if the context can time GPU work with GL_TIME_ELAPSED and
+        timestamp(), which needs OpenGL 3.3 or ARB_timer_query. */
+    static bool isTimerQuerySupported (const CoreProfileFunctions& functions)
+    {
+        return functions.glGetQueryObjectui64v != nullptr && functions.glQueryCounter != nullptr
+            && (OpenGLShaderProgram::getLanguageVersion() >= 3.3 || functions.isExtensionSupported ("GL_ARB_timer_query"));
+    }
+
+    void release (const CoreProfileFunctions& functions)
+    {
+        if (isCreated)
+            functions.glDeleteQueries (numFramesInFlight * numQueries, &queryIDs[0][0]);
+
+        isCreated = isMeasuring = false;
+        writeIndex = numPending = 0;
+    }
+
+    //==============================================================================
+    /** Starts a frame's measurements. Returns false if every slot is still
+        waiting for the GPU, in which case begin() and end() do nothing until
+        the next frame. */
+    bool beginFrame (const CoreProfileFunctions& functions, uint32 tag)
+    {
+        jassert (! isMeasuring); // Missing endFrame()
+
+        if (! isCreated)
+        {
+            functions.glGenQueries (numFramesInFlight * numQueries, &queryIDs[0][0]);
+            isCreated = true;
+        }
+
+        if (numPending == numFramesInFlight)
+        {
+            ++numFramesSkipped;
+            return false;
+        }
+
+        frames[writeIndex] = {};
+        frames[writeIndex].tag = tag;
+        isMeasuring = true;
+        return true;
+    }
+
+    /** Only one query per target can be active at a time, so queries for the
+        same target must not overlap. */
+    void begin (const CoreProfileFunctions& functions, int index, GLenum target)
+    {
+        jassert (isPositiveAndBelow (index, numQueries));
+
+        if (! isMeasuring)
+            return;
+
+        functions.glBeginQuery (target, queryIDs[writeIndex][index]);
+        frames[writeIndex].measuredMask |= 1u << index;
+    }
+
+    void end (const CoreProfileFunctions& functions, GLenum target)
+    {
+        if (isMeasuring)
+            functions.glEndQuery (target);
+    }
+
+    /** Records the GPU clock, in nanoseconds, once the commands before it
+        have finished. Unlike GL_TIME_ELAPSED this doesn't occupy a target,
+        so it can time spans that contain other timer queries. */
+    void timestamp (const CoreProfileFunctions& functions, int index)
+    {
+        jassert (isPositiveAndBelow (index, numQueries));
+
+        if (! isMeasuring)
+            return;
+
+        functions.glQueryCounter (queryIDs[writeIndex][index], GL_TIMESTAMP);
+        frames[writeIndex].measuredMask |= 1u << index;
+    }
+
+    void endFrame()
+    {
+        if (isMeasuring && frames[writeIndex].measuredMask != 0)
+        {
+            writeIndex = (writeIndex + 1) % numFramesInFlight;
+            ++numPending;
+        }
+
+        isMeasuring = false;
+    }
+
+    /** Calls `callback (const Results&)` for each measured frame whose
+        results have arrived, oldest first, and stops at the first that is
+        still in flight. */
+    template <typename Callback>
+    void collect (const CoreProfileFunctions& functions, Callback&& callback)
+    {
+        while (numPending > 0)
+        {
+            const int readIndex = (writeIndex - numPending + numFramesInFlight) % numFramesInFlight;
+            auto& results = frames[readIndex];
+
+            for (int i = 0; i < numQueries; ++i)
+            {
+                if (! results.wasMeasured (i))
+                    continue;
+
+                GLint isAvailable = 0;
+                functions.glGetQueryObjectiv (queryIDs[readIndex][i], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+
+                if (isAvailable == 0)
+                    return;
+            }
+
+            for (int i = 0; i < numQueries; ++i)
+                if (results.wasMeasured (i))
+                    results.values[(size_t) i] = getResult (functions, queryIDs[readIndex][i]);
+
+            --numPending;
+            callback (static_cast<const Results&> (results));
+        }
+    }
+
+    /** Frames that went unmeasured because the GPU was too far behind. */
+    int getNumFramesSkipped() const noexcept    { return numFramesSkipped; }
+
+private:
+    static uint64 getResult (const CoreProfileFunctions& functions, GLuint queryID)
+    {
+        // Nanoseconds overflow 32 bits after about 4 seconds, but samples rarely do
+        if (functions.glGetQueryObjectui64v != nullptr)
+        {
+            uint64 value = 0;
+            functions.glGetQueryObjectui64v (queryID, GL_QUERY_RESULT, &value);
+            return value;
+        }
+
+        GLuint value = 0;
+        functions.glGetQueryObjectuiv (queryID, GL_QUERY_RESULT, &value);
+        return value;
+    }
+
+    static constexpr int numFramesInFlight = 4;
+
+    GLuint queryIDs[numFramesInFlight][numQueries] = {};
+    Results frames[numFramesInFlight];
+    int writeIndex = 0, numPending = 0, numFramesSkipped = 0;
+    bool isCreated = false, isMeasuring = false;
+
+    JUCE_DECLARE_NON_COPYABLE (GpuQueryRing)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,156 @@
+//
+//  OffscreenFrameWriter.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace OpenGLUtil
+{
+
+/** Consumes rendered frames on a worker thread, so that encoding or user
+    processing never holds up the OpenGL thread.
+
+    Frames are either written as a numbered PNG sequence into a directory, or
+    passed to a callback. The queue is bounded: if the consumer falls behind by
+    more than `maxQueuedFrames`, `addFrame()` waits rather than dropping frames.
+ */
+class OffscreenFrameWriter : private Thread
+{
+public:
+    using FrameCallback = std::function<void (const Image& image, int frameNumber)>;
+
+    /** Writes frames to `directory` as frame_000000.png, frame_000001.png, ... */
+    explicit OffscreenFrameWriter (const File& directory, int maxQueuedFramesToUse = 8)
+        : Thread ("Offscreen Frame Writer"),
+          outputDirectory (directory),
+          maxQueuedFrames (maxQueuedFramesToUse)
+    {
+        outputDirectory.createDirectory();
+        startThread();
+    }
+
+    /** Calls `callback` on the worker thread for every frame. */
+    explicit OffscreenFrameWriter (FrameCallback callback, int maxQueuedFramesToUse = 8)
+        : Thread ("Offscreen Frame Writer"),
+          frameCallback (std::move (callback)),
+          maxQueuedFrames (maxQueuedFramesToUse)
+    {
+        startThread();
+    }
+
+    ~OffscreenFrameWriter() override
+    {
+        waitUntilAllFramesWritten();
+        signalThreadShouldExit();
+        frameAdded.signal();
+        stopThread (5000);
+    }
+
+    /** Queues a frame. Called from the OpenGL thread. */
+    void addFrame (Image&& image, int frameNumber)
+    {
+        for (;;)
+        {
+            {
+                const ScopedLock sl (queueLock);
+
+                if ((int) queue.size() < maxQueuedFrames)
+                {
+                    queue.push_back ({ std::move (image), frameNumber });
+                    break;
+                }
+            }
+
+            frameWritten.wait (100);
+        }
+
+        frameAdded.signal();
+    }
+
+    /** Blocks until the queue has been drained. */
+    void waitUntilAllFramesWritten()
+    {
+        while (getNumQueuedFrames() > 0 || isBusy)
+            frameWritten.wait (100);
+    }
+
+    int getNumQueuedFrames() const
+    {
+        const ScopedLock sl (queueLock);
+        return (int) queue.size();
+    }
+
+    int getNumFramesWritten() const noexcept    { return numFramesWritten; }
+
+private:
+    struct QueuedFrame
+    {
+        Image image;
+        int frameNumber = 0;
+    };
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            QueuedFrame frame;
+
+            {
+                const ScopedLock sl (queueLock);
+
+                if (! queue.empty())
+                {
+                    frame = std::move (queue.front());
+                    queue.pop_front();
+                    isBusy = true;
+                }
+            }
+
+            if (! frame.image.isValid())
+            {
+                frameAdded.wait (100);
+                continue;
+            }
+
+            if (frameCallback != nullptr)
+                frameCallback (frame.image, frame.frameNumber);
+            else
+                writeImage (frame.image, frame.frameNumber);
+
+            ++numFramesWritten;
+            isBusy = false;
+            frameWritten.signal();
+        }
+    }
+
+    void writeImage (const Image& image, int frameNumber) const
+    {
+        auto file = outputDirectory.getChildFile ("frame_" + String (frameNumber).paddedLeft ('0', 6) + ".png");
+        file.deleteFile();
+
+        FileOutputStream stream (file);
+        PNGImageFormat png;
+
+        if (! stream.openedOk() || ! png.writeImageToStream (image, stream))
+            DBG ("Failed to write " + file.getFullPathName());
+    }
+
+    File outputDirectory;
+    FrameCallback frameCallback;
+    const int maxQueuedFrames;
+
+    CriticalSection queueLock;
+    std::deque<QueuedFrame> queue;
+    WaitableEvent frameAdded, frameWritten;
+    std::atomic<bool> isBusy { false };
+    std::atomic<int> numFramesWritten { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE (OffscreenFrameWriter)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,143 @@
+//
+//  OffscreenRenderTarget.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** A framebuffer object of arbitrary size with an RGBA8 colour texture and a
+    depth/stencil renderbuffer, for rendering somewhere other than the window.
+
+    Unlike juce::OpenGLFrameBuffer this has a depth attachment, so 3D scenes
+    render correctly into it, and it remembers which framebuffer was bound
+    before `bind()` so that `unbind()` returns to JUCE's own target.
+ */
+class OffscreenRenderTarget
+{
+public:
+    OffscreenRenderTarget() = default;
+
+    ~OffscreenRenderTarget()
+    {
+        // You must call release() while the context is still active
+        jassert (frameBufferID == 0);
+    }
+
+    /** (Re)creates the attachments. Returns false if the driver reports the
+        framebuffer as incomplete. */
+    bool create (OpenGLContext& context, int newWidth, int newHeight)
+    {
+        jassert (newWidth > 0 && newHeight > 0);
+        release (context);
+
+        width = newWidth;
+        height = newHeight;
+
+        glGenTextures (1, &colourTextureID);
+        glBindTexture (GL_TEXTURE_2D, colourTextureID);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture (GL_TEXTURE_2D, 0);
+
+        context.extensions.glGenRenderbuffers (1, &depthBufferID);
+        context.extensions.glBindRenderbuffer (GL_RENDERBUFFER, depthBufferID);
+        context.extensions.glRenderbufferStorage (GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        context.extensions.glBindRenderbuffer (GL_RENDERBUFFER, 0);
+
+        GLint previousFrameBuffer = 0;
+        glGetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+
+        context.extensions.glGenFramebuffers (1, &frameBufferID);
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, frameBufferID);
+        context.extensions.glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colourTextureID, 0);
+        context.extensions.glFramebufferRenderbuffer (GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferID);
+
+        const bool complete = context.extensions.glCheckFramebufferStatus (GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, (GLuint) previousFrameBuffer);
+
+        if (! complete)
+            release (context);
+
+        return complete;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        if (frameBufferID != 0)     context.extensions.glDeleteFramebuffers (1, &frameBufferID);
+        if (depthBufferID != 0)     context.extensions.glDeleteRenderbuffers (1, &depthBufferID);
+        if (colourTextureID != 0)   glDeleteTextures (1, &colourTextureID);
+
+        frameBufferID = depthBufferID = colourTextureID = 0;
+        width = height = 0;
+    }
+
+    bool isValid() const noexcept               { return frameBufferID != 0; }
+
+    /** Makes this the target for drawing and reading, and sets the viewport
+        to cover all of it. */
+    void bind (OpenGLContext& context)
+    {
+        jassert (isValid());
+
+        glGetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &previousFrameBufferID);
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, frameBufferID);
+        glViewport (0, 0, width, height);
+    }
+
+    /** Restores whichever framebuffer was bound when bind() was called. */
+    void unbind (OpenGLContext& context)
+    {
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, (GLuint) previousFrameBufferID);
+    }
+
+    /** Copies the colour attachment into the currently bound draw framebuffer,
+        scaled to fill the given rectangle. */
+    void blitTo (OpenGLContext& context, const CoreProfileFunctions& functions,
+                 Rectangle<int> destination, GLenum filter = GL_LINEAR) const
+    {
+        blitTo (context, functions, { width, height }, destination, filter);
+    }
+
+    /** Copies part of the colour attachment, e.g. where a smaller viewport
+        was drawn, into the currently bound draw framebuffer. */
+    void blitTo (OpenGLContext& context, const CoreProfileFunctions& functions,
+                 Rectangle<int> source, Rectangle<int> destination, GLenum filter = GL_LINEAR) const
+    {
+        jassert (isValid());
+
+        GLint previousReadFrameBuffer = 0;
+        glGetIntegerv (GL_READ_FRAMEBUFFER_BINDING, &previousReadFrameBuffer);
+        context.extensions.glBindFramebuffer (GL_READ_FRAMEBUFFER, frameBufferID);
+
+        functions.glBlitFramebuffer (source.getX(), source.getY(), source.getRight(), source.getBottom(),
+                                     destination.getX(), destination.getY(),
+                                     destination.getRight(), destination.getBottom(),
+                                     GL_COLOR_BUFFER_BIT, filter);
+
+        context.extensions.glBindFramebuffer (GL_READ_FRAMEBUFFER, (GLuint) previousReadFrameBuffer);
+    }
+
+    int getWidth() const noexcept               { return width; }
+    int getHeight() const noexcept              { return height; }
+    GLuint getFrameBufferID() const noexcept    { return frameBufferID; }
+    GLuint getColourTextureID() const noexcept  { return colourTextureID; }
+
+private:
+    GLuint frameBufferID = 0, colourTextureID = 0, depthBufferID = 0;
+    GLint previousFrameBufferID = 0;
+    int width = 0, height = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (OffscreenRenderTarget)
+};
+
+} // OpenGLUtil
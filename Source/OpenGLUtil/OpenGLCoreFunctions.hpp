@@ -0,0 +1,336 @@
+//
+//  OpenGLCoreFunctions.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*  OpenGLContext::extensions only exposes the GLES 2 subset of OpenGL. These
+    definitions fill in the OpenGL 3.x core profile tokens and entry points that
+    the rest of OpenGLUtil depends on, for platforms whose GL headers stop at 1.1.
+*/
+#if JUCE_WINDOWS
+ #define OPENGLUTIL_APIENTRY __stdcall
+#else
+ #define OPENGLUTIL_APIENTRY
+#endif
+
+#ifndef GL_UNIFORM_BUFFER
+ #define GL_UNIFORM_BUFFER                      0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+ #define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT     0x8A34
+#endif
+#ifndef GL_MAX_UNIFORM_BLOCK_SIZE
+ #define GL_MAX_UNIFORM_BLOCK_SIZE              0x8A30
+#endif
+#ifndef GL_INVALID_INDEX
+ #define GL_INVALID_INDEX                       0xFFFFFFFFu
+#endif
+#ifndef GL_DYNAMIC_DRAW
+ #define GL_DYNAMIC_DRAW                        0x88E8
+#endif
+#ifndef GL_STREAM_READ
+ #define GL_STREAM_READ                         0x88E1
+#endif
+#ifndef GL_STREAM_DRAW
+ #define GL_STREAM_DRAW                         0x88E0
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+ #define GL_PIXEL_UNPACK_BUFFER                 0x88EC
+#endif
+#ifndef GL_MAP_WRITE_BIT
+ #define GL_MAP_WRITE_BIT                       0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+ #define GL_MAP_INVALIDATE_BUFFER_BIT           0x0008
+#endif
+#ifndef GL_TEXTURE_BASE_LEVEL
+ #define GL_TEXTURE_BASE_LEVEL                  0x813C
+#endif
+#ifndef GL_TEXTURE_MAX_LEVEL
+ #define GL_TEXTURE_MAX_LEVEL                   0x813D
+#endif
+#ifndef GL_TEXTURE_2D_ARRAY
+ #define GL_TEXTURE_2D_ARRAY                    0x8C1A
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+ #define GL_PIXEL_PACK_BUFFER                   0x88EB
+#endif
+#ifndef GL_MAP_READ_BIT
+ #define GL_MAP_READ_BIT                        0x0001
+#endif
+#ifndef GL_READ_FRAMEBUFFER
+ #define GL_READ_FRAMEBUFFER                    0x8CA8
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER
+ #define GL_DRAW_FRAMEBUFFER                    0x8CA9
+#endif
+#ifndef GL_DRAW_FRAMEBUFFER_BINDING
+ #define GL_DRAW_FRAMEBUFFER_BINDING            0x8CA6
+#endif
+#ifndef GL_READ_FRAMEBUFFER_BINDING
+ #define GL_READ_FRAMEBUFFER_BINDING            0x8CAA
+#endif
+#ifndef GL_DEPTH24_STENCIL8
+ #define GL_DEPTH24_STENCIL8                    0x88F0
+#endif
+#ifndef GL_DEPTH_STENCIL_ATTACHMENT
+ #define GL_DEPTH_STENCIL_ATTACHMENT            0x821A
+#endif
+#ifndef GL_RGBA8
+ #define GL_RGBA8                               0x8058
+#endif
+#ifndef GL_BGRA
+ #define GL_BGRA                                0x80E1
+#endif
+#ifndef GL_R8
+ #define GL_R8                                  0x8229
+#endif
+#ifndef GL_R16F
+ #define GL_R16F                                0x822D
+#endif
+#ifndef GL_RGBA16F
+ #define GL_RGBA16F                             0x881A
+#endif
+#ifndef GL_HALF_FLOAT
+ #define GL_HALF_FLOAT                          0x140B
+#endif
+#ifndef GL_COLOR_ATTACHMENT1
+ #define GL_COLOR_ATTACHMENT1                   0x8CE1
+#endif
+#ifndef GL_R32F
+ #define GL_R32F                                0x822E
+#endif
+#ifndef GL_SAMPLES_PASSED
+ #define GL_SAMPLES_PASSED                      0x8914
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED
+ #define GL_ANY_SAMPLES_PASSED                  0x8C2F
+#endif
+#ifndef GL_TIME_ELAPSED
+ #define GL_TIME_ELAPSED                        0x88BF
+#endif
+#ifndef GL_TIMESTAMP
+ #define GL_TIMESTAMP                           0x8E28
+#endif
+#ifndef GL_QUERY_RESULT
+ #define GL_QUERY_RESULT                        0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+ #define GL_QUERY_RESULT_AVAILABLE              0x8867
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+ #define GL_SYNC_GPU_COMMANDS_COMPLETE          0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+ #define GL_SYNC_FLUSH_COMMANDS_BIT             0x00000001
+#endif
+#ifndef GL_ALREADY_SIGNALED
+ #define GL_ALREADY_SIGNALED                    0x911A
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+ #define GL_TIMEOUT_EXPIRED                     0x911B
+#endif
+#ifndef GL_CONDITION_SATISFIED
+ #define GL_CONDITION_SATISFIED                 0x911C
+#endif
+#ifndef GL_WAIT_FAILED
+ #define GL_WAIT_FAILED                         0x911D
+#endif
+#ifndef GL_NUM_EXTENSIONS
+ #define GL_NUM_EXTENSIONS                      0x821D
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ #define GL_PROGRAM_BINARY_RETRIEVABLE_HINT     0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+ #define GL_PROGRAM_BINARY_LENGTH               0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+ #define GL_NUM_PROGRAM_BINARY_FORMATS          0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+ #define GL_PROGRAM_BINARY_FORMATS              0x87FF
+#endif
+#ifndef GL_ACTIVE_UNIFORM_BLOCKS
+ #define GL_ACTIVE_UNIFORM_BLOCKS               0x8A36
+#endif
+#ifndef GL_UNIFORM_BLOCK_DATA_SIZE
+ #define GL_UNIFORM_BLOCK_DATA_SIZE             0x8A40
+#endif
+#ifndef GL_ACTIVE_UNIFORMS
+ #define GL_ACTIVE_UNIFORMS                     0x8B86
+#endif
+#ifndef GL_ACTIVE_ATTRIBUTES
+ #define GL_ACTIVE_ATTRIBUTES                   0x8B89
+#endif
+#ifndef GL_FLOAT_VEC2
+ #define GL_FLOAT_VEC2                          0x8B50
+#endif
+#ifndef GL_FLOAT_VEC3
+ #define GL_FLOAT_VEC3                          0x8B51
+#endif
+#ifndef GL_FLOAT_VEC4
+ #define GL_FLOAT_VEC4                          0x8B52
+#endif
+#ifndef GL_INT_VEC2
+ #define GL_INT_VEC2                            0x8B53
+#endif
+#ifndef GL_INT_VEC3
+ #define GL_INT_VEC3                            0x8B54
+#endif
+#ifndef GL_INT_VEC4
+ #define GL_INT_VEC4                            0x8B55
+#endif
+#ifndef GL_BOOL
+ #define GL_BOOL                                0x8B56
+#endif
+#ifndef GL_SAMPLER_2D
+ #define GL_SAMPLER_2D                          0x8B5E
+#endif
+#ifndef GL_SAMPLER_CUBE
+ #define GL_SAMPLER_CUBE                        0x8B60
+#endif
+#ifndef GL_FLOAT_MAT2
+ #define GL_FLOAT_MAT2                          0x8B5A
+#endif
+#ifndef GL_FLOAT_MAT3
+ #define GL_FLOAT_MAT3                          0x8B5B
+#endif
+#ifndef GL_FLOAT_MAT4
+ #define GL_FLOAT_MAT4                          0x8B5C
+#endif
+#ifndef GL_SAMPLER_2D_ARRAY
+ #define GL_SAMPLER_2D_ARRAY                    0x8DC1
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+ #define GL_COMPLETION_STATUS_KHR               0x91B1
+#endif
+
+// Opaque fence handle, identical to GLsync where the GL headers declare it
+struct __GLsync;
+
+namespace OpenGLUtil
+{
+
+using SyncObject = __GLsync*;
+
+/** List of the core profile functions we load at runtime. Each entry is
+    (name, returnType, parameters), in the same spirit as JUCE's own
+    JUCE_GL_BASE_FUNCTIONS list.
+ */
+#define OPENGLUTIL_CORE_FUNCTIONS(USE_FUNCTION) \
+    USE_FUNCTION (glBindBufferBase,        void,   (GLenum target, GLuint index, GLuint buffer)) \
+    USE_FUNCTION (glBindBufferRange,       void,   (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)) \
+    USE_FUNCTION (glGetUniformBlockIndex,  GLuint, (GLuint program, const GLchar* uniformBlockName)) \
+    USE_FUNCTION (glUniformBlockBinding,   void,   (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding)) \
+    USE_FUNCTION (glMapBufferRange,        void*,  (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)) \
+    USE_FUNCTION (glUnmapBuffer,           GLboolean, (GLenum target)) \
+    USE_FUNCTION (glFenceSync,             SyncObject, (GLenum condition, GLbitfield flags)) \
+    USE_FUNCTION (glClientWaitSync,        GLenum, (SyncObject sync, GLbitfield flags, uint64 timeout)) \
+    USE_FUNCTION (glDeleteSync,            void,   (SyncObject sync)) \
+    USE_FUNCTION (glBlitFramebuffer,       void,   (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)) \
+    USE_FUNCTION (glDrawBuffers,           void,   (GLsizei n, const GLenum* buffers)) \
+    USE_FUNCTION (glClearBufferfv,         void,   (GLenum buffer, GLint drawBuffer, const GLfloat* value)) \
+    USE_FUNCTION (glBlendFuncSeparate,     void,   (GLenum sourceRGB, GLenum destinationRGB, GLenum sourceAlpha, GLenum destinationAlpha)) \
+    USE_FUNCTION (glTexImage3D,            void,   (GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)) \
+    USE_FUNCTION (glTexSubImage3D,         void,   (GLenum target, GLint level, GLint xOffset, GLint yOffset, GLint zOffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)) \
+    USE_FUNCTION (glGenerateMipmap,        void,   (GLenum target)) \
+    USE_FUNCTION (glGenQueries,            void,   (GLsizei n, GLuint* ids)) \
+    USE_FUNCTION (glDeleteQueries,         void,   (GLsizei n, const GLuint* ids)) \
+    USE_FUNCTION (glBeginQuery,            void,   (GLenum target, GLuint id)) \
+    USE_FUNCTION (glEndQuery,              void,   (GLenum target)) \
+    USE_FUNCTION (glGetQueryObjectiv,      void,   (GLuint id, GLenum pname, GLint* params)) \
+    USE_FUNCTION (glGetQueryObjectuiv,     void,   (GLuint id, GLenum pname, GLuint* params)) \
+    USE_FUNCTION (glGetStringi,            const GLubyte*, (GLenum name, GLuint index)) \
+    USE_FUNCTION (glGetActiveUniformBlockiv,   void, (GLuint program, GLuint uniformBlockIndex, GLenum pname, GLint* params)) \
+    USE_FUNCTION (glGetActiveUniformBlockName, void, (GLuint program, GLuint uniformBlockIndex, GLsizei bufSize, GLsizei* length, GLchar* uniformBlockName))
+
+/** Functions from extensions that may legitimately be missing, e.g.
+    ARB_get_program_binary on drivers older than OpenGL 4.1, or ARB_timer_query
+    before 3.3. These are loaded like the rest, but callers must check them
+    for nullptr before use.
+ */
+#define OPENGLUTIL_OPTIONAL_FUNCTIONS(USE_FUNCTION) \
+    USE_FUNCTION (glGetProgramBinary,      void,   (GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary)) \
+    USE_FUNCTION (glProgramBinary,         void,   (GLuint program, GLenum binaryFormat, const void* binary, GLsizei length)) \
+    USE_FUNCTION (glProgramParameteri,     void,   (GLuint program, GLenum pname, GLint value)) \
+    USE_FUNCTION (glMaxShaderCompilerThreadsKHR, void, (GLuint count)) \
+    USE_FUNCTION (glMaxShaderCompilerThreadsARB, void, (GLuint count)) \
+    USE_FUNCTION (glGetQueryObjectui64v,   void,   (GLuint id, GLenum pname, uint64* params)) \
+    USE_FUNCTION (glQueryCounter,          void,   (GLuint id, GLenum target))
+
+
+/** OpenGL 3.x core profile entry points that juce::OpenGLExtensionFunctions
+    does not provide.
+
+    Call `initialise()` from `newOpenGLContextCreated()` (or anywhere else the
+    context is active) before using any of the function pointers.
+ */
+struct CoreProfileFunctions
+{
+    void initialise()
+    {
+        jassert (OpenGLHelpers::isContextActive());
+
+       #define OPENGLUTIL_LOAD_FUNCTION(name, returnType, params) \
+            name = (decltype (name)) OpenGLHelpers::getExtensionFunction (#name);
+
+        OPENGLUTIL_CORE_FUNCTIONS (OPENGLUTIL_LOAD_FUNCTION)
+        OPENGLUTIL_OPTIONAL_FUNCTIONS (OPENGLUTIL_LOAD_FUNCTION)
+
+       #undef OPENGLUTIL_LOAD_FUNCTION
+
+        // Core profiles only list extensions one at a time, so ask once
+        extensionNames.clear();
+
+        if (glGetStringi != nullptr)
+        {
+            GLint numExtensions = 0;
+            glGetIntegerv (GL_NUM_EXTENSIONS, &numExtensions);
+
+            for (GLint i = 0; i < numExtensions; ++i)
+                if (auto* name = glGetStringi (GL_EXTENSIONS, (GLuint) i))
+                    extensionNames.add ((const char*) name);
+        }
+    }
+
+    /** True if every function in the core list could be resolved. */
+    bool areAllFunctionsAvailable() const noexcept
+    {
+        bool available = true;
+
+       #define OPENGLUTIL_CHECK_FUNCTION(name, returnType, params) \
+            available = available && name != nullptr;
+
+        OPENGLUTIL_CORE_FUNCTIONS (OPENGLUTIL_CHECK_FUNCTION)
+
+       #undef OPENGLUTIL_CHECK_FUNCTION
+
+        return available;
+    }
+
+    /** True if the context advertises the named extension, as of initialise(). */
+    bool isExtensionSupported (const char* extensionName) const
+    {
+        return extensionNames.contains (extensionName);
+    }
+
+   #define OPENGLUTIL_DECLARE_FUNCTION(name, returnType, params) \
+        returnType (OPENGLUTIL_APIENTRY* name) params = nullptr;
+
+    OPENGLUTIL_CORE_FUNCTIONS (OPENGLUTIL_DECLARE_FUNCTION)
+    OPENGLUTIL_OPTIONAL_FUNCTIONS (OPENGLUTIL_DECLARE_FUNCTION)
+
+   #undef OPENGLUTIL_DECLARE_FUNCTION
+
+private:
+    StringArray extensionNames;
+};
+
+} // OpenGLUtil
@@ -82,6 +82,10 @@ static OpenGLShaderProgram::Attribute* createAttribute (OpenGLContext& context,
  
     I hope functionality such as this gets integrated into the juce::Uniform class
     in the future.
+ 
+    For programs built with AsyncShaderProgram, prefer a UniformHandle and the
+    program's UniformRegistry, which find every name once after linking and
+    skip uploads of unchanged values.
  */
 template<class InternalType, InternalType * (*factoryFunction)(OpenGLContext&, OpenGLShaderProgram&, const String&)>
 class OpenGLNamedIDWrapper
@@ -0,0 +1,194 @@
+//
+//  ProgramBinaryCache.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "AsyncShaderProgram.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Keeps linked program binaries on disk so that later launches can skip
+    compiling and linking altogether.
+
+    Entries are keyed by a hash of the program's sources and defines. They live
+    in a folder named after a hash of the driver's vendor, renderer and version
+    strings. When any of those change, `initialise()` deletes the folders of
+    other drivers. When the sources change, `store()` replaces the program's
+    old entry. Any entry the driver still rejects, e.g. because its binary format
+    is no longer supported, is deleted and the program is compiled from source.
+ */
+class ProgramBinaryCache
+{
+public:
+    struct Statistics
+    {
+        int numHits = 0, numMisses = 0, numRejected = 0;
+
+        /** Compile time recorded with each entry when it was stored, minus the
+            time taken to load it instead. */
+        double timeSavedMs = 0.0;
+
+        String toString() const
+        {
+            return "Program cache: " + String (numHits) + " hit, " + String (numMisses) + " miss, "
+                 + String (numRejected) + " rejected, saved " + String (timeSavedMs, 1) + " ms";
+        }
+    };
+
+    explicit ProgramBinaryCache (const File& rootDirectoryToUse)
+        : rootDirectory (rootDirectoryToUse)
+    {
+    }
+
+    /** Reads the driver's identity and binary formats. Call on the OpenGL
+        thread, after CoreProfileFunctions::initialise(). */
+    void initialise (const CoreProfileFunctions& functions)
+    {
+        GLint numFormats = 0;
+
+        if (functions.glGetProgramBinary != nullptr && functions.glProgramBinary != nullptr)
+            glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+
+        supportedFormats.resize ((size_t) jmax (0, numFormats));
+
+        if (numFormats > 0)
+            glGetIntegerv (GL_PROGRAM_BINARY_FORMATS, supportedFormats.data());
+
+        if (! isAvailable())
+            return;
+
+        auto getString = [] (GLenum name) { return String ((const char*) glGetString (name)); };
+
+        const uint64 driverHash = hash (getString (GL_VENDOR) + "|" + getString (GL_RENDERER) + "|" + getString (GL_VERSION));
+        driverDirectory = rootDirectory.getChildFile (String::toHexString ((int64) driverHash));
+        driverDirectory.createDirectory();
+
+        // Entries made by any other driver are never going to load again
+        for (auto& directory : rootDirectory.findChildFiles (File::findDirectories, false))
+            if (directory != driverDirectory)
+                directory.deleteRecursively();
+    }
+
+    /** False if the driver can't save program binaries, in which case every
+        program is compiled from source. */
+    bool isAvailable() const noexcept   { return ! supportedFormats.empty(); }
+
+    /** Hash of everything that goes into building a program, other than the
+        driver itself. */
+    static uint64 getKey (const String& vertexSource, const String& fragmentSource, const String& defines)
+    {
+        return hash (defines + "\n//vertex\n" + vertexSource + "\n//fragment\n" + fragmentSource);
+    }
+
+    /** Tries to create `program` from the cached binary for `key`. Returns
+        false if there isn't one or the driver rejected it. */
+    bool load (OpenGLContext& context, const CoreProfileFunctions& functions,
+               const String& programName, uint64 key, AsyncShaderProgram& program)
+    {
+        if (! isAvailable())
+            return false;
+
+        const double startTime = Time::getMillisecondCounterHiRes();
+        const auto file = getEntryFile (programName, key);
+        MemoryBlock data;
+
+        if (! file.existsAsFile() || ! file.loadFileAsData (data) || data.getSize() < sizeof (EntryHeader))
+        {
+            ++statistics.numMisses;
+            return false;
+        }
+
+        EntryHeader header;
+        memcpy (&header, data.getData(), sizeof (header));
+
+        const bool isValid = header.magic == EntryHeader::expectedMagic
+                          && header.key == key
+                          && header.numBytes == data.getSize() - sizeof (header)
+                          && std::find (supportedFormats.begin(), supportedFormats.end(), (GLint) header.binaryFormat) != supportedFormats.end()
+                          && program.loadBinary (context, functions, header.binaryFormat,
+                                                 addBytesToPointer (data.getData(), sizeof (header)),
+                                                 (size_t) header.numBytes);
+
+        if (! isValid)
+        {
+            file.deleteFile();
+            ++statistics.numRejected;
+            ++statistics.numMisses;
+            return false;
+        }
+
+        ++statistics.numHits;
+        statistics.timeSavedMs += jmax (0.0, header.compileTimeMs - (Time::getMillisecondCounterHiRes() - startTime));
+        return true;
+    }
+
+    /** Saves the binary of a program that was just compiled from source,
+        replacing any older entry for the same program. */
+    void store (OpenGLContext& context, const CoreProfileFunctions& functions,
+                const String& programName, uint64 key, const AsyncShaderProgram& program)
+    {
+        if (! isAvailable() || program.wasLoadedFromBinary())
+            return;
+
+        EntryHeader header;
+        MemoryBlock binary;
+
+        if (! program.getBinary (context, functions, header.binaryFormat, binary))
+            return;
+
+        header.key = key;
+        header.numBytes = (uint32) binary.getSize();
+        header.compileTimeMs = program.getCompileTimeMs();
+
+        for (auto& oldEntry : driverDirectory.findChildFiles (File::findFiles, false, programName + "_*.bin"))
+            oldEntry.deleteFile();
+
+        MemoryBlock data (&header, sizeof (header));
+        data.append (binary.getData(), binary.getSize());
+        getEntryFile (programName, key).replaceWithData (data.getData(), data.getSize());
+    }
+
+    Statistics getStatistics() const noexcept   { return statistics; }
+
+private:
+    struct EntryHeader
+    {
+        static constexpr uint32 expectedMagic = 0x42504c47; // "GLPB"
+
+        uint32 magic = expectedMagic;
+        GLenum binaryFormat = 0;
+        uint64 key = 0;
+        uint32 numBytes = 0;
+        uint32 reserved = 0;
+        double compileTimeMs = 0.0;
+    };
+
+    /** 64 bit FNV-1a over the string's UTF-8 bytes. */
+    static uint64 hash (const String& text)
+    {
+        uint64 result = 0xcbf29ce484222325ull;
+
+        for (auto* c = text.toRawUTF8(); *c != 0; ++c)
+            result = (result ^ (uint8) *c) * 0x100000001b3ull;
+
+        return result;
+    }
+
+    File getEntryFile (const String& programName, uint64 key) const
+    {
+        return driverDirectory.getChildFile (programName + "_" + String::toHexString ((int64) key) + ".bin");
+    }
+
+    File rootDirectory, driverDirectory;
+    std::vector<GLint> supportedFormats;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE (ProgramBinaryCache)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,358 @@
+//
+//  ShaderPermutationSet.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "AsyncShaderProgram.hpp"
+#include "ProgramBinaryCache.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Builds variants of one vertex + fragment program by injecting `#define`s,
+    so a single pair of GLSL files can serve meshes with or without normals,
+    texture coordinates, vertex colours and so on.
+
+    A variant is selected by a bit mask over the feature names passed to the
+    constructor. A bit whose name appears nowhere in the sources is dropped
+    before building, and variants whose final sources are identical share one
+    program. Variants passed to `precompile()` are all started at once, so they
+    compile concurrently: on the driver's own threads with
+    KHR_parallel_shader_compile, and otherwise on the workers of the context's
+    SharedContextCompiler, see AsyncShaderProgram. Any other variant is only
+    compiled the first time `getProgram()` asks for it.
+
+    Programs are loaded from the ProgramBinaryCache when possible. All methods
+    must be called on the OpenGL thread.
+ */
+class ShaderPermutationSet
+{
+public:
+    using FeatureMask = uint32;
+
+    ShaderPermutationSet (const String& nameToUse, const StringArray& featureNamesToUse)
+        : name (nameToUse), featureNames (featureNamesToUse)
+    {
+        jassert (featureNames.size() <= 32);
+    }
+
+    ~ShaderPermutationSet()
+    {
+        // You must call release() while the context is still active
+        jassert (programs.empty());
+    }
+
+    /** Called whenever a program becomes ready, whether compiled or loaded
+        from the cache, e.g. to bind its uniform blocks. Its UniformRegistry has
+        already been filled in. */
+    std::function<void (AsyncShaderProgram&)> onProgramLinked;
+
+    /** Where to look for, and save, program binaries. May be nullptr. */
+    void setProgramBinaryCache (ProgramBinaryCache* cacheToUse) noexcept  { cache = cacheToUse; }
+
+    /** Replaces the GLSL sources and rebuilds every variant requested so far.
+        Each variant keeps using its current program until the rebuilt one
+        has linked. */
+    void setSources (OpenGLContext& context, const CoreProfileFunctions& functions,
+                     const String& newVertexSource, const String& newFragmentSource)
+    {
+        vertexSource = newVertexSource;
+        fragmentSource = newFragmentSource;
+        lastError.clear();
+
+        for (auto& variant : variants)
+            requestBuild (context, functions, variant.first, variant.second);
+    }
+
+    /** Starts building all of the given variants together. */
+    void precompile (OpenGLContext& context, const CoreProfileFunctions& functions,
+                     const Array<FeatureMask>& masks)
+    {
+        // Let the driver use as many compiler threads as it sees fit. GLX hands
+        // out a pointer for any name, so only the extension string says it's real
+        if (! hasSetCompilerThreads)
+        {
+            if (functions.glMaxShaderCompilerThreadsKHR != nullptr && functions.isExtensionSupported ("GL_KHR_parallel_shader_compile"))
+                functions.glMaxShaderCompilerThreadsKHR (0xffffffffu);
+            else if (functions.glMaxShaderCompilerThreadsARB != nullptr && functions.isExtensionSupported ("GL_ARB_parallel_shader_compile"))
+                functions.glMaxShaderCompilerThreadsARB (0xffffffffu);
+
+            hasSetCompilerThreads = true;
+        }
+
+        for (auto mask : masks)
+            getOrCreateVariant (context, functions, mask);
+    }
+
+    /** Returns the program for the given features, or nullptr while its first
+        build is still in progress (or has failed). */
+    AsyncShaderProgram* getProgram (OpenGLContext& context, const CoreProfileFunctions& functions,
+                                    FeatureMask mask)
+    {
+        const auto& variant = getOrCreateVariant (context, functions, mask);
+
+        if (variant.currentKey == 0)
+            return nullptr;
+
+        return &programs[variant.currentKey]->program;
+    }
+
+    /** Checks on builds in progress without blocking, and switches variants
+        over to programs that have finished. Call once per frame. Returns true
+        if any variant changed program or failed to build. */
+    bool update (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        for (auto& entry : programs)
+        {
+            auto& build = *entry.second;
+
+            if (build.program.getState() != AsyncShaderProgram::State::compiling)
+                continue;
+
+            const auto state = build.program.update (context);
+
+            if (state == AsyncShaderProgram::State::linked)
+            {
+                programLinked (context, functions, build.program);
+
+                if (cache != nullptr)
+                    cache->store (context, functions, build.cacheName, entry.first, build.program);
+            }
+            else if (state == AsyncShaderProgram::State::failed)
+            {
+                lastError = build.program.getLastError();
+            }
+        }
+
+        bool anyChanged = false;
+
+        for (auto& entry : variants)
+        {
+            auto& variant = entry.second;
+
+            if (variant.pendingKey == 0)
+                continue;
+
+            const auto state = programs[variant.pendingKey]->program.getState();
+
+            if (state == AsyncShaderProgram::State::linked)
+            {
+                // Carry uniform values over from the program being replaced
+                if (variant.currentKey != 0)
+                    programs[variant.pendingKey]->program.getUniforms()
+                        .copyValuesFrom (programs[variant.currentKey]->program.getUniforms());
+
+                variant.currentKey = variant.pendingKey;
+                variant.pendingKey = 0;
+                anyChanged = true;
+            }
+            else if (state == AsyncShaderProgram::State::failed)
+            {
+                variant.pendingKey = 0;
+                anyChanged = true;
+            }
+        }
+
+        if (anyChanged)
+            releaseUnusedPrograms (context);
+
+        return anyChanged;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        for (auto& entry : programs)
+            entry.second->program.release (context);
+
+        programs.clear();
+        variants.clear();
+        hasSetCompilerThreads = false;
+    }
+
+    /** True while any variant is waiting for a build. */
+    bool isCompiling() const
+    {
+        for (auto& entry : variants)
+            if (entry.second.pendingKey != 0)
+                return true;
+
+        return false;
+    }
+
+    /** The error from the most recent failed build since setSources(). */
+    const String& getLastError() const noexcept { return lastError; }
+
+    int getNumVariants() const noexcept         { return (int) variants.size(); }
+    int getNumPrograms() const noexcept         { return (int) programs.size(); }
+
+    /** Inserts `defines` after the #version line, followed by a #line
+        directive so compiler errors still point at the original line numbers. */
+    static String injectDefines (const String& source, const String& defines)
+    {
+        if (defines.isEmpty())
+            return source;
+
+        auto lines = StringArray::fromLines (source);
+        int versionLine = 0;
+
+        while (versionLine < lines.size() && ! lines[versionLine].trimStart().startsWith ("#version"))
+            ++versionLine;
+
+        if (versionLine == lines.size())
+            return defines + source;
+
+        lines.insert (versionLine + 1, defines + "#line " + String (versionLine + 2));
+        return lines.joinIntoString ("\n");
+    }
+
+private:
+    struct Variant
+    {
+        uint64 currentKey = 0, pendingKey = 0;
+    };
+
+    struct Build
+    {
+        AsyncShaderProgram program;
+        String cacheName;
+    };
+
+    Variant& getOrCreateVariant (OpenGLContext& context, const CoreProfileFunctions& functions, FeatureMask mask)
+    {
+        auto existing = variants.find (mask);
+
+        if (existing != variants.end())
+            return existing->second;
+
+        auto& variant = variants[mask];
+        requestBuild (context, functions, mask, variant);
+        return variant;
+    }
+
+    void requestBuild (OpenGLContext& context, const CoreProfileFunctions& functions,
+                       FeatureMask mask, Variant& variant)
+    {
+        // You must call setSources() before asking for any variant
+        jassert (vertexSource.isNotEmpty() && fragmentSource.isNotEmpty());
+
+        const FeatureMask usedMask = removeUnusedFeatures (mask);
+        const String defines = getDefines (usedMask);
+        const uint64 key = ProgramBinaryCache::getKey (vertexSource, fragmentSource, defines);
+
+        if (key == variant.currentKey)
+        {
+            variant.pendingKey = 0;
+            return;
+        }
+
+        variant.pendingKey = key;
+
+        // Another variant already builds these exact sources
+        if (programs.find (key) != programs.end())
+            return;
+
+        auto build = std::make_unique<Build>();
+        build->cacheName = name + "-" + String::toHexString ((int) usedMask);
+
+        if (cache != nullptr && cache->load (context, functions, build->cacheName, key, build->program))
+        {
+            programLinked (context, functions, build->program);
+        }
+        else
+        {
+            build->program.compile (context, functions,
+                                    injectDefines (vertexSource, defines),
+                                    injectDefines (fragmentSource, defines));
+        }
+
+        programs[key] = std::move (build);
+    }
+
+    void programLinked (OpenGLContext& context, const CoreProfileFunctions& functions, AsyncShaderProgram& program)
+    {
+        program.getUniforms().reflect (context, functions, program.getProgramID());
+
+        if (onProgramLinked != nullptr)
+            onProgramLinked (program);
+    }
+
+    FeatureMask removeUnusedFeatures (FeatureMask mask) const
+    {
+        for (int i = 0; i < featureNames.size(); ++i)
+        {
+            const FeatureMask bit = FeatureMask (1) << i;
+
+            if ((mask & bit) != 0
+                 && ! containsWholeWord (vertexSource, featureNames[i])
+                 && ! containsWholeWord (fragmentSource, featureNames[i]))
+                mask &= ~bit;
+        }
+
+        // Bits beyond the named features can't mean anything either
+        return mask & (FeatureMask) ((uint64 (1) << featureNames.size()) - 1);
+    }
+
+    String getDefines (FeatureMask mask) const
+    {
+        String defines;
+
+        for (int i = 0; i < featureNames.size(); ++i)
+            if ((mask & (FeatureMask (1) << i)) != 0)
+                defines << "#define " << featureNames[i] << " 1\n";
+
+        return defines;
+    }
+
+    static bool containsWholeWord (const String& text, const String& word)
+    {
+        auto isIdentifierChar = [] (juce_wchar c) { return CharacterFunctions::isLetterOrDigit (c) || c == '_'; };
+
+        for (int index = text.indexOf (word); index >= 0; index = text.indexOf (index + 1, word))
+        {
+            const int end = index + word.length();
+
+            if ((index == 0 || ! isIdentifierChar (text[index - 1]))
+                 && (end >= text.length() || ! isIdentifierChar (text[end])))
+                return true;
+        }
+
+        return false;
+    }
+
+    void releaseUnusedPrograms (OpenGLContext& context)
+    {
+        for (auto it = programs.begin(); it != programs.end();)
+        {
+            bool isUsed = false;
+
+            for (auto& entry : variants)
+                isUsed = isUsed || entry.second.currentKey == it->first || entry.second.pendingKey == it->first;
+
+            if (isUsed)
+            {
+                ++it;
+                continue;
+            }
+
+            it->second->program.release (context);
+            it = programs.erase (it);
+        }
+    }
+
+    const String name;
+    const StringArray featureNames;
+    String vertexSource, fragmentSource, lastError;
+    ProgramBinaryCache* cache = nullptr;
+    bool hasSetCompilerThreads = false;
+
+    std::map<FeatureMask, Variant> variants;
+    std::map<uint64, std::unique_ptr<Build>> programs;
+
+    JUCE_DECLARE_NON_COPYABLE (ShaderPermutationSet)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,105 @@
+//
+//  ShaderSourceWatcher.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace OpenGLUtil
+{
+
+/** Watches a directory of GLSL sources and reports the files that change, so
+    shaders can be reloaded without rebuilding the app.
+
+    Polls modification times on the message thread a couple of times a second,
+    which costs a handful of stat calls and works the same on every platform.
+ */
+class ShaderSourceWatcher : private Timer
+{
+public:
+    /** Called on the message thread with every .glsl file that has been
+        modified since the last check. */
+    std::function<void (const Array<File>& changedFiles)> onFilesChanged;
+
+    ShaderSourceWatcher() = default;
+
+    /** Starts watching `directory`. Files already in it are not reported
+        until they are next modified. */
+    void startWatching (const File& directory, int intervalMs = 500)
+    {
+        watchedDirectory = directory;
+        lastModificationTimes.clear();
+        findChangedFiles();
+        startTimer (intervalMs);
+    }
+
+    void stopWatching()
+    {
+        stopTimer();
+        watchedDirectory = File();
+    }
+
+    bool isWatching() const noexcept    { return isTimerRunning(); }
+
+    /** Looks for `relativePath` next to the executable and then in each of its
+        parent directories, which finds the project's source tree when running
+        a development build from its Builds folder. Returns File() if it can't
+        be found, as in an installed copy of the app.
+     */
+    static File findSourceDirectory (const String& relativePath)
+    {
+        for (auto directory = File::getSpecialLocation (File::currentExecutableFile).getParentDirectory();
+             ! directory.isRoot();
+             directory = directory.getParentDirectory())
+        {
+            auto candidate = directory.getChildFile (relativePath);
+
+            if (candidate.isDirectory())
+                return candidate;
+        }
+
+        return {};
+    }
+
+private:
+    void timerCallback() override
+    {
+        auto changedFiles = findChangedFiles();
+
+        if (! changedFiles.isEmpty() && onFilesChanged != nullptr)
+            onFilesChanged (changedFiles);
+    }
+
+    Array<File> findChangedFiles()
+    {
+        Array<File> changedFiles;
+
+        DirectoryIterator iterator (watchedDirectory, true, "*.glsl", File::findFiles);
+        Time modificationTime;
+
+        while (iterator.next (nullptr, nullptr, nullptr, &modificationTime, nullptr, nullptr))
+        {
+            const auto file = iterator.getFile();
+            const auto key = file.getFullPathName();
+
+            if (lastModificationTimes.contains (key)
+                 && lastModificationTimes[key] != modificationTime.toMilliseconds())
+                changedFiles.add (file);
+
+            lastModificationTimes.set (key, modificationTime.toMilliseconds());
+        }
+
+        return changedFiles;
+    }
+
+    File watchedDirectory;
+    HashMap<String, int64> lastModificationTimes;
+
+    JUCE_DECLARE_NON_COPYABLE (ShaderSourceWatcher)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,405 @@
+//
+//  SharedContextCompiler.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** One program for a SharedContextCompiler worker to compile and link.
+
+    The program belongs to the worker until the job is `finished`, and to
+    whoever takes it from then on. A job cancelled before that is cleaned up
+    by the worker, so the render thread never waits for it.
+ */
+struct ShaderCompileJob : public ReferenceCountedObject
+{
+    using Ptr = ReferenceCountedObjectPtr<ShaderCompileJob>;
+
+    enum class Status
+    {
+        queued,     /**< Waiting for a worker. */
+        running,    /**< Being compiled by a worker. */
+        finished,   /**< The results below are ready to take. */
+        cancelled,  /**< Nobody wants the results any more. */
+        abandoned   /**< The workers stopped before getting to it. */
+    };
+
+    ShaderCompileJob (const String& vertexSourceToUse, const String& fragmentSourceToUse)
+        : vertexSource (vertexSourceToUse), fragmentSource (fragmentSourceToUse)
+    {
+    }
+
+    const String vertexSource, fragmentSource;
+    std::atomic<Status> status { Status::queued };
+
+    // Written by the worker before the status becomes `finished`
+    GLuint programID = 0;
+    SyncObject fence = nullptr;
+    String error;
+
+    /** Compiles and links the program in the active context, waiting for the
+        result, then fences it so that other contexts know when it's safe to use.
+        Called by a worker, after moving the job from `queued` to `running`. */
+    void run (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        const GLuint vertexShaderID = submitShader (context, GL_VERTEX_SHADER, vertexSource);
+        const GLuint fragmentShaderID = submitShader (context, GL_FRAGMENT_SHADER, fragmentSource);
+
+        GLuint newProgramID = context.extensions.glCreateProgram();
+        context.extensions.glAttachShader (newProgramID, vertexShaderID);
+        context.extensions.glAttachShader (newProgramID, fragmentShaderID);
+
+        if (functions.glProgramParameteri != nullptr)
+            functions.glProgramParameteri (newProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        context.extensions.glLinkProgram (newProgramID);
+
+        // Blocks until the driver is done, which is the point of being on this thread
+        GLint isLinked = GL_FALSE;
+        context.extensions.glGetProgramiv (newProgramID, GL_LINK_STATUS, &isLinked);
+
+        String log;
+
+        if (isLinked == GL_FALSE)
+            log = getShaderLog (context, vertexShaderID, "Vertex shader")
+                + getShaderLog (context, fragmentShaderID, "Fragment shader")
+                + getProgramLog (context, newProgramID);
+
+        for (auto shaderID : { vertexShaderID, fragmentShaderID })
+        {
+            context.extensions.glDetachShader (newProgramID, shaderID);
+            context.extensions.glDeleteShader (shaderID);
+        }
+
+        if (isLinked == GL_FALSE)
+        {
+            context.extensions.glDeleteProgram (newProgramID);
+            newProgramID = 0;
+        }
+
+        // Flushed, so that the other context's wait on the fence can't hang
+        const SyncObject newFence = functions.glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        programID = newProgramID;
+        fence = newFence;
+        error = log;
+
+        auto expected = Status::running;
+
+        if (! status.compare_exchange_strong (expected, Status::finished))
+            deleteResults (context, functions);
+    }
+
+    /** Tells the worker the results aren't wanted, or deletes them if they are
+        already there. Call from the context that would have taken them. */
+    void cancel (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        for (auto from : { Status::queued, Status::running })
+        {
+            auto expected = from;
+
+            if (status.compare_exchange_strong (expected, Status::cancelled))
+                return;
+        }
+
+        if (status == Status::finished)
+            deleteResults (context, functions);
+    }
+
+    //==============================================================================
+    static GLuint submitShader (OpenGLContext& context, GLenum type, const String& source)
+    {
+        const GLuint shaderID = context.extensions.glCreateShader (type);
+        const GLchar* sourceText = source.toRawUTF8();
+        context.extensions.glShaderSource (shaderID, 1, &sourceText, nullptr);
+        context.extensions.glCompileShader (shaderID);
+        return shaderID;
+    }
+
+    static String getShaderLog (OpenGLContext& context, GLuint shaderID, const String& stageName)
+    {
+        GLint isCompiled = GL_FALSE;
+        context.extensions.glGetShaderiv (shaderID, GL_COMPILE_STATUS, &isCompiled);
+
+        if (isCompiled != GL_FALSE)
+            return {};
+
+        GLchar log[4096] = { 0 };
+        GLsizei length = 0;
+        context.extensions.glGetShaderInfoLog (shaderID, sizeof (log), &length, log);
+        return stageName + ": " + String::fromUTF8 (log, (int) length).trim() + "\n";
+    }
+
+    static String getProgramLog (OpenGLContext& context, GLuint programID)
+    {
+        GLchar log[4096] = { 0 };
+        GLsizei length = 0;
+        context.extensions.glGetProgramInfoLog (programID, sizeof (log), &length, log);
+        return String::fromUTF8 (log, (int) length).trim();
+    }
+
+private:
+    void deleteResults (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        if (programID != 0)
+            context.extensions.glDeleteProgram (programID);
+
+        if (fence != nullptr)
+            functions.glDeleteSync (fence);
+
+        programID = 0;
+        fence = nullptr;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ShaderCompileJob)
+};
+
+
+/** Compiles shader programs on worker threads, each with a hidden OpenGL
+    context sharing objects with the main one, so that the render thread
+    never waits for the driver's compiler.
+
+    Each worker is a 1x1 child component of the host, since JUCE only creates
+    a context for a component on screen. It draws nothing. Its context shares
+    with the main context's native one, see OpenGLContext::setNativeSharedContext(),
+    so the programs it links can be used by the main context once their
+    fence has signalled.
+
+    Workers are started from the message thread after the main context has
+    been created, and stopped when it closes. Meanwhile, the queue is stored
+    on the main context, where AsyncShaderProgram::compile() finds it with
+    getQueue(). Compiles submitted while no worker is running fall back to
+    the main context.
+ */
+class SharedContextCompiler
+{
+public:
+    /** The jobs waiting for a worker, shared between the main context and
+        the workers, which may come and go independently. */
+    class Queue : public ReferenceCountedObject
+    {
+    public:
+        /** Hands the job to the workers. Returns false if none is running,
+            in which case the caller must compile some other way. */
+        bool submit (ShaderCompileJob* job)
+        {
+            const ScopedLock sl (lock);
+
+            if (workerContexts.isEmpty())
+                return false;
+
+            jobs.add (job);
+
+            // Coalesced, so only the workers' next frames pick the job up
+            for (auto* workerContext : workerContexts)
+                workerContext->triggerRepaint();
+
+            return true;
+        }
+
+        /** The next job still wanted, now marked `running`, or nullptr. */
+        ShaderCompileJob::Ptr popNext()
+        {
+            const ScopedLock sl (lock);
+
+            while (! jobs.isEmpty())
+            {
+                ShaderCompileJob::Ptr job = jobs.removeAndReturn (0);
+                auto expected = ShaderCompileJob::Status::queued;
+
+                if (job->status.compare_exchange_strong (expected, ShaderCompileJob::Status::running))
+                    return job;
+            }
+
+            return nullptr;
+        }
+
+        void addWorker (OpenGLContext& workerContext)
+        {
+            const ScopedLock sl (lock);
+            workerContexts.addIfNotAlreadyThere (&workerContext);
+        }
+
+        /** Once the last worker has gone, the jobs still queued are abandoned,
+            and their programs compile on the main context instead. */
+        void removeWorker (OpenGLContext& workerContext)
+        {
+            const ScopedLock sl (lock);
+            workerContexts.removeFirstMatchingValue (&workerContext);
+
+            if (! workerContexts.isEmpty())
+                return;
+
+            for (auto* job : jobs)
+            {
+                auto expected = ShaderCompileJob::Status::queued;
+                job->status.compare_exchange_strong (expected, ShaderCompileJob::Status::abandoned);
+            }
+
+            jobs.clear();
+        }
+
+        int getNumWorkers() const
+        {
+            const ScopedLock sl (lock);
+            return workerContexts.size();
+        }
+
+    private:
+        CriticalSection lock;
+        Array<OpenGLContext*> workerContexts;
+        ReferenceCountedArray<ShaderCompileJob> jobs;
+    };
+
+    /** The workers are added to `hostToUse`, which should be the component
+        the main context is attached to. */
+    explicit SharedContextCompiler (Component& hostToUse, int numWorkersToUse = 2)
+        : host (hostToUse), numWorkers (numWorkersToUse)
+    {
+        jassert (numWorkers > 0);
+    }
+
+    ~SharedContextCompiler()
+    {
+        stopWorkers();
+    }
+
+    /** Call from newOpenGLContextCreated(). Stores the queue on the main
+        context and starts the workers, sharing with it, on the message thread.
+        `pixelFormat` must be the main context's, as some platforms only
+        share between contexts of the same format. */
+    void contextCreated (OpenGLContext& mainContext, const OpenGLPixelFormat& pixelFormat)
+    {
+        mainContext.setAssociatedObject (queueName, queue.get());
+
+        const int thisGeneration = ++generation;
+        void* nativeContext = mainContext.getRawContext();
+        WeakReference<SharedContextCompiler> weakThis (this);
+
+        MessageManager::callAsync ([weakThis, thisGeneration, nativeContext, pixelFormat]
+        {
+            // The main context has closed since, so its native one is gone
+            if (weakThis != nullptr && weakThis->generation == thisGeneration)
+                weakThis->startWorkers (nativeContext, pixelFormat);
+        });
+    }
+
+    /** Call from openGLContextClosing(). The workers stop on the message thread. */
+    void contextClosing()
+    {
+        ++generation;
+        WeakReference<SharedContextCompiler> weakThis (this);
+
+        MessageManager::callAsync ([weakThis]
+        {
+            if (weakThis != nullptr)
+                weakThis->stopWorkers();
+        });
+    }
+
+    /** The queue stored on `context` by contextCreated(), if any. Call with
+        the context active. */
+    static Queue* getQueue (OpenGLContext& context)
+    {
+        return dynamic_cast<Queue*> (context.getAssociatedObject (queueName));
+    }
+
+    /** Workers whose contexts are running. */
+    int getNumWorkers() const   { return queue->getNumWorkers(); }
+
+private:
+    class Worker : public Component,
+                   private OpenGLRenderer
+    {
+    public:
+        Worker (Queue& queueToUse, void* nativeContextToShareWith, const OpenGLPixelFormat& pixelFormat)
+            : queue (&queueToUse)
+        {
+            setInterceptsMouseClicks (false, false);
+
+            context.setNativeSharedContext (nativeContextToShareWith);
+            context.setOpenGLVersionRequired (OpenGLContext::OpenGLVersion::openGL3_2);
+            context.setPixelFormat (pixelFormat);
+            context.setComponentPaintingEnabled (false);
+            context.setContinuousRepainting (false);
+            context.setRenderer (this);
+            context.attachTo (*this);
+        }
+
+        ~Worker() override
+        {
+            // Waits for a compile in progress to finish
+            context.detach();
+        }
+
+    private:
+        void newOpenGLContextCreated() override
+        {
+            functions.initialise();
+            context.setSwapInterval (0);
+
+            if (functions.areAllFunctionsAvailable())
+                queue->addWorker (context);
+        }
+
+        void renderOpenGL() override
+        {
+            while (auto job = queue->popNext())
+                job->run (context, functions);
+
+            OpenGLHelpers::clear (Colours::black);
+        }
+
+        void openGLContextClosing() override
+        {
+            queue->removeWorker (context);
+        }
+
+        ReferenceCountedObjectPtr<Queue> queue;
+        OpenGLContext context;
+        CoreProfileFunctions functions;
+
+        JUCE_DECLARE_NON_COPYABLE (Worker)
+    };
+
+    void startWorkers (void* nativeContextToShareWith, const OpenGLPixelFormat& pixelFormat)
+    {
+        stopWorkers();
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            auto* worker = workers.add (new Worker (*queue, nativeContextToShareWith, pixelFormat));
+            host.addAndMakeVisible (worker);
+            worker->setBounds (0, 0, 1, 1);
+        }
+    }
+
+    void stopWorkers()
+    {
+        for (auto* worker : workers)
+            host.removeChildComponent (worker);
+
+        workers.clear();
+    }
+
+    static constexpr const char* queueName = "OpenGLUtil::SharedContextCompiler";
+
+    Component& host;
+    const int numWorkers;
+    ReferenceCountedObjectPtr<Queue> queue { new Queue() };
+    OwnedArray<Worker> workers;
+    std::atomic<int> generation { 0 };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE (SharedContextCompiler)
+    JUCE_DECLARE_NON_COPYABLE (SharedContextCompiler)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,177 @@
+//
+//  TextureArrayPacker.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Packs many images into a few GL_TEXTURE_2D_ARRAY textures, so that meshes
+    using different images can still be drawn with one texture bind, or merged
+    into one draw with the layer index stored in their vertices.
+
+    Images are converted to 8 bit BGRA and grouped by size. Each group becomes
+    one array, with one layer per image, and a group that outgrows
+    `maxLayersPerArray` continues in a new array. Packing happens on the CPU
+    and can be done on any thread; the pixels are kept after `upload()` so the
+    arrays can be uploaded again when a new context is created.
+
+    The arrays are uploaded in one go, so this suits small images such as
+    the single colour layers of untextured materials. Stream image files in
+    with TextureStreamer::requestArray() instead.
+ */
+class TextureArrayPacker
+{
+public:
+    /** Where an image ended up. The shader samples it with
+        texture (sampler, vec3 (u, v, layer)) after binding the array. */
+    struct Placement
+    {
+        int arrayIndex = -1;
+        int layer = 0;
+
+        bool isValid() const noexcept   { return arrayIndex >= 0; }
+    };
+
+    /** Every OpenGL 3.3 implementation supports at least this many layers. */
+    static constexpr int maxLayersPerArray = 256;
+
+    TextureArrayPacker() = default;
+
+    ~TextureArrayPacker()
+    {
+        // You must call release() while the context is still active
+        for (auto& array : arrays)
+            jassert (array.textureID == 0);
+    }
+
+    /** Adds an image as a layer of an array of the same size. */
+    Placement add (const Image& image)
+    {
+        const auto argbImage = image.convertedToFormat (Image::ARGB);
+        const int width = argbImage.getWidth(), height = argbImage.getHeight();
+        const Placement placement = allocateLayer (width, height);
+        auto& array = arrays[(size_t) placement.arrayIndex];
+
+        // juce::Image::ARGB is BGRA in memory on little endian machines.
+        // Rows are flipped since OpenGL expects the bottom row first
+        const Image::BitmapData bitmap (argbImage, Image::BitmapData::readOnly);
+        const size_t rowBytes = (size_t) width * 4;
+        auto* layerPixels = array.pixels.data() + (size_t) placement.layer * rowBytes * (size_t) height;
+
+        for (int y = 0; y < height; ++y)
+            memcpy (layerPixels + (size_t) (height - 1 - y) * rowBytes, bitmap.getLinePointer (y), rowBytes);
+
+        return placement;
+    }
+
+    /** Adds a single pixel layer of one colour, for materials without a
+        texture, so they can share an array and a draw with each other. */
+    Placement add (Colour colour)
+    {
+        const auto argb = colour.getARGB();
+
+        if (colourPlacements.find (argb) != colourPlacements.end())
+            return colourPlacements[argb];
+
+        Image pixel (Image::ARGB, 1, 1, false);
+        pixel.setPixelAt (0, 0, colour);
+        return colourPlacements[argb] = add (pixel);
+    }
+
+    /** Creates, or recreates, the array textures with full mip chains. Call
+        on the OpenGL thread, after CoreProfileFunctions::initialise(). */
+    void upload (const CoreProfileFunctions& functions)
+    {
+        for (auto& array : arrays)
+        {
+            if (array.textureID == 0)
+                glGenTextures (1, &array.textureID);
+
+            glBindTexture (GL_TEXTURE_2D_ARRAY, array.textureID);
+            glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+            functions.glTexImage3D (GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, array.width, array.height, array.numLayers,
+                                    0, GL_BGRA, GL_UNSIGNED_BYTE, array.pixels.data());
+            functions.glGenerateMipmap (GL_TEXTURE_2D_ARRAY);
+
+            glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+
+        glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    void release()
+    {
+        for (auto& array : arrays)
+        {
+            if (array.textureID != 0)
+                glDeleteTextures (1, &array.textureID);
+
+            array.textureID = 0;
+        }
+    }
+
+    /** The texture to bind to GL_TEXTURE_2D_ARRAY, or 0 before upload(). */
+    GLuint getTextureID (int arrayIndex) const
+    {
+        return isPositiveAndBelow (arrayIndex, (int) arrays.size()) ? arrays[(size_t) arrayIndex].textureID : 0;
+    }
+
+    int getNumArrays() const noexcept   { return (int) arrays.size(); }
+
+    int getNumLayers() const noexcept
+    {
+        int numLayers = 0;
+
+        for (auto& array : arrays)
+            numLayers += array.numLayers;
+
+        return numLayers;
+    }
+
+private:
+    struct TextureArray
+    {
+        int width = 0, height = 0, numLayers = 0;
+        std::vector<uint8> pixels; // BGRA layers, one after another
+        GLuint textureID = 0;
+    };
+
+    Placement allocateLayer (int width, int height)
+    {
+        int arrayIndex = 0;
+
+        while (arrayIndex < (int) arrays.size()
+                && ! (arrays[(size_t) arrayIndex].width == width
+                       && arrays[(size_t) arrayIndex].height == height
+                       && arrays[(size_t) arrayIndex].numLayers < maxLayersPerArray))
+            ++arrayIndex;
+
+        if (arrayIndex == (int) arrays.size())
+        {
+            arrays.emplace_back();
+            arrays.back().width = width;
+            arrays.back().height = height;
+        }
+
+        auto& array = arrays[(size_t) arrayIndex];
+        array.pixels.resize (array.pixels.size() + (size_t) (width * height * 4));
+        return { arrayIndex, array.numLayers++ };
+    }
+
+    std::vector<TextureArray> arrays;
+    std::map<uint32, Placement> colourPlacements;
+
+    JUCE_DECLARE_NON_COPYABLE (TextureArrayPacker)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,585 @@
+//
+//  TextureStreamer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+
+/** Loads image files into mipmapped textures without hitching the render
+    thread, and keeps the GPU memory they use under a cap.
+
+    Decoding and mip generation run on a thread pool. Finished mip chains are
+    uploaded through a pixel buffer object, smallest level first, and never
+    more bytes per frame than the upload budget allows. So a texture appears
+    blurry within a frame or two of being decoded, then sharpens as its finer
+    levels arrive. When the textures on the GPU exceed the residency cap, the
+    ones that have gone unused longest are evicted. An evicted texture is
+    streamed in again the next time it is asked for.
+
+    Texture arrays are streamed the same way, with each layer decoded by its
+    own job and uploaded level by level with glTexSubImage3D. Their storage
+    is allocated up front, so a whole array counts against the cap as soon as
+    its first level arrives.
+
+    Apart from the constructor, every method must be called on the OpenGL
+    thread.
+ */
+class TextureStreamer
+{
+public:
+    /** Identifies a requested texture. Zero means no texture. */
+    using TextureID = int;
+
+    /** A layer of a texture array: an image file, and the colour to fill the
+        layer with if the file can't be read. */
+    struct ArrayLayer
+    {
+        File file;
+        Colour fallbackColour { Colours::white };
+    };
+
+    struct Statistics
+    {
+        int numTextures = 0, numResident = 0, numDecoding = 0, numUploading = 0, numEvictions = 0;
+        int64 residentBytes = 0, maxResidentBytes = 0;
+
+        String toString() const
+        {
+            return "Textures: " + String (numResident) + "/" + String (numTextures) + " on GPU, "
+                 + String (numDecoding) + " decoding, " + String (numUploading) + " uploading, "
+                 + String (residentBytes / (1024.0 * 1024.0), 1) + "/"
+                 + String (maxResidentBytes / (1024.0 * 1024.0), 0) + " MB, "
+                 + String (numEvictions) + " evicted";
+        }
+    };
+
+    TextureStreamer (int64 maxResidentBytesToUse = 256 * 1024 * 1024,
+                     int64 uploadBytesPerFrameToUse = 4 * 1024 * 1024,
+                     int numDecodeThreads = 2)
+        : maxResidentBytes (maxResidentBytesToUse),
+          uploadBytesPerFrame (uploadBytesPerFrameToUse),
+          decodePool (numDecodeThreads)
+    {
+    }
+
+    ~TextureStreamer()
+    {
+        decodePool.removeAllJobs (true, 10000);
+
+        // You must call release() while the context is still active
+        jassert (pixelBufferID == 0);
+    }
+
+    /** Caps the GPU memory used by textures. Textures drawn in the last frame
+        are never evicted, so the cap can be exceeded if they alone need more. */
+    void setMaxResidentBytes (int64 newMaxBytes) noexcept       { maxResidentBytes = newMaxBytes; }
+
+    /** Limits how many bytes of texture data are uploaded in one frame. A
+        single mip level larger than this is still uploaded, on its own. */
+    void setUploadBytesPerFrame (int64 newBytesPerFrame) noexcept { uploadBytesPerFrame = newBytesPerFrame; }
+
+    /** Starts streaming the image file into a GL_TEXTURE_2D, unless it has
+        been requested before. */
+    TextureID request (const File& imageFile)
+    {
+        for (size_t i = 0; i < entries.size(); ++i)
+            if (! entries[i]->isArray && entries[i]->layers.front().source.file == imageFile)
+                return (TextureID) i + 1;
+
+        entries.push_back (std::make_unique<Entry>());
+        entries.back()->layers.resize (1);
+        entries.back()->layers.front().source.file = imageFile;
+
+        const TextureID id = (TextureID) entries.size();
+        startDecoding (id);
+        return id;
+    }
+
+    /** Starts streaming the images into a GL_TEXTURE_2D_ARRAY, one layer per
+        image in order. Each image is scaled to `layerSize` square, which
+        should be a power of two. */
+    TextureID requestArray (const std::vector<ArrayLayer>& layers, int layerSize)
+    {
+        jassert (! layers.empty() && isPowerOfTwo (layerSize));
+
+        entries.push_back (std::make_unique<Entry>());
+        auto& entry = *entries.back();
+        entry.isArray = true;
+        entry.layerSize = layerSize;
+        entry.numLevels = 1;
+
+        while ((layerSize >> (entry.numLevels - 1)) > 1)
+            ++entry.numLevels;
+
+        for (auto& layer : layers)
+        {
+            entry.layers.emplace_back();
+            entry.layers.back().source = layer;
+        }
+
+        const TextureID id = (TextureID) entries.size();
+        startDecoding (id);
+        return id;
+    }
+
+    /** The texture to bind for this frame, to GL_TEXTURE_2D or
+        GL_TEXTURE_2D_ARRAY depending on how it was requested, or 0 until
+        every layer has a level on the GPU. Marks the texture as used. */
+    GLuint getTextureID (TextureID id)
+    {
+        if (id <= 0 || id > (TextureID) entries.size())
+            return 0;
+
+        auto& entry = *entries[(size_t) id - 1];
+        entry.lastUsedFrame = frameNumber;
+
+        if (entry.state == State::evicted)
+            startDecoding (id);
+
+        return entry.isShowable ? entry.textureID : 0;
+    }
+
+    /** Takes in finished decodes, uploads within the frame's budget and
+        evicts textures beyond the cap. Call once per frame. */
+    void update (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        ++frameNumber;
+
+        collectDecodedTextures();
+        uploadWithinBudget (context, functions);
+        evictLeastRecentlyUsed();
+        updateStatistics();
+    }
+
+    void release (OpenGLContext& context)
+    {
+        decodePool.removeAllJobs (true, 10000);
+
+        for (auto& entry : entries)
+            if (entry->textureID != 0)
+                glDeleteTextures (1, &entry->textureID);
+
+        if (pixelBufferID != 0)
+            context.extensions.glDeleteBuffers (1, &pixelBufferID);
+
+        pixelBufferID = 0;
+        entries.clear();
+        residentBytes = 0;
+
+        const ScopedLock sl (decodedLock);
+        decoded.clear();
+    }
+
+    /** Safe to call from any thread. */
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    enum class State
+    {
+        decoding,   /**< Waiting for the decode pool. */
+        uploading,  /**< Some levels are still to be uploaded. */
+        resident,   /**< Every level is on the GPU. */
+        evicted,    /**< Removed from the GPU, streamed again when next used. */
+        failed      /**< The file couldn't be read as an image. */
+    };
+
+    struct MipLevel
+    {
+        int width = 0, height = 0;
+        std::vector<uint8> pixels; // BGRA, bottom row first
+    };
+
+    struct Layer
+    {
+        ArrayLayer source;
+        bool isDecoded = false;
+        std::vector<MipLevel> levels;
+        int nextLevel = -1; // The next level to upload, counting down to 0
+    };
+
+    struct Entry
+    {
+        bool isArray = false;
+        int layerSize = 0;              // Arrays only
+        int numLevels = 0;              // Known up front for arrays, once decoded otherwise
+        std::vector<Layer> layers;      // Just one unless it is an array
+        State state = State::decoding;
+        int numLayersDecoding = 0;
+        bool isShowable = false;        // Every layer has a level on the GPU
+        GLuint textureID = 0;
+        int64 residentBytes = 0;
+        uint32 lastUsedFrame = 0;
+
+        GLenum getTarget() const noexcept   { return isArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D; }
+
+        /** The finest level that every layer has on the GPU, or numLevels if
+            some layer has none yet. */
+        int getFinestCompleteLevel() const noexcept
+        {
+            int level = 0;
+
+            for (auto& layer : layers)
+                level = jmax (level, layer.isDecoded ? layer.nextLevel + 1 : numLevels);
+
+            return level;
+        }
+    };
+
+    struct DecodedLayer
+    {
+        TextureID id;
+        int layer;
+        std::vector<MipLevel> levels;
+    };
+
+    void startDecoding (TextureID id)
+    {
+        auto& entry = *entries[(size_t) id - 1];
+        entry.state = State::decoding;
+        entry.isShowable = false;
+
+        for (size_t i = 0; i < entry.layers.size(); ++i)
+        {
+            auto& layer = entry.layers[i];
+            layer.isDecoded = false;
+            layer.levels.clear();
+            layer.nextLevel = -1;
+            ++entry.numLayersDecoding;
+
+            decodePool.addJob ([this, id, layerIndex = (int) i, source = layer.source, layerSize = entry.layerSize]
+            {
+                auto levels = decode (source, layerSize);
+
+                const ScopedLock sl (decodedLock);
+                decoded.push_back ({ id, layerIndex, std::move (levels) });
+            });
+        }
+    }
+
+    void collectDecodedTextures()
+    {
+        std::vector<DecodedLayer> finished;
+
+        {
+            const ScopedLock sl (decodedLock);
+            finished.swap (decoded);
+        }
+
+        for (auto& decodedLayer : finished)
+        {
+            auto& entry = *entries[(size_t) decodedLayer.id - 1];
+            auto& layer = entry.layers[(size_t) decodedLayer.layer];
+            --entry.numLayersDecoding;
+
+            // Array layers fall back to their colour, so only a 2D texture can fail
+            if (decodedLayer.levels.empty())
+            {
+                DBG ("Failed to load texture " + layer.source.file.getFullPathName());
+                entry.state = State::failed;
+                continue;
+            }
+
+            layer.levels = std::move (decodedLayer.levels);
+            layer.nextLevel = (int) layer.levels.size() - 1;
+            layer.isDecoded = true;
+
+            if (! entry.isArray)
+                entry.numLevels = (int) layer.levels.size();
+
+            entry.state = State::uploading;
+        }
+    }
+
+    void uploadWithinBudget (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        int64 bytesUploaded = 0;
+
+        for (;;)
+        {
+            // The smallest pending level across all textures and layers goes
+            // first, so every texture gets something to show before any gets sharp
+            Entry* next = nullptr;
+            Layer* nextLayer = nullptr;
+
+            for (auto& entry : entries)
+                if (entry->state == State::uploading)
+                    for (auto& layer : entry->layers)
+                        if (layer.isDecoded && layer.nextLevel >= 0
+                             && (nextLayer == nullptr || getNextLevelBytes (layer) < getNextLevelBytes (*nextLayer)))
+                        {
+                            next = entry.get();
+                            nextLayer = &layer;
+                        }
+
+            if (next == nullptr)
+                return;
+
+            const int64 numBytes = getNextLevelBytes (*nextLayer);
+
+            if (bytesUploaded > 0 && bytesUploaded + numBytes > uploadBytesPerFrame)
+                return;
+
+            uploadNextLevel (context, functions, *next, (int) (nextLayer - next->layers.data()));
+            bytesUploaded += numBytes;
+        }
+    }
+
+    void uploadNextLevel (OpenGLContext& context, const CoreProfileFunctions& functions, Entry& entry, int layerIndex)
+    {
+        auto& layer = entry.layers[(size_t) layerIndex];
+        const int level = layer.nextLevel;
+        auto& mip = layer.levels[(size_t) level];
+        const auto numBytes = (GLsizeiptr) mip.pixels.size();
+        const GLenum target = entry.getTarget();
+
+        if (entry.textureID == 0)
+            createTexture (functions, entry, level);
+        else
+            glBindTexture (target, entry.textureID);
+
+        if (pixelBufferID == 0)
+            context.extensions.glGenBuffers (1, &pixelBufferID);
+
+        // Orphaning the buffer lets the driver hand us fresh memory while the
+        // previous upload may still be reading the old contents
+        context.extensions.glBindBuffer (GL_PIXEL_UNPACK_BUFFER, pixelBufferID);
+        context.extensions.glBufferData (GL_PIXEL_UNPACK_BUFFER, numBytes, nullptr, GL_STREAM_DRAW);
+
+        if (auto* destination = functions.glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, numBytes,
+                                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT))
+        {
+            memcpy (destination, mip.pixels.data(), (size_t) numBytes);
+            functions.glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+
+            glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+
+            if (entry.isArray)
+                functions.glTexSubImage3D (GL_TEXTURE_2D_ARRAY, level, 0, 0, layerIndex, mip.width, mip.height, 1,
+                                           GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+            else
+                glTexImage2D (GL_TEXTURE_2D, level, GL_RGBA8, mip.width, mip.height, 0,
+                              GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        context.extensions.glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (! entry.isArray)
+        {
+            entry.residentBytes += numBytes;
+            residentBytes += numBytes;
+        }
+
+        std::vector<uint8>().swap (mip.pixels);
+
+        if (--layer.nextLevel < 0)
+            layer.levels.clear();
+
+        // Only sample the levels that have arrived in every layer
+        const int baseLevel = entry.getFinestCompleteLevel();
+        entry.isShowable = baseLevel < entry.numLevels;
+
+        if (entry.isShowable)
+            glTexParameteri (target, GL_TEXTURE_BASE_LEVEL, baseLevel);
+
+        glBindTexture (target, 0);
+
+        if (entry.numLayersDecoding == 0 && baseLevel == 0)
+            entry.state = State::resident;
+    }
+
+    /** Creates and binds the texture. A 2D texture grows a level at a time,
+        but an array's layers arrive independently, so its storage is
+        allocated for every level at once and counted as resident from now. */
+    void createTexture (const CoreProfileFunctions& functions, Entry& entry, int coarsestLevel)
+    {
+        const GLenum target = entry.getTarget();
+
+        glGenTextures (1, &entry.textureID);
+        glBindTexture (target, entry.textureID);
+        glTexParameteri (target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri (target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri (target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri (target, GL_TEXTURE_MAX_LEVEL, entry.isArray ? entry.numLevels - 1 : coarsestLevel);
+
+        if (! entry.isArray)
+            return;
+
+        const int numLayers = (int) entry.layers.size();
+
+        for (int level = 0; level < entry.numLevels; ++level)
+        {
+            const int size = jmax (1, entry.layerSize >> level);
+            functions.glTexImage3D (GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, numLayers,
+                                    0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+            entry.residentBytes += (int64) size * size * 4 * numLayers;
+        }
+
+        residentBytes += entry.residentBytes;
+    }
+
+    void evictLeastRecentlyUsed()
+    {
+        while (residentBytes > maxResidentBytes)
+        {
+            Entry* leastRecentlyUsed = nullptr;
+
+            // Arrays with layers still decoding are left alone, so that
+            // their decodes can't land after the array has been restarted
+            for (auto& entry : entries)
+                if (entry->textureID != 0 && entry->numLayersDecoding == 0 && frameNumber - entry->lastUsedFrame > 1
+                     && (leastRecentlyUsed == nullptr || entry->lastUsedFrame < leastRecentlyUsed->lastUsedFrame))
+                    leastRecentlyUsed = entry.get();
+
+            if (leastRecentlyUsed == nullptr)
+                return;
+
+            glDeleteTextures (1, &leastRecentlyUsed->textureID);
+            residentBytes -= leastRecentlyUsed->residentBytes;
+
+            leastRecentlyUsed->textureID = 0;
+            leastRecentlyUsed->residentBytes = 0;
+            leastRecentlyUsed->isShowable = false;
+            leastRecentlyUsed->state = State::evicted;
+
+            for (auto& layer : leastRecentlyUsed->layers)
+            {
+                layer.levels.clear();
+                layer.isDecoded = false;
+            }
+            ++numEvictions;
+        }
+    }
+
+    void updateStatistics()
+    {
+        Statistics newStatistics;
+        newStatistics.numTextures = (int) entries.size();
+        newStatistics.numEvictions = numEvictions;
+        newStatistics.residentBytes = residentBytes;
+        newStatistics.maxResidentBytes = maxResidentBytes;
+
+        for (auto& entry : entries)
+        {
+            newStatistics.numResident  += entry->state == State::resident ? 1 : 0;
+            newStatistics.numDecoding  += entry->state == State::decoding ? 1 : 0;
+            newStatistics.numUploading += entry->state == State::uploading ? 1 : 0;
+        }
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics = newStatistics;
+    }
+
+    static int64 getNextLevelBytes (const Layer& layer)
+    {
+        return (int64) layer.levels[(size_t) layer.nextLevel].pixels.size();
+    }
+
+    /** Runs on the decode pool: reads the file and builds its full mip chain
+        with a 2x2 box filter. For an array layer, i.e. when `layerSize` isn't
+        0, the image is scaled to the layer's size, and a file that isn't an
+        image gives a layer of the fallback colour. Otherwise it gives nothing. */
+    static std::vector<MipLevel> decode (const ArrayLayer& source, int layerSize)
+    {
+        auto image = ImageFileFormat::loadFrom (source.file);
+
+        if (layerSize > 0)
+        {
+            if (image.isValid())
+            {
+                image = image.rescaled (layerSize, layerSize, Graphics::highResamplingQuality);
+            }
+            else
+            {
+                DBG ("Failed to load texture " + source.file.getFullPathName());
+                image = Image (Image::ARGB, layerSize, layerSize, false);
+                image.clear (image.getBounds(), source.fallbackColour);
+            }
+        }
+
+        if (! image.isValid())
+            return {};
+
+        image = image.convertedToFormat (Image::ARGB);
+
+        std::vector<MipLevel> levels (1);
+        auto& base = levels.front();
+        base.width = image.getWidth();
+        base.height = image.getHeight();
+        base.pixels.resize ((size_t) (base.width * base.height * 4));
+
+        {
+            // juce::Image::ARGB is BGRA in memory on little endian machines.
+            // Rows are flipped since OpenGL expects the bottom row first
+            const Image::BitmapData bitmap (image, Image::BitmapData::readOnly);
+            const size_t rowBytes = (size_t) base.width * 4;
+
+            for (int y = 0; y < base.height; ++y)
+                memcpy (base.pixels.data() + (size_t) (base.height - 1 - y) * rowBytes, bitmap.getLinePointer (y), rowBytes);
+        }
+
+        while (levels.back().width > 1 || levels.back().height > 1)
+            levels.push_back (downsample (levels.back()));
+
+        return levels;
+    }
+
+    static MipLevel downsample (const MipLevel& source)
+    {
+        MipLevel result;
+        result.width = jmax (1, source.width / 2);
+        result.height = jmax (1, source.height / 2);
+        result.pixels.resize ((size_t) (result.width * result.height * 4));
+
+        for (int y = 0; y < result.height; ++y)
+        {
+            const int y0 = jmin (y * 2, source.height - 1), y1 = jmin (y * 2 + 1, source.height - 1);
+
+            for (int x = 0; x < result.width; ++x)
+            {
+                const int x0 = jmin (x * 2, source.width - 1), x1 = jmin (x * 2 + 1, source.width - 1);
+                auto* destination = result.pixels.data() + (size_t) (y * result.width + x) * 4;
+
+                for (int channel = 0; channel < 4; ++channel)
+                {
+                    auto sample = [&] (int sx, int sy) { return (int) source.pixels[(size_t) (sy * source.width + sx) * 4 + (size_t) channel]; };
+                    destination[channel] = (uint8) ((sample (x0, y0) + sample (x1, y0) + sample (x0, y1) + sample (x1, y1) + 2) / 4);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    int64 maxResidentBytes, uploadBytesPerFrame;
+    int64 residentBytes = 0;
+    int numEvictions = 0;
+    uint32 frameNumber = 0;
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    GLuint pixelBufferID = 0;
+
+    CriticalSection decodedLock;
+    std::vector<DecodedLayer> decoded;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    // Declared last so that it is destroyed, and its jobs stopped, first
+    ThreadPool decodePool;
+
+    JUCE_DECLARE_NON_COPYABLE (TextureStreamer)
+};
+
+} // OpenGLUtil
@@ -0,0 +1,218 @@
+//
+//  UniformBuffer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+// Uniform Buffer Objects ======================================================
+
+/** Connects the uniform block called `blockName` in the program to the
+    given binding point.
+
+    Returns false if the program has no active block with that name, which is
+    normal when a shader stage doesn't reference the block (the GLSL compiler
+    strips unused blocks).
+ */
+static bool bindUniformBlock (const CoreProfileFunctions& functions,
+                              GLuint programID,
+                              const char* blockName,
+                              GLuint bindingPoint)
+{
+    const GLuint blockIndex = functions.glGetUniformBlockIndex (programID, blockName);
+
+    if (blockIndex == GL_INVALID_INDEX)
+        return false;
+
+    functions.glUniformBlockBinding (programID, blockIndex, bindingPoint);
+    return true;
+}
+
+static bool bindUniformBlock (const CoreProfileFunctions& functions,
+                              OpenGLShaderProgram& shaderProgram,
+                              const char* blockName,
+                              GLuint bindingPoint)
+{
+    return bindUniformBlock (functions, shaderProgram.getProgramID(), blockName, bindingPoint);
+}
+
+
+/** A std140 uniform buffer holding a single `BlockType`, permanently attached
+    to one binding point. Every shader program whose block is bound to the same
+    binding point reads the same data, so a value like the camera only has to be
+    uploaded once no matter how many programs use it.
+
+    `BlockType` must be a standard layout struct laid out with std140 rules,
+    which in practice means using only 4-component vectors and mat4s.
+ */
+template <typename BlockType>
+class UniformBuffer
+{
+public:
+    static_assert (sizeof (BlockType) % 16 == 0, "std140 blocks are padded to 16 bytes");
+
+    UniformBuffer (GLuint bindingPointToUse) : bindingPoint (bindingPointToUse) {}
+
+    ~UniformBuffer()
+    {
+        // You must call release() from openGLContextClosing() while the context is still active
+        jassert (bufferID == 0);
+    }
+
+    void create (OpenGLContext& context, const CoreProfileFunctions& functions)
+    {
+        jassert (bufferID == 0);
+
+        context.extensions.glGenBuffers (1, &bufferID);
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, bufferID);
+        context.extensions.glBufferData (GL_UNIFORM_BUFFER, sizeof (BlockType), nullptr, GL_DYNAMIC_DRAW);
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, 0);
+
+        functions.glBindBufferBase (GL_UNIFORM_BUFFER, bindingPoint, bufferID);
+    }
+
+    void release (OpenGLContext& context)
+    {
+        if (bufferID != 0)
+            context.extensions.glDeleteBuffers (1, &bufferID);
+
+        bufferID = 0;
+    }
+
+    /** Copies the whole block to the GPU. Only call this when the data has
+        actually changed. */
+    void upload (OpenGLContext& context, const BlockType& block)
+    {
+        jassert (bufferID != 0);
+
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, bufferID);
+        context.extensions.glBufferSubData (GL_UNIFORM_BUFFER, 0, sizeof (BlockType), &block);
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, 0);
+    }
+
+    GLuint getBindingPoint() const noexcept     { return bindingPoint; }
+
+private:
+    const GLuint bindingPoint;
+    GLuint bufferID = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (UniformBuffer)
+};
+
+
+/** A uniform buffer holding an array of `BlockType` records, one per draw.
+
+    Records are written into a CPU staging copy with `set()`, uploaded together
+    with a single `upload()`, and each draw then selects its own record with
+    `bindElement()`, which is a glBindBufferRange call. This replaces one
+    glUniform* call per uniform per draw with one bind per draw.
+ */
+template <typename BlockType>
+class UniformBufferArray
+{
+public:
+    static_assert (sizeof (BlockType) % 16 == 0, "std140 blocks are padded to 16 bytes");
+
+    UniformBufferArray (GLuint bindingPointToUse) : bindingPoint (bindingPointToUse) {}
+
+    ~UniformBufferArray()
+    {
+        // You must call release() from openGLContextClosing() while the context is still active
+        jassert (bufferID == 0);
+    }
+
+    void create (OpenGLContext& context)
+    {
+        jassert (bufferID == 0);
+
+        // Ranged binds must start on a multiple of the driver's offset alignment
+        GLint alignment = 256;
+        glGetIntegerv (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        stride = (size_t) roundUpToMultiple ((int) sizeof (BlockType), jmax (1, (int) alignment));
+
+        context.extensions.glGenBuffers (1, &bufferID);
+        capacity = 0;
+
+        // The stride may have changed, so any staged records need to be set again
+        staging.assign (count * stride, 0);
+    }
+
+    void release (OpenGLContext& context)
+    {
+        if (bufferID != 0)
+            context.extensions.glDeleteBuffers (1, &bufferID);
+
+        bufferID = 0;
+        capacity = 0;
+    }
+
+    /** Sets the number of records. Existing records are preserved. */
+    void resize (size_t numElements)
+    {
+        staging.resize (numElements * stride);
+        count = numElements;
+    }
+
+    size_t size() const noexcept    { return count; }
+
+    void set (size_t index, const BlockType& block)
+    {
+        jassert (index < count);
+        memcpy (staging.data() + index * stride, &block, sizeof (BlockType));
+    }
+
+    /** Uploads all records in one call. The buffer is reallocated only when
+        the number of records grows. */
+    void upload (OpenGLContext& context)
+    {
+        jassert (bufferID != 0);
+
+        if (staging.empty())
+            return;
+
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, bufferID);
+
+        if (capacity < staging.size())
+        {
+            capacity = staging.size();
+            context.extensions.glBufferData (GL_UNIFORM_BUFFER, (GLsizeiptr) capacity, staging.data(), GL_DYNAMIC_DRAW);
+        }
+        else
+        {
+            context.extensions.glBufferSubData (GL_UNIFORM_BUFFER, 0, (GLsizeiptr) staging.size(), staging.data());
+        }
+
+        context.extensions.glBindBuffer (GL_UNIFORM_BUFFER, 0);
+    }
+
+    /** Makes the record at `index` the one seen by the shader's block. */
+    void bindElement (const CoreProfileFunctions& functions, size_t index) const
+    {
+        jassert (index < count);
+        functions.glBindBufferRange (GL_UNIFORM_BUFFER, bindingPoint, bufferID,
+                                     (GLintptr) (index * stride), (GLsizeiptr) sizeof (BlockType));
+    }
+
+    GLuint getBindingPoint() const noexcept     { return bindingPoint; }
+
+private:
+    static int roundUpToMultiple (int value, int multiple) noexcept
+    {
+        return ((value + multiple - 1) / multiple) * multiple;
+    }
+
+    const GLuint bindingPoint;
+    GLuint bufferID = 0;
+    size_t stride = sizeof (BlockType), count = 0, capacity = 0;
+    std::vector<uint8> staging;
+
+    JUCE_DECLARE_NON_COPYABLE (UniformBufferArray)
+};
+
+} // OpenGLUtil
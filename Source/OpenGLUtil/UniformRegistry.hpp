@@ -0,0 +1,449 @@
+//
+//  UniformRegistry.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLCoreFunctions.hpp"
+
+namespace OpenGLUtil
+{
+// Uniform Handles =============================================================
+
+/** Maps uniform names to small integers, shared by every program, so that
+    looking a uniform up in a program is an array index rather than a string
+    comparison or a glGetUniformLocation call.
+ */
+struct UniformNameTable
+{
+    static int getID (const String& name)
+    {
+        auto& table = getTable();
+        const SpinLock::ScopedLockType sl (table.lock);
+
+        if (table.ids.contains (name))
+            return table.ids[name];
+
+        const int id = table.ids.size();
+        table.ids.set (name, id);
+        return id;
+    }
+
+private:
+    struct Table
+    {
+        SpinLock lock;
+        HashMap<String, int> ids;
+    };
+
+    static Table& getTable()
+    {
+        static Table table;
+        return table;
+    }
+};
+
+
+/** How each C++ type that can be assigned to a uniform maps onto GLSL. */
+template <typename ValueType>
+struct UniformTraits;
+
+template <>
+struct UniformTraits<GLfloat>
+{
+    static constexpr int numComponents = 1;
+    static constexpr bool isInteger = false;
+    static void write (const GLfloat& value, GLfloat* dest)             { dest[0] = value; }
+};
+
+template <>
+struct UniformTraits<GLint>
+{
+    static constexpr int numComponents = 1;
+    static constexpr bool isInteger = true;
+    static void write (const GLint& value, GLint* dest)                 { dest[0] = value; }
+};
+
+template <>
+struct UniformTraits<Point<GLfloat>>
+{
+    static constexpr int numComponents = 2;
+    static constexpr bool isInteger = false;
+    static void write (const Point<GLfloat>& value, GLfloat* dest)      { dest[0] = value.x; dest[1] = value.y; }
+};
+
+template <>
+struct UniformTraits<Vector3D<GLfloat>>
+{
+    static constexpr int numComponents = 3;
+    static constexpr bool isInteger = false;
+    static void write (const Vector3D<GLfloat>& value, GLfloat* dest)   { dest[0] = value.x; dest[1] = value.y; dest[2] = value.z; }
+};
+
+template <>
+struct UniformTraits<Colour>
+{
+    static constexpr int numComponents = 4;
+    static constexpr bool isInteger = false;
+
+    static void write (const Colour& value, GLfloat* dest)
+    {
+        dest[0] = value.getFloatRed();
+        dest[1] = value.getFloatGreen();
+        dest[2] = value.getFloatBlue();
+        dest[3] = value.getFloatAlpha();
+    }
+};
+
+template <>
+struct UniformTraits<Matrix3D<GLfloat>>
+{
+    static constexpr int numComponents = 16;
+    static constexpr bool isInteger = false;
+    static void write (const Matrix3D<GLfloat>& value, GLfloat* dest)   { memcpy (dest, value.mat, sizeof (value.mat)); }
+};
+
+
+/** A typed reference to a uniform by name. Create these once, e.g. as class
+    members; the name is only looked at in the constructor. The same handle
+    works with every program, whether or not that program uses the uniform.
+ */
+template <typename ValueType>
+class UniformHandle
+{
+public:
+    explicit UniformHandle (const String& name) : id (UniformNameTable::getID (name)) {}
+
+    int getID() const noexcept  { return id; }
+
+private:
+    int id;
+};
+
+
+// Uniform Registry ============================================================
+
+/** Everything a linked program exposes, enumerated once after linking with
+    glGetActiveUniform, glGetActiveAttrib and glGetActiveUniformBlockName.
+
+    Uniform values are kept in a CPU side shadow copy. `set()` only marks a
+    uniform as dirty if its value actually changed, and `upload()` sends just
+    the dirty ones, so setting every uniform every frame costs no GL calls
+    when nothing has changed.
+ */
+class UniformRegistry
+{
+public:
+    struct Uniform
+    {
+        String name;
+        GLint location = -1;
+        GLenum type = 0;
+        GLint arraySize = 1;
+        int numComponents = 1;
+        bool isInteger = false;
+        size_t valueOffset = 0;
+        bool isDirty = false;
+    };
+
+    struct Attribute
+    {
+        String name;
+        GLint location = -1;
+        GLenum type = 0;
+        GLint arraySize = 1;
+    };
+
+    struct Block
+    {
+        String name;
+        GLuint index = 0;
+        GLint dataSize = 0;
+    };
+
+    UniformRegistry() = default;
+
+    /** Enumerates the program's active uniforms, attributes and uniform
+        blocks. Uniforms inside blocks are left to the uniform buffers. */
+    void reflect (OpenGLContext& context, const CoreProfileFunctions& functions, GLuint programID)
+    {
+        uniforms.clear();
+        attributes.clear();
+        blocks.clear();
+        uniformIndexForID.clear();
+        dirtyUniforms.clear();
+        values.clear();
+
+        GLchar name[256];
+        GLint count = 0;
+
+        context.extensions.glGetProgramiv (programID, GL_ACTIVE_UNIFORMS, &count);
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            Uniform uniform;
+            GLsizei length = 0;
+            context.extensions.glGetActiveUniform (programID, (GLuint) i, sizeof (name), &length,
+                                                   &uniform.arraySize, &uniform.type, name);
+            uniform.name = getBaseName (name, length);
+            uniform.location = context.extensions.glGetUniformLocation (programID, name);
+
+            if (uniform.location < 0)
+                continue; // Lives in a uniform block
+
+            uniform.numComponents = getNumComponents (uniform.type);
+            uniform.isInteger = isIntegerType (uniform.type);
+            uniform.valueOffset = values.size();
+            values.resize (values.size() + (size_t) (uniform.numComponents * uniform.arraySize), 0);
+
+            const int id = UniformNameTable::getID (uniform.name);
+
+            if ((int) uniformIndexForID.size() <= id)
+                uniformIndexForID.resize ((size_t) id + 1, -1);
+
+            uniformIndexForID[(size_t) id] = (int) uniforms.size();
+            uniforms.push_back (uniform);
+        }
+
+        context.extensions.glGetProgramiv (programID, GL_ACTIVE_ATTRIBUTES, &count);
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            Attribute attribute;
+            GLsizei length = 0;
+            context.extensions.glGetActiveAttrib (programID, (GLuint) i, sizeof (name), &length,
+                                                  &attribute.arraySize, &attribute.type, name);
+            attribute.name = getBaseName (name, length);
+            attribute.location = context.extensions.glGetAttribLocation (programID, name);
+            attributes.push_back (attribute);
+        }
+
+        context.extensions.glGetProgramiv (programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+
+        for (GLint i = 0; i < count; ++i)
+        {
+            Block block;
+            GLsizei length = 0;
+            block.index = (GLuint) i;
+            functions.glGetActiveUniformBlockName (programID, block.index, sizeof (name), &length, name);
+            functions.glGetActiveUniformBlockiv (programID, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+            block.name = String::fromUTF8 (name, (int) length);
+            blocks.push_back (block);
+        }
+    }
+
+    /** Sets a uniform's value in the shadow copy. Does nothing if the program
+        has no such uniform, or the value hasn't changed. */
+    template <typename ValueType>
+    void set (const UniformHandle<ValueType>& handle, const ValueType& value)
+    {
+        set (handle, &value, 1);
+    }
+
+    /** Sets the first `numElements` elements of an array uniform. */
+    template <typename ValueType>
+    void set (const UniformHandle<ValueType>& handle, const ValueType* elements, int numElements)
+    {
+        using Traits = UniformTraits<ValueType>;
+        using ComponentType = typename std::conditional<Traits::isInteger, GLint, GLfloat>::type;
+
+        auto* uniform = findUniform (handle.getID());
+
+        if (uniform == nullptr)
+            return;
+
+        // The uniform's GLSL type doesn't match the handle's C++ type
+        jassert (uniform->numComponents == Traits::numComponents && uniform->isInteger == Traits::isInteger);
+
+        ComponentType newValues[Traits::numComponents];
+        auto* shadow = reinterpret_cast<ComponentType*> (values.data() + uniform->valueOffset);
+        bool hasChanged = false;
+
+        for (int i = 0; i < jmin (numElements, (int) uniform->arraySize); ++i)
+        {
+            Traits::write (elements[i], newValues);
+            auto* element = shadow + i * Traits::numComponents;
+
+            if (memcmp (element, newValues, sizeof (newValues)) != 0)
+            {
+                memcpy (element, newValues, sizeof (newValues));
+                hasChanged = true;
+            }
+        }
+
+        if (hasChanged)
+            markDirty (*uniform);
+    }
+
+    /** Sends every changed uniform to the program, which must be in use. */
+    void upload (OpenGLContext& context)
+    {
+        for (auto index : dirtyUniforms)
+        {
+            auto& uniform = uniforms[(size_t) index];
+            const auto* data = values.data() + uniform.valueOffset;
+            const GLint location = uniform.location;
+            const GLsizei count = uniform.arraySize;
+
+            if (uniform.isInteger)
+            {
+                const auto* ints = reinterpret_cast<const GLint*> (data);
+
+                switch (uniform.numComponents)
+                {
+                    case 1:  context.extensions.glUniform1iv (location, count, ints); break;
+                    case 2:  context.extensions.glUniform2iv (location, count, ints); break;
+                    case 3:  context.extensions.glUniform3iv (location, count, ints); break;
+                    default: context.extensions.glUniform4iv (location, count, ints); break;
+                }
+            }
+            else
+            {
+                const auto* floats = reinterpret_cast<const GLfloat*> (data);
+
+                switch (uniform.type)
+                {
+                    case GL_FLOAT_MAT2: context.extensions.glUniformMatrix2fv (location, count, GL_FALSE, floats); break;
+                    case GL_FLOAT_MAT3: context.extensions.glUniformMatrix3fv (location, count, GL_FALSE, floats); break;
+                    case GL_FLOAT_MAT4: context.extensions.glUniformMatrix4fv (location, count, GL_FALSE, floats); break;
+                    case GL_FLOAT_VEC2: context.extensions.glUniform2fv (location, count, floats); break;
+                    case GL_FLOAT_VEC3: context.extensions.glUniform3fv (location, count, floats); break;
+                    case GL_FLOAT_VEC4: context.extensions.glUniform4fv (location, count, floats); break;
+                    default:            context.extensions.glUniform1fv (location, count, floats); break;
+                }
+            }
+
+            uniform.isDirty = false;
+        }
+
+        dirtyUniforms.clear();
+    }
+
+    /** Copies the shadow values of every uniform the two programs have in
+        common, e.g. from a program that is being replaced by a rebuilt one.
+        Copied values are uploaded by the next `upload()`. */
+    void copyValuesFrom (const UniformRegistry& other)
+    {
+        for (auto& uniform : uniforms)
+        {
+            const int id = UniformNameTable::getID (uniform.name);
+            const auto* source = other.findUniform (id);
+
+            if (source == nullptr || source->type != uniform.type)
+                continue;
+
+            const auto numWords = (size_t) (uniform.numComponents * jmin (uniform.arraySize, source->arraySize));
+            const auto* first = other.values.data() + source->valueOffset;
+            std::copy (first, first + numWords, values.begin() + (std::ptrdiff_t) uniform.valueOffset);
+            markDirty (uniform);
+        }
+    }
+
+    /** Connects the named uniform block to a binding point. Returns false if
+        the program has no such block. */
+    bool bindBlock (const CoreProfileFunctions& functions, GLuint programID, const String& blockName,
+                    GLuint bindingPoint, size_t expectedDataSize) const
+    {
+        for (const auto& block : blocks)
+        {
+            if (block.name == blockName)
+            {
+                // The GLSL block's std140 size doesn't match the C++ struct that mirrors it
+                jassert ((size_t) block.dataSize == expectedDataSize);
+                ignoreUnused (expectedDataSize);
+
+                functions.glUniformBlockBinding (programID, block.index, bindingPoint);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template <typename ValueType>
+    bool hasUniform (const UniformHandle<ValueType>& handle) const noexcept  { return findUniform (handle.getID()) != nullptr; }
+
+    /** The location of the named attribute, or -1. Not for use on the hot path. */
+    GLint getAttributeLocation (const String& attributeName) const
+    {
+        for (const auto& attribute : attributes)
+            if (attribute.name == attributeName)
+                return attribute.location;
+
+        return -1;
+    }
+
+    const std::vector<Uniform>& getUniforms() const noexcept       { return uniforms; }
+    const std::vector<Attribute>& getAttributes() const noexcept   { return attributes; }
+    const std::vector<Block>& getBlocks() const noexcept           { return blocks; }
+
+private:
+    using Word = uint32;
+    static_assert (sizeof (Word) == sizeof (GLfloat) && sizeof (Word) == sizeof (GLint), "Shadow words hold one component");
+
+    const Uniform* findUniform (int id) const noexcept
+    {
+        if (id < 0 || id >= (int) uniformIndexForID.size() || uniformIndexForID[(size_t) id] < 0)
+            return nullptr;
+
+        return &uniforms[(size_t) uniformIndexForID[(size_t) id]];
+    }
+
+    Uniform* findUniform (int id) noexcept
+    {
+        return const_cast<Uniform*> (static_cast<const UniformRegistry&> (*this).findUniform (id));
+    }
+
+    void markDirty (Uniform& uniform)
+    {
+        if (! uniform.isDirty)
+        {
+            uniform.isDirty = true;
+            dirtyUniforms.push_back ((int) (&uniform - uniforms.data()));
+        }
+    }
+
+    /** Array uniforms are reported as "name[0]". */
+    static String getBaseName (const GLchar* name, GLsizei length)
+    {
+        return String::fromUTF8 (name, (int) length).upToFirstOccurrenceOf ("[", false, false);
+    }
+
+    static int getNumComponents (GLenum type) noexcept
+    {
+        switch (type)
+        {
+            case GL_FLOAT_VEC2: case GL_INT_VEC2:   return 2;
+            case GL_FLOAT_VEC3: case GL_INT_VEC3:   return 3;
+            case GL_FLOAT_VEC4: case GL_INT_VEC4:   return 4;
+            case GL_FLOAT_MAT2:                     return 4;
+            case GL_FLOAT_MAT3:                     return 9;
+            case GL_FLOAT_MAT4:                     return 16;
+            default:                                return 1;
+        }
+    }
+
+    static bool isIntegerType (GLenum type) noexcept
+    {
+        switch (type)
+        {
+            case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+            case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_CUBE: case GL_SAMPLER_2D_ARRAY:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    std::vector<Uniform> uniforms;
+    std::vector<Attribute> attributes;
+    std::vector<Block> blocks;
+    std::vector<int> uniformIndexForID, dirtyUniforms;
+    std::vector<Word> values;
+};
+
+} // OpenGLUtil
@@ -0,0 +1,272 @@
+//
+//  VertexLayout.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "UniformRegistry.hpp"
+
+namespace OpenGLUtil
+{
+// Vertex Layout Descriptions ==================================================
+
+/** One vertex attribute as glVertexAttribPointer wants it. */
+struct VertexAttributeDescription
+{
+    GLuint location = 0;
+    GLint numComponents = 0;
+    GLenum type = 0;
+    GLboolean normalised = GL_FALSE;
+    size_t offset = 0;
+};
+
+/** The runtime view of a VertexLayout: what the VertexArrayCache needs to set
+    up a VAO and what a program's attributes are checked against. */
+struct VertexLayoutDescription
+{
+    GLsizei stride = 0;
+    const VertexAttributeDescription* attributes = nullptr;
+    size_t numAttributes = 0;
+
+    /** The same vertices with only the position, location 0, enabled, or
+        nullptr if there is no position. Depth-only passes draw through it so
+        they don't fetch anything else. */
+    const VertexLayoutDescription* positionOnly = nullptr;
+
+    /** Points the enabled attributes at the currently bound GL_ARRAY_BUFFER. */
+    void enable (OpenGLContext& context) const
+    {
+        for (size_t i = 0; i < numAttributes; ++i)
+        {
+            const auto& attribute = attributes[i];
+            context.extensions.glVertexAttribPointer (attribute.location, attribute.numComponents, attribute.type,
+                                                      attribute.normalised, stride, (const GLvoid*) attribute.offset);
+            context.extensions.glEnableVertexAttribArray (attribute.location);
+        }
+    }
+
+    /** True if every attribute the linked program reads is supplied by this
+        layout. Built-in inputs such as gl_VertexID are ignored. */
+    bool isCompatibleWith (const UniformRegistry& program) const
+    {
+        for (const auto& input : program.getAttributes())
+        {
+            if (input.name.startsWith ("gl_"))
+                continue;
+
+            bool isSupplied = false;
+
+            for (size_t i = 0; i < numAttributes; ++i)
+                isSupplied = isSupplied || (GLint) attributes[i].location == input.location;
+
+            if (! isSupplied)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+
+/** Maps C++ component types to GL type tokens. */
+template <typename ComponentType> struct VertexComponentType;
+template <> struct VertexComponentType<GLfloat>  { static constexpr GLenum value = GL_FLOAT; };
+template <> struct VertexComponentType<GLbyte>   { static constexpr GLenum value = GL_BYTE; };
+template <> struct VertexComponentType<GLubyte>  { static constexpr GLenum value = GL_UNSIGNED_BYTE; };
+template <> struct VertexComponentType<GLshort>  { static constexpr GLenum value = GL_SHORT; };
+template <> struct VertexComponentType<GLushort> { static constexpr GLenum value = GL_UNSIGNED_SHORT; };
+
+
+/** A vertex attribute at a fixed shader location. With `normalised`, integer
+    components are mapped to [0, 1] or [-1, 1] as they are read. */
+template <GLuint location, typename ComponentType, int numComponents, bool normalised = false>
+struct VertexAttribute
+{
+    static_assert (numComponents >= 1 && numComponents <= 4, "Attributes have 1 to 4 components");
+
+    static constexpr size_t size = sizeof (ComponentType) * (size_t) numComponents;
+
+    static constexpr VertexAttributeDescription describe (size_t offset)
+    {
+        return { location, numComponents, VertexComponentType<ComponentType>::value,
+                 (GLboolean) (normalised ? GL_TRUE : GL_FALSE), offset };
+    }
+};
+
+
+/** Attributes start on 4 byte boundaries, which every driver handles well. */
+constexpr size_t alignVertexAttributeOffset (size_t offset)
+{
+    return (offset + 3) & ~(size_t) 3;
+}
+
+template <typename... Attributes>
+constexpr std::array<VertexAttributeDescription, sizeof... (Attributes)> makeVertexAttributeDescriptions()
+{
+    std::array<VertexAttributeDescription, sizeof... (Attributes)> descriptions {};
+    size_t index = 0, offset = 0;
+
+    ((descriptions[index++] = Attributes::describe (offset),
+      offset = alignVertexAttributeOffset (offset + Attributes::size)), ...);
+
+    return descriptions;
+}
+
+
+/** An interleaved vertex format, described entirely at compile time:
+
+    @code
+    using Layout = VertexLayout<VertexAttribute<0, GLfloat, 3>,           // position
+                                VertexAttribute<1, GLbyte, 4, true>>;     // normal
+    static_assert (sizeof (MyVertex) == Layout::stride, "Layout doesn't match MyVertex");
+    static_assert (Layout::hasOffsets ({ offsetof (MyVertex, position), offsetof (MyVertex, normal) }),
+                   "Attributes don't match MyVertex's fields");
+    @endcode
+
+    Offsets and the stride are constants, so setting up a VAO is a fixed
+    sequence of glVertexAttribPointer calls with nothing computed at runtime.
+ */
+template <typename... Attributes>
+struct VertexLayout
+{
+    static constexpr size_t numAttributes = sizeof... (Attributes);
+    static constexpr std::array<VertexAttributeDescription, numAttributes> attributes
+        = makeVertexAttributeDescriptions<Attributes...>();
+    static constexpr GLsizei stride = (GLsizei) (alignVertexAttributeOffset (Attributes::size) + ...);
+
+    /** True if the attributes start at exactly these offsets, in order. With
+        offsetof, this catches vertex structs whose fields are in a different
+        order from the layout's attributes, which the stride alone can't. */
+    static constexpr bool hasOffsets (std::initializer_list<size_t> offsets)
+    {
+        if (offsets.size() != numAttributes)
+            return false;
+
+        size_t index = 0;
+
+        for (auto offset : offsets)
+            if (attributes[index++].offset != offset)
+                return false;
+
+        return true;
+    }
+
+    /** One instance per layout type, so its address also identifies the layout. */
+    static const VertexLayoutDescription& getDescription()
+    {
+        // Layouts list the position first, if they have one
+        constexpr bool hasPosition = numAttributes > 0 && attributes[0].location == 0;
+
+        static const VertexLayoutDescription positionOnly { stride, attributes.data(), 1 };
+        static const VertexLayoutDescription description { stride, attributes.data(), numAttributes,
+                                                           hasPosition ? &positionOnly : nullptr };
+        return description;
+    }
+};
+
+
+// Vertex Array Cache ==========================================================
+
+/** Owns one VAO per combination of vertex layout and buffers, created the
+    first time it is asked for. Binding a mesh is then a single
+    glBindVertexArray, however often meshes are switched.
+
+    Shaders fix their attribute locations with layout (location = N), so a VAO
+    works with every program whose inputs its layout supplies; check that with
+    VertexLayoutDescription::isCompatibleWith() when a program links.
+ */
+class VertexArrayCache
+{
+public:
+    VertexArrayCache() = default;
+
+    ~VertexArrayCache()
+    {
+        // You must call release() while the context is still active
+        jassert (vertexArrays.empty());
+    }
+
+    /** Returns the VAO for the layout and buffers, creating it if needed. */
+    GLuint get (OpenGLContext& context, const VertexLayoutDescription& layout,
+                GLuint vertexBufferID, GLuint indexBufferID = 0)
+    {
+        const Key key { &layout, vertexBufferID, indexBufferID };
+        auto existing = vertexArrays.find (key);
+
+        if (existing != vertexArrays.end())
+            return existing->second;
+
+        GLuint vertexArrayID = 0;
+        context.extensions.glGenVertexArrays (1, &vertexArrayID);
+        context.extensions.glBindVertexArray (vertexArrayID);
+
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBufferID);
+        layout.enable (context);
+
+        // The element buffer binding is part of the VAO's state
+        if (indexBufferID != 0)
+            context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+
+        context.extensions.glBindVertexArray (0);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+
+        vertexArrays[key] = vertexArrayID;
+        return vertexArrayID;
+    }
+
+    template <typename Layout>
+    GLuint get (OpenGLContext& context, GLuint vertexBufferID, GLuint indexBufferID = 0)
+    {
+        return get (context, Layout::getDescription(), vertexBufferID, indexBufferID);
+    }
+
+    /** Deletes every VAO that refers to the buffer. Call this before deleting
+        the buffer itself. */
+    void releaseBuffer (OpenGLContext& context, GLuint bufferID)
+    {
+        for (auto it = vertexArrays.begin(); it != vertexArrays.end();)
+        {
+            if (it->first.vertexBufferID == bufferID || it->first.indexBufferID == bufferID)
+            {
+                context.extensions.glDeleteVertexArrays (1, &it->second);
+                it = vertexArrays.erase (it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void release (OpenGLContext& context)
+    {
+        for (auto& entry : vertexArrays)
+            context.extensions.glDeleteVertexArrays (1, &entry.second);
+
+        vertexArrays.clear();
+    }
+
+    int size() const noexcept   { return (int) vertexArrays.size(); }
+
+private:
+    struct Key
+    {
+        const VertexLayoutDescription* layout;
+        GLuint vertexBufferID, indexBufferID;
+
+        bool operator< (const Key& other) const noexcept
+        {
+            return std::tie (layout, vertexBufferID, indexBufferID)
+                 < std::tie (other.layout, other.vertexBufferID, other.indexBufferID);
+        }
+    };
+
+    std::map<Key, GLuint> vertexArrays;
+
+    JUCE_DECLARE_NON_COPYABLE (VertexArrayCache)
+};
+
+} // OpenGLUtil
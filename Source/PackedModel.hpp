@@ -0,0 +1,140 @@
+//
+//  PackedModel.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "OpenGLUtil/WavefrontObjFile.hpp"
+#include "OpenGLUtil/TextureArrayPacker.hpp"
+#include "OpenGLUtil/TextureStreamer.hpp"
+#include "Rendering/DrawCommandList.hpp"
+#include "VertexFormats.hpp"
+
+/** A Wavefront OBJ model prepared for drawing with as few binds and draws as
+    possible.
+
+    Materials without a diffuse texture get a single pixel layer of their
+    diffuse colour in a texture array, and all of their shapes are merged
+    into one batch, with the layer stored as the third texture coordinate of
+    each vertex. Textured shapes are merged the same way, with each texture
+    file a layer of a streamed array. The files aren't read here, but left
+    for the renderer to request with TextureStreamer::requestArray(), so
+    loading a model never waits for its images.
+ */
+struct PackedModel
+{
+    using Vertex = VertexFormats::PositionNormalLayeredTexture;
+
+    /** Texture files are scaled to this size so that they fit an array. */
+    static constexpr int textureLayerSize = 512;
+
+    /** About 90 MB of mip chains at the layer size, so one array never takes
+        up much of the streamer's residency cap. */
+    static constexpr int maxLayersPerStreamedArray = 64;
+
+    /** The texture files of one array, streamed in by the renderer. */
+    struct StreamedArray
+    {
+        std::vector<OpenGLUtil::TextureStreamer::ArrayLayer> layers;
+
+        // Assigned by the renderer when it requests the array
+        OpenGLUtil::TextureStreamer::TextureID texture = 0;
+    };
+
+    struct Batch
+    {
+        int textureArray = -1;      // In `textures`, for the untextured materials
+        int streamedArray = -1;     // In `streamedArrays`, for the textured ones
+        std::vector<Vertex> vertices; // Triangles, not indexed
+
+        // Assigned by the renderer when the model is added to the scene
+        Rendering::MeshID mesh = 0;
+        Rendering::MaterialID material = 0;
+        GLuint vertexBufferID = 0;
+
+        /** Expands the mesh's indexed triangles into this batch. */
+        void appendTriangles (const WavefrontObjFile::Mesh& mesh, GLfloat layer)
+        {
+            for (auto index : mesh.indices)
+            {
+                const int i = (int) index;
+                const auto& position = mesh.vertices.getReference (i);
+                const auto normal = i < mesh.normals.size() ? mesh.normals[i] : WavefrontObjFile::Vertex { 0.0f, 0.0f, 1.0f };
+                const auto textureCoordinate = i < mesh.textureCoords.size() ? mesh.textureCoords[i] : WavefrontObjFile::TextureCoord { 0.5f, 0.5f };
+
+                vertices.push_back ({ { position.x, position.y, position.z },
+                                      { normal.x, normal.y, normal.z },
+                                      { textureCoordinate.x, textureCoordinate.y, layer } });
+            }
+        }
+    };
+
+    OpenGLUtil::TextureArrayPacker textures;
+    std::vector<StreamedArray> streamedArrays;
+    std::vector<Batch> batches;
+
+    /** Merges the shapes of a loaded OBJ file. Texture names are resolved
+        relative to `textureDirectory`, usually the folder of the OBJ file;
+        materials whose texture file is missing fall back to their colour. */
+    static std::unique_ptr<PackedModel> fromWavefrontFile (const WavefrontObjFile& objFile, const File& textureDirectory)
+    {
+        auto model = std::make_unique<PackedModel>();
+        std::map<String, std::pair<int, int>> filePlacements; // Path to streamed array and layer
+
+        for (auto* shape : objFile.shapes)
+        {
+            const auto& material = shape->material;
+            const auto colour = Colour::fromFloatRGBA (material.diffuse.x, material.diffuse.y, material.diffuse.z, 1.0f);
+
+            if (material.diffuseTextureName.isNotEmpty())
+            {
+                const auto textureFile = textureDirectory.getChildFile (material.diffuseTextureName);
+
+                if (textureFile.existsAsFile())
+                {
+                    const auto path = textureFile.getFullPathName();
+
+                    if (filePlacements.find (path) == filePlacements.end())
+                        filePlacements[path] = model->addStreamedLayer ({ textureFile, colour });
+
+                    const auto placement = filePlacements[path];
+                    model->getBatch (-1, placement.first).appendTriangles (shape->mesh, (GLfloat) placement.second);
+                    continue;
+                }
+
+                DBG ("Missing texture " + textureFile.getFullPathName());
+            }
+
+            const auto placement = model->textures.add (colour);
+            model->getBatch (placement.arrayIndex, -1).appendTriangles (shape->mesh, (GLfloat) placement.layer);
+        }
+
+        return model;
+    }
+
+private:
+    std::pair<int, int> addStreamedLayer (const OpenGLUtil::TextureStreamer::ArrayLayer& layer)
+    {
+        if (streamedArrays.empty() || (int) streamedArrays.back().layers.size() >= maxLayersPerStreamedArray)
+            streamedArrays.emplace_back();
+
+        streamedArrays.back().layers.push_back (layer);
+        return { (int) streamedArrays.size() - 1, (int) streamedArrays.back().layers.size() - 1 };
+    }
+
+    Batch& getBatch (int textureArray, int streamedArray)
+    {
+        for (auto& batch : batches)
+            if (batch.textureArray == textureArray && batch.streamedArray == streamedArray)
+                return batch;
+
+        batches.emplace_back();
+        batches.back().textureArray = textureArray;
+        batches.back().streamedArray = streamedArray;
+        return batches.back();
+    }
+};
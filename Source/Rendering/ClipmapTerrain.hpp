@@ -0,0 +1,489 @@
+//
+//  ClipmapTerrain.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/AsyncShaderProgram.hpp"
+#include "../OpenGLUtil/VertexLayout.hpp"
+#include "../ShaderUniformBlocks.hpp"
+
+namespace Rendering
+{
+
+/** Supplies heights to a ClipmapTerrain. Coordinates are in samples of the
+    given level, where level L has 2^L times the spacing of level 0, and
+    sample (0, 0) lies at the world origin for every level. */
+class HeightSource
+{
+public:
+    virtual ~HeightSource() = default;
+
+    /** Writes `width` x `depth` heights, in world units, row by row along x.
+        Called on the OpenGL thread. */
+    virtual void readHeights (int level, int64 x, int64 z, int width, int depth, float* heights) = 0;
+};
+
+
+/** Heights from a headerless file of 16 bit unsigned little-endian samples,
+    e.g. a RAW export from a terrain tool, centred on the world origin. The
+    file is memory-mapped, so only the parts the terrain actually samples are
+    read from disk. Coarser levels point sample every 2^L samples, which is
+    cheap but may alias on rough terrain.
+ */
+class MappedHeightfield : public HeightSource
+{
+public:
+    Result open (const File& rawFile, int widthToUse, int depthToUse, float heightScaleToUse)
+    {
+        if (widthToUse <= 0 || depthToUse <= 0)
+            return Result::fail ("The heightfield needs a size");
+
+        mappedFile = std::make_unique<MemoryMappedFile> (rawFile, MemoryMappedFile::readOnly);
+        samples = static_cast<const uint8*> (mappedFile->getData());
+
+        if (samples == nullptr || mappedFile->getSize() < (size_t) widthToUse * (size_t) depthToUse * 2)
+        {
+            mappedFile.reset();
+            samples = nullptr;
+            return Result::fail (rawFile.getFileName() + " is missing or smaller than "
+                                 + String (widthToUse) + " x " + String (depthToUse) + " 16 bit samples");
+        }
+
+        width = widthToUse;
+        depth = depthToUse;
+        heightScale = heightScaleToUse / 65535.0f;
+        return Result::ok();
+    }
+
+    void readHeights (int level, int64 x, int64 z, int numColumns, int numRows, float* heights) override
+    {
+        jassert (samples != nullptr);
+        const int64 step = (int64) 1 << level;
+
+        for (int row = 0; row < numRows; ++row)
+        {
+            // Outside the file, the edge samples carry on
+            const int64 sourceZ = jlimit ((int64) 0, (int64) depth - 1, (z + row) * step + depth / 2);
+            const auto* sourceRow = samples + (size_t) sourceZ * (size_t) width * 2;
+
+            for (int column = 0; column < numColumns; ++column)
+            {
+                const int64 sourceX = jlimit ((int64) 0, (int64) width - 1, (x + column) * step + width / 2);
+                const auto* sample = sourceRow + sourceX * 2;
+                *heights++ = heightScale * (float) (sample[0] | (sample[1] << 8));
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    const uint8* samples = nullptr;
+    int width = 0, depth = 0;
+    float heightScale = 1.0f;
+};
+
+
+//==============================================================================
+/** Draws a heightfield of any size around the camera as a geometry clipmap.
+
+    The terrain is a stack of levels, each a square grid of `gridSize` cells
+    centred on the camera, with twice the cell size of the level inside it.
+    Every level draws the same vertex buffer: a grid of integer vertex
+    coordinates that the vertex shader scales and offsets. The finest level
+    draws it whole; the others draw it as a ring with a hole where the next
+    finer level is. The hole sits one cell off centre on either axis
+    depending on the camera, so there are four ring index ranges. All of them
+    and the full grid share one index buffer.
+
+    Each level's heights live in one layer of a texture array, addressed
+    toroidally: the sample at (x, z) is always stored at texel (x mod size,
+    z mod size). When the camera moves, a level's window of samples slides
+    and only the rows and columns that enter it are read and uploaded. The
+    rest of the texture stays where it is.
+
+    Near its outer edge each level blends its heights into the next coarser
+    level's, so the levels meet without cracks or popping.
+ */
+class ClipmapTerrain
+{
+public:
+    /** Cells along each side of a level. A multiple of 4, so the finer level
+        covers exactly half of it, and small enough for 16 bit indices. */
+    static constexpr int gridSize = 252;
+
+    /** Samples along each side of a level's texture. Covers the grid plus one
+        sample each side for normals. */
+    static constexpr int textureSize = 256;
+
+    struct Statistics
+    {
+        int numLevels = 0;
+        int64 numSamplesUploaded = 0;   // During the last update
+        double uploadTimeMs = 0;
+
+        String toString() const
+        {
+            return "Terrain: " + String (numLevels) + " levels, " + String (numSamplesUploaded)
+                 + " samples uploaded in " + String (uploadTimeMs, 2) + " ms";
+        }
+    };
+
+    ClipmapTerrain() = default;
+
+    ~ClipmapTerrain()
+    {
+        // You must call release() while the context is still active
+        jassert (heightTextureID == 0);
+    }
+
+    /** Sets the heights to draw, the world distance between samples of the
+        finest level, and how many levels to draw. Takes effect from the
+        next create(). */
+    void setSource (std::shared_ptr<HeightSource> newSource, float sampleSpacingToUse, int numLevelsToUse)
+    {
+        jassert (numLevelsToUse > 0 && sampleSpacingToUse > 0.0f);
+
+        source = std::move (newSource);
+        sampleSpacing = sampleSpacingToUse;
+        levels.assign ((size_t) numLevelsToUse, {});
+    }
+
+    bool hasSource() const noexcept     { return source != nullptr; }
+
+    /** Creates the grid, the height textures and starts compiling the
+        shaders. Heights are read in by the first update(). */
+    void create (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        release (context);
+
+        createGrid (context);
+
+        glGenTextures (1, &heightTextureID);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, heightTextureID);
+        functions.glTexImage3D (GL_TEXTURE_2D_ARRAY, 0, GL_R32F, textureSize, textureSize, (GLsizei) levels.size(),
+                                0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri (GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+
+        for (auto& level : levels)
+            level.isValid = false;
+
+        program.compile (context, functions, BinaryData::TerrainVertex_glsl, BinaryData::TerrainFragment_glsl);
+        hasReflectedUniforms = false;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        program.release (context);
+
+        if (heightTextureID != 0)
+            glDeleteTextures (1, &heightTextureID);
+
+        if (vertexArrayID != 0)
+            context.extensions.glDeleteVertexArrays (1, &vertexArrayID);
+
+        for (auto* bufferID : { &vertexBufferID, &indexBufferID })
+            if (*bufferID != 0)
+                context.extensions.glDeleteBuffers (1, bufferID);
+
+        heightTextureID = vertexArrayID = vertexBufferID = indexBufferID = 0;
+    }
+
+    bool isCreated() const noexcept     { return heightTextureID != 0; }
+
+    //==============================================================================
+    /** Centres the levels on the camera and uploads the samples that have
+        come into view since the last call. */
+    void update (const OpenGLUtil::CoreProfileFunctions& functions, const Vector3D<GLfloat>& cameraPosition)
+    {
+        jassert (isCreated() && hasSource());
+
+        const auto startTime = Time::getMillisecondCounterHiRes();
+        numSamplesUploaded = 0;
+
+        glBindTexture (GL_TEXTURE_2D_ARRAY, heightTextureID);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+
+        for (int index = 0; index < (int) levels.size(); ++index)
+        {
+            auto& level = levels[(size_t) index];
+            const double spacing = getSpacing (index);
+
+            // Snapped to every other sample, so each level's vertices land on the coarser level's
+            level.originX = 2 * (int64) std::floor (cameraPosition.x / (2.0 * spacing)) - gridSize / 2;
+            level.originZ = 2 * (int64) std::floor (cameraPosition.z / (2.0 * spacing)) - gridSize / 2;
+            level.viewerX = (float) (cameraPosition.x / spacing - (double) level.originX);
+            level.viewerZ = (float) (cameraPosition.z / spacing - (double) level.originZ);
+
+            updateWindow (functions, index, level.originX - 1, level.originZ - 1);
+        }
+
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei (GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei (GL_UNPACK_SKIP_ROWS, 0);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics.numLevels = (int) levels.size();
+        statistics.numSamplesUploaded = numSamplesUploaded;
+        statistics.uploadTimeMs = Time::getMillisecondCounterHiRes() - startTime;
+    }
+
+    /** Draws every level with the camera from the CameraUniforms block at
+        `cameraBindingPoint`. Needs depth testing enabled to look right.
+        Draws nothing until the shaders have linked. */
+    void render (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions, GLuint cameraBindingPoint)
+    {
+        if (program.update (context) != OpenGLUtil::AsyncShaderProgram::State::linked)
+            return;
+
+        auto& uniforms = program.getUniforms();
+
+        if (! hasReflectedUniforms)
+        {
+            uniforms.reflect (context, functions, program.getProgramID());
+            uniforms.bindBlock (functions, program.getProgramID(), "CameraUniforms",
+                                cameraBindingPoint, sizeof (ShaderUniformBlocks::CameraUniforms));
+            uniforms.set (heightsUniform, 0);
+            uniforms.set (gridSizeUniform, (GLfloat) gridSize);
+            hasReflectedUniforms = true;
+        }
+
+        program.use (context);
+        context.extensions.glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, heightTextureID);
+        context.extensions.glBindVertexArray (vertexArrayID);
+
+        for (int index = 0; index < (int) levels.size(); ++index)
+        {
+            const auto& level = levels[(size_t) index];
+            const double spacing = getSpacing (index);
+            const bool hasCoarserLevel = index + 1 < (int) levels.size();
+
+            uniforms.set (levelUniform, (GLint) index);
+            uniforms.set (spacingUniform, (GLfloat) spacing);
+            uniforms.set (levelOriginUniform, { (GLfloat) ((double) level.originX * spacing),
+                                                (GLfloat) ((double) level.originZ * spacing) });
+            uniforms.set (textureOffsetUniform, { (GLfloat) wrap (level.originX), (GLfloat) wrap (level.originZ) });
+            uniforms.set (coarserTextureOffsetUniform, { (GLfloat) wrap (level.originX / 2), (GLfloat) wrap (level.originZ / 2) });
+            uniforms.set (viewerPositionUniform, { level.viewerX, level.viewerZ });
+            uniforms.set (hasCoarserLevelUniform, (GLint) (hasCoarserLevel ? 1 : 0));
+            uniforms.upload (context);
+
+            // The finest level fills the hole in the middle of this one
+            IndexRange range = fullGrid;
+
+            if (index > 0)
+            {
+                const auto& finer = levels[(size_t) index - 1];
+                const int holeX = (int) (finer.originX / 2 - level.originX) - gridSize / 4;
+                const int holeZ = (int) (finer.originZ / 2 - level.originZ) - gridSize / 4;
+                jassert (isPositiveAndBelow (holeX, 2) && isPositiveAndBelow (holeZ, 2));
+
+                range = rings[holeZ * 2 + holeX];
+            }
+
+            glDrawElements (GL_TRIANGLES, range.numIndices, GL_UNSIGNED_SHORT,
+                            (const GLvoid*) (sizeof (GLushort) * (size_t) range.firstIndex));
+        }
+
+        context.extensions.glBindVertexArray (0);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    struct Level
+    {
+        int64 originX = 0, originZ = 0;     // Sample at the grid's first vertex
+        int64 windowX = 0, windowZ = 0;     // First sample held in the texture
+        float viewerX = 0, viewerZ = 0;     // Camera, in grid cells from the first vertex
+        bool isValid = false;
+    };
+
+    struct IndexRange
+    {
+        GLsizei firstIndex = 0, numIndices = 0;
+    };
+
+    double getSpacing (int level) const noexcept    { return (double) sampleSpacing * (double) (1 << level); }
+
+    static int wrap (int64 sample) noexcept
+    {
+        return (int) (((sample % textureSize) + textureSize) % textureSize);
+    }
+
+    /** Builds the shared grid and its five index ranges: the full grid, then
+        the ring with its hole offset by (0, 0), (1, 0), (0, 1) and (1, 1). */
+    void createGrid (OpenGLContext& context)
+    {
+        constexpr int row = gridSize + 1;
+        static_assert (row * row <= 65536, "The grid must be indexable with 16 bits");
+
+        std::vector<GLfloat> vertices;
+        vertices.reserve ((size_t) (row * row * 2));
+
+        for (int z = 0; z <= gridSize; ++z)
+        {
+            for (int x = 0; x <= gridSize; ++x)
+            {
+                vertices.push_back ((GLfloat) x);
+                vertices.push_back ((GLfloat) z);
+            }
+        }
+
+        std::vector<GLushort> indices;
+
+        auto addCells = [&] (int holeX, int holeZ)
+        {
+            IndexRange range;
+            range.firstIndex = (GLsizei) indices.size();
+
+            const int holeStart = gridSize / 4, holeEnd = holeStart + gridSize / 2;
+
+            for (int z = 0; z < gridSize; ++z)
+            {
+                for (int x = 0; x < gridSize; ++x)
+                {
+                    if (holeX >= 0 && x >= holeStart + holeX && x < holeEnd + holeX
+                                   && z >= holeStart + holeZ && z < holeEnd + holeZ)
+                        continue;
+
+                    // Counter-clockwise seen from above
+                    const auto corner = (GLushort) (z * row + x);
+                    const GLushort cell[6] = { corner, (GLushort) (corner + row), (GLushort) (corner + row + 1),
+                                               corner, (GLushort) (corner + row + 1), (GLushort) (corner + 1) };
+                    indices.insert (indices.end(), std::begin (cell), std::end (cell));
+                }
+            }
+
+            range.numIndices = (GLsizei) indices.size() - range.firstIndex;
+            return range;
+        };
+
+        fullGrid = addCells (-1, -1);
+
+        for (int i = 0; i < 4; ++i)
+            rings[i] = addCells (i & 1, i >> 1);
+
+        context.extensions.glGenVertexArrays (1, &vertexArrayID);
+        context.extensions.glBindVertexArray (vertexArrayID);
+
+        context.extensions.glGenBuffers (1, &vertexBufferID);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBufferID);
+        context.extensions.glBufferData (GL_ARRAY_BUFFER, (GLsizeiptr) (sizeof (GLfloat) * vertices.size()),
+                                         vertices.data(), GL_STATIC_DRAW);
+
+        context.extensions.glGenBuffers (1, &indexBufferID);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+        context.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) (sizeof (GLushort) * indices.size()),
+                                         indices.data(), GL_STATIC_DRAW);
+
+        GridLayout::getDescription().enable (context);
+
+        context.extensions.glBindVertexArray (0);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    /** Slides a level's window of samples to start at (x, z), uploading only
+        the columns and rows that weren't in it before. */
+    void updateWindow (const OpenGLUtil::CoreProfileFunctions& functions, int index, int64 x, int64 z)
+    {
+        auto& level = levels[(size_t) index];
+        const int64 dx = x - level.windowX, dz = z - level.windowZ;
+
+        if (level.isValid && dx == 0 && dz == 0)
+            return;
+
+        if (! level.isValid || std::abs (dx) >= textureSize || std::abs (dz) >= textureSize)
+        {
+            uploadRegion (functions, index, x, z, textureSize, textureSize);
+        }
+        else
+        {
+            if (dx != 0)
+                uploadRegion (functions, index, dx > 0 ? level.windowX + textureSize : x, z, (int) std::abs (dx), textureSize);
+
+            if (dz != 0)
+                uploadRegion (functions, index, x, dz > 0 ? level.windowZ + textureSize : z, textureSize, (int) std::abs (dz));
+        }
+
+        level.windowX = x;
+        level.windowZ = z;
+        level.isValid = true;
+    }
+
+    /** Reads a rectangle of samples and writes it to the level's layer,
+        split where it wraps around the edges of the texture. */
+    void uploadRegion (const OpenGLUtil::CoreProfileFunctions& functions, int index,
+                       int64 x, int64 z, int numColumns, int numRows)
+    {
+        staging.resize ((size_t) (numColumns * numRows));
+        source->readHeights (index, x, z, numColumns, numRows, staging.data());
+        numSamplesUploaded += numColumns * numRows;
+
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, numColumns);
+
+        const int firstColumns = jmin (numColumns, textureSize - wrap (x));
+        const int firstRows = jmin (numRows, textureSize - wrap (z));
+
+        for (int part = 0; part < 4; ++part)
+        {
+            const bool isWrappedX = (part & 1) != 0, isWrappedZ = (part & 2) != 0;
+            const int partColumns = isWrappedX ? numColumns - firstColumns : firstColumns;
+            const int partRows = isWrappedZ ? numRows - firstRows : firstRows;
+
+            if (partColumns <= 0 || partRows <= 0)
+                continue;
+
+            glPixelStorei (GL_UNPACK_SKIP_PIXELS, isWrappedX ? firstColumns : 0);
+            glPixelStorei (GL_UNPACK_SKIP_ROWS, isWrappedZ ? firstRows : 0);
+            functions.glTexSubImage3D (GL_TEXTURE_2D_ARRAY, 0, isWrappedX ? 0 : wrap (x), isWrappedZ ? 0 : wrap (z), index,
+                                       partColumns, partRows, 1, GL_RED, GL_FLOAT, staging.data());
+        }
+    }
+
+    using GridLayout = OpenGLUtil::VertexLayout<OpenGLUtil::VertexAttribute<0, GLfloat, 2>>;
+
+    std::shared_ptr<HeightSource> source;
+    float sampleSpacing = 1.0f;
+    std::vector<Level> levels;
+    std::vector<float> staging;
+    int64 numSamplesUploaded = 0;
+
+    GLuint heightTextureID = 0, vertexArrayID = 0, vertexBufferID = 0, indexBufferID = 0;
+    IndexRange fullGrid, rings[4];
+
+    OpenGLUtil::AsyncShaderProgram program;
+    const OpenGLUtil::UniformHandle<GLint> heightsUniform { "heights" };
+    const OpenGLUtil::UniformHandle<GLint> levelUniform { "level" };
+    const OpenGLUtil::UniformHandle<GLfloat> spacingUniform { "spacing" };
+    const OpenGLUtil::UniformHandle<GLfloat> gridSizeUniform { "gridSize" };
+    const OpenGLUtil::UniformHandle<Point<GLfloat>> levelOriginUniform { "levelOrigin" };
+    const OpenGLUtil::UniformHandle<Point<GLfloat>> textureOffsetUniform { "textureOffset" };
+    const OpenGLUtil::UniformHandle<Point<GLfloat>> coarserTextureOffsetUniform { "coarserTextureOffset" };
+    const OpenGLUtil::UniformHandle<Point<GLfloat>> viewerPositionUniform { "viewerPosition" };
+    const OpenGLUtil::UniformHandle<GLint> hasCoarserLevelUniform { "hasCoarserLevel" };
+    bool hasReflectedUniforms = false;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE (ClipmapTerrain)
+};
+
+} // namespace Rendering
@@ -0,0 +1,260 @@
+//
+//  DepthPrePass.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/GpuQueryRing.hpp"
+
+namespace Rendering
+{
+
+/** Decides, frame by frame, whether the opaque pass draws depth first, and
+    measures what that decision costs.
+
+    With the pre-pass, opaque geometry is drawn twice: once writing depth
+    only, from the positions alone, then shaded with GL_EQUAL so that every
+    pixel is shaded exactly once. Without it, opaque draws are sorted front
+    to back and overdraw is whatever early depth testing fails to reject.
+    The pre-pass wins when the fragments it saves cost more than drawing the
+    geometry again.
+
+    In automatic mode both sides of that are measured with GPU queries:
+    - Shading without the pre-pass: the samples shaded and the time taken,
+      which give the cost per fragment.
+    - Shading with it: the samples shaded, i.e. the visible ones, and the
+      time the depth-only pass took.
+    The overdraw is the ratio of the two sample counts. Every so often a
+    frame is drawn the other way, so that the side not in use stays measured
+    as the view changes. Results arrive a few frames late, but the scene
+    rarely changes faster than that.
+ */
+class DepthPrePass
+{
+public:
+    enum class Mode
+    {
+        off,
+        on,
+        automatic
+    };
+
+    struct Statistics
+    {
+        Mode mode = Mode::automatic;
+        bool isActive = false;
+        float overdraw = 0;                 // Samples shaded without the pre-pass per visible sample, 0 until measured
+        float fragmentCostNs = 0;           // GPU time per shaded sample without the pre-pass
+        float depthPassMs = 0, shadingPassMs = 0;
+
+        String toString() const
+        {
+            String text = "Depth pre-pass: " + String (isActive ? "on" : "off")
+                        + String (mode == Mode::automatic ? " (auto)" : "");
+
+            if (overdraw > 0)
+                text << ", overdraw " << String (overdraw, 2) << "x";
+
+            if (fragmentCostNs > 0)
+                text << ", " << String (fragmentCostNs, 3) << " ns/fragment";
+
+            if (shadingPassMs > 0)
+                text << ", depth " << String (depthPassMs, 2) << " ms + shading " << String (shadingPassMs, 2) << " ms";
+
+            return text;
+        }
+    };
+
+    DepthPrePass() = default;
+
+    void setMode (Mode newMode) noexcept            { mode = newMode; }
+    Mode getMode() const noexcept                   { return mode; }
+
+    void release (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        queries.release (functions);
+        hasMeasuredPrePass = hasMeasuredDirect = false;
+    }
+
+    //==============================================================================
+    /** Takes in the measurements that have arrived and decides whether this
+        frame uses the pre-pass. Call before recording draws, because the
+        opaque sort order depends on it. */
+    bool beginFrame (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (! hasCheckedTimerQueries)
+        {
+            canTime = OpenGLUtil::GpuQueryRing<numQueries>::isTimerQuerySupported (functions);
+            hasCheckedTimerQueries = true;
+        }
+
+        queries.collect (functions, [this] (const Queries::Results& results) { addMeasurement (results); });
+
+        const Mode currentMode = mode;
+
+        if (currentMode != Mode::automatic)
+            isActive = currentMode == Mode::on;
+        else if (! hasMeasuredDirect || ! hasMeasuredPrePass)
+            isActive = hasMeasuredDirect; // Measure each way once before choosing
+        else
+        {
+            preferPrePass = isPrePassCheaper();
+            const bool isProbe = ++framesSinceProbe >= framesBetweenProbes;
+
+            if (isProbe)
+                framesSinceProbe = 0;
+
+            isActive = isProbe ? ! preferPrePass : preferPrePass;
+        }
+
+        queries.beginFrame (functions, isActive ? prePassTag : directTag);
+        updateStatistics (currentMode);
+        return isActive;
+    }
+
+    bool isActiveThisFrame() const noexcept         { return isActive; }
+
+    /** Bracket the depth-only draws. */
+    void beginDepthPass (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (canTime)
+            queries.begin (functions, depthTimeQuery, GL_TIME_ELAPSED);
+    }
+
+    void endDepthPass (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (canTime)
+            queries.end (functions, GL_TIME_ELAPSED);
+    }
+
+    /** Bracket the shaded opaque draws. */
+    void beginShadingPass (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        queries.begin (functions, samplesQuery, GL_SAMPLES_PASSED);
+
+        if (canTime)
+            queries.begin (functions, shadingTimeQuery, GL_TIME_ELAPSED);
+    }
+
+    void endShadingPass (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (canTime)
+            queries.end (functions, GL_TIME_ELAPSED);
+
+        queries.end (functions, GL_SAMPLES_PASSED);
+    }
+
+    /** Call once per beginFrame(), after the opaque draws. */
+    void endFrame()
+    {
+        queries.endFrame();
+    }
+
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    static constexpr int numQueries = 3;
+    using Queries = OpenGLUtil::GpuQueryRing<numQueries>;
+
+    enum QueryIndex { samplesQuery, shadingTimeQuery, depthTimeQuery };
+    enum FrameTag : uint32 { directTag, prePassTag };
+
+    void addMeasurement (const Queries::Results& results)
+    {
+        const bool isPrePass = results.tag == prePassTag;
+
+        // Frames with nothing opaque skip the depth pass, and would average in zeros
+        if (! results.wasMeasured (samplesQuery))
+            return;
+
+        if (canTime && (! results.wasMeasured (shadingTimeQuery) || (isPrePass && ! results.wasMeasured (depthTimeQuery))))
+            return;
+
+        const float samples = (float) results.values[samplesQuery];
+        const float shadingNs = (float) results.values[shadingTimeQuery];
+
+        if (isPrePass)
+        {
+            visibleSamples = smooth (visibleSamples, samples, hasMeasuredPrePass);
+            prePassShadingNs = smooth (prePassShadingNs, shadingNs, hasMeasuredPrePass);
+            depthPassNs = smooth (depthPassNs, (float) results.values[depthTimeQuery], hasMeasuredPrePass);
+            hasMeasuredPrePass = true;
+        }
+        else
+        {
+            directSamples = smooth (directSamples, samples, hasMeasuredDirect);
+            directShadingNs = smooth (directShadingNs, shadingNs, hasMeasuredDirect);
+            hasMeasuredDirect = true;
+        }
+    }
+
+    /** An exponential moving average, so one noisy frame can't flip the mode. */
+    static float smooth (float average, float value, bool hasAverage) noexcept
+    {
+        return hasAverage ? average + 0.2f * (value - average) : value;
+    }
+
+    float getOverdraw() const noexcept              { return directSamples / jmax (1.0f, visibleSamples); }
+    float getFragmentCostNs() const noexcept        { return directShadingNs / jmax (1.0f, directSamples); }
+
+    bool isPrePassCheaper() const noexcept
+    {
+        // Without timers all we know is the overdraw
+        if (! canTime)
+            return getOverdraw() > overdrawThreshold;
+
+        const float savedNs = jmax (0.0f, directSamples - visibleSamples) * getFragmentCostNs();
+
+        // Some hysteresis, so a scene near the break-even point doesn't flip every probe
+        return savedNs > depthPassNs * (preferPrePass ? 0.9f : 1.1f);
+    }
+
+    void updateStatistics (Mode currentMode)
+    {
+        Statistics newStatistics;
+        newStatistics.mode = currentMode;
+        newStatistics.isActive = isActive;
+
+        if (hasMeasuredDirect && hasMeasuredPrePass)
+            newStatistics.overdraw = getOverdraw();
+
+        if (canTime && hasMeasuredDirect)
+            newStatistics.fragmentCostNs = getFragmentCostNs();
+
+        if (canTime && (isActive ? hasMeasuredPrePass : hasMeasuredDirect))
+        {
+            newStatistics.depthPassMs = isActive ? depthPassNs * 1.0e-6f : 0.0f;
+            newStatistics.shadingPassMs = (isActive ? prePassShadingNs : directShadingNs) * 1.0e-6f;
+        }
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics = newStatistics;
+    }
+
+    static constexpr int framesBetweenProbes = 30;
+    static constexpr float overdrawThreshold = 1.5f;
+
+    std::atomic<Mode> mode { Mode::automatic };
+    Queries queries;
+    bool canTime = false, hasCheckedTimerQueries = false;
+    bool isActive = false, preferPrePass = false, hasMeasuredDirect = false, hasMeasuredPrePass = false;
+    int framesSinceProbe = 0;
+
+    float directSamples = 0, directShadingNs = 0;
+    float visibleSamples = 0, prePassShadingNs = 0, depthPassNs = 0;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE (DepthPrePass)
+};
+
+} // namespace Rendering
@@ -0,0 +1,317 @@
+//
+//  DrawCommandList.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Rendering
+{
+
+using MeshID = uint32;
+using MaterialID = uint32;
+
+/** Builds the 64 bit keys that order draw commands. Sorting by key submits
+    the passes in order and, within the opaque pass, groups draws by program,
+    material and mesh so that state changes as rarely as possible, nearest
+    first within each group so early depth testing rejects more fragments.
+    Without a depth pre-pass, overdraw matters more than state changes, so
+    opaque draws can instead be sorted front to back across all groups.
+    Transparent draws must blend back to front, so for them depth comes first,
+    unless they are blended order-independently (see WeightedBlendedOIT), in
+    which case they group by state like opaque draws and depth is left out.
+
+    @code
+    Opaque:           pass:4 | program:8 | material:16 | mesh:12 | depth:24
+    Front to back:    pass:4 | depth:24 | program:8 | material:16 | mesh:12
+    Transparent:      pass:4 | depth:24 (inverted) | program:8 | material:16 | mesh:12
+    Weighted blended: pass:4 | program:8 | material:16 | mesh:12 | 0:24
+    @endcode
+ */
+struct SortKey
+{
+    enum Pass : uint32
+    {
+        opaquePass = 0,
+        transparentPass = 1
+    };
+
+    /** Maps view space distance in [nearPlane, farPlane] to 24 bits. */
+    static uint32 quantiseDepth (float distance, float nearPlane, float farPlane) noexcept
+    {
+        const float proportion = jlimit (0.0f, 1.0f, (distance - nearPlane) / (farPlane - nearPlane));
+        return (uint32) (proportion * (float) maxDepth);
+    }
+
+    static uint64 makeOpaque (uint32 program, MaterialID material, MeshID mesh, uint32 depth) noexcept
+    {
+        return ((uint64) opaquePass << 60) | (getProgramMaterialMesh (program, material, mesh) << 24) | (uint64) depth;
+    }
+
+    static uint64 makeOpaqueFrontToBack (uint32 program, MaterialID material, MeshID mesh, uint32 depth) noexcept
+    {
+        return ((uint64) opaquePass << 60) | ((uint64) depth << 36) | getProgramMaterialMesh (program, material, mesh);
+    }
+
+    static uint64 makeTransparent (uint32 program, MaterialID material, MeshID mesh, uint32 depth) noexcept
+    {
+        return ((uint64) transparentPass << 60) | ((uint64) (maxDepth - depth) << 36) | getProgramMaterialMesh (program, material, mesh);
+    }
+
+    static uint64 makeWeightedBlended (uint32 program, MaterialID material, MeshID mesh) noexcept
+    {
+        return ((uint64) transparentPass << 60) | (getProgramMaterialMesh (program, material, mesh) << 24);
+    }
+
+    static constexpr uint32 maxDepth = (1u << 24) - 1;
+
+private:
+    /** IDs too large for their field are clamped rather than spilling into
+        the neighbouring fields. Commands carry their own material and mesh,
+        so those draws are still correct, just grouped less tightly. */
+    static uint64 getProgramMaterialMesh (uint32 program, MaterialID material, MeshID mesh) noexcept
+    {
+        return ((uint64) jmin (program, maxProgram) << 28)
+             | ((uint64) jmin (material, maxMaterial) << 12)
+             | (uint64) jmin (mesh, maxMesh);
+    }
+
+    static constexpr uint32 maxProgram = (1u << 8) - 1, maxMaterial = (1u << 16) - 1, maxMesh = (1u << 12) - 1;
+};
+
+
+/** Everything the render thread needs to issue one draw. Commands are plain
+    data, so any thread can record them without touching OpenGL.
+ */
+struct DrawCommand
+{
+    uint64 sortKey;
+    uint32 object;      // The same for one object from frame to frame, e.g. its index in the scene
+    MeshID mesh;
+    MaterialID material;
+    GLfloat transform[16];
+};
+
+
+/** A bump allocator that hands out memory from large blocks and frees it all
+    at once with `reset()`. Blocks are kept between frames, so after the first
+    few frames recording never touches the heap.
+ */
+class LinearAllocator
+{
+public:
+    explicit LinearAllocator (size_t blockSizeToUse = 64 * 1024)
+        : blockSize (blockSizeToUse)
+    {
+    }
+
+    void* allocate (size_t numBytes, size_t alignment)
+    {
+        jassert (numBytes <= blockSize);
+
+        for (;;)
+        {
+            if (currentBlock < blocks.size())
+            {
+                auto base = reinterpret_cast<uintptr_t> (blocks[currentBlock].get());
+                auto aligned = (base + offset + alignment - 1) & ~(uintptr_t) (alignment - 1);
+
+                if (aligned + numBytes <= base + blockSize)
+                {
+                    offset = (size_t) (aligned + numBytes - base);
+                    return reinterpret_cast<void*> (aligned);
+                }
+
+                ++currentBlock;
+                offset = 0;
+                continue;
+            }
+
+            blocks.emplace_back (new uint8[blockSize]);
+        }
+    }
+
+    template <typename Type>
+    Type* allocate()
+    {
+        static_assert (std::is_trivially_destructible<Type>::value, "reset() never runs destructors");
+        return static_cast<Type*> (allocate (sizeof (Type), alignof (Type)));
+    }
+
+    /** Releases every allocation at once, keeping the blocks for reuse. */
+    void reset() noexcept
+    {
+        currentBlock = 0;
+        offset = 0;
+    }
+
+private:
+    const size_t blockSize;
+    std::vector<std::unique_ptr<uint8[]>> blocks;
+    size_t currentBlock = 0, offset = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (LinearAllocator)
+};
+
+
+/** Draw commands recorded by one thread. Each worker thread gets a list of
+    its own, so recording needs no locks at all.
+ */
+class DrawCommandList
+{
+public:
+    DrawCommandList() = default;
+
+    void add (uint64 sortKey, uint32 object, MeshID mesh, MaterialID material, const Matrix3D<GLfloat>& transform)
+    {
+        auto* command = allocator.allocate<DrawCommand>();
+        command->sortKey = sortKey;
+        command->object = object;
+        command->mesh = mesh;
+        command->material = material;
+        memcpy (command->transform, transform.mat, sizeof (command->transform));
+
+        commands.push_back (command);
+    }
+
+    void reset() noexcept
+    {
+        allocator.reset();
+        commands.clear();
+    }
+
+    size_t size() const noexcept                            { return commands.size(); }
+    const std::vector<DrawCommand*>& getCommands() const    { return commands; }
+
+private:
+    LinearAllocator allocator;
+    std::vector<DrawCommand*> commands;
+
+    JUCE_DECLARE_NON_COPYABLE (DrawCommandList)
+};
+
+
+/** Owns one DrawCommandList per recording thread for the current frame, and
+    merges them into a single submission order on the render thread.
+
+    Typical use per frame:
+        1. `beginFrame (numRecorders)` on the render thread
+        2. workers call `getList (workerIndex).add (...)` in parallel
+        3. `merge()` on the render thread once the workers are done, then
+           submit the returned commands in order
+ */
+class DrawCommandQueue
+{
+public:
+    DrawCommandQueue() = default;
+
+    void beginFrame (int numRecorders)
+    {
+        while ((int) lists.size() < numRecorders)
+            lists.push_back (std::make_unique<DrawCommandList>());
+
+        for (auto& list : lists)
+            list->reset();
+
+        numActiveLists = numRecorders;
+    }
+
+    DrawCommandList& getList (int recorderIndex)
+    {
+        jassert (isPositiveAndBelow (recorderIndex, numActiveLists));
+        return *lists[(size_t) recorderIndex];
+    }
+
+    /** Merges all lists and orders the commands by sort key, with an LSD
+        radix sort. Commands with equal keys keep their recording order, so
+        the result is deterministic no matter how the work was split between
+        threads. The returned array is valid until the next beginFrame(). */
+    const std::vector<const DrawCommand*>& merge()
+    {
+        const double startTime = Time::getMillisecondCounterHiRes();
+
+        entries.clear();
+
+        for (int i = 0; i < numActiveLists; ++i)
+            for (auto* command : lists[(size_t) i]->getCommands())
+                entries.push_back ({ command->sortKey, command });
+
+        radixSort (entries, scratch);
+
+        merged.clear();
+
+        for (auto& entry : entries)
+            merged.push_back (entry.command);
+
+        lastSortTimeMs = Time::getMillisecondCounterHiRes() - startTime;
+        return merged;
+    }
+
+    /** Number of commands in the last merge. */
+    size_t getNumCommands() const noexcept      { return merged.size(); }
+
+    /** Time the last merge took, sort included. */
+    double getSortTimeMs() const noexcept       { return lastSortTimeMs; }
+
+private:
+    struct SortEntry
+    {
+        uint64 key;
+        const DrawCommand* command;
+    };
+
+    /** Sorts by key one byte at a time, least significant first. Bytes that
+        are the same in every key, e.g. the pass when everything is opaque,
+        are skipped. */
+    static void radixSort (std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+    {
+        if (entries.empty())
+            return;
+
+        constexpr int numBytes = sizeof (uint64);
+        size_t histograms[numBytes][256] = {};
+
+        for (auto& entry : entries)
+            for (int byte = 0; byte < numBytes; ++byte)
+                ++histograms[byte][(entry.key >> (byte * 8)) & 0xff];
+
+        scratch.resize (entries.size());
+
+        for (int byte = 0; byte < numBytes; ++byte)
+        {
+            auto& histogram = histograms[byte];
+
+            if (histogram[(entries.front().key >> (byte * 8)) & 0xff] == entries.size())
+                continue;
+
+            // Turn the counts into the first output index of each bucket
+            size_t offset = 0;
+
+            for (auto& count : histogram)
+            {
+                const size_t bucketSize = count;
+                count = offset;
+                offset += bucketSize;
+            }
+
+            for (auto& entry : entries)
+                scratch[histogram[(entry.key >> (byte * 8)) & 0xff]++] = entry;
+
+            entries.swap (scratch);
+        }
+    }
+
+    std::vector<std::unique_ptr<DrawCommandList>> lists;
+    std::vector<SortEntry> entries, scratch;
+    std::vector<const DrawCommand*> merged;
+    int numActiveLists = 0;
+    double lastSortTimeMs = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (DrawCommandQueue)
+};
+
+} // namespace Rendering
@@ -0,0 +1,316 @@
+//
+//  DynamicResolution.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/AsyncShaderProgram.hpp"
+#include "../OpenGLUtil/GpuQueryRing.hpp"
+#include "../OpenGLUtil/OffscreenRenderTarget.hpp"
+
+namespace Rendering
+{
+
+/** Renders the scene at a fraction of the window's resolution when the GPU
+    can't keep up with the full one, then scales it back up with a sharpening
+    filter.
+
+    Each frame's GPU time is measured with timestamp queries and, once it
+    arrives a few frames later, converted to what it would be at the current
+    scale, assuming the cost is proportional to the number of pixels. The
+    scale moves in steps of `Settings::scaleStep`, so the target is resized
+    rarely and the image doesn't shimmer with every small change in load:
+    - Over the target time, it drops straight to the step predicted to fit.
+    - Well under it for a while, it rises one step, if that step is predicted
+      to fit too.
+    After each change it waits for frames rendered at the new scale before
+    judging again.
+
+    The scene is drawn into the bottom left of a target the size of the
+    window, so changing the scale never reallocates anything. At full scale
+    the target is bypassed and the scene is drawn straight to the window.
+    Without timer queries the scale stays at its maximum.
+ */
+class DynamicResolution
+{
+public:
+    struct Settings
+    {
+        bool isEnabled = true;
+        float targetGpuTimeMs = 12.0f;  // Leaves some of a 60 Hz frame for the CPU side and the compositor
+        float minScale = 0.5f;          // Of the width and height, so a quarter of the pixels
+        float maxScale = 1.0f;
+        float scaleStep = 0.125f;
+        float sharpness = 0.5f;         // 0 to 1
+    };
+
+    struct Statistics
+    {
+        bool isSupported = true;
+        float scale = 1.0f;
+        float gpuTimeMs = 0, targetGpuTimeMs = 0;
+        Rectangle<int> renderArea, windowArea;
+
+        String toString() const
+        {
+            if (! isSupported)
+                return "Resolution: fixed, no GPU timer queries";
+
+            return "Resolution: " + String (roundToInt (scale * 100.0f)) + "% ("
+                 + String (renderArea.getWidth()) + "x" + String (renderArea.getHeight()) + " of "
+                 + String (windowArea.getWidth()) + "x" + String (windowArea.getHeight()) + "), GPU "
+                 + String (gpuTimeMs, 2) + " / " + String (targetGpuTimeMs, 1) + " ms";
+        }
+    };
+
+    DynamicResolution() = default;
+
+    /** Takes effect from the next frame. Call on the OpenGL thread. */
+    void setSettings (const Settings& newSettings)
+    {
+        jassert (newSettings.minScale > 0 && newSettings.minScale <= newSettings.maxScale && newSettings.maxScale <= 1.0f);
+        settings = newSettings;
+        scale = snap (scale);
+    }
+
+    void release (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        target.release (context);
+        program.release (context);
+        queries.release (functions);
+
+        if (vertexArrayID != 0)
+            context.extensions.glDeleteVertexArrays (1, &vertexArrayID);
+
+        vertexArrayID = 0;
+        hasReflectedUniforms = false;
+    }
+
+    //==============================================================================
+    /** Chooses this frame's scale and, below full scale, redirects drawing
+        into the scaled target. Returns the area to render the scene into. */
+    Rectangle<int> begin (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions,
+                          Rectangle<int> viewportArea)
+    {
+        if (! hasCheckedTimerQueries)
+        {
+            isSupported = Queries::isTimerQuerySupported (functions);
+            hasCheckedTimerQueries = true;
+        }
+
+        windowArea = viewportArea;
+
+        if (isSupported)
+        {
+            queries.collect (functions, [this] (const Queries::Results& results) { addMeasurement (results); });
+            updateScale();
+            queries.beginFrame (functions, (uint32) roundToInt (scale * (float) tagsPerUnitScale));
+            queries.timestamp (functions, startQuery);
+        }
+
+        isRenderingToTarget = false;
+        renderArea = viewportArea;
+
+        if (scale < 1.0f && prepare (context, functions, viewportArea.getWidth(), viewportArea.getHeight()))
+        {
+            renderArea = { jmax (1, roundToInt (scale * (float) viewportArea.getWidth())),
+                           jmax (1, roundToInt (scale * (float) viewportArea.getHeight())) };
+            target.bind (context);
+            isRenderingToTarget = true;
+        }
+
+        updateStatistics();
+        return renderArea;
+    }
+
+    /** Finishes timing the frame and, if it was scaled, draws it into the
+        viewport passed to begin() with the sharpening upscale. */
+    void end (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (isSupported)
+        {
+            queries.timestamp (functions, endQuery);
+            queries.endFrame();
+        }
+
+        if (! isRenderingToTarget)
+            return;
+
+        target.unbind (context);
+        glViewport (windowArea.getX(), windowArea.getY(), windowArea.getWidth(), windowArea.getHeight());
+
+        // Until the upscale has linked, a plain bilinear stretch
+        if (program.update (context) != OpenGLUtil::AsyncShaderProgram::State::linked)
+        {
+            target.blitTo (context, functions, renderArea, windowArea);
+            return;
+        }
+
+        auto& uniforms = program.getUniforms();
+
+        if (! hasReflectedUniforms)
+        {
+            uniforms.reflect (context, functions, program.getProgramID());
+            uniforms.set (sourceTextureUniform, 0);
+            hasReflectedUniforms = true;
+        }
+
+        program.use (context);
+        uniforms.set (sourceScaleUniform, Point<GLfloat> ((float) renderArea.getWidth() / (float) target.getWidth(),
+                                                          (float) renderArea.getHeight() / (float) target.getHeight()));
+        uniforms.set (sharpnessUniform, settings.sharpness);
+        uniforms.upload (context);
+
+        context.extensions.glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, target.getColourTextureID());
+
+        if (vertexArrayID == 0)
+            context.extensions.glGenVertexArrays (1, &vertexArrayID);
+
+        context.extensions.glBindVertexArray (vertexArrayID);
+        glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+        context.extensions.glBindVertexArray (0);
+        glBindTexture (GL_TEXTURE_2D, 0);
+    }
+
+    float getScale() const noexcept                 { return scale; }
+
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    using Queries = OpenGLUtil::GpuQueryRing<2>;
+    enum QueryIndex { startQuery, endQuery };
+
+    // Frames are tagged with their scale, in these units
+    static constexpr int tagsPerUnitScale = 1000;
+
+    bool prepare (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions, int width, int height)
+    {
+        if (! target.isValid() || target.getWidth() != width || target.getHeight() != height)
+            if (! target.create (context, width, height))
+                return false;
+
+        if (program.getState() == OpenGLUtil::AsyncShaderProgram::State::empty)
+        {
+            program.compile (context, functions, BinaryData::FullScreenQuadVertex_glsl,
+                             BinaryData::SharpeningUpscaleFragment_glsl);
+            hasReflectedUniforms = false;
+        }
+
+        return true;
+    }
+
+    void addMeasurement (const Queries::Results& results)
+    {
+        if (! results.wasMeasured (startQuery) || ! results.wasMeasured (endQuery))
+            return;
+
+        // Scaled to what the frame would have cost at the current scale
+        const float measuredScale = (float) results.tag / (float) tagsPerUnitScale;
+        const float ms = (float) (results.values[endQuery] - results.values[startQuery]) * 1.0e-6f;
+        const float msAtScale = ms * square (scale / measuredScale);
+
+        gpuTimeMs = numMeasurements > 0 ? gpuTimeMs + 0.25f * (msAtScale - gpuTimeMs) : msAtScale;
+
+        // Judge a new scale only on frames drawn at it
+        if (std::abs (measuredScale - scale) < 0.5f / (float) tagsPerUnitScale)
+            ++numMeasurements;
+    }
+
+    void updateScale()
+    {
+        if (! settings.isEnabled)
+        {
+            scale = snap (settings.maxScale);
+            return;
+        }
+
+        if (numMeasurements < measurementsBeforeChange)
+            return;
+
+        const float targetMs = settings.targetGpuTimeMs;
+
+        if (gpuTimeMs > targetMs)
+        {
+            // Pixels cost time, so the scale that fits goes with the square root
+            changeScale (snapDown (scale * std::sqrt (targetMs / gpuTimeMs)));
+            framesUnderTarget = 0;
+        }
+        else if (gpuTimeMs < headroom * targetMs && ++framesUnderTarget >= framesBeforeRaising)
+        {
+            const float raised = snap (scale + settings.scaleStep);
+
+            if (gpuTimeMs * square (raised / scale) < headroom * targetMs)
+                changeScale (raised);
+
+            framesUnderTarget = 0;
+        }
+    }
+
+    void changeScale (float newScale)
+    {
+        if (newScale != scale)
+        {
+            scale = newScale;
+            numMeasurements = 0;
+        }
+    }
+
+    float snap (float value) const noexcept
+    {
+        return jlimit (settings.minScale, settings.maxScale, settings.scaleStep * std::round (value / settings.scaleStep));
+    }
+
+    float snapDown (float value) const noexcept
+    {
+        return jlimit (settings.minScale, settings.maxScale, settings.scaleStep * std::floor (value / settings.scaleStep));
+    }
+
+    void updateStatistics()
+    {
+        Statistics newStatistics;
+        newStatistics.isSupported = isSupported;
+        newStatistics.scale = isRenderingToTarget ? scale : 1.0f;
+        newStatistics.gpuTimeMs = gpuTimeMs;
+        newStatistics.targetGpuTimeMs = settings.targetGpuTimeMs;
+        newStatistics.renderArea = renderArea;
+        newStatistics.windowArea = windowArea;
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics = newStatistics;
+    }
+
+    // Rising must look cheap for a while first, falling happens at once
+    static constexpr float headroom = 0.8f;
+    static constexpr int measurementsBeforeChange = 4, framesBeforeRaising = 60;
+
+    Settings settings;
+    float scale = 1.0f, gpuTimeMs = 0;
+    int numMeasurements = 0, framesUnderTarget = 0;
+    bool isSupported = false, hasCheckedTimerQueries = false, isRenderingToTarget = false;
+    Rectangle<int> windowArea, renderArea;
+
+    Queries queries;
+    OpenGLUtil::OffscreenRenderTarget target;
+    OpenGLUtil::AsyncShaderProgram program;
+    const OpenGLUtil::UniformHandle<GLint> sourceTextureUniform { "sourceTexture" };
+    const OpenGLUtil::UniformHandle<Point<GLfloat>> sourceScaleUniform { "sourceScale" };
+    const OpenGLUtil::UniformHandle<GLfloat> sharpnessUniform { "sharpness" };
+    GLuint vertexArrayID = 0;
+    bool hasReflectedUniforms = false;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE (DynamicResolution)
+};
+
+} // namespace Rendering
@@ -0,0 +1,315 @@
+//
+//  JobSystem.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace Rendering
+{
+
+/** A work-stealing job scheduler for per-frame scene work: transforms,
+    culling, animation, LOD selection and so on.
+
+    Every worker thread, plus one shared slot for all other threads, has its
+    own deque of jobs. A thread pushes and pops jobs at the back of its own
+    deque, which keeps recently created, cache-warm work local, and steals
+    from the front of another thread's deque only when its own runs dry.
+
+    Jobs can have children, which must all finish before their parent counts
+    as finished, and dependencies, which hold a job back until other jobs have
+    finished. Waiting on a job runs other jobs in the meantime, so the render
+    thread helps out instead of blocking.
+
+    Typical use per frame:
+        1. `parallelFor()`, or `createJob()`, `addDependency()`, `schedule()`
+           and `wait()` for more involved graphs
+        2. `reset()` once every job of the frame has finished
+ */
+class JobSystem
+{
+public:
+    class Job
+    {
+    public:
+        bool isFinished() const noexcept    { return finished.load(); }
+
+    private:
+        friend class JobSystem;
+
+        std::function<void()> work;
+        Job* parent = nullptr;
+        std::atomic<int> numUnfinished { 1 };   // Itself, plus its unfinished children
+        std::atomic<int> numBlockers { 1 };     // Unfinished prerequisites, plus one until scheduled
+        std::vector<Job*> dependents;
+
+        // Set last, once nothing touches the job any more
+        std::atomic<bool> finished { false };
+    };
+
+    explicit JobSystem (int numWorkersToUse = jmax (1, SystemStats::getNumCpus() - 1))
+    {
+        for (int i = 0; i <= numWorkersToUse; ++i)
+            queues.push_back (std::make_unique<WorkQueue>());
+
+        for (int i = 0; i < numWorkersToUse; ++i)
+            workers.push_back (std::make_unique<Worker> (*this, i + 1));
+
+        for (auto& worker : workers)
+            worker->startThread();
+    }
+
+    ~JobSystem()
+    {
+        for (auto& worker : workers)
+            worker->signalThreadShouldExit();
+
+        workAvailable.signal();
+
+        for (auto& worker : workers)
+            worker->stopThread (1000);
+    }
+
+    int getNumWorkers() const noexcept      { return (int) workers.size(); }
+
+    //==============================================================================
+    /** Creates a job that runs `work` once scheduled. With a parent, the
+        parent isn't finished until this job is; create children before the
+        parent finishes, e.g. from inside the parent's own work. Jobs live
+        until `reset()`. */
+    Job* createJob (std::function<void()> work, Job* parent = nullptr)
+    {
+        Job* job = nullptr;
+
+        {
+            const SpinLock::ScopedLockType sl (jobsLock);
+            jobs.emplace_back();
+            job = &jobs.back();
+        }
+
+        job->work = std::move (work);
+        job->parent = parent;
+
+        if (parent != nullptr)
+            ++parent->numUnfinished;
+
+        return job;
+    }
+
+    /** Holds `job` back until `prerequisite` has finished. Both must be
+        declared before either of them is scheduled. */
+    void addDependency (Job* job, Job* prerequisite)
+    {
+        ++job->numBlockers;
+        prerequisite->dependents.push_back (job);
+    }
+
+    /** Lets the job run as soon as its prerequisites have finished. */
+    void schedule (Job* job)
+    {
+        unblock (job);
+    }
+
+    /** Runs other jobs until `job` has finished. */
+    void wait (const Job* job)
+    {
+        const int queueIndex = getCurrentQueueIndex();
+
+        while (! job->isFinished())
+        {
+            if (auto* next = findJob (queueIndex))
+                execute (next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    /** Calls `function (chunkBegin, chunkEnd)` for consecutive chunks of up to
+        `grainSize` indices covering [begin, end), spread across the workers,
+        and returns once every chunk is done. The chunk boundaries depend only
+        on the arguments, never on which thread runs which chunk. */
+    template <typename Function>
+    void parallelFor (size_t begin, size_t end, size_t grainSize, Function&& function)
+    {
+        jassert (grainSize > 0);
+
+        if (end <= begin)
+            return;
+
+        if (end - begin <= grainSize)
+        {
+            function (begin, end);
+            return;
+        }
+
+        auto* root = createJob ([] {});
+
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grainSize)
+        {
+            const size_t chunkEnd = jmin (end, chunkBegin + grainSize);
+            schedule (createJob ([&function, chunkBegin, chunkEnd] { function (chunkBegin, chunkEnd); }, root));
+        }
+
+        schedule (root);
+        wait (root);
+    }
+
+    /** Frees every job created so far. Only call this when none of them are
+        scheduled or running, e.g. at the end of a frame. */
+    void reset()
+    {
+        const SpinLock::ScopedLockType sl (jobsLock);
+
+       #if JUCE_DEBUG
+        for (auto& job : jobs)
+            jassert (job.isFinished());
+       #endif
+
+        jobs.clear();
+    }
+
+private:
+    struct WorkQueue
+    {
+        SpinLock lock;
+        std::deque<Job*> jobs;
+    };
+
+    class Worker : public Thread
+    {
+    public:
+        Worker (JobSystem& ownerToUse, int queueIndexToUse)
+            : Thread ("Job Worker " + String (queueIndexToUse)),
+              owner (ownerToUse), queueIndex (queueIndexToUse)
+        {
+        }
+
+        void run() override
+        {
+            getCurrentThreadSlot() = { &owner, queueIndex };
+
+            while (! threadShouldExit())
+            {
+                if (auto* job = owner.findJob (queueIndex))
+                    owner.execute (job);
+                else
+                    owner.workAvailable.wait (1);
+            }
+        }
+
+    private:
+        JobSystem& owner;
+        const int queueIndex;
+    };
+
+    struct ThreadSlot
+    {
+        const JobSystem* owner = nullptr;
+        int queueIndex = 0;
+    };
+
+    static ThreadSlot& getCurrentThreadSlot()
+    {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    /** Workers use their own queue, any other thread the shared queue 0. */
+    int getCurrentQueueIndex() const
+    {
+        const auto& slot = getCurrentThreadSlot();
+        return slot.owner == this ? slot.queueIndex : 0;
+    }
+
+    void push (Job* job)
+    {
+        auto& queue = *queues[(size_t) getCurrentQueueIndex()];
+
+        {
+            const SpinLock::ScopedLockType sl (queue.lock);
+            queue.jobs.push_back (job);
+        }
+
+        workAvailable.signal();
+    }
+
+    /** Newest job from our own queue, or else the oldest one from another. */
+    Job* findJob (int queueIndex)
+    {
+        {
+            auto& queue = *queues[(size_t) queueIndex];
+            const SpinLock::ScopedLockType sl (queue.lock);
+
+            if (! queue.jobs.empty())
+            {
+                auto* job = queue.jobs.back();
+                queue.jobs.pop_back();
+                return job;
+            }
+        }
+
+        const int numQueues = (int) queues.size();
+
+        for (int i = 1; i < numQueues; ++i)
+        {
+            auto& victim = *queues[(size_t) ((queueIndex + i) % numQueues)];
+            const SpinLock::ScopedLockType sl (victim.lock);
+
+            if (! victim.jobs.empty())
+            {
+                auto* job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void execute (Job* job)
+    {
+        job->work();
+        finish (job);
+    }
+
+    void finish (Job* job)
+    {
+        if (--job->numUnfinished > 0)
+            return;
+
+        // Once marked, the job may be freed as soon as everything after it has
+        // finished, so read what's needed first
+        auto* parent = job->parent;
+        const bool hasDependents = ! job->dependents.empty();
+        job->finished = true;
+
+        // The dependents can't have finished yet, so the job is still alive
+        if (hasDependents)
+            for (auto* dependent : job->dependents)
+                unblock (dependent);
+
+        if (parent != nullptr)
+            finish (parent);
+    }
+
+    void unblock (Job* job)
+    {
+        if (--job->numBlockers == 0)
+            push (job);
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::unique_ptr<Worker>> workers;
+    WaitableEvent workAvailable;
+
+    SpinLock jobsLock;
+    std::deque<Job> jobs;
+
+    JUCE_DECLARE_NON_COPYABLE (JobSystem)
+};
+
+} // namespace Rendering
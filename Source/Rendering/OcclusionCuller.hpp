@@ -0,0 +1,480 @@
+//
+//  OcclusionCuller.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/AsyncShaderProgram.hpp"
+#include "../OpenGLUtil/GpuQueryRing.hpp"
+#include "../OpenGLUtil/UniformBuffer.hpp"
+#include "../OpenGLUtil/VertexLayout.hpp"
+#include "../ShaderUniformBlocks.hpp"
+#include "DrawCommandList.hpp"
+#include "SimdMath.hpp"
+
+namespace Rendering
+{
+
+/** Skips objects that were hidden behind others, found with hardware
+    occlusion queries on their bounding boxes.
+
+    After the opaque pass, the bounding box of each object due for a test is
+    drawn against the depth buffer, with colour and depth writes off, inside
+    an occlusion query. If no sample of the box passes, nothing of the object
+    can be visible either. Results are read only once the GPU reports them
+    available, usually a frame or two later, and until then each object keeps
+    the visibility it had, so reading them never stalls the pipeline. This
+    relies on the view changing little from one frame to the next:
+    - Hidden objects are tested every frame, so they come back one or two
+      frames after they are uncovered.
+    - Visible objects are tested every `Settings::visibleQueryInterval`
+      frames, staggered so that the queries spread out over the frames.
+    Objects whose box reaches the near plane, e.g. because the camera is in
+    it, can't be tested that way and always count as visible.
+
+    Since results come in late, a renderer that only draws on demand must
+    keep drawing while isAwaitingResults() is true, or an object uncovered by
+    the last change of view would stay hidden until something else repaints.
+
+    Objects are identified by DrawCommand::object, which must stay the same
+    from frame to frame.
+ */
+class OcclusionCuller
+{
+public:
+    struct Settings
+    {
+        bool isEnabled = true;
+        int visibleQueryInterval = 8;   // Frames between tests of a visible object
+    };
+
+    struct Statistics
+    {
+        bool isEnabled = true;
+        int numObjects = 0;
+        int numCulled = 0;              // Drawn objects skipped this frame
+        int numQueriesIssued = 0;       // Boxes tested this frame
+        int numQueriesPending = 0;      // Still waiting for the GPU, from this frame and earlier ones
+        float queryCpuMs = 0;           // Issuing this frame's queries
+        float queryGpuMs = 0;           // Drawing the boxes, 0 without timer queries
+
+        String toString() const
+        {
+            if (! isEnabled)
+                return "Occlusion culling: off";
+
+            String text = "Occlusion culling: " + String (numCulled) + " of " + String (numObjects) + " culled, "
+                        + String (numQueriesIssued) + " queries (" + String (numQueriesPending) + " pending), "
+                        + String (queryCpuMs, 3) + " ms CPU";
+
+            if (queryGpuMs > 0)
+                text << ", " << String (queryGpuMs, 3) << " ms GPU";
+
+            return text;
+        }
+    };
+
+    OcclusionCuller() = default;
+
+    ~OcclusionCuller()
+    {
+        // You must call release() while the context is still active
+        jassert (vertexArrayID == 0 && freeQueries.empty() && pending.empty());
+    }
+
+    /** Takes effect from the next frame. Call on the OpenGL thread. */
+    void setSettings (const Settings& newSettings)
+    {
+        jassert (newSettings.visibleQueryInterval > 0);
+        settings = newSettings;
+    }
+
+    void release (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        for (const auto& query : pending)
+            freeQueries.push_back (query.queryID);
+
+        if (! freeQueries.empty())
+            functions.glDeleteQueries ((GLsizei) freeQueries.size(), freeQueries.data());
+
+        program.release (context);
+        timer.release (functions);
+
+        if (vertexArrayID != 0)
+            context.extensions.glDeleteVertexArrays (1, &vertexArrayID);
+
+        for (auto* bufferID : { &vertexBufferID, &indexBufferID })
+            if (*bufferID != 0)
+                context.extensions.glDeleteBuffers (1, bufferID);
+
+        vertexArrayID = vertexBufferID = indexBufferID = 0;
+        freeQueries.clear();
+        pending.clear();
+        objects.clear();
+        hasReflectedUniforms = false;
+    }
+
+    //==============================================================================
+    /** Takes in the query results that have arrived. Call once per frame,
+        before drawing anything that isVisible() decides about. */
+    void beginFrame (const OpenGLUtil::CoreProfileFunctions& functions, size_t numObjects)
+    {
+        if (! hasCheckedQueries)
+        {
+            canTime = Timer::isTimerQuerySupported (functions);
+            queryTarget = OpenGLShaderProgram::getLanguageVersion() >= 3.3 || functions.isExtensionSupported ("GL_ARB_occlusion_query2")
+                            ? GL_ANY_SAMPLES_PASSED : GL_SAMPLES_PASSED;
+            hasCheckedQueries = true;
+        }
+
+        // Start over when switched back on, rather than trusting old results
+        if (settings.isEnabled != isEnabled)
+        {
+            isEnabled = settings.isEnabled;
+            objects.assign (objects.size(), {});
+        }
+
+        objects.resize (numObjects);
+        collectResults (functions);
+
+        if (canTime)
+            timer.collect (functions, [this] (const Timer::Results& results) { queryGpuNs = (float) results.values[0]; });
+
+        ++frameNumber;
+        numCulled = numQueriesIssued = 0;
+        queryCpuMs = 0;
+
+        if (! isEnabled)
+            updateStatistics();
+    }
+
+    /** False if the object was hidden when last tested, so it needn't be drawn. */
+    bool isVisible (uint32 object) const noexcept
+    {
+        return ! isEnabled || object >= objects.size() || objects[object].isVisible;
+    }
+
+    /** True while some hidden object was last tested before the view or an
+        object last moved, so the next frames may find it uncovered. Once every
+        hidden object has been tested against the scene as it is now, this is
+        false until something moves again. */
+    bool isAwaitingResults() const noexcept
+    {
+        if (! isEnabled)
+            return false;
+
+        return std::any_of (objects.begin(), objects.end(), [this] (const ObjectState& object)
+        {
+            // Anything not submitted this frame isn't being tested, so can't be waited for
+            const bool isBeingTested = object.isQueryPending || object.lastTestedFrame == frameNumber;
+            return ! object.isVisible && isBeingTested && object.resultFrame < lastMovedFrame;
+        });
+    }
+
+    /** Tests the bounding boxes of the commands' objects that are due for it
+        against the current depth buffer. Call after the opaque draws, and not
+        inside another GL_SAMPLES_PASSED or GL_ANY_SAMPLES_PASSED query.
+
+        `objectUniforms` must hold each command's record at the command's
+        index, as the draws used, and `getBounds (const DrawCommand&)` returns
+        the local bounds of its mesh. Issues nothing until the box shader has
+        linked. */
+    template <typename GetBounds>
+    void issueQueries (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions,
+                       const std::vector<const DrawCommand*>& commands,
+                       const OpenGLUtil::UniformBufferArray<ShaderUniformBlocks::ObjectUniforms>& objectUniforms,
+                       const Matrix3D<GLfloat>& viewMatrix, float nearPlane, GetBounds&& getBounds)
+    {
+        if (! isEnabled)
+            return;
+
+        const double startTime = Time::getMillisecondCounterHiRes();
+
+        if (! prepare (context, functions))
+        {
+            updateStatistics();
+            return;
+        }
+
+        program.use (context);
+        context.extensions.glBindVertexArray (vertexArrayID);
+
+        if (canTime)
+        {
+            timer.beginFrame (functions, 0);
+            timer.begin (functions, 0, GL_TIME_ELAPSED);
+        }
+
+        // The boxes only need testing; the depth they'd write would hide real geometry
+        glColorMask (GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask (GL_FALSE);
+        glDepthFunc (GL_LEQUAL);
+
+        const auto view = Matrix4::fromMatrix3D (viewMatrix);
+        auto& uniforms = program.getUniforms();
+        bool hasMoved = memcmp (view.m, lastView.m, sizeof (view.m)) != 0;
+        lastView = view;
+
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            const auto& command = *commands[i];
+            jassert (command.object < objects.size());
+
+            auto& object = objects[command.object];
+
+            if (memcmp (object.transform, command.transform, sizeof (object.transform)) != 0)
+            {
+                memcpy (object.transform, command.transform, sizeof (object.transform));
+                hasMoved = true;
+            }
+
+            if (! object.isVisible)
+                ++numCulled;
+
+            // Tested again already, or visible and not due yet
+            if (object.isQueryPending || object.lastTestedFrame == frameNumber
+                 || (object.isVisible && (frameNumber + command.object) % (uint32) settings.visibleQueryInterval != 0))
+                continue;
+
+            object.lastTestedFrame = frameNumber;
+
+            Matrix4 model;
+            memcpy (model.m, command.transform, sizeof (model.m));
+
+            const auto bounds = getBounds (command);
+
+            // The camera looks down -z, so a box nearer than the near plane is clipped and could hide nothing
+            if (bounds.transformedBy (model * view).max[2] > -nearPlane)
+            {
+                object.isVisible = true;
+                continue;
+            }
+
+            // A little larger, so faces the mesh lies on don't fight with its own depth
+            Vector3D<GLfloat> boxMin, boxSize;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float margin = 0.01f * (bounds.max[axis] - bounds.min[axis]) + 1.0e-4f;
+                (&boxMin.x)[axis] = bounds.min[axis] - margin;
+                (&boxSize.x)[axis] = bounds.max[axis] - bounds.min[axis] + 2.0f * margin;
+            }
+
+            uniforms.set (boxMinUniform, boxMin);
+            uniforms.set (boxSizeUniform, boxSize);
+            uniforms.upload (context);
+            objectUniforms.bindElement (functions, i);
+
+            const GLuint queryID = getFreeQuery (functions);
+            functions.glBeginQuery (queryTarget, queryID);
+            glDrawElements (GL_TRIANGLES, numBoxIndices, GL_UNSIGNED_SHORT, nullptr);
+            functions.glEndQuery (queryTarget);
+
+            pending.push_back ({ command.object, queryID, frameNumber });
+            object.isQueryPending = true;
+            ++numQueriesIssued;
+        }
+
+        if (hasMoved)
+            lastMovedFrame = frameNumber;
+
+        glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask (GL_TRUE);
+        glDepthFunc (GL_LESS);
+
+        if (canTime)
+        {
+            timer.end (functions, GL_TIME_ELAPSED);
+            timer.endFrame();
+        }
+
+        context.extensions.glBindVertexArray (0);
+
+        queryCpuMs = (float) (Time::getMillisecondCounterHiRes() - startTime);
+        updateStatistics();
+    }
+
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    using Timer = OpenGLUtil::GpuQueryRing<1>;
+    using BoxLayout = OpenGLUtil::VertexLayout<OpenGLUtil::VertexAttribute<0, GLfloat, 3>>;
+
+    struct ObjectState
+    {
+        bool isVisible = true, isQueryPending = false;
+        uint32 lastTestedFrame = 0;
+        uint32 resultFrame = 0;         // When the query isVisible came from was issued
+        GLfloat transform[16] = {};     // As of the last frame, to notice it moving
+    };
+
+    struct PendingQuery
+    {
+        uint32 object;
+        GLuint queryID;
+        uint32 frame;
+    };
+
+    /** Results arrive in the order the queries were issued, so this stops at
+        the first one that isn't ready. */
+    void collectResults (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        size_t numCollected = 0;
+
+        for (; numCollected < pending.size(); ++numCollected)
+        {
+            const auto& query = pending[numCollected];
+
+            GLint isAvailable = 0;
+            functions.glGetQueryObjectiv (query.queryID, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+
+            if (isAvailable == 0)
+                break;
+
+            GLuint samplesPassed = 0;
+            functions.glGetQueryObjectuiv (query.queryID, GL_QUERY_RESULT, &samplesPassed);
+            freeQueries.push_back (query.queryID);
+
+            // The object list may have shrunk since the query was issued
+            if (query.object < objects.size())
+            {
+                auto& object = objects[query.object];
+                object.isQueryPending = false;
+
+                if (isEnabled)
+                {
+                    object.isVisible = samplesPassed > 0;
+                    object.resultFrame = query.frame;
+                }
+            }
+        }
+
+        pending.erase (pending.begin(), pending.begin() + (std::ptrdiff_t) numCollected);
+    }
+
+    GLuint getFreeQuery (const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (freeQueries.empty())
+        {
+            freeQueries.resize (queriesPerAllocation);
+            functions.glGenQueries ((GLsizei) queriesPerAllocation, freeQueries.data());
+        }
+
+        const GLuint queryID = freeQueries.back();
+        freeQueries.pop_back();
+        return queryID;
+    }
+
+    /** Creates the unit cube and starts compiling the shaders. Returns true
+        once everything is ready to draw with. */
+    bool prepare (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (vertexArrayID == 0)
+        {
+            createBox (context);
+            program.compile (context, functions, BinaryData::OcclusionBoxVertex_glsl, BinaryData::OcclusionBoxFragment_glsl);
+            hasReflectedUniforms = false;
+        }
+
+        if (program.update (context) != OpenGLUtil::AsyncShaderProgram::State::linked)
+            return false;
+
+        if (! hasReflectedUniforms)
+        {
+            auto& uniforms = program.getUniforms();
+            uniforms.reflect (context, functions, program.getProgramID());
+            uniforms.bindBlock (functions, program.getProgramID(), "CameraUniforms",
+                                ShaderUniformBlocks::cameraBindingPoint, sizeof (ShaderUniformBlocks::CameraUniforms));
+            uniforms.bindBlock (functions, program.getProgramID(), "ObjectUniforms",
+                                ShaderUniformBlocks::objectBindingPoint, sizeof (ShaderUniformBlocks::ObjectUniforms));
+            hasReflectedUniforms = true;
+        }
+
+        return true;
+    }
+
+    void createBox (OpenGLContext& context)
+    {
+        // Corner i has x, y and z from bits 0, 1 and 2 of i
+        GLfloat vertices[8 * 3];
+
+        for (int i = 0; i < 8; ++i)
+            for (int axis = 0; axis < 3; ++axis)
+                vertices[i * 3 + axis] = (GLfloat) ((i >> axis) & 1);
+
+        // Two triangles per face; with face culling off the winding doesn't matter
+        const GLushort indices[numBoxIndices] = { 0, 2, 1,  1, 2, 3,    4, 5, 6,  5, 7, 6,     // -z, +z
+                                                  0, 1, 4,  1, 5, 4,    2, 6, 3,  3, 6, 7,     // -y, +y
+                                                  0, 4, 2,  2, 4, 6,    1, 3, 5,  3, 7, 5 };   // -x, +x
+
+        context.extensions.glGenVertexArrays (1, &vertexArrayID);
+        context.extensions.glBindVertexArray (vertexArrayID);
+
+        context.extensions.glGenBuffers (1, &vertexBufferID);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBufferID);
+        context.extensions.glBufferData (GL_ARRAY_BUFFER, (GLsizeiptr) sizeof (vertices), vertices, GL_STATIC_DRAW);
+
+        context.extensions.glGenBuffers (1, &indexBufferID);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+        context.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) sizeof (indices), indices, GL_STATIC_DRAW);
+
+        BoxLayout::getDescription().enable (context);
+
+        context.extensions.glBindVertexArray (0);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void updateStatistics()
+    {
+        Statistics newStatistics;
+        newStatistics.isEnabled = isEnabled;
+        newStatistics.numObjects = (int) objects.size();
+        newStatistics.numCulled = numCulled;
+        newStatistics.numQueriesIssued = numQueriesIssued;
+        newStatistics.numQueriesPending = (int) pending.size();
+        newStatistics.queryCpuMs = queryCpuMs;
+        newStatistics.queryGpuMs = queryGpuNs * 1.0e-6f;
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics = newStatistics;
+    }
+
+    static constexpr int numBoxIndices = 36;
+    static constexpr size_t queriesPerAllocation = 64;
+
+    Settings settings;
+    bool isEnabled = true, canTime = false, hasCheckedQueries = false;
+    GLenum queryTarget = GL_SAMPLES_PASSED;
+    uint32 frameNumber = 0, lastMovedFrame = 0;
+    Matrix4 lastView {};
+
+    std::vector<ObjectState> objects;
+    std::vector<PendingQuery> pending;
+    std::vector<GLuint> freeQueries;
+
+    OpenGLUtil::AsyncShaderProgram program;
+    const OpenGLUtil::UniformHandle<Vector3D<GLfloat>> boxMinUniform { "boxMin" };
+    const OpenGLUtil::UniformHandle<Vector3D<GLfloat>> boxSizeUniform { "boxSize" };
+    GLuint vertexArrayID = 0, vertexBufferID = 0, indexBufferID = 0;
+    bool hasReflectedUniforms = false;
+
+    Timer timer;
+    int numCulled = 0, numQueriesIssued = 0;
+    float queryCpuMs = 0, queryGpuNs = 0;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    JUCE_DECLARE_NON_COPYABLE (OcclusionCuller)
+};
+
+} // namespace Rendering
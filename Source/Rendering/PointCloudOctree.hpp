@@ -0,0 +1,325 @@
+//
+//  PointCloudOctree.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <numeric>
+#include "../VertexFormats.hpp"
+
+namespace Rendering
+{
+
+/** A point cloud stored as an octree of point chunks, in a file that is
+    memory-mapped rather than read, so clouds far larger than RAM can be
+    opened instantly and only the chunks actually drawn are ever paged in.
+
+    Every node holds up to `pointsPerNode` points from its region, chosen so
+    that each node on its own is a uniform subsample of that region: the root
+    is a coarse preview of the whole cloud, and each level down adds detail.
+    Drawing a node and all of its ancestors draws every point of its region
+    exactly once, so a renderer can stop descending wherever the detail is
+    fine enough (see PointCloudRenderer).
+
+    File layout: a FileHeader, then `numNodes` Node records with the root
+    first, then the points of every node, one contiguous chunk per node. All
+    values are stored in the byte order of the machine that built the file.
+ */
+class PointCloudOctree
+{
+public:
+    using Point = VertexFormats::PositionColour;
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32 version;
+        uint32 numNodes;
+        uint32 pointsPerNode;
+        uint64 numPoints;
+        float boundsMin[3], boundsMax[3];
+    };
+
+    struct Node
+    {
+        float centre[3];
+        float halfSize;         // The node is a cube
+        int32 children[8];      // Node indices, or -1; bit 0 of the index is +x, bit 1 +y, bit 2 +z
+        uint64 firstPoint;      // Index into the file's points
+        uint32 numPoints;
+        uint32 depth;
+    };
+
+    static_assert (sizeof (FileHeader) == 48 && sizeof (Node) == 64, "The file layout must not depend on padding");
+
+    static constexpr uint32 currentVersion = 1;
+
+    /** Leaves this deep take any number of points, so duplicate points can't
+        make the tree infinitely deep. */
+    static constexpr uint32 maxDepth = 20;
+
+    PointCloudOctree() = default;
+
+    //==============================================================================
+    /** Maps an octree file built with build(). */
+    Result open (const File& octreeFile)
+    {
+        mappedFile = std::make_unique<MemoryMappedFile> (octreeFile, MemoryMappedFile::readOnly);
+        const auto* data = static_cast<const uint8*> (mappedFile->getData());
+        const size_t size = mappedFile->getSize();
+
+        if (data == nullptr || size < sizeof (FileHeader))
+            return fail ("Can't map point cloud " + octreeFile.getFullPathName());
+
+        header = reinterpret_cast<const FileHeader*> (data);
+
+        if (memcmp (header->magic, "PCOT", 4) != 0 || header->version != currentVersion)
+            return fail (octreeFile.getFileName() + " is not a point cloud octree, or is from another version");
+
+        // Compared by division, so huge counts in a corrupt header can't overflow
+        const size_t bodySize = size - sizeof (FileHeader);
+
+        if (header->numNodes == 0 || header->numNodes > bodySize / sizeof (Node)
+             || header->numPoints > (bodySize - sizeof (Node) * header->numNodes) / sizeof (Point))
+            return fail (octreeFile.getFileName() + " is truncated");
+
+        nodes = reinterpret_cast<const Node*> (data + sizeof (FileHeader));
+        points = reinterpret_cast<const Point*> (data + sizeof (FileHeader) + sizeof (Node) * header->numNodes);
+
+        for (uint32 i = 0; i < header->numNodes; ++i)
+            if (! isValidNode (i))
+                return fail (octreeFile.getFileName() + " is corrupt: node " + String (i) + " is out of range");
+
+        return Result::ok();
+    }
+
+    bool isOpen() const noexcept                        { return nodes != nullptr; }
+
+    int getNumNodes() const noexcept                    { return isOpen() ? (int) header->numNodes : 0; }
+    uint64 getNumPoints() const noexcept                { return isOpen() ? header->numPoints : 0; }
+    int getPointsPerNode() const noexcept               { return isOpen() ? (int) header->pointsPerNode : 0; }
+    const FileHeader& getHeader() const noexcept        { return *header; }
+
+    const Node& getNode (int index) const noexcept      { return nodes[index]; }
+
+    /** The node's points, straight from the mapping. Touching them may page
+        them in from disk, so avoid doing that first on the render thread. */
+    const Point* getPoints (const Node& node) const noexcept    { return points + node.firstPoint; }
+
+    //==============================================================================
+    /** Reads points for build() from a text file, e.g. an .xyz export, with
+        one point per line: x y z, then optionally r g b in 0..255. Values can
+        be separated by spaces, tabs or commas. Lines starting with '#', and
+        lines with fewer than three values, are skipped. */
+    static Result readTextPoints (const File& textFile, std::vector<Point>& points)
+    {
+        FileInputStream stream (textFile);
+
+        if (! stream.openedOk())
+            return Result::fail ("Can't read " + textFile.getFullPathName());
+
+        while (! stream.isExhausted())
+        {
+            const auto line = stream.readNextLine().trim();
+
+            if (line.isEmpty() || line.startsWithChar ('#'))
+                continue;
+
+            StringArray values;
+            values.addTokens (line, " \t,", {});
+            values.removeEmptyStrings();
+
+            if (values.size() < 3)
+                continue;
+
+            Point point;
+
+            for (int axis = 0; axis < 3; ++axis)
+                point.position[axis] = values[axis].getFloatValue();
+
+            for (int channel = 0; channel < 3; ++channel)
+                point.colour[channel] = (GLubyte) (values.size() >= 6 ? jlimit (0, 255, values[3 + channel].getIntValue()) : 255);
+
+            point.colour[3] = 255;
+            points.push_back (point);
+        }
+
+        if (points.empty())
+            return Result::fail (textFile.getFileName() + " has no points");
+
+        return Result::ok();
+    }
+
+    /** Sorts points into an octree and writes it to `outputFile`.
+
+        The points are visited in a shuffled order, and each one goes into
+        the shallowest node on its path that still has room. That is what
+        makes every node a uniform subsample of its region. The tree is built
+        in memory, so this needs about 8 bytes per point on top of the input.
+     */
+    static Result build (const std::vector<Point>& input, const File& outputFile, int pointsPerNode = 16384)
+    {
+        jassert (pointsPerNode > 0);
+
+        if (input.empty())
+            return Result::fail ("No points to write");
+
+        // A cube around all of the points
+        float boundsMin[3], boundsMax[3];
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            boundsMin[axis] = boundsMax[axis] = input.front().position[axis];
+
+            for (const auto& point : input)
+            {
+                boundsMin[axis] = jmin (boundsMin[axis], point.position[axis]);
+                boundsMax[axis] = jmax (boundsMax[axis], point.position[axis]);
+            }
+        }
+
+        const float halfSize = 0.5f * jmax (boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1],
+                                            boundsMax[2] - boundsMin[2], 1.0e-6f);
+
+        std::vector<Node> nodes (1);
+        std::vector<std::vector<uint32>> nodePoints (1);
+        nodes[0] = makeNode ({ 0.5f * (boundsMin[0] + boundsMax[0]), 0.5f * (boundsMin[1] + boundsMax[1]),
+                               0.5f * (boundsMin[2] + boundsMax[2]) }, halfSize, 0);
+
+        // Fisher-Yates, seeded so the same input always gives the same file
+        std::vector<uint32> order (input.size());
+        std::iota (order.begin(), order.end(), 0u);
+        Random random (0x5eed);
+
+        for (size_t i = order.size() - 1; i > 0; --i)
+            std::swap (order[i], order[(size_t) random.nextInt64() % (i + 1)]);
+
+        for (const auto pointIndex : order)
+        {
+            const auto* position = input[pointIndex].position;
+            size_t node = 0;
+
+            while (nodePoints[node].size() >= (size_t) pointsPerNode && nodes[node].depth < maxDepth)
+            {
+                const int octant = (position[0] >= nodes[node].centre[0] ? 1 : 0)
+                                 | (position[1] >= nodes[node].centre[1] ? 2 : 0)
+                                 | (position[2] >= nodes[node].centre[2] ? 4 : 0);
+
+                if (nodes[node].children[octant] < 0)
+                {
+                    const float childHalfSize = 0.5f * nodes[node].halfSize;
+                    const Node child = makeNode ({ nodes[node].centre[0] + ((octant & 1) ? childHalfSize : -childHalfSize),
+                                                   nodes[node].centre[1] + ((octant & 2) ? childHalfSize : -childHalfSize),
+                                                   nodes[node].centre[2] + ((octant & 4) ? childHalfSize : -childHalfSize) },
+                                                 childHalfSize, nodes[node].depth + 1);
+
+                    nodes[node].children[octant] = (int32) nodes.size();
+                    nodes.push_back (child);
+                    nodePoints.emplace_back();
+                }
+
+                node = (size_t) nodes[node].children[octant];
+            }
+
+            nodePoints[node].push_back (pointIndex);
+        }
+
+        // Assign each node its chunk of the point data
+        uint64 firstPoint = 0;
+
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            nodes[i].firstPoint = firstPoint;
+            nodes[i].numPoints = (uint32) nodePoints[i].size();
+            firstPoint += nodes[i].numPoints;
+        }
+
+        FileHeader header;
+        memcpy (header.magic, "PCOT", 4);
+        header.version = currentVersion;
+        header.numNodes = (uint32) nodes.size();
+        header.pointsPerNode = (uint32) pointsPerNode;
+        header.numPoints = firstPoint;
+        memcpy (header.boundsMin, boundsMin, sizeof (boundsMin));
+        memcpy (header.boundsMax, boundsMax, sizeof (boundsMax));
+
+        // Written next to the target and swapped in, so readers never see half a file
+        TemporaryFile temporaryFile (outputFile);
+
+        {
+            FileOutputStream stream (temporaryFile.getFile());
+
+            if (! stream.openedOk())
+                return Result::fail ("Can't write " + outputFile.getFullPathName());
+
+            bool ok = stream.write (&header, sizeof (header))
+                   && stream.write (nodes.data(), sizeof (Node) * nodes.size());
+
+            for (size_t i = 0; i < nodes.size() && ok; ++i)
+                for (const auto pointIndex : nodePoints[i])
+                    ok = ok && stream.write (&input[pointIndex], sizeof (Point));
+
+            stream.flush();
+
+            if (! ok || stream.getStatus().failed())
+                return Result::fail ("Failed writing " + outputFile.getFullPathName());
+        }
+
+        if (! temporaryFile.overwriteTargetFileWithTemporary())
+            return Result::fail ("Can't replace " + outputFile.getFullPathName());
+
+        return Result::ok();
+    }
+
+private:
+    static Node makeNode (std::array<float, 3> centre, float halfSize, uint32 depth)
+    {
+        Node node;
+        std::copy (centre.begin(), centre.end(), node.centre);
+        node.halfSize = halfSize;
+        std::fill (std::begin (node.children), std::end (node.children), -1);
+        node.firstPoint = 0;
+        node.numPoints = 0;
+        node.depth = depth;
+        return node;
+    }
+
+    /** Checks a node only refers to points and nodes in the file, so that
+        nothing reading the mapping can run off its end. build() always adds
+        children after their parent, so requiring that also rules out cycles. */
+    bool isValidNode (uint32 index) const noexcept
+    {
+        const auto& node = nodes[index];
+
+        if (node.firstPoint > header->numPoints || node.numPoints > header->numPoints - node.firstPoint)
+            return false;
+
+        for (auto child : node.children)
+            if (child >= 0 && ((uint32) child <= index || (uint32) child >= header->numNodes))
+                return false;
+
+        return true;
+    }
+
+    Result fail (const String& message)
+    {
+        mappedFile.reset();
+        header = nullptr;
+        nodes = nullptr;
+        points = nullptr;
+        return Result::fail (message);
+    }
+
+    std::unique_ptr<MemoryMappedFile> mappedFile;
+    const FileHeader* header = nullptr;
+    const Node* nodes = nullptr;
+    const Point* points = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE (PointCloudOctree)
+};
+
+} // namespace Rendering
@@ -0,0 +1,389 @@
+//
+//  PointCloudRenderer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <queue>
+#include <unordered_map>
+#include "../OpenGLUtil/VertexLayout.hpp"
+#include "PointCloudOctree.hpp"
+#include "SimdMath.hpp"
+
+namespace Rendering
+{
+
+/** Draws a PointCloudOctree of any size within a fixed point budget.
+
+    Every frame, `update()` walks the octree from the root, always expanding
+    the visible node with the largest screen-space error next: the projected
+    distance between neighbouring points of that node, in pixels. It stops
+    once the error is small enough everywhere or the next node would exceed
+    the point budget. Nearby regions get detailed nodes, distant ones get
+    coarse ones, and the number of points drawn stays bounded however large
+    the cloud is.
+
+    Chosen nodes are streamed in and out of GPU buffers. A worker thread
+    first reads each node's pages from the mapped file, so the render thread
+    never waits on the disk. A few nodes per frame are then uploaded, coarse
+    ones first. Nodes that haven't been chosen for longest are evicted once
+    the resident point limit is reached. Until a node arrives, its ancestors,
+    which are always chosen first, stand in for it.
+ */
+class PointCloudRenderer
+{
+public:
+    struct Settings
+    {
+        int64 pointBudget = 4000000;            // Most points drawn per frame
+        int64 maxResidentPoints = 16000000;     // GPU buffer limit, 16 bytes per point
+        int maxUploadsPerFrame = 8;             // Nodes
+        float maxScreenSpaceError = 2.0f;       // Pixels between neighbouring points worth refining
+    };
+
+    struct Statistics
+    {
+        int numSelectedNodes = 0, numDrawnNodes = 0, numResidentNodes = 0, numPagingNodes = 0;
+        int64 numDrawnPoints = 0, numResidentPoints = 0;
+
+        String toString() const
+        {
+            return "Points: " + String (numDrawnPoints) + " in " + String (numDrawnNodes) + "/"
+                 + String (numSelectedNodes) + " nodes drawn, " + String (numResidentNodes) + " nodes ("
+                 + String (numResidentPoints) + " points) on GPU, " + String (numPagingNodes) + " paging in";
+        }
+    };
+
+    PointCloudRenderer() = default;
+
+    ~PointCloudRenderer()
+    {
+        // You must call release() while the context is still active
+        jassert (residentNodes.empty());
+    }
+
+    /** Replaces the cloud being drawn. Call on the OpenGL thread. */
+    void setOctree (OpenGLContext& context, std::shared_ptr<const PointCloudOctree> newOctree)
+    {
+        release (context);
+        octree = std::move (newOctree);
+    }
+
+    bool hasOctree() const noexcept                     { return octree != nullptr && octree->isOpen(); }
+
+    void setSettings (const Settings& newSettings)      { settings = newSettings; }
+
+    /** Frees every node's GPU buffers and forgets the page-ins in flight, so
+        a new context or octree starts from nothing. The octree is kept, so
+        drawing can carry on in a new context. */
+    void release (OpenGLContext& context)
+    {
+        for (auto& entry : residentNodes)
+        {
+            vertexArrays.releaseBuffer (context, entry.second.bufferID);
+            context.extensions.glDeleteBuffers (1, &entry.second.bufferID);
+        }
+
+        residentNodes.clear();
+        residentPoints = 0;
+        vertexArrays.release (context);
+
+        // Running paging jobs hold their own flags and octree, so they finish harmlessly
+        pagingNodes.clear();
+        selectedNodes.clear();
+    }
+
+    //==============================================================================
+    /** Chooses the nodes to draw from the camera and streams them in.
+        `modelView` takes the cloud's coordinates into view space. */
+    void update (OpenGLContext& context, const Matrix3D<GLfloat>& modelView,
+                 const Matrix3D<GLfloat>& projection, int viewportHeight)
+    {
+        if (! hasOctree())
+            return;
+
+        ++frameNumber;
+        selectNodes (modelView, projection, viewportHeight);
+        streamNodes (context);
+        evictNodes (context);
+        updateStatistics();
+    }
+
+    /** Draws the resident chosen nodes as GL_POINTS. The caller binds a
+        program for VertexFormats::PositionColour and sets up its uniforms. */
+    void render (OpenGLContext& context)
+    {
+        for (auto nodeIndex : selectedNodes)
+        {
+            auto resident = residentNodes.find (nodeIndex);
+
+            if (resident == residentNodes.end())
+                continue;
+
+            context.extensions.glBindVertexArray (resident->second.vertexArrayID);
+            glDrawArrays (GL_POINTS, 0, (GLsizei) resident->second.numPoints);
+        }
+
+        context.extensions.glBindVertexArray (0);
+    }
+
+    Statistics getStatistics() const
+    {
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        return statistics;
+    }
+
+private:
+    using Point = PointCloudOctree::Point;
+    using Node = PointCloudOctree::Node;
+
+    struct ResidentNode
+    {
+        GLuint bufferID = 0, vertexArrayID = 0;
+        uint32 numPoints = 0;
+        uint32 lastUsedFrame = 0;
+    };
+
+    /** Fills `selectedNodes`, parents before children, most urgent first. */
+    void selectNodes (const Matrix3D<GLfloat>& modelView, const Matrix3D<GLfloat>& projection, int viewportHeight)
+    {
+        const auto modelViewMatrix = Matrix4::fromMatrix3D (modelView);
+        const auto modelViewProjection = modelViewMatrix * Matrix4::fromMatrix3D (projection);
+
+        // Pixels per view space unit at distance 1, and how much the model view scales lengths
+        const float* mv = modelViewMatrix.m;
+        const float pixelsPerUnit = 0.5f * (float) viewportHeight * projection.mat[5];
+        const float scale = std::sqrt (mv[0] * mv[0] + mv[1] * mv[1] + mv[2] * mv[2]);
+        const float spacingPerSize = 2.0f / std::sqrt ((float) octree->getPointsPerNode());
+
+        auto screenSpaceError = [&] (const Node& node)
+        {
+            const float x = mv[0] * node.centre[0] + mv[4] * node.centre[1] + mv[8]  * node.centre[2] + mv[12];
+            const float y = mv[1] * node.centre[0] + mv[5] * node.centre[1] + mv[9]  * node.centre[2] + mv[13];
+            const float z = mv[2] * node.centre[0] + mv[6] * node.centre[1] + mv[10] * node.centre[2] + mv[14];
+            const float radius = node.halfSize * scale * 1.7320508f;
+            const float distance = jmax (std::sqrt (x * x + y * y + z * z) - radius, 1.0e-3f);
+
+            return node.halfSize * spacingPerSize * scale / distance * pixelsPerUnit;
+        };
+
+        using Candidate = std::pair<float, int>; // (error, node index)
+        std::priority_queue<Candidate> candidates;
+        selectedNodes.clear();
+        int64 numSelectedPoints = 0;
+
+        if (isVisible (octree->getNode (0), modelViewProjection))
+            candidates.push ({ screenSpaceError (octree->getNode (0)), 0 });
+
+        while (! candidates.empty())
+        {
+            const auto nodeIndex = candidates.top().second;
+            const bool needsMoreDetail = candidates.top().first > settings.maxScreenSpaceError;
+            candidates.pop();
+
+            const auto& node = octree->getNode (nodeIndex);
+
+            if (numSelectedPoints + node.numPoints > settings.pointBudget)
+                break;
+
+            selectedNodes.push_back (nodeIndex);
+            numSelectedPoints += node.numPoints;
+
+            if (! needsMoreDetail)
+                continue;
+
+            for (auto childIndex : node.children)
+                if (childIndex >= 0 && isVisible (octree->getNode (childIndex), modelViewProjection))
+                    candidates.push ({ screenSpaceError (octree->getNode (childIndex)), childIndex });
+        }
+    }
+
+    /** False if all eight corners of the node lie outside the same clipping plane. */
+    static bool isVisible (const Node& node, const Matrix4& modelViewProjection)
+    {
+        const float* m = modelViewProjection.m;
+        int outsideCount[6] = { 0 };
+
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const float x = node.centre[0] + ((corner & 1) ? node.halfSize : -node.halfSize);
+            const float y = node.centre[1] + ((corner & 2) ? node.halfSize : -node.halfSize);
+            const float z = node.centre[2] + ((corner & 4) ? node.halfSize : -node.halfSize);
+
+            float clip[4];
+
+            for (int row = 0; row < 4; ++row)
+                clip[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z + m[12 + row];
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                outsideCount[axis * 2]     += clip[axis] < -clip[3] ? 1 : 0;
+                outsideCount[axis * 2 + 1] += clip[axis] >  clip[3] ? 1 : 0;
+            }
+        }
+
+        for (auto count : outsideCount)
+            if (count == 8)
+                return false;
+
+        return true;
+    }
+
+    /** Pages in chosen nodes that aren't resident yet, and uploads those
+        that have been paged in, up to the per-frame limit. */
+    void streamNodes (OpenGLContext& context)
+    {
+        int numUploads = 0;
+
+        for (auto nodeIndex : selectedNodes)
+        {
+            auto resident = residentNodes.find (nodeIndex);
+
+            if (resident != residentNodes.end())
+            {
+                resident->second.lastUsedFrame = frameNumber;
+                continue;
+            }
+
+            auto paging = pagingNodes.find (nodeIndex);
+
+            if (paging == pagingNodes.end())
+            {
+                if ((int) pagingNodes.size() < maxPagingNodes)
+                    startPaging (nodeIndex);
+            }
+            else if (paging->second->load() && numUploads < settings.maxUploadsPerFrame)
+            {
+                upload (context, nodeIndex);
+                pagingNodes.erase (paging);
+                ++numUploads;
+            }
+        }
+
+        // Forget finished page-ins nobody wants any more; the OS may drop their pages again
+        for (auto it = pagingNodes.begin(); it != pagingNodes.end();)
+        {
+            if (it->second->load() && std::find (selectedNodes.begin(), selectedNodes.end(), it->first) == selectedNodes.end())
+                it = pagingNodes.erase (it);
+            else
+                ++it;
+        }
+    }
+
+    void startPaging (int nodeIndex)
+    {
+        auto isPagedIn = std::make_shared<std::atomic<bool>> (false);
+        pagingNodes[nodeIndex] = isPagedIn;
+
+        pagingPool.addJob ([cloud = octree, nodeIndex, isPagedIn]
+        {
+            // Touching one byte per page makes the OS read the whole chunk in
+            const auto& node = cloud->getNode (nodeIndex);
+            const auto* bytes = reinterpret_cast<const volatile uint8*> (cloud->getPoints (node));
+            const size_t numBytes = sizeof (Point) * node.numPoints;
+            uint8 checksum = 0;
+
+            for (size_t i = 0; i < numBytes; i += 4096)
+                checksum = (uint8) (checksum + bytes[i]);
+
+            ignoreUnused (checksum);
+            *isPagedIn = true;
+        });
+    }
+
+    void upload (OpenGLContext& context, int nodeIndex)
+    {
+        const auto& node = octree->getNode (nodeIndex);
+        ResidentNode resident;
+        resident.numPoints = node.numPoints;
+        resident.lastUsedFrame = frameNumber;
+
+        context.extensions.glGenBuffers (1, &resident.bufferID);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, resident.bufferID);
+        context.extensions.glBufferData (GL_ARRAY_BUFFER, (GLsizeiptr) (sizeof (Point) * node.numPoints),
+                                         octree->getPoints (node), GL_STATIC_DRAW);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+
+        resident.vertexArrayID = vertexArrays.get<Point::Layout> (context, resident.bufferID);
+        residentNodes[nodeIndex] = resident;
+        residentPoints += node.numPoints;
+    }
+
+    /** Frees the least recently chosen nodes until under the resident limit.
+        Nodes chosen this frame are never evicted. */
+    void evictNodes (OpenGLContext& context)
+    {
+        if (residentPoints <= settings.maxResidentPoints)
+            return;
+
+        std::vector<std::pair<uint32, int>> candidates; // (last used frame, node index)
+
+        for (auto& entry : residentNodes)
+            if (entry.second.lastUsedFrame != frameNumber)
+                candidates.push_back ({ entry.second.lastUsedFrame, entry.first });
+
+        std::sort (candidates.begin(), candidates.end());
+
+        for (auto& candidate : candidates)
+        {
+            if (residentPoints <= settings.maxResidentPoints)
+                break;
+
+            auto& resident = residentNodes[candidate.second];
+            vertexArrays.releaseBuffer (context, resident.bufferID);
+            context.extensions.glDeleteBuffers (1, &resident.bufferID);
+            residentPoints -= resident.numPoints;
+            residentNodes.erase (candidate.second);
+        }
+    }
+
+    void updateStatistics()
+    {
+        Statistics newStatistics;
+        newStatistics.numSelectedNodes = (int) selectedNodes.size();
+        newStatistics.numResidentNodes = (int) residentNodes.size();
+        newStatistics.numResidentPoints = residentPoints;
+        newStatistics.numPagingNodes = (int) pagingNodes.size();
+
+        for (auto nodeIndex : selectedNodes)
+        {
+            auto resident = residentNodes.find (nodeIndex);
+
+            if (resident != residentNodes.end())
+            {
+                ++newStatistics.numDrawnNodes;
+                newStatistics.numDrawnPoints += resident->second.numPoints;
+            }
+        }
+
+        const SpinLock::ScopedLockType sl (statisticsLock);
+        statistics = newStatistics;
+    }
+
+    // Enough to keep the uploads fed without queueing up reads nobody will want
+    static constexpr int maxPagingNodes = 64;
+
+    std::shared_ptr<const PointCloudOctree> octree;
+    Settings settings;
+    uint32 frameNumber = 0;
+
+    std::vector<int> selectedNodes;
+    std::unordered_map<int, ResidentNode> residentNodes;
+    std::unordered_map<int, std::shared_ptr<std::atomic<bool>>> pagingNodes;
+    int64 residentPoints = 0;
+    OpenGLUtil::VertexArrayCache vertexArrays;
+
+    SpinLock statisticsLock;
+    Statistics statistics;
+
+    // Declared last so that it is destroyed, and its jobs finished, first
+    ThreadPool pagingPool { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE (PointCloudRenderer)
+};
+
+} // namespace Rendering
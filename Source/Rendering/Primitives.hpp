@@ -0,0 +1,448 @@
+//
+//  Primitives.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include "../VertexFormats.hpp"
+
+namespace Rendering
+{
+
+/** Indexed parametric shapes with analytic normals and texture coordinates,
+    all fitting the cube from -0.5 to 0.5 like ShapeVertices. Triangles wind
+    counter-clockwise seen from outside.
+
+    getSize() is constexpr, so buffers can be sized at compile time, and
+    generate() writes straight into buffers the caller owns. getCached()
+    generates each shape and tessellation once per program run.
+
+    `tessellation` is the number of segments around a full circle, at least
+    4. Spheres get half as many rings, at least 3, and flat faces a quarter
+    as many subdivisions per edge.
+ */
+namespace Primitives
+{
+
+using Vertex = VertexFormats::PositionNormalTexture;
+using Index = GLuint;
+
+enum class Shape
+{
+    cube,       // Unit cube, each face its own patch so edges stay sharp
+    sphere,     // UV sphere of radius 0.5
+    cylinder,   // Radius 0.5, height 1, capped
+    torus,      // Ring radius 0.35, tube radius 0.15, around y
+    grid,       // Unit square in the xz plane, facing +y
+    capsule     // Radius 0.25, height 1 including the caps
+};
+
+struct Size
+{
+    int numVertices, numIndices;
+};
+
+/** Segments around a full circle, for a tessellation level. */
+constexpr int getSegments (int tessellation) noexcept       { return tessellation < 4 ? 4 : tessellation; }
+
+/** Rings of a sphere, or segments around a torus's tube. */
+constexpr int getRings (int tessellation) noexcept          { return tessellation < 6 ? 3 : getSegments (tessellation) / 2; }
+
+/** Subdivisions of each edge of a flat face. */
+constexpr int getSubdivisions (int tessellation) noexcept   { return tessellation < 8 ? 1 : tessellation / 4; }
+
+/** The number of vertices and indices generate() writes. */
+constexpr Size getSize (Shape shape, int tessellation) noexcept
+{
+    const int segments = getSegments (tessellation);
+    const int rings = getRings (tessellation);
+    const int subdivisions = getSubdivisions (tessellation);
+
+    switch (shape)
+    {
+        case Shape::cube:       return { 6 * (subdivisions + 1) * (subdivisions + 1), 36 * subdivisions * subdivisions };
+        case Shape::grid:       return { (subdivisions + 1) * (subdivisions + 1), 6 * subdivisions * subdivisions };
+        case Shape::sphere:     return { (segments + 1) * (rings + 1), 6 * segments * (rings - 1) };
+        case Shape::cylinder:   return { 6 * (segments + 1), 12 * segments };
+        case Shape::torus:      return { (segments + 1) * (rings + 1), 6 * segments * rings };
+        case Shape::capsule:    return { (segments + 1) * 2 * (subdivisions + 1), 12 * segments * subdivisions };
+    }
+
+    return { 0, 0 };
+}
+
+static_assert (getSize (Shape::cube, 4).numVertices == 24 && getSize (Shape::cube, 4).numIndices == 36,
+               "A cube at the lowest tessellation shares its vertices within each face");
+
+//==============================================================================
+namespace PrimitivesDetail
+{
+
+/** A square patch of (subdivisions + 1)^2 vertices, spanned by `u` and `v`
+    from `centre`. Front-facing along u x v. */
+static void generatePatch (const float* centre, const float* u, const float* v, const float* normal, int subdivisions,
+                           Vertex*& vertices, Index*& indices, Index& nextIndex)
+{
+    const Index first = nextIndex;
+
+    for (int j = 0; j <= subdivisions; ++j)
+    {
+        for (int i = 0; i <= subdivisions; ++i)
+        {
+            const float a = (float) i / (float) subdivisions, b = (float) j / (float) subdivisions;
+            auto& vertex = *vertices++;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                vertex.position[axis] = centre[axis] + (a - 0.5f) * u[axis] + (b - 0.5f) * v[axis];
+                vertex.normal[axis] = normal[axis];
+            }
+
+            vertex.textureCoordinate[0] = a;
+            vertex.textureCoordinate[1] = b;
+        }
+    }
+
+    const Index row = (Index) subdivisions + 1;
+
+    for (Index j = 0; j < (Index) subdivisions; ++j)
+    {
+        for (Index i = 0; i < (Index) subdivisions; ++i)
+        {
+            const Index corner = first + j * row + i;
+            const Index quad[6] = { corner, corner + 1, corner + row + 1, corner, corner + row + 1, corner + row };
+            indices = std::copy (std::begin (quad), std::end (quad), indices);
+        }
+    }
+
+    nextIndex += row * row;
+}
+
+/** One row of a surface of revolution around y: a circle of `radius` at
+    height `y`, with the normal's radial and y components. A row not joined
+    to the previous one starts a new strip, which is how flat caps get their
+    own normals. */
+struct ProfilePoint
+{
+    float radius, y, normalRadial, normalY, v;
+    bool joinsPrevious;
+};
+
+/** Sweeps a profile around the y axis. Rows must run from top to bottom
+    along the outside; rows of zero radius close the surface with triangles. */
+static void generateLathe (const std::vector<ProfilePoint>& profile, int segments,
+                           Vertex*& vertices, Index*& indices, Index& nextIndex)
+{
+    const Index first = nextIndex;
+    const Index row = (Index) segments + 1;
+
+    for (const auto& point : profile)
+    {
+        for (int i = 0; i <= segments; ++i)
+        {
+            const float angle = MathConstants<float>::twoPi * (float) i / (float) segments;
+            const float sine = i == segments ? 0.0f : std::sin (angle);
+            const float cosine = i == segments ? 1.0f : std::cos (angle);
+            auto& vertex = *vertices++;
+
+            vertex.position[0] = point.radius * sine;
+            vertex.position[1] = point.y;
+            vertex.position[2] = point.radius * cosine;
+            vertex.normal[0] = point.normalRadial * sine;
+            vertex.normal[1] = point.normalY;
+            vertex.normal[2] = point.normalRadial * cosine;
+            vertex.textureCoordinate[0] = (float) i / (float) segments;
+            vertex.textureCoordinate[1] = point.v;
+        }
+    }
+
+    for (size_t j = 1; j < profile.size(); ++j)
+    {
+        if (! profile[j].joinsPrevious)
+            continue;
+
+        const bool isTopPole = profile[j - 1].radius == 0.0f;
+        const bool isBottomPole = profile[j].radius == 0.0f;
+
+        for (Index i = 0; i < (Index) segments; ++i)
+        {
+            const Index a = first + (Index) (j - 1) * row + i, b = a + 1, c = b + row, d = a + row;
+            const Index lower[3] = { a, d, c }, upper[3] = { a, c, b };
+
+            if (! isBottomPole)
+                indices = std::copy (std::begin (lower), std::end (lower), indices);
+
+            if (! isTopPole)
+                indices = std::copy (std::begin (upper), std::end (upper), indices);
+        }
+    }
+
+    nextIndex += row * (Index) profile.size();
+}
+
+/** Rows of a circular arc of `radius` centred at height `centreY`, from
+    polar angle `startAngle` to `endAngle`, measured from +y. */
+static void addArc (std::vector<ProfilePoint>& profile, float centreRadius, float centreY, float radius,
+                    float startAngle, float endAngle, int numSteps, bool joinsPrevious)
+{
+    for (int j = 0; j <= numSteps; ++j)
+    {
+        const float angle = startAngle + (endAngle - startAngle) * (float) j / (float) numSteps;
+        const float normalRadial = std::sin (angle), normalY = std::cos (angle);
+        const float pointRadius = jmax (0.0f, centreRadius + radius * normalRadial);
+
+        profile.push_back ({ pointRadius, centreY + radius * normalY, normalRadial, normalY, 0.0f,
+                             j > 0 || joinsPrevious });
+    }
+}
+
+} // namespace PrimitivesDetail
+
+//==============================================================================
+/** Writes getSize (shape, tessellation) vertices and indices into the given
+    buffers. Indices start at `baseVertex`, so several shapes can share one
+    vertex buffer and still be drawn from one index buffer. */
+static void generate (Shape shape, int tessellation, Vertex* vertices, Index* indices, Index baseVertex = 0)
+{
+    using namespace PrimitivesDetail;
+
+    const int segments = getSegments (tessellation);
+    const int rings = getRings (tessellation);
+    const int subdivisions = getSubdivisions (tessellation);
+    Index nextIndex = baseVertex;
+
+    switch (shape)
+    {
+        case Shape::cube:
+        {
+            // Normal, then u and v such that u x v is the normal
+            static const float faces[6][3][3] = {
+                { {  1,  0,  0 }, {  0,  0, -1 }, {  0,  1,  0 } },
+                { { -1,  0,  0 }, {  0,  0,  1 }, {  0,  1,  0 } },
+                { {  0,  1,  0 }, {  1,  0,  0 }, {  0,  0, -1 } },
+                { {  0, -1,  0 }, {  1,  0,  0 }, {  0,  0,  1 } },
+                { {  0,  0,  1 }, {  1,  0,  0 }, {  0,  1,  0 } },
+                { {  0,  0, -1 }, { -1,  0,  0 }, {  0,  1,  0 } }
+            };
+
+            for (const auto& face : faces)
+            {
+                const float centre[3] = { 0.5f * face[0][0], 0.5f * face[0][1], 0.5f * face[0][2] };
+                generatePatch (centre, face[1], face[2], face[0], subdivisions, vertices, indices, nextIndex);
+            }
+
+            break;
+        }
+
+        case Shape::grid:
+        {
+            const float centre[3] = { 0, 0, 0 }, u[3] = { 1, 0, 0 }, v[3] = { 0, 0, -1 }, normal[3] = { 0, 1, 0 };
+            generatePatch (centre, u, v, normal, subdivisions, vertices, indices, nextIndex);
+            break;
+        }
+
+        case Shape::sphere:
+        {
+            std::vector<ProfilePoint> profile;
+            addArc (profile, 0.0f, 0.0f, 0.5f, 0.0f, MathConstants<float>::pi, rings, false);
+
+            for (size_t j = 0; j < profile.size(); ++j)
+                profile[j].v = 1.0f - (float) j / (float) (profile.size() - 1);
+
+            generateLathe (profile, segments, vertices, indices, nextIndex);
+            break;
+        }
+
+        case Shape::cylinder:
+        {
+            const std::vector<ProfilePoint> profile {
+                { 0.0f,  0.5f, 0.0f,  1.0f, 1.0f, false }, { 0.5f,  0.5f, 0.0f,  1.0f, 1.0f, true },
+                { 0.5f,  0.5f, 1.0f,  0.0f, 1.0f, false }, { 0.5f, -0.5f, 1.0f,  0.0f, 0.0f, true },
+                { 0.5f, -0.5f, 0.0f, -1.0f, 0.0f, false }, { 0.0f, -0.5f, 0.0f, -1.0f, 0.0f, true }
+            };
+
+            generateLathe (profile, segments, vertices, indices, nextIndex);
+            break;
+        }
+
+        case Shape::torus:
+        {
+            // The tube's cross-section, starting on the outside and heading down
+            std::vector<ProfilePoint> profile;
+            addArc (profile, 0.35f, 0.0f, 0.15f, MathConstants<float>::halfPi,
+                    MathConstants<float>::halfPi + MathConstants<float>::twoPi, rings, false);
+
+            for (size_t j = 0; j < profile.size(); ++j)
+                profile[j].v = (float) j / (float) (profile.size() - 1);
+
+            generateLathe (profile, segments, vertices, indices, nextIndex);
+            break;
+        }
+
+        case Shape::capsule:
+        {
+            std::vector<ProfilePoint> profile;
+            addArc (profile, 0.0f,  0.25f, 0.25f, 0.0f, MathConstants<float>::halfPi, subdivisions, false);
+            addArc (profile, 0.0f, -0.25f, 0.25f, MathConstants<float>::halfPi, MathConstants<float>::pi, subdivisions, true);
+
+            for (auto& point : profile)
+                point.v = point.y + 0.5f;
+
+            generateLathe (profile, segments, vertices, indices, nextIndex);
+            break;
+        }
+    }
+
+    jassert (nextIndex - baseVertex == (Index) getSize (shape, tessellation).numVertices);
+}
+
+/** A generated shape, for callers that would rather not manage buffers. */
+struct Mesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<Index> indices;
+};
+
+/** Generates each shape and tessellation only once, however many times it
+    is asked for. Safe to call from any thread; the result lives until the
+    program exits. */
+static const Mesh& getCached (Shape shape, int tessellation)
+{
+    static CriticalSection lock;
+    static std::map<std::pair<Shape, int>, std::unique_ptr<Mesh>> cache;
+
+    const ScopedLock sl (lock);
+    auto& mesh = cache[{ shape, tessellation }];
+
+    if (mesh == nullptr)
+    {
+        const auto size = getSize (shape, tessellation);
+        mesh = std::make_unique<Mesh>();
+        mesh->vertices.resize ((size_t) size.numVertices);
+        mesh->indices.resize ((size_t) size.numIndices);
+        generate (shape, tessellation, mesh->vertices.data(), mesh->indices.data());
+    }
+
+    return *mesh;
+}
+
+} // namespace Primitives
+
+//==============================================================================
+/** Keeps every primitive in use in one shared vertex buffer and one shared
+    index buffer. Each shape and tessellation is stored once, however many
+    objects draw it, and all of them share a single VAO, so switching between
+    primitives costs no binds. Draw a primitive's range with glDrawElements,
+    or glDrawElementsInstanced to draw many copies of it in one call.
+
+    The vertices are kept on the CPU too, so a new context can upload them
+    again. Call only on the OpenGL thread.
+ */
+class PrimitiveBuffers
+{
+public:
+    using Vertex = Primitives::Vertex;
+
+    /** Where a primitive lives in the index buffer. */
+    struct Range
+    {
+        GLsizei firstIndex = 0, numIndices = 0;
+
+        /** The `indices` argument to glDrawElements. */
+        const GLvoid* getIndexOffset() const noexcept
+        {
+            return (const GLvoid*) (sizeof (Primitives::Index) * (size_t) firstIndex);
+        }
+    };
+
+    PrimitiveBuffers() = default;
+
+    ~PrimitiveBuffers()
+    {
+        // You must call release() while the context is still active
+        jassert (vertexBufferID == 0);
+    }
+
+    /** Adds the primitive if it isn't stored yet, growing the buffers. */
+    Range get (OpenGLContext& context, Primitives::Shape shape, int tessellation)
+    {
+        auto& range = ranges[{ shape, tessellation }];
+
+        if (range.numIndices == 0)
+        {
+            const auto size = Primitives::getSize (shape, tessellation);
+            const auto baseVertex = (Primitives::Index) vertices.size();
+
+            range.firstIndex = (GLsizei) indices.size();
+            range.numIndices = size.numIndices;
+
+            vertices.resize (vertices.size() + (size_t) size.numVertices);
+            indices.resize (indices.size() + (size_t) size.numIndices);
+            Primitives::generate (shape, tessellation, vertices.data() + baseVertex,
+                                  indices.data() + range.firstIndex, baseVertex);
+
+            needsUpload = true;
+        }
+
+        if (needsUpload || vertexBufferID == 0)
+            upload (context);
+
+        return range;
+    }
+
+    /** Re-specifying the storage keeps the buffer names, so VAOs set up with
+        them stay valid as primitives are added. */
+    void upload (OpenGLContext& context)
+    {
+        if (vertexBufferID == 0)
+        {
+            context.extensions.glGenBuffers (1, &vertexBufferID);
+            context.extensions.glGenBuffers (1, &indexBufferID);
+        }
+
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, vertexBufferID);
+        context.extensions.glBufferData (GL_ARRAY_BUFFER, (GLsizeiptr) (sizeof (Vertex) * vertices.size()),
+                                         vertices.data(), GL_STATIC_DRAW);
+        context.extensions.glBindBuffer (GL_ARRAY_BUFFER, 0);
+
+        // The element array binding belongs to the VAO, so don't disturb whichever one is bound
+        context.extensions.glBindVertexArray (0);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+        context.extensions.glBufferData (GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr) (sizeof (Primitives::Index) * indices.size()),
+                                         indices.data(), GL_STATIC_DRAW);
+        context.extensions.glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        needsUpload = false;
+    }
+
+    /** Frees the GPU buffers but keeps the primitives, ready for upload(). */
+    void release (OpenGLContext& context)
+    {
+        if (vertexBufferID != 0)
+        {
+            context.extensions.glDeleteBuffers (1, &vertexBufferID);
+            context.extensions.glDeleteBuffers (1, &indexBufferID);
+        }
+
+        vertexBufferID = indexBufferID = 0;
+    }
+
+    GLuint getVertexBufferID() const noexcept   { return vertexBufferID; }
+    GLuint getIndexBufferID() const noexcept    { return indexBufferID; }
+
+private:
+    std::vector<Vertex> vertices;
+    std::vector<Primitives::Index> indices;
+    std::map<std::pair<Primitives::Shape, int>, Range> ranges;
+    GLuint vertexBufferID = 0, indexBufferID = 0;
+    bool needsUpload = false;
+
+    JUCE_DECLARE_NON_COPYABLE (PrimitiveBuffers)
+};
+
+} // namespace Rendering
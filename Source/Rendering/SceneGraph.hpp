@@ -0,0 +1,119 @@
+//
+//  SceneGraph.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "SimdMath.hpp"
+
+namespace Rendering
+{
+
+/** A hierarchy of transforms. Each node has a local transform relative to its
+    parent, and a world transform that is the product of its own and all of
+    its ancestors' local transforms.
+
+    Nodes are stored as parallel arrays (parent, local, world, dirty) in
+    topological order: a node is always created after its parent, so its
+    index is greater. `update()` can then walk the arrays once, front to back,
+    and every parent is up to date before its children are reached.
+
+    Changing a local transform only marks the node dirty. `update()` recomputes
+    the world transforms of dirty nodes and their descendants, and nothing
+    else, so a scene that hasn't changed costs nothing per frame.
+ */
+class SceneGraph
+{
+public:
+    using NodeID = uint32;
+
+    /** Created with the graph; every other node descends from it. */
+    static constexpr NodeID root = 0;
+
+    SceneGraph()
+    {
+        addNode (root, {});
+    }
+
+    /** Adds a child of `parent`. Its world transform is valid after the next
+        update(). */
+    NodeID addNode (NodeID parent, const Matrix3D<GLfloat>& localTransform = {})
+    {
+        jassert (parent < (NodeID) parents.size() || parents.empty());
+
+        const auto node = (NodeID) parents.size();
+        parents.push_back (parent);
+        localTransforms.push_back (localTransform);
+        worldTransforms.push_back (localTransform);
+        dirtyFlags.push_back (1);
+
+        firstDirtyNode = jmin (firstDirtyNode, node);
+        return node;
+    }
+
+    void setLocalTransform (NodeID node, const Matrix3D<GLfloat>& newTransform)
+    {
+        localTransforms[node] = newTransform;
+        dirtyFlags[node] = 1;
+        firstDirtyNode = jmin (firstDirtyNode, node);
+    }
+
+    const Matrix3D<GLfloat>& getLocalTransform (NodeID node) const    { return localTransforms[node]; }
+
+    /** As of the last update(). */
+    const Matrix3D<GLfloat>& getWorldTransform (NodeID node) const    { return worldTransforms[node]; }
+
+    NodeID getParent (NodeID node) const                               { return parents[node]; }
+    int getNumNodes() const noexcept                                   { return (int) parents.size(); }
+
+    /** Recomputes the world transforms of every dirty node and its
+        descendants. Returns the number of nodes recomputed, which is zero
+        whenever nothing has changed since the last call. */
+    int update()
+    {
+        const auto numNodes = (NodeID) parents.size();
+
+        if (firstDirtyNode >= numNodes)
+            return 0;
+
+        // First pass: spread dirtiness down the tree and list the nodes to recompute
+        nodesToUpdate.clear();
+
+        for (NodeID node = firstDirtyNode; node < numNodes; ++node)
+        {
+            if (node != root && dirtyFlags[parents[node]] != 0)
+                dirtyFlags[node] = 1;
+
+            if (dirtyFlags[node] != 0)
+                nodesToUpdate.push_back (node);
+        }
+
+        // Second pass: one matrix product per listed node, parents first
+        for (auto node : nodesToUpdate)
+        {
+            if (node == root)
+                worldTransforms[node] = localTransforms[node];
+            else
+                Matrix4::multiply (localTransforms[node].mat, worldTransforms[parents[node]].mat, worldTransforms[node].mat);
+        }
+
+        std::fill (dirtyFlags.begin() + firstDirtyNode, dirtyFlags.end(), (uint8) 0);
+        firstDirtyNode = numNodes;
+
+        return (int) nodesToUpdate.size();
+    }
+
+private:
+    std::vector<NodeID> parents;
+    std::vector<Matrix3D<GLfloat>> localTransforms, worldTransforms;
+    std::vector<uint8> dirtyFlags;
+    NodeID firstDirtyNode = 0;
+
+    std::vector<NodeID> nodesToUpdate;
+};
+
+} // namespace Rendering
@@ -0,0 +1,396 @@
+//
+//  SimdMath.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+ #define RENDERING_SIMD_SSE 1
+ #include <immintrin.h>
+#elif JUCE_ARM && defined (__ARM_NEON)
+ #define RENDERING_SIMD_NEON 1
+ #include <arm_neon.h>
+#endif
+
+#if RENDERING_SIMD_SSE && defined (__AVX__)
+ #define RENDERING_SIMD_AVX 1
+#endif
+
+namespace Rendering
+{
+
+/** Four floats in one SIMD register: SSE on Intel, NEON on ARM, or a plain
+    array where neither is available. Only what the matrix code needs.
+ */
+struct Float4
+{
+   #if RENDERING_SIMD_SSE
+    __m128 v;
+
+    static Float4 load (const float* source) noexcept                 { return { _mm_loadu_ps (source) }; }
+    static Float4 broadcast (float value) noexcept                    { return { _mm_set1_ps (value) }; }
+    void store (float* destination) const noexcept                    { _mm_storeu_ps (destination, v); }
+
+    Float4 operator+ (Float4 other) const noexcept                    { return { _mm_add_ps (v, other.v) }; }
+    Float4 operator* (Float4 other) const noexcept                    { return { _mm_mul_ps (v, other.v) }; }
+
+    /** a * b + c, fused where the target supports it. */
+    static Float4 multiplyAdd (Float4 a, Float4 b, Float4 c) noexcept
+    {
+       #if defined (__FMA__)
+        return { _mm_fmadd_ps (a.v, b.v, c.v) };
+       #else
+        return { _mm_add_ps (_mm_mul_ps (a.v, b.v), c.v) };
+       #endif
+    }
+   #elif RENDERING_SIMD_NEON
+    float32x4_t v;
+
+    static Float4 load (const float* source) noexcept                 { return { vld1q_f32 (source) }; }
+    static Float4 broadcast (float value) noexcept                    { return { vdupq_n_f32 (value) }; }
+    void store (float* destination) const noexcept                    { vst1q_f32 (destination, v); }
+
+    Float4 operator+ (Float4 other) const noexcept                    { return { vaddq_f32 (v, other.v) }; }
+    Float4 operator* (Float4 other) const noexcept                    { return { vmulq_f32 (v, other.v) }; }
+
+    static Float4 multiplyAdd (Float4 a, Float4 b, Float4 c) noexcept { return { vmlaq_f32 (c.v, a.v, b.v) }; }
+   #else
+    float v[4];
+
+    static Float4 load (const float* source) noexcept                 { return { { source[0], source[1], source[2], source[3] } }; }
+    static Float4 broadcast (float value) noexcept                    { return { { value, value, value, value } }; }
+    void store (float* destination) const noexcept                    { std::copy (v, v + 4, destination); }
+
+    Float4 operator+ (Float4 other) const noexcept                    { return { { v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3] } }; }
+    Float4 operator* (Float4 other) const noexcept                    { return { { v[0] * other.v[0], v[1] * other.v[1], v[2] * other.v[2], v[3] * other.v[3] } }; }
+
+    static Float4 multiplyAdd (Float4 a, Float4 b, Float4 c) noexcept { return a * b + c; }
+   #endif
+};
+
+
+//==============================================================================
+/** A 4x4 float matrix with the same memory layout as juce::Matrix3D::mat, so
+    converting between the two is a 64 byte copy. Points transform as in GLSL
+    with the matrix uploaded as is: x' = m[0] x + m[4] y + m[8] z + m[12].
+
+    Aligned to 16 bytes, so arrays of them suit SIMD loads.
+ */
+struct alignas (16) Matrix4
+{
+    float m[16];
+
+    static Matrix4 identity() noexcept
+    {
+        return { { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } };
+    }
+
+    static Matrix4 fromMatrix3D (const Matrix3D<GLfloat>& source) noexcept
+    {
+        Matrix4 result;
+        memcpy (result.m, source.mat, sizeof (result.m));
+        return result;
+    }
+
+    Matrix3D<GLfloat> toMatrix3D() const noexcept
+    {
+        return Matrix3D<GLfloat> (m);
+    }
+
+    /** The transform `*this` followed by `other`, like Matrix3D's operator*. */
+    Matrix4 operator* (const Matrix4& other) const noexcept
+    {
+        Matrix4 result;
+        multiply (m, other.m, result.m);
+        return result;
+    }
+
+    /** The general inverse, by cofactors. Returns the identity for a singular
+        matrix. Prefer `affineInverted()` for rigid and scaling transforms. */
+    Matrix4 inverted() const noexcept
+    {
+        // Determinants of the 2x2 minors in the first two and last two columns
+        const float s0 = m[0] * m[5] - m[4] * m[1],   s1 = m[0] * m[6] - m[4] * m[2];
+        const float s2 = m[0] * m[7] - m[4] * m[3],   s3 = m[1] * m[6] - m[5] * m[2];
+        const float s4 = m[1] * m[7] - m[5] * m[3],   s5 = m[2] * m[7] - m[6] * m[3];
+        const float c5 = m[10] * m[15] - m[14] * m[11], c4 = m[9] * m[15] - m[13] * m[11];
+        const float c3 = m[9] * m[14] - m[13] * m[10],  c2 = m[8] * m[15] - m[12] * m[11];
+        const float c1 = m[8] * m[14] - m[12] * m[10],  c0 = m[8] * m[13] - m[12] * m[9];
+
+        const float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+        if (determinant == 0.0f)
+            return identity();
+
+        const float d = 1.0f / determinant;
+
+        return { { ( m[5] * c5 - m[6] * c4 + m[7] * c3) * d,
+                   (-m[1] * c5 + m[2] * c4 - m[3] * c3) * d,
+                   ( m[13] * s5 - m[14] * s4 + m[15] * s3) * d,
+                   (-m[9] * s5 + m[10] * s4 - m[11] * s3) * d,
+
+                   (-m[4] * c5 + m[6] * c2 - m[7] * c1) * d,
+                   ( m[0] * c5 - m[2] * c2 + m[3] * c1) * d,
+                   (-m[12] * s5 + m[14] * s2 - m[15] * s1) * d,
+                   ( m[8] * s5 - m[10] * s2 + m[11] * s1) * d,
+
+                   ( m[4] * c4 - m[5] * c2 + m[7] * c0) * d,
+                   (-m[0] * c4 + m[1] * c2 - m[3] * c0) * d,
+                   ( m[12] * s4 - m[13] * s2 + m[15] * s0) * d,
+                   (-m[8] * s4 + m[9] * s2 - m[11] * s0) * d,
+
+                   (-m[4] * c3 + m[5] * c1 - m[6] * c0) * d,
+                   ( m[0] * c3 - m[1] * c1 + m[2] * c0) * d,
+                   (-m[12] * s3 + m[13] * s1 - m[14] * s0) * d,
+                   ( m[8] * s3 - m[9] * s1 + m[10] * s0) * d } };
+    }
+
+    /** The inverse of a matrix whose last row is (0, 0, 0, 1), e.g. any mix
+        of rotation, scale and translation. Cheaper than `inverted()`: it only
+        inverts the upper 3x3, then rotates and negates the translation.
+        Returns the identity for a singular matrix. */
+    Matrix4 affineInverted() const noexcept
+    {
+        // Cofactors of the upper 3x3, already transposed into the adjugate
+        const float a0 = m[5] * m[10] - m[9] * m[6],  a1 = m[9] * m[2] - m[1] * m[10], a2 = m[1] * m[6] - m[5] * m[2];
+        const float a4 = m[8] * m[6] - m[4] * m[10],  a5 = m[0] * m[10] - m[8] * m[2], a6 = m[4] * m[2] - m[0] * m[6];
+        const float a8 = m[4] * m[9] - m[8] * m[5],   a9 = m[8] * m[1] - m[0] * m[9],  a10 = m[0] * m[5] - m[4] * m[1];
+
+        const float determinant = m[0] * a0 + m[4] * a1 + m[8] * a2;
+
+        if (determinant == 0.0f)
+            return identity();
+
+        const float d = 1.0f / determinant;
+
+        Matrix4 result { { a0 * d, a1 * d, a2 * d, 0,
+                           a4 * d, a5 * d, a6 * d, 0,
+                           a8 * d, a9 * d, a10 * d, 0,
+                           0, 0, 0, 1 } };
+
+        for (int row = 0; row < 3; ++row)
+            result.m[12 + row] = -(result.m[row] * m[12] + result.m[4 + row] * m[13] + result.m[8 + row] * m[14]);
+
+        return result;
+    }
+
+    /** The matrix that transforms normals: the inverse transpose of the upper
+        3x3, with no translation. */
+    Matrix4 getNormalMatrix() const noexcept
+    {
+        const auto inverse = affineInverted();
+        Matrix4 result = identity();
+
+        for (int column = 0; column < 3; ++column)
+            for (int row = 0; row < 3; ++row)
+                result.m[column * 4 + row] = inverse.m[row * 4 + column];
+
+        return result;
+    }
+
+    /** result = a * b for matrices stored like Matrix3D::mat. `result` may
+        alias neither input. */
+    static void multiply (const float* a, const float* b, float* result) noexcept
+    {
+        const auto b0 = Float4::load (b), b1 = Float4::load (b + 4), b2 = Float4::load (b + 8), b3 = Float4::load (b + 12);
+
+        for (int row = 0; row < 4; ++row)
+        {
+            const float* r = a + row * 4;
+            auto sum = Float4::broadcast (r[0]) * b0;
+            sum = Float4::multiplyAdd (Float4::broadcast (r[1]), b1, sum);
+            sum = Float4::multiplyAdd (Float4::broadcast (r[2]), b2, sum);
+            sum = Float4::multiplyAdd (Float4::broadcast (r[3]), b3, sum);
+            sum.store (result + row * 4);
+        }
+    }
+};
+
+
+//==============================================================================
+/** Positions or directions stored as separate x, y and z arrays, the layout
+    the batch transforms below work on. Any of the pointers may be the same
+    as the matching output pointer, to transform in place.
+ */
+struct SoAVectors
+{
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+struct SoAVectorsOut
+{
+    float* x;
+    float* y;
+    float* z;
+};
+
+
+namespace SimdMathDetail
+{
+    /** Transforms one register's worth of vectors, for any SIMD width. Each
+        lane holds a different vector; matrix elements are broadcast. */
+    template <typename Vector>
+    static void transformLanes (const float* m, bool includeTranslation,
+                                Vector x, Vector y, Vector z, Vector& outX, Vector& outY, Vector& outZ) noexcept
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            auto result = includeTranslation ? Vector::broadcast (m[12 + row]) : Vector::broadcast (0.0f);
+            result = Vector::multiplyAdd (Vector::broadcast (m[row]), x, result);
+            result = Vector::multiplyAdd (Vector::broadcast (m[4 + row]), y, result);
+            result = Vector::multiplyAdd (Vector::broadcast (m[8 + row]), z, result);
+            (row == 0 ? outX : row == 1 ? outY : outZ) = result;
+        }
+    }
+
+   #if RENDERING_SIMD_AVX
+    struct Float8
+    {
+        __m256 v;
+
+        static Float8 load (const float* source) noexcept                  { return { _mm256_loadu_ps (source) }; }
+        static Float8 broadcast (float value) noexcept                     { return { _mm256_set1_ps (value) }; }
+        void store (float* destination) const noexcept                     { _mm256_storeu_ps (destination, v); }
+
+        static Float8 multiplyAdd (Float8 a, Float8 b, Float8 c) noexcept
+        {
+           #if defined (__FMA__)
+            return { _mm256_fmadd_ps (a.v, b.v, c.v) };
+           #else
+            return { _mm256_add_ps (_mm256_mul_ps (a.v, b.v), c.v) };
+           #endif
+        }
+    };
+   #endif
+
+    template <typename Vector, size_t width>
+    static size_t transformBlocks (const Matrix4& matrix, bool includeTranslation,
+                                   SoAVectors input, SoAVectorsOut output, size_t begin, size_t numVectors) noexcept
+    {
+        size_t i = begin;
+
+        for (; i + width <= numVectors; i += width)
+        {
+            Vector x, y, z;
+            transformLanes (matrix.m, includeTranslation,
+                            Vector::load (input.x + i), Vector::load (input.y + i), Vector::load (input.z + i), x, y, z);
+            x.store (output.x + i);
+            y.store (output.y + i);
+            z.store (output.z + i);
+        }
+
+        return i;
+    }
+
+    static void transform (const Matrix4& matrix, bool includeTranslation,
+                           SoAVectors input, SoAVectorsOut output, size_t numVectors) noexcept
+    {
+        size_t i = 0;
+
+       #if RENDERING_SIMD_AVX
+        i = transformBlocks<Float8, 8> (matrix, includeTranslation, input, output, i, numVectors);
+       #endif
+
+       #if RENDERING_SIMD_SSE || RENDERING_SIMD_NEON
+        i = transformBlocks<Float4, 4> (matrix, includeTranslation, input, output, i, numVectors);
+       #endif
+
+        // The last few, one at a time
+        const float* m = matrix.m;
+        const float t = includeTranslation ? 1.0f : 0.0f;
+
+        for (; i < numVectors; ++i)
+        {
+            const float x = input.x[i], y = input.y[i], z = input.z[i];
+            output.x[i] = m[0] * x + m[4] * y + m[8]  * z + m[12] * t;
+            output.y[i] = m[1] * x + m[5] * y + m[9]  * z + m[13] * t;
+            output.z[i] = m[2] * x + m[6] * y + m[10] * z + m[14] * t;
+        }
+    }
+}
+
+/** Transforms `numVectors` points by `matrix`, including its translation. The
+    w row is ignored, so use this for affine transforms; project separately. */
+static void transformPoints (const Matrix4& matrix, SoAVectors input, SoAVectorsOut output, size_t numVectors) noexcept
+{
+    SimdMathDetail::transform (matrix, true, input, output, numVectors);
+}
+
+/** Transforms `numVectors` directions by the upper 3x3 of `matrix`. To
+    transform normals, pass `Matrix4::getNormalMatrix()` and renormalise. */
+static void transformDirections (const Matrix4& matrix, SoAVectors input, SoAVectorsOut output, size_t numVectors) noexcept
+{
+    SimdMathDetail::transform (matrix, false, input, output, numVectors);
+}
+
+
+//==============================================================================
+/** An axis-aligned box. */
+struct Bounds
+{
+    float min[3] = { 0, 0, 0 };
+    float max[3] = { 0, 0, 0 };
+
+    /** The smallest box around `numPoints` positions of three floats, each
+        `stride` bytes after the last, e.g. the positions of interleaved
+        vertices. Empty at the origin if there are no points. */
+    static Bounds around (const float* firstPosition, size_t numPoints, size_t stride) noexcept
+    {
+        Bounds result;
+
+        if (numPoints == 0)
+            return result;
+
+        auto* bytes = reinterpret_cast<const uint8*> (firstPosition);
+        std::copy (firstPosition, firstPosition + 3, result.min);
+        std::copy (firstPosition, firstPosition + 3, result.max);
+
+        for (size_t i = 1; i < numPoints; ++i)
+        {
+            auto* position = reinterpret_cast<const float*> (bytes + i * stride);
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                result.min[axis] = jmin (result.min[axis], position[axis]);
+                result.max[axis] = jmax (result.max[axis], position[axis]);
+            }
+        }
+
+        return result;
+    }
+
+    /** The smallest axis-aligned box that contains this one after `matrix`
+        has been applied, from its centre and extents: the centre transforms
+        as a point, the extents by the absolute values of the 3x3 part. */
+    Bounds transformedBy (const Matrix4& matrix) const noexcept
+    {
+        const float* m = matrix.m;
+        Bounds result;
+
+        for (int row = 0; row < 3; ++row)
+        {
+            float centre = m[12 + row], extent = 0.0f;
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float element = m[axis * 4 + row];
+                centre += element * 0.5f * (min[axis] + max[axis]);
+                extent += std::abs (element) * 0.5f * (max[axis] - min[axis]);
+            }
+
+            result.min[row] = centre - extent;
+            result.max[row] = centre + extent;
+        }
+
+        return result;
+    }
+};
+
+} // namespace Rendering
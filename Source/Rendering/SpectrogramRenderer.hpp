@@ -0,0 +1,203 @@
+//
+//  SpectrogramRenderer.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/AsyncShaderProgram.hpp"
+
+namespace Rendering
+{
+
+/** Draws a scrolling spectrogram from a texture that is only ever written one
+    column at a time.
+
+    The levels live in a GL_R8 texture with one column per spectrum and one
+    row per frequency bin. A new spectrum overwrites the oldest column, at an
+    index that wraps around, and the fragment shader turns that index into a
+    scroll offset. Each new spectrum costs one glTexSubImage2D of `numBins`
+    bytes, however much history is shown. Levels are coloured through a small
+    colour map texture.
+ */
+class SpectrogramRenderer
+{
+public:
+    SpectrogramRenderer() = default;
+
+    ~SpectrogramRenderer()
+    {
+        // You must call release() while the context is still active
+        jassert (levelTextureID == 0);
+    }
+
+    /** Creates the textures for `numBinsToUse` bins and `numColumnsToUse`
+        spectra of history, and starts compiling the shaders. */
+    void create (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions,
+                 int numBinsToUse, int numColumnsToUse)
+    {
+        release (context);
+
+        numBins = numBinsToUse;
+        numColumns = numColumnsToUse;
+        writeColumn = 0;
+        columnBytes.assign ((size_t) numBins, 0);
+
+        // Starts out silent
+        const std::vector<uint8> silence ((size_t) (numBins * numColumns), 0);
+        glGenTextures (1, &levelTextureID);
+        glBindTexture (GL_TEXTURE_2D, levelTextureID);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_R8, numColumns, numBins, 0, GL_RED, GL_UNSIGNED_BYTE, silence.data());
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        createColourMap();
+        glBindTexture (GL_TEXTURE_2D, 0);
+
+        // An empty VAO, since core profiles draw nothing without one
+        context.extensions.glGenVertexArrays (1, &vertexArrayID);
+
+        program.compile (context, functions, BinaryData::FullScreenQuadVertex_glsl, BinaryData::SpectrogramFragment_glsl);
+        hasReflectedUniforms = false;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        program.release (context);
+
+        for (auto* textureID : { &levelTextureID, &colourMapTextureID })
+        {
+            if (*textureID != 0)
+                glDeleteTextures (1, textureID);
+
+            *textureID = 0;
+        }
+
+        if (vertexArrayID != 0)
+            context.extensions.glDeleteVertexArrays (1, &vertexArrayID);
+
+        vertexArrayID = 0;
+    }
+
+    bool isCreated() const noexcept     { return levelTextureID != 0; }
+    int getNumColumns() const noexcept  { return numColumns; }
+
+    /** Adds a spectrum of `numLevels` values in 0..1 as the newest column.
+        Spectra skipped since the last call, going by `sequenceNumber`, are
+        filled with copies of this one so the time axis keeps its scale. Does
+        nothing if the sequence number hasn't changed. */
+    void update (const float* levels, int numLevels, uint32 sequenceNumber)
+    {
+        jassert (isCreated() && numLevels == numBins);
+
+        if (sequenceNumber == lastSequenceNumber)
+            return;
+
+        const int numNewColumns = jlimit (1, numColumns, (int) (sequenceNumber - lastSequenceNumber));
+        lastSequenceNumber = sequenceNumber;
+
+        for (int i = 0; i < numBins; ++i)
+            columnBytes[(size_t) i] = (uint8) roundToInt (255.0f * jlimit (0.0f, 1.0f, levels[i]));
+
+        glBindTexture (GL_TEXTURE_2D, levelTextureID);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+
+        for (int i = 0; i < numNewColumns; ++i)
+        {
+            glTexSubImage2D (GL_TEXTURE_2D, 0, writeColumn, 0, 1, numBins, GL_RED, GL_UNSIGNED_BYTE, columnBytes.data());
+            writeColumn = (writeColumn + 1) % numColumns;
+        }
+
+        glBindTexture (GL_TEXTURE_2D, 0);
+    }
+
+    /** Fills the current viewport with the spectrogram, oldest on the left.
+        Draws nothing until the shaders have linked. */
+    void render (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        if (program.update (context) != OpenGLUtil::AsyncShaderProgram::State::linked)
+            return;
+
+        auto& uniforms = program.getUniforms();
+
+        if (! hasReflectedUniforms)
+        {
+            uniforms.reflect (context, functions, program.getProgramID());
+            uniforms.set (levelTextureUniform, 0);
+            uniforms.set (colourMapTextureUniform, 1);
+            hasReflectedUniforms = true;
+        }
+
+        // The column about to be overwritten is the oldest one
+        uniforms.set (oldestColumnUniform, ((GLfloat) writeColumn + 0.5f) / (GLfloat) numColumns);
+        uniforms.set (columnSpanUniform, (GLfloat) (numColumns - 1) / (GLfloat) numColumns);
+
+        program.use (context);
+        uniforms.upload (context);
+
+        context.extensions.glActiveTexture (GL_TEXTURE1);
+        glBindTexture (GL_TEXTURE_2D, colourMapTextureID);
+        context.extensions.glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, levelTextureID);
+
+        context.extensions.glBindVertexArray (vertexArrayID);
+        glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+        context.extensions.glBindVertexArray (0);
+
+        context.extensions.glActiveTexture (GL_TEXTURE1);
+        glBindTexture (GL_TEXTURE_2D, 0);
+        context.extensions.glActiveTexture (GL_TEXTURE0);
+        glBindTexture (GL_TEXTURE_2D, 0);
+    }
+
+private:
+    /** Black through blue and magenta to yellow and white, as levels rise. */
+    void createColourMap()
+    {
+        constexpr int numColours = 256;
+
+        ColourGradient gradient (Colours::black, 0.0f, 0.0f, Colours::white, 1.0f, 0.0f, false);
+        gradient.addColour (0.25, Colour (0xff1b0c80));
+        gradient.addColour (0.5, Colour (0xffb0237a));
+        gradient.addColour (0.75, Colour (0xfff7a21b));
+
+        std::vector<uint8> pixels;
+
+        for (int i = 0; i < numColours; ++i)
+        {
+            const auto colour = gradient.getColourAtPosition (i / (double) (numColours - 1));
+            pixels.insert (pixels.end(), { colour.getRed(), colour.getGreen(), colour.getBlue(), colour.getAlpha() });
+        }
+
+        glGenTextures (1, &colourMapTextureID);
+        glBindTexture (GL_TEXTURE_2D, colourMapTextureID);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, numColours, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    OpenGLUtil::AsyncShaderProgram program;
+    const OpenGLUtil::UniformHandle<GLint> levelTextureUniform { "levelTexture" };
+    const OpenGLUtil::UniformHandle<GLint> colourMapTextureUniform { "colourMapTexture" };
+    const OpenGLUtil::UniformHandle<GLfloat> oldestColumnUniform { "oldestColumn" };
+    const OpenGLUtil::UniformHandle<GLfloat> columnSpanUniform { "columnSpan" };
+    bool hasReflectedUniforms = false;
+
+    GLuint levelTextureID = 0, colourMapTextureID = 0, vertexArrayID = 0;
+    int numBins = 0, numColumns = 0, writeColumn = 0;
+    uint32 lastSequenceNumber = 0;
+    std::vector<uint8> columnBytes;
+
+    JUCE_DECLARE_NON_COPYABLE (SpectrogramRenderer)
+};
+
+} // namespace Rendering
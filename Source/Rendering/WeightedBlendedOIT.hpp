@@ -0,0 +1,231 @@
+//
+//  WeightedBlendedOIT.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "../OpenGLUtil/AsyncShaderProgram.hpp"
+
+namespace Rendering
+{
+
+/** Weighted blended order-independent transparency (McGuire and Bavoil,
+    2013). Transparent surfaces are drawn in any order, in one pass, into two
+    targets that only ever add or multiply, so the result doesn't depend on
+    the order. A full-screen composite then blends their weighted average
+    colour over the opaque scene.
+
+    - The accumulation target (RGBA16F) sums colour * alpha * weight in rgb,
+      and multiplies (1 - alpha) into its alpha, which ends up as the
+      revealage: how much of the opaque scene shows through.
+    - The weight target (R16F) sums alpha * weight.
+
+    OpenGL 3.2 has one blend function for all draw buffers, so the revealage
+    shares the accumulation target: glBlendFuncSeparate adds the colour
+    channels and multiplies alpha. Fragment shaders write both targets when
+    compiled with WEIGHTED_BLENDED_OIT, see BasicFragment.glsl.
+
+    The opaque scene's depth is copied into the pass, so transparent surfaces
+    behind opaque ones are hidden, but they don't write depth themselves. The
+    copy is a blit, which only works between identical depth formats, so the
+    framebuffer drawn into must be GL_DEPTH24_STENCIL8 like the pass's own:
+    an OffscreenRenderTarget, or a window created with 24 depth and 8
+    stencil bits, as OpenGLComponent sets up.
+ */
+class WeightedBlendedOIT
+{
+public:
+    WeightedBlendedOIT() = default;
+
+    ~WeightedBlendedOIT()
+    {
+        // You must call release() while the context is still active
+        jassert (frameBufferID == 0);
+    }
+
+    /** Creates the targets, or recreates them if the size has changed, and
+        starts compiling the composite shaders. Returns false if the driver
+        can't render to them. */
+    bool prepare (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions, int newWidth, int newHeight)
+    {
+        if (frameBufferID != 0 && newWidth == width && newHeight == height)
+            return true;
+
+        releaseTargets (context);
+
+        width = newWidth;
+        height = newHeight;
+
+        accumulationTextureID = createTexture (GL_RGBA16F, GL_RGBA);
+        weightTextureID = createTexture (GL_R16F, GL_RED);
+
+        context.extensions.glGenRenderbuffers (1, &depthBufferID);
+        context.extensions.glBindRenderbuffer (GL_RENDERBUFFER, depthBufferID);
+        context.extensions.glRenderbufferStorage (GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        context.extensions.glBindRenderbuffer (GL_RENDERBUFFER, 0);
+
+        GLint previousFrameBuffer = 0;
+        glGetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+
+        context.extensions.glGenFramebuffers (1, &frameBufferID);
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, frameBufferID);
+        context.extensions.glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulationTextureID, 0);
+        context.extensions.glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightTextureID, 0);
+        context.extensions.glFramebufferRenderbuffer (GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBufferID);
+
+        const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        functions.glDrawBuffers (2, drawBuffers);
+
+        const bool complete = context.extensions.glCheckFramebufferStatus (GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, (GLuint) previousFrameBuffer);
+
+        if (! complete)
+        {
+            releaseTargets (context);
+            return false;
+        }
+
+        if (program.getState() == OpenGLUtil::AsyncShaderProgram::State::empty)
+        {
+            program.compile (context, functions, BinaryData::FullScreenQuadVertex_glsl,
+                             BinaryData::TransparencyCompositeFragment_glsl);
+            hasReflectedUniforms = false;
+        }
+
+        return true;
+    }
+
+    void release (OpenGLContext& context)
+    {
+        program.release (context);
+        releaseTargets (context);
+    }
+
+    //==============================================================================
+    /** Redirects drawing into the transparency targets, with the depth of the
+        framebuffer that was bound, and sets up blending for the pass. The
+        targets must have been prepared at the size of `viewportArea`. */
+    void begin (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions, Rectangle<int> viewportArea)
+    {
+        jassert (frameBufferID != 0 && viewportArea.getWidth() == width && viewportArea.getHeight() == height);
+
+        glGetIntegerv (GL_DRAW_FRAMEBUFFER_BINDING, &previousFrameBufferID);
+        previousViewport = viewportArea;
+
+        // Opaque surfaces still hide transparent ones behind them. A depth
+        // blit needs matching formats, hence the 24/8 window pixel format
+        context.extensions.glBindFramebuffer (GL_READ_FRAMEBUFFER, (GLuint) previousFrameBufferID);
+        context.extensions.glBindFramebuffer (GL_DRAW_FRAMEBUFFER, frameBufferID);
+        functions.glBlitFramebuffer (viewportArea.getX(), viewportArea.getY(), viewportArea.getRight(), viewportArea.getBottom(),
+                                     0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, frameBufferID);
+        glViewport (0, 0, width, height);
+
+        // Nothing accumulated, everything revealed
+        const GLfloat accumulationClear[] = { 0.0f, 0.0f, 0.0f, 1.0f }, weightClear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        functions.glClearBufferfv (GL_COLOR, 0, accumulationClear);
+        functions.glClearBufferfv (GL_COLOR, 1, weightClear);
+
+        glEnable (GL_DEPTH_TEST);
+        glDepthMask (GL_FALSE);
+        glEnable (GL_BLEND);
+        functions.glBlendFuncSeparate (GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    /** Returns to the framebuffer that was bound at begin() and blends the
+        transparent surfaces over it. Skips the composite until its shaders
+        have linked. */
+    void end (OpenGLContext& context, const OpenGLUtil::CoreProfileFunctions& functions)
+    {
+        context.extensions.glBindFramebuffer (GL_FRAMEBUFFER, (GLuint) previousFrameBufferID);
+        glViewport (previousViewport.getX(), previousViewport.getY(), previousViewport.getWidth(), previousViewport.getHeight());
+
+        glDepthMask (GL_TRUE);
+        glDisable (GL_DEPTH_TEST);
+
+        if (program.update (context) == OpenGLUtil::AsyncShaderProgram::State::linked)
+        {
+            auto& uniforms = program.getUniforms();
+
+            if (! hasReflectedUniforms)
+            {
+                uniforms.reflect (context, functions, program.getProgramID());
+                uniforms.set (accumulationTextureUniform, 0);
+                uniforms.set (weightTextureUniform, 1);
+                hasReflectedUniforms = true;
+            }
+
+            program.use (context);
+            uniforms.upload (context);
+
+            context.extensions.glActiveTexture (GL_TEXTURE1);
+            glBindTexture (GL_TEXTURE_2D, weightTextureID);
+            context.extensions.glActiveTexture (GL_TEXTURE0);
+            glBindTexture (GL_TEXTURE_2D, accumulationTextureID);
+
+            // The composite outputs the average colour and its coverage
+            glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+            if (vertexArrayID == 0)
+                context.extensions.glGenVertexArrays (1, &vertexArrayID);
+
+            context.extensions.glBindVertexArray (vertexArrayID);
+            glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+            context.extensions.glBindVertexArray (0);
+
+            context.extensions.glActiveTexture (GL_TEXTURE1);
+            glBindTexture (GL_TEXTURE_2D, 0);
+            context.extensions.glActiveTexture (GL_TEXTURE0);
+            glBindTexture (GL_TEXTURE_2D, 0);
+        }
+
+        glDisable (GL_BLEND);
+    }
+
+private:
+    GLuint createTexture (GLint internalFormat, GLenum format)
+    {
+        GLuint textureID = 0;
+        glGenTextures (1, &textureID);
+        glBindTexture (GL_TEXTURE_2D, textureID);
+        glTexImage2D (GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_HALF_FLOAT, nullptr);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture (GL_TEXTURE_2D, 0);
+        return textureID;
+    }
+
+    void releaseTargets (OpenGLContext& context)
+    {
+        if (frameBufferID != 0)     context.extensions.glDeleteFramebuffers (1, &frameBufferID);
+        if (depthBufferID != 0)     context.extensions.glDeleteRenderbuffers (1, &depthBufferID);
+        if (vertexArrayID != 0)     context.extensions.glDeleteVertexArrays (1, &vertexArrayID);
+
+        for (auto* textureID : { &accumulationTextureID, &weightTextureID })
+            if (*textureID != 0)
+                glDeleteTextures (1, textureID);
+
+        frameBufferID = depthBufferID = vertexArrayID = accumulationTextureID = weightTextureID = 0;
+        width = height = 0;
+    }
+
+    GLuint frameBufferID = 0, depthBufferID = 0, accumulationTextureID = 0, weightTextureID = 0, vertexArrayID = 0;
+    int width = 0, height = 0;
+    GLint previousFrameBufferID = 0;
+    Rectangle<int> previousViewport;
+
+    OpenGLUtil::AsyncShaderProgram program;
+    const OpenGLUtil::UniformHandle<GLint> accumulationTextureUniform { "accumulationTexture" };
+    const OpenGLUtil::UniformHandle<GLint> weightTextureUniform { "weightTexture" };
+    bool hasReflectedUniforms = false;
+
+    JUCE_DECLARE_NON_COPYABLE (WeightedBlendedOIT)
+};
+
+} // namespace Rendering
@@ -0,0 +1,118 @@
+//
+//  AudioTests.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "SelfTests.hpp"
+#include "../Audio/SpectrumAnalyser.hpp"
+#include "../Audio/SyntheticSignalSource.hpp"
+
+/** Checks that the audio thread's side of the visualiser never waits on the
+    analyser: with the analyser stalled, every `pushSamples()` still returns
+    quickly, and whatever doesn't fit is dropped and counted.
+ */
+class AudioTests : public UnitTest
+{
+public:
+    AudioTests() : UnitTest ("Audio", SelfTests::testCategory) {}
+
+    void runTest() override
+    {
+        beginTest ("SampleFifo drops and counts what doesn't fit");
+        {
+            Audio::SampleFifo fifo (1000);
+            std::vector<float> block ((size_t) blockSize, 0.5f);
+            int64 numRequested = 0, numWritten = 0;
+
+            for (int i = 0; i < 10; ++i)
+            {
+                numWritten += fifo.push (block.data(), blockSize);
+                numRequested += blockSize;
+            }
+
+            // AbstractFifo keeps one slot free
+            expectEquals ((int) numWritten, 999);
+            expectEquals (fifo.getNumDroppedSamples(), numRequested - numWritten);
+
+            std::vector<float> destination (1000);
+            expectEquals (fifo.pop (destination.data(), 1000), 999);
+            expectEquals (fifo.push (block.data(), blockSize), blockSize);
+        }
+
+        beginTest ("pushSamples returns within a bound while the analyser is stalled");
+        {
+            // Never started, so nothing ever reads the ring
+            Audio::SpectrumAnalyser analyser (sampleRate);
+            std::vector<float> block ((size_t) blockSize, 0.5f);
+
+            double maxPushMs = 0.0;
+            int numPushesAfterFull = 0, numExactDrops = 0;
+
+            // Several seconds of audio, far more than the quarter second ring
+            for (int i = 0; i < 400; ++i)
+            {
+                const auto droppedBefore = analyser.getNumDroppedSamples();
+                const auto startTicks = Time::getHighResolutionTicks();
+                analyser.pushSamples (block.data(), blockSize);
+                maxPushMs = jmax (maxPushMs, 1000.0 * Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks));
+
+                // Once something has been dropped the ring is full, so every later block is dropped whole
+                if (droppedBefore > 0)
+                {
+                    ++numPushesAfterFull;
+                    numExactDrops += (analyser.getNumDroppedSamples() - droppedBefore == blockSize) ? 1 : 0;
+                }
+            }
+
+            logMessage ("Slowest push: " + String (maxPushMs, 4) + " ms");
+            expectLessThan (maxPushMs, getMaxPushMs());
+            expectGreaterThan (numPushesAfterFull, 0);
+            expectEquals (numExactDrops, numPushesAfterFull);
+            expectGreaterThan (analyser.getNumDroppedSamples(), (int64) (400 * blockSize) - (int64) sampleRate / 4);
+        }
+
+        beginTest ("A paced source never waits on a stalled analyser, which then recovers");
+        {
+            Audio::SpectrumAnalyser analyser (sampleRate);
+            std::atomic<int64> numPushed { 0 };
+
+            Audio::SyntheticSignalSource source ([&] (const float* samples, int numSamples)
+            {
+                analyser.pushSamples (samples, numSamples);
+                numPushed += numSamples;
+            }, sampleRate, blockSize);
+
+            // Longer than the ring holds, with the analyser stalled throughout
+            source.start();
+            Thread::sleep (600);
+            source.stop();
+
+            logMessage ("Slowest callback: " + String (source.getMaxCallbackTimeMs(), 4) + " ms");
+            expectLessThan (source.getMaxCallbackTimeMs(), getMaxPushMs());
+            expectGreaterThan (analyser.getNumDroppedSamples(), (int64) 0);
+            expectLessThan (analyser.getNumDroppedSamples(), numPushed.load());
+
+            // Whatever the ring kept is analysed once the analyser runs
+            analyser.start();
+            const auto timeout = Time::getMillisecondCounter() + 2000;
+
+            while (analyser.getLatestSpectrum().sequenceNumber == 0 && Time::getMillisecondCounter() < timeout)
+                Thread::sleep (5);
+
+            analyser.stop();
+            expectGreaterThan (analyser.getLatestSpectrum().sequenceNumber, (uint32) 0);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 44100.0;
+    static constexpr int blockSize = 512;
+
+    /** A quarter of a block's duration: far more than a copy into the ring
+        needs, but well short of what waiting on another thread would cost. */
+    static double getMaxPushMs()    { return 0.25 * 1000.0 * blockSize / sampleRate; }
+};
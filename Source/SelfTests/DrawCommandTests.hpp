@@ -0,0 +1,159 @@
+//
+//  DrawCommandTests.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "SelfTests.hpp"
+#include "../Rendering/DrawCommandList.hpp"
+
+/** A key as prepareScene() would make it: a few programs, a couple of hundred
+    materials and meshes, any depth, and some transparent objects, sorted
+    either way. Repeats are likely, which is what stability is about. */
+static uint64 makeRandomSortKey (Random& random)
+{
+    using Rendering::SortKey;
+
+    const auto program = (uint32) random.nextInt (8);
+    const auto material = (Rendering::MaterialID) random.nextInt (200);
+    const auto mesh = (Rendering::MeshID) random.nextInt (300);
+    const auto depth = SortKey::quantiseDepth (0.1f + random.nextFloat() * 99.9f, 0.1f, 100.0f);
+
+    switch (random.nextInt (10))
+    {
+        case 0:  return SortKey::makeTransparent (program, material, mesh, depth);
+        case 1:  return SortKey::makeWeightedBlended (program, material, mesh);
+        case 2:  return SortKey::makeOpaqueFrontToBack (program, material, mesh, depth);
+        default: return SortKey::makeOpaque (program, material, mesh, depth);
+    }
+}
+
+/** Records `keys` in order, with each command's object set to its index,
+    split into `numLists` consecutive runs as the scene's recording jobs do. */
+static void recordSplit (Rendering::DrawCommandQueue& queue, const std::vector<uint64>& keys, int numLists)
+{
+    queue.beginFrame (numLists);
+    const Matrix3D<GLfloat> transform;
+
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const auto list = (int) (i * (size_t) numLists / jmax ((size_t) 1, keys.size()));
+        queue.getList (list).add (keys[i], (uint32) i, 0, 0, transform);
+    }
+}
+
+/** Checks that DrawCommandQueue::merge() orders commands by key, keeping
+    recording order among equal keys, however recording was split up.
+ */
+class DrawCommandTests : public UnitTest
+{
+public:
+    DrawCommandTests() : UnitTest ("DrawCommandQueue", SelfTests::testCategory) {}
+
+    void runTest() override
+    {
+        auto random = getRandom();
+        Rendering::DrawCommandQueue queue;
+
+        beginTest ("merge sorts by key");
+        {
+            for (size_t numCommands : { (size_t) 0, (size_t) 1, (size_t) 2, (size_t) 255, (size_t) 10000 })
+            {
+                const auto keys = makeKeys (random, numCommands);
+                recordSplit (queue, keys, 4);
+                const auto& merged = queue.merge();
+
+                expectEquals ((int) merged.size(), (int) numCommands);
+                expect (std::is_sorted (merged.begin(), merged.end(), [] (const Rendering::DrawCommand* a, const Rendering::DrawCommand* b)
+                        {
+                            return a->sortKey < b->sortKey;
+                        }), "Commands out of key order for " + String ((int) numCommands) + " commands");
+            }
+        }
+
+        beginTest ("merge is stable and independent of the split into lists");
+        {
+            const auto keys = makeKeys (random, 20000);
+
+            // A stable sort of the recording order is the only right answer
+            std::vector<uint32> expected;
+
+            for (uint32 i = 0; i < (uint32) keys.size(); ++i)
+                expected.push_back (i);
+
+            std::stable_sort (expected.begin(), expected.end(), [&keys] (uint32 a, uint32 b) { return keys[a] < keys[b]; });
+
+            for (int numLists : { 1, 2, 3, 8, 64 })
+            {
+                recordSplit (queue, keys, numLists);
+                const auto& merged = queue.merge();
+
+                std::vector<uint32> objects;
+
+                for (auto* command : merged)
+                    objects.push_back (command->object);
+
+                expect (objects == expected, "Order differs from a stable sort with " + String (numLists) + " lists");
+            }
+        }
+    }
+
+private:
+    static std::vector<uint64> makeKeys (Random& random, size_t numKeys)
+    {
+        std::vector<uint64> keys;
+
+        for (size_t i = 0; i < numKeys; ++i)
+            keys.push_back (makeRandomSortKey (random));
+
+        return keys;
+    }
+};
+
+
+/** Times merge() on 100K commands recorded into several lists, against the
+    target of about a millisecond, and std::stable_sort on the same keys.
+ */
+class DrawCommandBenchmark : public UnitTest
+{
+public:
+    DrawCommandBenchmark() : UnitTest ("DrawCommandQueue sort", SelfTests::benchmarkCategory) {}
+
+    void runTest() override
+    {
+        auto random = getRandom();
+        const int numCommands = 100000, numLists = 8;
+
+        std::vector<uint64> keys;
+
+        for (int i = 0; i < numCommands; ++i)
+            keys.push_back (makeRandomSortKey (random));
+
+        beginTest ("Merge 100K commands");
+        {
+            Rendering::DrawCommandQueue queue;
+            recordSplit (queue, keys, numLists);
+
+            double bestSortMs = std::numeric_limits<double>::max();
+            SelfTests::timeBest ([&]
+            {
+                queue.merge();
+                bestSortMs = jmin (bestSortMs, queue.getSortTimeMs());
+            });
+
+            std::vector<uint64> sorted;
+            const double stableSortMs = SelfTests::timeBest ([&]
+            {
+                sorted = keys;
+                std::stable_sort (sorted.begin(), sorted.end());
+            });
+
+            logMessage (String::formatted ("merge():          %8.3f ms, %5.1f ns per command, target about 1 ms",
+                                           bestSortMs, bestSortMs * 1.0e6 / numCommands));
+            logMessage (String::formatted ("std::stable_sort: %8.3f ms, keys only", stableSortMs));
+        }
+    }
+};
@@ -0,0 +1,321 @@
+//
+//  JobSystemTests.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "SelfTests.hpp"
+#include "../Rendering/JobSystem.hpp"
+
+/** Runs `function (callerIndex)` on `numCallers` threads at once, so that
+    they contend for the same JobSystem, and returns when all are done. */
+template <typename Function>
+static void runConcurrently (int numCallers, Function&& function)
+{
+    std::vector<std::thread> callers;
+
+    for (int i = 0; i < numCallers; ++i)
+        callers.emplace_back ([&function, i] { function (i); });
+
+    for (auto& caller : callers)
+        caller.join();
+}
+
+/** Checks that parallelFor and dependency graphs give the same results as a
+    serial run, however their jobs are spread and stolen, while other
+    threads submit work to the same JobSystem.
+ */
+class JobSystemTests : public UnitTest
+{
+public:
+    JobSystemTests() : UnitTest ("JobSystem", SelfTests::testCategory) {}
+
+    void runTest() override
+    {
+        Rendering::JobSystem jobs;
+        logMessage ("Workers: " + String (jobs.getNumWorkers()));
+
+        beginTest ("parallelFor is deterministic under contention");
+        {
+            const size_t numIndices = 100000, grainSize = 257;
+            const size_t numChunks = (numIndices + grainSize - 1) / grainSize;
+            const auto expected = sumChunksSerially (numIndices, grainSize);
+
+            for (int round = 0; round < numRounds; ++round)
+            {
+                std::vector<std::vector<double>> chunkSums (numCallers, std::vector<double> (numChunks));
+                std::vector<std::vector<int>> visits (numCallers, std::vector<int> (numIndices));
+
+                runConcurrently (numCallers, [&] (int caller)
+                {
+                    jobs.parallelFor (0, numIndices, grainSize, [&] (size_t begin, size_t end)
+                    {
+                        chunkSums[(size_t) caller][begin / grainSize] = sumRange (begin, end);
+
+                        for (size_t i = begin; i < end; ++i)
+                            ++visits[(size_t) caller][i];
+                    });
+                });
+
+                jobs.reset();
+
+                for (int caller = 0; caller < numCallers; ++caller)
+                {
+                    // Chunks are combined in order, so any difference is a chunking or visiting bug
+                    expect (chunkSums[(size_t) caller] == expected, "Chunk sums differ from a serial run");
+                    expect (std::all_of (visits[(size_t) caller].begin(), visits[(size_t) caller].end(),
+                                         [] (int n) { return n == 1; }),
+                            "Some index was visited more or less than once");
+                }
+            }
+        }
+
+        beginTest ("Dependency graphs run every job after its prerequisites, under contention");
+        {
+            auto random = getRandom();
+
+            for (int round = 0; round < numRounds; ++round)
+            {
+                const auto graph = makeRandomGraph (random, 300);
+                const auto expected = evaluateSerially (graph);
+
+                std::vector<uint64> values (graph.size());
+                std::vector<int> finishOrder (graph.size());
+                std::atomic<int> numFinished { 0 };
+                std::atomic<bool> isGraphDone { false };
+
+                runConcurrently (numCallers, [&] (int caller)
+                {
+                    if (caller > 0)
+                    {
+                        // Keep the workers and queues busy while the graph runs
+                        while (! isGraphDone)
+                            jobs.parallelFor (0, 4096, 64, [] (size_t begin, size_t end) { sumRange (begin, end); });
+
+                        return;
+                    }
+
+                    std::vector<Rendering::JobSystem::Job*> nodes;
+                    auto* sink = jobs.createJob ([] {});
+
+                    for (size_t i = 0; i < graph.size(); ++i)
+                    {
+                        nodes.push_back (jobs.createJob ([&, i]
+                        {
+                            values[i] = evaluateNode (graph, values, i);
+                            finishOrder[i] = numFinished++;
+                        }));
+
+                        jobs.addDependency (sink, nodes.back());
+                    }
+
+                    for (size_t i = 0; i < graph.size(); ++i)
+                        for (auto prerequisite : graph[i])
+                            jobs.addDependency (nodes[i], nodes[prerequisite]);
+
+                    // Scheduled newest first, so that most jobs start out blocked
+                    for (auto node = nodes.rbegin(); node != nodes.rend(); ++node)
+                        jobs.schedule (*node);
+
+                    jobs.schedule (sink);
+                    jobs.wait (sink);
+                    isGraphDone = true;
+                });
+
+                jobs.reset();
+
+                expect (values == expected, "Graph results differ from a serial run");
+
+                for (size_t i = 0; i < graph.size(); ++i)
+                    for (auto prerequisite : graph[i])
+                        expect (finishOrder[prerequisite] < finishOrder[i], "A job ran before its prerequisite");
+            }
+        }
+
+        beginTest ("Parents finish after their children");
+        {
+            std::atomic<int> numChildrenFinished { 0 };
+            int numChildrenFinishedBeforeParent = -1;
+            const int numChildren = 64;
+
+            auto* parent = jobs.createJob ([] {});
+            auto* afterParent = jobs.createJob ([&] { numChildrenFinishedBeforeParent = numChildrenFinished; });
+            jobs.addDependency (afterParent, parent);
+
+            for (int i = 0; i < numChildren; ++i)
+                jobs.schedule (jobs.createJob ([&] { ++numChildrenFinished; }, parent));
+
+            jobs.schedule (afterParent);
+            jobs.schedule (parent);
+            jobs.wait (afterParent);
+            jobs.reset();
+
+            expectEquals (numChildrenFinishedBeforeParent, numChildren);
+        }
+    }
+
+private:
+    static constexpr int numCallers = 4, numRounds = 20;
+
+    // Prerequisites per node, always earlier nodes, so index order is a valid serial order
+    using Graph = std::vector<std::vector<size_t>>;
+
+    static double sumRange (size_t begin, size_t end)
+    {
+        double sum = 0.0;
+
+        for (size_t i = begin; i < end; ++i)
+            sum += std::sin ((double) i * 0.001);
+
+        return sum;
+    }
+
+    static std::vector<double> sumChunksSerially (size_t numIndices, size_t grainSize)
+    {
+        std::vector<double> sums;
+
+        for (size_t begin = 0; begin < numIndices; begin += grainSize)
+            sums.push_back (sumRange (begin, jmin (numIndices, begin + grainSize)));
+
+        return sums;
+    }
+
+    static Graph makeRandomGraph (Random& random, size_t numNodes)
+    {
+        Graph graph (numNodes);
+
+        for (size_t i = 1; i < numNodes; ++i)
+            for (int n = random.nextInt (4); --n >= 0;)
+                graph[i].push_back ((size_t) random.nextInt ((int) i));
+
+        return graph;
+    }
+
+    /** Mixes the node's index with its prerequisites' values, in a way that
+        depends on their order, so reading a value too early shows up. */
+    static uint64 evaluateNode (const Graph& graph, const std::vector<uint64>& values, size_t node)
+    {
+        uint64 value = (uint64) node + 1;
+
+        for (auto prerequisite : graph[node])
+            value = value * 6364136223846793005ull + values[prerequisite];
+
+        return value;
+    }
+
+    static std::vector<uint64> evaluateSerially (const Graph& graph)
+    {
+        std::vector<uint64> values (graph.size());
+
+        for (size_t i = 0; i < graph.size(); ++i)
+            values[i] = evaluateNode (graph, values, i);
+
+        return values;
+    }
+};
+
+
+/** Times parallelFor and a dependency graph with 1, 2, 4... workers up to
+    the default count, against a serial run on the calling thread.
+ */
+class JobSystemBenchmark : public UnitTest
+{
+public:
+    JobSystemBenchmark() : UnitTest ("JobSystem scaling", SelfTests::benchmarkCategory) {}
+
+    void runTest() override
+    {
+        const int maxWorkers = Rendering::JobSystem().getNumWorkers();
+        const size_t numIndices = 1 << 21, grainSize = 4096;
+        std::vector<float> output (numIndices);
+
+        beginTest ("parallelFor scaling");
+        {
+            const double serialMs = SelfTests::timeBest ([&] { transformRange (output, 0, numIndices); });
+            logMessage (String::formatted ("Serial:      %8.2f ms", serialMs));
+
+            for (int numWorkers = 1;; numWorkers = jmin (maxWorkers, numWorkers * 2))
+            {
+                Rendering::JobSystem jobs (numWorkers);
+
+                const double ms = SelfTests::timeBest ([&]
+                {
+                    jobs.parallelFor (0, numIndices, grainSize, [&] (size_t begin, size_t end)
+                    {
+                        transformRange (output, begin, end);
+                    });
+
+                    jobs.reset();
+                });
+
+                logMessage (String::formatted ("%2d workers:  %8.2f ms, %5.2fx serial", numWorkers, ms, serialMs / ms));
+
+                if (numWorkers == maxWorkers)
+                    break;
+            }
+        }
+
+        beginTest ("Dependency graph overhead");
+        {
+            // Layers of small jobs, each depending on two jobs of the layer before
+            const int numLayers = 64, jobsPerLayer = 64;
+
+            for (int numWorkers = 1;; numWorkers = jmin (maxWorkers, numWorkers * 2))
+            {
+                Rendering::JobSystem jobs (numWorkers);
+
+                const double ms = SelfTests::timeBest ([&]
+                {
+                    std::vector<Rendering::JobSystem::Job*> all, previous, current;
+                    auto* sink = jobs.createJob ([] {});
+
+                    for (int layer = 0; layer < numLayers; ++layer)
+                    {
+                        current.clear();
+
+                        for (int i = 0; i < jobsPerLayer; ++i)
+                        {
+                            const size_t begin = (size_t) (layer * jobsPerLayer + i) * 256;
+                            current.push_back (jobs.createJob ([&output, begin] { transformRange (output, begin, begin + 256); }));
+                            jobs.addDependency (sink, current.back());
+                            all.push_back (current.back());
+
+                            if (! previous.empty())
+                            {
+                                jobs.addDependency (current.back(), previous[(size_t) i]);
+                                jobs.addDependency (current.back(), previous[(size_t) (i + 1) % previous.size()]);
+                            }
+                        }
+
+                        previous = current;
+                    }
+
+                    // Every dependency is declared, so the jobs can be let go now
+                    for (auto* job : all)
+                        jobs.schedule (job);
+
+                    jobs.schedule (sink);
+
+                    jobs.wait (sink);
+                    jobs.reset();
+                });
+
+                logMessage (String::formatted ("%2d workers:  %8.2f ms, %6.2f us per job",
+                                               numWorkers, ms, ms * 1000.0 / (numLayers * jobsPerLayer)));
+
+                if (numWorkers == maxWorkers)
+                    break;
+            }
+        }
+    }
+
+private:
+    static void transformRange (std::vector<float>& output, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+            output[i] = std::sqrt ((float) i) * std::sin ((float) i * 0.01f);
+    }
+};
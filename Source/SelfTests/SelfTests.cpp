@@ -0,0 +1,39 @@
+//
+//  SelfTests.cpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#include "SelfTests.hpp"
+#include "AudioTests.hpp"
+#include "DrawCommandTests.hpp"
+#include "JobSystemTests.hpp"
+#include "SimdMathTests.hpp"
+
+namespace SelfTests
+{
+// Constructing a UnitTest registers it with the runner
+static AudioTests audioTests;
+static DrawCommandTests drawCommandTests;
+static DrawCommandBenchmark drawCommandBenchmark;
+static JobSystemTests jobSystemTests;
+static JobSystemBenchmark jobSystemBenchmark;
+static SimdMathTests simdMathTests;
+static SimdMathBenchmark simdMathBenchmark;
+
+int run (const String& category)
+{
+    UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runTestsInCategory (category);
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    return numFailures;
+}
+
+} // namespace SelfTests
@@ -0,0 +1,46 @@
+//
+//  SelfTests.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** Tests and benchmarks for the parts of the app that don't need an OpenGL
+    context. They are juce::UnitTests, registered in SelfTests.cpp, and run
+    from the command line before any window opens:
+
+        --self-test    runs the tests; the app returns 1 if any of them fail
+        --benchmark    runs the benchmarks and logs their timings
+ */
+namespace SelfTests
+{
+static const char* const testCategory = "Self Test";
+static const char* const benchmarkCategory = "Benchmark";
+
+/** Runs every UnitTest in the category, logging as it goes, and returns the
+    number of failed expectations. */
+int run (const String& category);
+
+/** The best of a few runs of `function`, after one to warm up, in
+    milliseconds. */
+template <typename Function>
+double timeBest (Function&& function, int numRuns = 8)
+{
+    function();
+    double best = std::numeric_limits<double>::max();
+
+    for (int i = 0; i < numRuns; ++i)
+    {
+        const double start = Time::getMillisecondCounterHiRes();
+        function();
+        best = jmin (best, Time::getMillisecondCounterHiRes() - start);
+    }
+
+    return best;
+}
+
+} // namespace SelfTests
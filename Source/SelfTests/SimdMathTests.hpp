@@ -0,0 +1,213 @@
+//
+//  SimdMathTests.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "SelfTests.hpp"
+#include "../Rendering/SimdMath.hpp"
+
+/** A random mix of rotation, non-uniform scale and translation. */
+static Rendering::Matrix4 makeRandomAffineMatrix (Random& random)
+{
+    auto next = [&random] (float low, float high) { return low + random.nextFloat() * (high - low); };
+
+    const float angle = next (-3.0f, 3.0f), cosine = std::cos (angle), sine = std::sin (angle);
+    const float sx = next (0.5f, 2.0f), sy = next (0.5f, 2.0f), sz = next (0.5f, 2.0f);
+
+    // A rotation about z, scaled per axis, then translated
+    return { { cosine * sx, sine * sx, 0, 0,
+               -sine * sy, cosine * sy, 0, 0,
+               0, 0, sz, 0,
+               next (-10.0f, 10.0f), next (-10.0f, 10.0f), next (-10.0f, 10.0f), 1 } };
+}
+
+/** Checks the SIMD matrix code against juce::Matrix3D and plain scalar
+    loops, including the leftovers after the last full SIMD block.
+ */
+class SimdMathTests : public UnitTest
+{
+public:
+    SimdMathTests() : UnitTest ("SimdMath", SelfTests::testCategory) {}
+
+    void runTest() override
+    {
+        auto random = getRandom();
+
+        beginTest ("Matrix4 multiplies like Matrix3D");
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                const auto a = makeRandomAffineMatrix (random), b = makeRandomAffineMatrix (random);
+                const auto expected = a.toMatrix3D() * b.toMatrix3D();
+                expectMatricesNear ((a * b).m, expected.mat);
+            }
+        }
+
+        beginTest ("affineInverted matches inverted");
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                const auto matrix = makeRandomAffineMatrix (random);
+                expectMatricesNear (matrix.affineInverted().m, matrix.inverted().m);
+                expectMatricesNear ((matrix * matrix.affineInverted()).m, Rendering::Matrix4::identity().m);
+            }
+
+            Rendering::Matrix4 singular {};
+            singular.m[15] = 1.0f;
+            expectMatricesNear (singular.affineInverted().m, Rendering::Matrix4::identity().m);
+        }
+
+        beginTest ("transformPoints matches a scalar loop");
+        {
+            const auto matrix = makeRandomAffineMatrix (random);
+
+            for (size_t numPoints : { (size_t) 0, (size_t) 1, (size_t) 7, (size_t) 8, (size_t) 13, (size_t) 1000 })
+            {
+                std::vector<float> x (numPoints), y (numPoints), z (numPoints);
+
+                for (size_t i = 0; i < numPoints; ++i)
+                {
+                    x[i] = random.nextFloat() * 20.0f - 10.0f;
+                    y[i] = random.nextFloat() * 20.0f - 10.0f;
+                    z[i] = random.nextFloat() * 20.0f - 10.0f;
+                }
+
+                std::vector<float> outX (numPoints), outY (numPoints), outZ (numPoints);
+                Rendering::transformPoints (matrix, { x.data(), y.data(), z.data() },
+                                            { outX.data(), outY.data(), outZ.data() }, numPoints);
+
+                const float* m = matrix.m;
+                float maxError = 0.0f;
+
+                for (size_t i = 0; i < numPoints; ++i)
+                {
+                    maxError = jmax (maxError, std::abs (outX[i] - (m[0] * x[i] + m[4] * y[i] + m[8]  * z[i] + m[12])));
+                    maxError = jmax (maxError, std::abs (outY[i] - (m[1] * x[i] + m[5] * y[i] + m[9]  * z[i] + m[13])));
+                    maxError = jmax (maxError, std::abs (outZ[i] - (m[2] * x[i] + m[6] * y[i] + m[10] * z[i] + m[14])));
+                }
+
+                expect (maxError < 1.0e-4f, "Transformed points differ for " + String ((int) numPoints) + " points");
+            }
+        }
+    }
+
+private:
+    void expectMatricesNear (const float* actual, const float* expected)
+    {
+        float maxError = 0.0f;
+
+        for (int i = 0; i < 16; ++i)
+            maxError = jmax (maxError, std::abs (actual[i] - expected[i]));
+
+        expect (maxError < 1.0e-4f, "Matrices differ by " + String (maxError, 6));
+    }
+};
+
+
+/** Times Matrix4 and the batch transforms against juce::Matrix3D and the
+    Vector3D loop they replace, on the same data.
+ */
+class SimdMathBenchmark : public UnitTest
+{
+public:
+    SimdMathBenchmark() : UnitTest ("SimdMath vs Matrix3D", SelfTests::benchmarkCategory) {}
+
+    void runTest() override
+    {
+        auto random = getRandom();
+        const int numMatrices = 4096, numPoints = 1 << 16;
+
+        std::vector<Rendering::Matrix4> matrices, products (numMatrices);
+        std::vector<Matrix3D<GLfloat>> juceMatrices, juceProducts (numMatrices);
+
+        for (int i = 0; i < numMatrices; ++i)
+        {
+            matrices.push_back (makeRandomAffineMatrix (random));
+            juceMatrices.push_back (matrices.back().toMatrix3D());
+        }
+
+        beginTest ("Matrix multiplication");
+        {
+            const double juceMs = SelfTests::timeBest ([&]
+            {
+                for (int i = 0; i < numMatrices; ++i)
+                    juceProducts[(size_t) i] = juceMatrices[(size_t) i] * juceMatrices[(size_t) (numMatrices - 1 - i)];
+            });
+
+            const double simdMs = SelfTests::timeBest ([&]
+            {
+                for (int i = 0; i < numMatrices; ++i)
+                    products[(size_t) i] = matrices[(size_t) i] * matrices[(size_t) (numMatrices - 1 - i)];
+            });
+
+            logComparison ("Matrix3D operator*", juceMs, "Matrix4 operator*", simdMs, numMatrices);
+        }
+
+        beginTest ("Matrix inversion");
+        {
+            // Matrix3D has no inverse, so this compares the two of ours
+            const double generalMs = SelfTests::timeBest ([&]
+            {
+                for (int i = 0; i < numMatrices; ++i)
+                    products[(size_t) i] = matrices[(size_t) i].inverted();
+            });
+
+            const double affineMs = SelfTests::timeBest ([&]
+            {
+                for (int i = 0; i < numMatrices; ++i)
+                    products[(size_t) i] = matrices[(size_t) i].affineInverted();
+            });
+
+            logComparison ("inverted()", generalMs, "affineInverted()", affineMs, numMatrices);
+        }
+
+        beginTest ("Point transforms");
+        {
+            std::vector<Vector3D<GLfloat>> points, transformed ((size_t) numPoints);
+            std::vector<float> x, y, z, outX ((size_t) numPoints), outY ((size_t) numPoints), outZ ((size_t) numPoints);
+
+            for (int i = 0; i < numPoints; ++i)
+            {
+                points.push_back ({ random.nextFloat(), random.nextFloat(), random.nextFloat() });
+                x.push_back (points.back().x);
+                y.push_back (points.back().y);
+                z.push_back (points.back().z);
+            }
+
+            const auto& juceMatrix = juceMatrices.front();
+
+            // Matrix3D can't transform a Vector3D itself, so this is the loop it takes by hand
+            const double vectorMs = SelfTests::timeBest ([&]
+            {
+                const float* m = juceMatrix.mat;
+
+                for (size_t i = 0; i < points.size(); ++i)
+                {
+                    const auto& p = points[i];
+                    transformed[i] = { m[0] * p.x + m[4] * p.y + m[8]  * p.z + m[12],
+                                       m[1] * p.x + m[5] * p.y + m[9]  * p.z + m[13],
+                                       m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14] };
+                }
+            });
+
+            const double simdMs = SelfTests::timeBest ([&]
+            {
+                Rendering::transformPoints (matrices.front(), { x.data(), y.data(), z.data() },
+                                            { outX.data(), outY.data(), outZ.data() }, (size_t) numPoints);
+            });
+
+            logComparison ("Vector3D loop", vectorMs, "transformPoints", simdMs, numPoints);
+        }
+    }
+
+private:
+    void logComparison (const String& baselineName, double baselineMs, const String& name, double ms, int numItems)
+    {
+        logMessage (String::formatted ("%-20s %8.1f ns each", baselineName.toRawUTF8(), baselineMs * 1.0e6 / numItems));
+        logMessage (String::formatted ("%-20s %8.1f ns each, %5.2fx faster", name.toRawUTF8(), ms * 1.0e6 / numItems, baselineMs / ms));
+    }
+};
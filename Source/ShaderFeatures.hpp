@@ -0,0 +1,46 @@
+//
+//  ShaderFeatures.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** The optional features of the GLSL programs in Resources/OpenGLShaderPrograms.
+    Each one is a #define that the shaders test with #ifdef, and each mesh
+    selects the program variant matching the vertex data it has.
+ */
+namespace ShaderFeatures
+{
+
+enum Feature : uint32
+{
+    hasNormals              = 1 << 0,   /**< Normals at attribute location 1, lit with a headlight. */
+    hasTextureCoordinates   = 1 << 1,   /**< Texture coordinates at location 2, modulating the colour. */
+    
+    /** With hasTextureCoordinates: three texture coordinates, the third one
+        selecting a layer of a texture array, see TextureArrayPacker. */
+    hasTextureLayers        = 1 << 2,
+    
+    /** A per-vertex colour at location 7, multiplying the object's colour. */
+    hasVertexColours        = 1 << 3,
+    
+    /** Not a property of the mesh: the variant drawn in the transparent pass,
+        writing the two targets of Rendering::WeightedBlendedOIT. */
+    isWeightedBlended       = 1 << 4
+};
+
+/** The #define names, in bit order. */
+static StringArray getDefineNames()
+{
+    return { "HAS_NORMALS", "HAS_TEXTURE_COORDINATES", "HAS_TEXTURE_LAYERS", "HAS_VERTEX_COLOURS", "WEIGHTED_BLENDED_OIT" };
+}
+
+/** The variant depth-only draws use. No feature moves vertices, so every
+    mesh's depth is drawn by the plain position-only program. */
+static constexpr uint32 depthOnly = 0;
+
+} // namespace ShaderFeatures
@@ -0,0 +1,40 @@
+//
+//  ShaderUniformBlocks.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/** CPU side mirrors of the std140 uniform blocks declared in the GLSL programs
+    in Resources/OpenGLShaderPrograms. If you change a block in GLSL, change the
+    matching struct here too.
+ */
+namespace ShaderUniformBlocks
+{
+
+/** Binding points shared by every shader program. */
+enum BindingPoint : GLuint
+{
+    cameraBindingPoint = 0,
+    objectBindingPoint = 1
+};
+
+/** Per-frame camera data. Uploaded only when the camera changes. */
+struct CameraUniforms
+{
+    GLfloat projectionMatrix[16];
+    GLfloat viewMatrix[16];
+};
+
+/** Per-object data. One record per draw, selected with a ranged bind. */
+struct ObjectUniforms
+{
+    GLfloat modelMatrix[16];
+    GLfloat colour[4];
+};
+
+} // namespace ShaderUniformBlocks
@@ -0,0 +1,84 @@
+//
+//  VertexFormats.hpp
+//  OpenGL 3D App Template - App
+//
+//  Copyright © 2020 TesserAct Music Technology LLC. All rights reserved.
+//
+
+#pragma once
+
+#include "OpenGLUtil/VertexLayout.hpp"
+#include "ShaderFeatures.hpp"
+
+/** The vertex formats meshes can use, with their compile-time layouts. The
+    attribute locations match the layout (location = N) inputs of
+    BasicVertex.glsl, and each format names the ShaderFeatures its program
+    variant needs.
+ */
+namespace VertexFormats
+{
+using OpenGLUtil::VertexAttribute;
+using OpenGLUtil::VertexLayout;
+
+/** Position only, e.g. the vertices from ShapeVertices. */
+using PositionLayout = VertexLayout<VertexAttribute<0, GLfloat, 3>>;
+static_assert (sizeof (Vector3D<GLfloat>) == PositionLayout::stride, "Vector3D must be tightly packed");
+
+/** Position, normal and texture coordinates. */
+struct PositionNormalTexture
+{
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLfloat textureCoordinate[2];
+    
+    using Layout = VertexLayout<VertexAttribute<0, GLfloat, 3>,
+                                VertexAttribute<1, GLfloat, 3>,
+                                VertexAttribute<2, GLfloat, 2>>;
+    static constexpr uint32 shaderFeatures = ShaderFeatures::hasNormals | ShaderFeatures::hasTextureCoordinates;
+};
+
+/** Position, normal and texture coordinates into a texture array, the third
+    coordinate being the layer. Lets meshes with different textures be merged
+    into one draw. */
+struct PositionNormalLayeredTexture
+{
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLfloat textureCoordinate[3];
+    
+    using Layout = VertexLayout<VertexAttribute<0, GLfloat, 3>,
+                                VertexAttribute<1, GLfloat, 3>,
+                                VertexAttribute<2, GLfloat, 3>>;
+    static constexpr uint32 shaderFeatures = ShaderFeatures::hasNormals | ShaderFeatures::hasTextureCoordinates
+                                           | ShaderFeatures::hasTextureLayers;
+};
+
+/** Position and an 8 bit RGBA colour, e.g. the points of a PointCloudOctree. */
+struct PositionColour
+{
+    GLfloat position[3];
+    GLubyte colour[4];
+    
+    using Layout = VertexLayout<VertexAttribute<0, GLfloat, 3>,
+                                VertexAttribute<7, GLubyte, 4, true>>;
+    static constexpr uint32 shaderFeatures = ShaderFeatures::hasVertexColours;
+};
+
+static_assert (sizeof (PositionNormalTexture) == PositionNormalTexture::Layout::stride, "Layout doesn't match PositionNormalTexture");
+static_assert (sizeof (PositionNormalLayeredTexture) == PositionNormalLayeredTexture::Layout::stride, "Layout doesn't match PositionNormalLayeredTexture");
+static_assert (sizeof (PositionColour) == PositionColour::Layout::stride, "Layout doesn't match PositionColour");
+
+// The stride can't tell fields apart, so check each attribute lines up with its field too
+static_assert (PositionNormalTexture::Layout::hasOffsets ({ offsetof (PositionNormalTexture, position),
+                                                            offsetof (PositionNormalTexture, normal),
+                                                            offsetof (PositionNormalTexture, textureCoordinate) }),
+               "Attributes don't match PositionNormalTexture's fields");
+static_assert (PositionNormalLayeredTexture::Layout::hasOffsets ({ offsetof (PositionNormalLayeredTexture, position),
+                                                                   offsetof (PositionNormalLayeredTexture, normal),
+                                                                   offsetof (PositionNormalLayeredTexture, textureCoordinate) }),
+               "Attributes don't match PositionNormalLayeredTexture's fields");
+static_assert (PositionColour::Layout::hasOffsets ({ offsetof (PositionColour, position),
+                                                     offsetof (PositionColour, colour) }),
+               "Attributes don't match PositionColour's fields");
+
+} // namespace VertexFormats